@@ -57,6 +57,7 @@
 %constant int OP_SYNONYM = Xapian::Query::OP_SYNONYM;
 %constant int OP_MAX = Xapian::Query::OP_MAX;
 %constant int OP_WILDCARD = Xapian::Query::OP_WILDCARD;
+%constant int OP_EDIT_DISTANCE = Xapian::Query::OP_EDIT_DISTANCE;
 %constant int OP_VALUE_LE = Xapian::Query::OP_VALUE_LE;
 %constant int FLAG_BOOLEAN = Xapian::QueryParser::FLAG_BOOLEAN;
 %constant int FLAG_PHRASE = Xapian::QueryParser::FLAG_PHRASE;
@@ -5,6 +5,7 @@ noinst_HEADERS +=\
 	api/emptypostlist.h\
 	api/leafpostlist.h\
 	api/maptermlist.h\
+	api/msetcache.h\
 	api/omenquireinternal.h\
 	api/postlist.h\
 	api/queryinternal.h\
@@ -12,7 +13,8 @@ noinst_HEADERS +=\
 	api/replication.h\
 	api/smallvector.h\
 	api/termlist.h\
-	api/vectortermlist.h
+	api/vectortermlist.h\
+	api/wildcardpattern.h
 
 EXTRA_DIST +=\
 	api/Makefile
@@ -30,6 +32,7 @@ lib_src +=\
 	api/keymaker.cc\
 	api/leafpostlist.cc\
 	api/matchspy.cc\
+	api/msetcache.cc\
 	api/omdatabase.cc\
 	api/omdocument.cc\
 	api/omenquire.cc\
@@ -48,4 +51,5 @@ lib_src +=\
 	api/valueiterator.cc\
 	api/valuerangeproc.cc\
 	api/valuesetmatchdecider.cc\
-	api/vectortermlist.cc
+	api/vectortermlist.cc\
+	api/wildcardpattern.cc
@@ -84,11 +84,14 @@ class Compactor::Internal : public Xapian::Internal::intrusive_base {
     string destdir_compat;
     size_t block_size;
     unsigned flags;
+    unsigned max_threads;
 
     vector<string> srcdirs_compat;
 
   public:
-    Internal() : block_size(8192), flags(FULL) { }
+    Internal() : block_size(8192), flags(FULL), max_threads(1) { }
+
+    unsigned get_max_threads() const { return max_threads; }
 };
 
 Compactor::Compactor() : internal(new Compactor::Internal()) { }
@@ -107,6 +110,14 @@ Compactor::set_flags_(unsigned flags, unsigned mask)
     internal->flags = (internal->flags & mask) | flags;
 }
 
+void
+Compactor::set_max_threads(unsigned max_threads)
+{
+    if (max_threads == 0)
+	throw Xapian::InvalidArgumentError("max_threads must be at least 1");
+    internal->max_threads = max_threads;
+}
+
 void
 Compactor::set_destdir(const string & destdir)
 {
@@ -383,6 +394,9 @@ Database::compact_(const string * output_ptr, int fd, unsigned flags,
 
     Xapian::Compactor::compaction_level compaction =
 	static_cast<Xapian::Compactor::compaction_level>(flags & (Xapian::Compactor::STANDARD|Xapian::Compactor::FULL|Xapian::Compactor::FULLER));
+    unsigned max_threads = 1;
+    if (compactor)
+	max_threads = compactor->internal->get_max_threads();
     if (backend == BACKEND_CHERT) {
 #ifdef XAPIAN_HAS_CHERT_BACKEND
 	ChertDatabase::compact(compactor, destdir.c_str(), internals, offset,
@@ -402,11 +416,13 @@ Database::compact_(const string * output_ptr, int fd, unsigned flags,
 	if (output_ptr) {
 	    GlassDatabase::compact(compactor, destdir.c_str(), 0,
 				   internals, offset,
-				   block_size, compaction, flags, last_docid);
+				   block_size, compaction, flags, last_docid,
+				   max_threads);
 	} else {
 	    GlassDatabase::compact(compactor, NULL, fd,
 				   internals, offset,
-				   block_size, compaction, flags, last_docid);
+				   block_size, compaction, flags, last_docid,
+				   max_threads);
 	}
 #else
 	(void)compactor;
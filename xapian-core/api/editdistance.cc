@@ -1,13 +1,15 @@
 /** @file editdistance.cc
  * @brief Edit distance calculation algorithm.
  *
- *  Based on that described in:
+ *  The bit-parallel calculation is based on that described in:
  *
- *  "An extension of Ukkonen's enhanced dynamic programming ASM algorithm"
- *  by Hal Berghel, University of Arkansas
- *  and David Roach, Acxiom Corporation
+ *  "A fast bit-vector algorithm for approximate string matching based on
+ *  dynamic programming" by Gene Myers, Journal of the ACM 46(3), 1999
  *
- *  http://berghel.net/publications/asm/asm.php
+ *  with the extension to handle transpositions described in:
+ *
+ *  "A Bit-Vector Algorithm for Computing Levenshtein and Damerau Edit
+ *  Distances" by Heikki Hyyrö, Nordic Journal of Computing 10(1), 2003
  */
 /* Copyright (C) 2003 Richard Boulton
  * Copyright (C) 2007,2008,2009 Olly Betts
@@ -38,172 +40,135 @@
 
 using namespace std;
 
-template<class CHR>
-struct edist_seq {
-    edist_seq(const CHR * ptr_, int len_) : ptr(ptr_), len(len_) { }
-    const CHR * ptr;
-    int len;
-};
-
-template<class CHR>
-class edist_state {
-    /// Don't allow assignment.
-    void operator=(const edist_state &);
-
-    /// Don't allow copying.
-    edist_state(const edist_state &);
-
-    edist_seq<CHR> seq1;
-    edist_seq<CHR> seq2;
-
-    /* Array of f(k,p) values, where f(k,p) = the largest index i such that
-     * d(i,j) = p and d(i,j) is on diagonal k.
-     * ie: f(k,p) = largest i s.t. d(i,k+i) = p
-     * Where: d(i,j) = edit distance between substrings of length i and j.
-     */
-    int * fkp;
-    int fkp_cols;
-
-    /* Maximum possible edit distance (this is referred to as ZERO_K in
-     * the algorithm description by Berghel and Roach). */
-    int maxdist;
+/// The longest target we handle with the bit-parallel algorithm.
+#define MAX_BIT_PARALLEL_LEN 64
 
-    int calc_index(int k, int p) const {
-	return (k + maxdist) * fkp_cols + p + 1;
-    }
-
-  public:
-
-    edist_state(const CHR * ptr1, int len1, const CHR * ptr2, int len2);
-
-    ~edist_state();
-
-    int get_f_kp(int k, int p) const {
-	return fkp[calc_index(k, p)];
-    }
-
-    void set_f_kp(int k, int p, int val) {
-	fkp[calc_index(k, p)] = val;
-    }
-
-    bool is_transposed(int pos1, int pos2) const {
-	if (pos1 <= 0 || pos2 <= 0 || pos1 >= seq1.len || pos2 >= seq2.len) return false;
-	return (seq1.ptr[pos1 - 1] == seq2.ptr[pos2] &&
-		seq1.ptr[pos1] == seq2.ptr[pos2 - 1]);
-    }
-
-    void edist_calc_f_kp(int k, int p);
-};
-
-template<class CHR>
-void edist_state<CHR>::edist_calc_f_kp(int k, int p)
+EditDistanceCalculator::EditDistanceCalculator(const unsigned * ptr, int len)
+    : target(ptr, ptr + len)
 {
-    int maxlen = get_f_kp(k, p - 1) + 1; /* dist if do substitute */
-    int maxlen2 = get_f_kp(k - 1, p - 1); /* dist if do insert */
-    int maxlen3 = get_f_kp(k + 1, p - 1) + 1; /* dist if delete */
-
-    if (is_transposed(maxlen, maxlen + k)) {
-	// Transposition.
-	++maxlen;
-    }
-
-    if (maxlen >= maxlen2) {
-	if (maxlen >= maxlen3) {
-	    // Transposition or Substitution.
-	} else {
-	    // Deletion.
-	    maxlen = maxlen3;
+    fill(peq_low, peq_low + 256, uint64_t(0));
+    if (len > MAX_BIT_PARALLEL_LEN) return;
+    for (int i = 0; i != len; ++i) {
+	unsigned ch = ptr[i];
+	uint64_t bit = uint64_t(1) << i;
+	if (ch < 256) {
+	    peq_low[ch] |= bit;
+	    continue;
 	}
-    } else {
-	if (maxlen2 >= maxlen3) {
-	    // Insertion.
-	    maxlen = maxlen2;
+	vector<pair<unsigned, uint64_t> >::iterator j;
+	j = lower_bound(peq_high.begin(), peq_high.end(),
+			make_pair(ch, uint64_t(0)));
+	if (j != peq_high.end() && j->first == ch) {
+	    j->second |= bit;
 	} else {
-	    // Deletion.
-	    maxlen = maxlen3;
+	    peq_high.insert(j, make_pair(ch, bit));
 	}
     }
-
-    /* Check for exact matches, and increase the length until we don't have
-     * one. */
-    while (maxlen < seq1.len &&
-	   maxlen + k < seq2.len &&
-	   seq1.ptr[maxlen] == seq2.ptr[maxlen + k]) {
-	++maxlen;
-    }
-    set_f_kp(k, p, maxlen);
 }
 
-#define INF 1000000
-template<class CHR>
-edist_state<CHR>::edist_state(const CHR * ptr1, int len1,
-			      const CHR * ptr2, int len2)
-    : seq1(ptr1, len1), seq2(ptr2, len2), maxdist(len2)
+uint64_t
+EditDistanceCalculator::get_peq(unsigned ch) const
 {
-    Assert(len2 >= len1);
-    /* Each row represents a value of k, from -maxdist to maxdist. */
-    int fkp_rows = maxdist * 2 + 1;
-    /* Each column represents a value of p, from -1 to maxdist. */
-    fkp_cols = maxdist + 2;
-    /* fkp is stored as a rectangular array, row by row. */
-    fkp = new int[fkp_rows * fkp_cols];
+    if (ch < 256) return peq_low[ch];
+    vector<pair<unsigned, uint64_t> >::const_iterator j;
+    j = lower_bound(peq_high.begin(), peq_high.end(),
+		    make_pair(ch, uint64_t(0)));
+    if (j != peq_high.end() && j->first == ch) return j->second;
+    return 0;
+}
 
-    for (int k = -maxdist; k <= maxdist; k++) {
-	for (int p = -1; p <= maxdist; p++) {
-	    if (p == abs(k) - 1) {
-		if (k < 0) {
-		    set_f_kp(k, p, abs(k) - 1);
-		} else {
-		    set_f_kp(k, p, -1);
-		}
-	    } else if (p < abs(k)) {
-		set_f_kp(k, p, -INF);
-	    }
+int
+EditDistanceCalculator::calc_bit_parallel(const unsigned * ptr, int len,
+					  int max_distance) const
+{
+    int m = int(target.size());
+    AssertRel(m,<=,MAX_BIT_PARALLEL_LEN);
+    // Bit i of VP (VN) is set if the vertical delta between rows i and i + 1
+    // of the current column is +1 (-1).  D0 marks the diagonal deltas which
+    // are zero.
+    uint64_t VP = ~uint64_t(0);
+    uint64_t VN = 0;
+    uint64_t D0 = 0;
+    uint64_t PM_old = 0;
+    const uint64_t top_bit = uint64_t(1) << (m - 1);
+    int dist = m;
+    for (int j = 0; j != len; ++j) {
+	uint64_t PM = get_peq(ptr[j]);
+	// Transpositions: positions where the previous column could match the
+	// next target character and this column the current one.
+	uint64_t TR = (((~D0) & PM) << 1) & PM_old;
+	D0 = (((PM & VP) + VP) ^ VP) | PM | VN | TR;
+	uint64_t HP = VN | ~(D0 | VP);
+	uint64_t HN = D0 & VP;
+	if (HP & top_bit) {
+	    ++dist;
+	} else if (HN & top_bit) {
+	    --dist;
 	}
+	// The distance can decrease by at most one per remaining character,
+	// so stop if we can't get back within max_distance.
+	if (dist - (len - j - 1) > max_distance) return dist - (len - j - 1);
+	// The top row of the matrix is 0, 1, 2, ... so shift in a +1 delta.
+	HP = (HP << 1) | 1;
+	HN <<= 1;
+	VP = HN | ~(D0 | HP);
+	VN = HP & D0;
+	PM_old = PM;
     }
+    return dist;
 }
 
-template<class CHR>
-edist_state<CHR>::~edist_state() {
-    delete [] fkp;
-}
-
-template<class CHR>
-static int
-seqcmp_editdist(const CHR * ptr1, int len1, const CHR * ptr2, int len2,
-		int max_distance)
+int
+EditDistanceCalculator::calc_banded(const unsigned * ptr, int len,
+				    int max_distance) const
 {
-    int lendiff = len2 - len1;
-    /* Make sure second sequence is longer (or same length). */
-    if (lendiff < 0) {
-	lendiff = -lendiff;
-	swap(ptr1, ptr2);
-	swap(len1, len2);
-    }
-
-    /* Special case for if one or both sequences are empty. */
-    if (len1 == 0) return len2;
-
-    edist_state<CHR> state(ptr1, len1, ptr2, len2);
-
-    int p = lendiff; /* This is the minimum possible edit distance. */
-    while (p <= max_distance) {
-	for (int temp_p = 0; temp_p != p; ++temp_p) {
-	    int inc = p - temp_p;
-	    if (abs(lendiff - inc) <= temp_p) {
-		state.edist_calc_f_kp(lendiff - inc, temp_p);
-	    }
-	    if (abs(lendiff + inc) <= temp_p) {
-		state.edist_calc_f_kp(lendiff + inc, temp_p);
+    // Standard dynamic programming, but only calculating the cells within
+    // max_distance of the diagonal - anything outside the band must exceed
+    // max_distance.  Values are capped at max_distance + 1 so that cells just
+    // outside the band can be treated as "too far".
+    const int m = int(target.size());
+    const int k = max_distance;
+    const int cap = k + 1;
+    vector<int> prev2(m + 1, cap), prev(m + 1, cap), cur(m + 1, cap);
+    for (int j = 0; j <= min(m, k); ++j) prev[j] = j;
+    for (int i = 1; i <= len; ++i) {
+	int lo = max(1, i - k);
+	int hi = min(m, i + k);
+	cur[lo - 1] = (lo == 1) ? min(i, cap) : cap;
+	if (hi < m) cur[hi + 1] = cap;
+	int row_min = cur[lo - 1];
+	unsigned ch = ptr[i - 1];
+	for (int j = lo; j <= hi; ++j) {
+	    int cost = (target[j - 1] == ch) ? 0 : 1;
+	    int d = min(prev[j - 1] + cost, min(prev[j], cur[j - 1]) + 1);
+	    if (i > 1 && j > 1 &&
+		target[j - 1] == ptr[i - 2] && target[j - 2] == ch) {
+		d = min(d, prev2[j - 2] + 1);
 	    }
+	    cur[j] = min(d, cap);
+	    row_min = min(row_min, cur[j]);
 	}
-	state.edist_calc_f_kp(lendiff, p);
-
-	if (state.get_f_kp(lendiff, p) == len1) break;
-	++p;
+	if (row_min > k) return cap;
+	swap(prev2, prev);
+	swap(prev, cur);
     }
+    return prev[m];
+}
 
-    return p;
+int
+EditDistanceCalculator::operator()(const unsigned * ptr, int len,
+				   int max_distance) const
+{
+    int m = int(target.size());
+    int lendiff = abs(m - len);
+    // The edit distance can't be less than the difference in lengths.
+    if (lendiff > max_distance) return lendiff;
+    // Special case for if one or both sequences are empty.
+    if (m == 0) return len;
+    if (len == 0) return m;
+    if (m <= MAX_BIT_PARALLEL_LEN)
+	return calc_bit_parallel(ptr, len, max_distance);
+    return calc_banded(ptr, len, max_distance);
 }
 
 int
@@ -211,5 +176,12 @@ edit_distance_unsigned(const unsigned * ptr1, int len1,
 		       const unsigned * ptr2, int len2,
 		       int max_distance)
 {
-    return seqcmp_editdist<unsigned>(ptr1, len1, ptr2, len2, max_distance);
+    // Use the shorter sequence as the target, so the bit-parallel algorithm
+    // can be used if either is short enough.
+    if (len1 > len2) {
+	swap(ptr1, ptr2);
+	swap(len1, len2);
+    }
+    EditDistanceCalculator edcalc(ptr1, len1);
+    return edcalc(ptr2, len2, max_distance);
 }
@@ -22,7 +22,11 @@
 #ifndef XAPIAN_INCLUDED_EDITDISTANCE_H
 #define XAPIAN_INCLUDED_EDITDISTANCE_H
 
-/** Calculate the edit distance between two sequences.
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/** Calculate edit distances from a fixed target sequence.
  *
  *  Edit distance is defined as the minimum number of edit operations
  *  required to move from one sequence to another.  The edit operations
@@ -33,6 +37,68 @@
  *   - Transposition of two neighbouring characters at an arbitrary position
  *     in the string.
  *
+ *  If the target is at most 64 characters long we use the bit-parallel
+ *  algorithm of Myers, with Hyyrö's extension to handle transpositions,
+ *  which processes a whole column of the dynamic programming matrix in a few
+ *  word operations.  For longer targets we calculate just the band of the
+ *  matrix within the maximum edit distance of the diagonal.
+ *
+ *  The per-character bitmasks only depend on the target, so it's much more
+ *  efficient to create one of these objects and use it to compare against
+ *  many sequences than to call edit_distance_unsigned() for each.
+ */
+class EditDistanceCalculator {
+    /// The target sequence.
+    std::vector<unsigned> target;
+
+    /// Bitmasks of the positions of each character < 256 in the target.
+    uint64_t peq_low[256];
+
+    /** Bitmasks of the positions of other characters in the target.
+     *
+     *  Sorted by character so we can binary chop.
+     */
+    std::vector<std::pair<unsigned, uint64_t> > peq_high;
+
+    /// Return the bitmask for character @a ch.
+    uint64_t get_peq(unsigned ch) const;
+
+    /// Bit-parallel calculation (target has at most 64 characters).
+    int calc_bit_parallel(const unsigned * ptr, int len,
+			  int max_distance) const;
+
+    /// Banded dynamic programming calculation (for longer targets).
+    int calc_banded(const unsigned * ptr, int len, int max_distance) const;
+
+  public:
+    /** Construct.
+     *
+     *  @param ptr	A pointer to the start of the target sequence.
+     *  @param len	The length of the target sequence.
+     */
+    EditDistanceCalculator(const unsigned * ptr, int len);
+
+    /** Calculate the edit distance from the target to a sequence.
+     *
+     *  @param ptr	A pointer to the start of the sequence.
+     *  @param len	The length of the sequence.
+     *  @param max_distance The greatest edit distance that's interesting to
+     *			us.  If the true edit distance is > max_distance, any
+     *			value > max_distance may be returned instead (which
+     *			allows the calculation to stop early for poor
+     *			matches).
+     *
+     *  @return The edit distance from the target to the sequence.
+     */
+    int operator()(const unsigned * ptr, int len, int max_distance) const;
+};
+
+/** Calculate the edit distance between two sequences.
+ *
+ *  See EditDistanceCalculator for details.  If you're comparing the same
+ *  sequence with several others, using EditDistanceCalculator directly is
+ *  more efficient.
+ *
  *  @param ptr1 A pointer to the start of the first sequence.
  *  @param len1 The length of the first sequence.
  *  @param ptr2 A pointer to the start of the second sequence.
@@ -26,12 +26,14 @@
 #include "leafpostlist.h"
 #include "omassert.h"
 #include "debuglog.h"
+#include "weight/weightinternal.h"
 
 using namespace std;
 
 LeafPostList::~LeafPostList()
 {
     delete weight;
+    delete bound_weight;
 }
 
 Xapian::doccount
@@ -53,11 +55,12 @@ LeafPostList::get_termfreq_est() const
 }
 
 void
-LeafPostList::set_termweight(const Xapian::Weight * weight_)
+LeafPostList::set_termweight(const Xapian::Weight * weight_, double factor)
 {
     // This method shouldn't be called more than once on the same object.
     Assert(!weight);
     weight = weight_;
+    termweight_factor = factor;
     need_doclength = weight->get_sumpart_needs_doclength_();
     need_unique_terms = weight->get_sumpart_needs_uniqueterms_();
 }
@@ -68,6 +71,16 @@ LeafPostList::get_maxweight() const
     return weight ? weight->get_maxpart() : 0;
 }
 
+double
+LeafPostList::get_maxweight_for_wdf(Xapian::termcount wdf_max)
+{
+    if (!weight) return 0;
+    return Xapian::Weight::Internal::get_maxpart_for_wdf(*weight,
+							 termweight_factor,
+							 wdf_max,
+							 bound_weight);
+}
+
 double
 LeafPostList::get_weight() const
 {
@@ -45,6 +45,12 @@ class LeafPostList : public PostList {
   protected:
     const Xapian::Weight * weight;
 
+    /// The factor weight was initialised with.
+    double termweight_factor;
+
+    /// Copy of weight used by get_maxweight_for_wdf(), or NULL.
+    Xapian::Weight * bound_weight;
+
     bool need_doclength, need_unique_terms;
 
     /// The term name for this postlist (empty for an alldocs postlist).
@@ -52,9 +58,18 @@ class LeafPostList : public PostList {
 
     /// Only constructable as a base class for derived classes.
     explicit LeafPostList(const std::string & term_)
-	: weight(0), need_doclength(false), need_unique_terms(false),
+	: weight(0), termweight_factor(0.0), bound_weight(0),
+	  need_doclength(false), need_unique_terms(false),
 	  term(term_) { }
 
+    /** Return an upper bound on get_weight() for documents in which the wdf
+     *  is at most @a wdf_max.
+     *
+     *  Postlists which know a bound on the wdf of a range of their entries
+     *  can use this to skip entries which can't reach a minimum weight.
+     */
+    double get_maxweight_for_wdf(Xapian::termcount wdf_max);
+
   public:
     ~LeafPostList();
 
@@ -66,8 +81,10 @@ class LeafPostList : public PostList {
      *  You should not call this more than once on a particular object.
      *
      *  @param weight_	The weighting object to use.  Must not be NULL.
+     *  @param factor	The factor @a weight_ was (or will be) initialised
+     *			with.
      */
-    void set_termweight(const Xapian::Weight * weight_);
+    void set_termweight(const Xapian::Weight * weight_, double factor);
 
     double resolve_lazy_termweight(Xapian::Weight * weight_,
 				   Xapian::Weight::Internal * stats,
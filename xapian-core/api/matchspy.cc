@@ -28,8 +28,12 @@
 #include <xapian/queryparser.h>
 #include <xapian/registry.h>
 
+#include <algorithm>
+#include <deque>
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "autoptr.h"
@@ -37,12 +41,14 @@
 #include "noreturn.h"
 #include "omassert.h"
 #include "net/length.h"
+#include "pack.h"
 #include "stringutils.h"
 #include "str.h"
 #include "termlist.h"
 
 #include <cfloat>
 #include <cmath>
+#include <cstdint>
 
 using namespace std;
 using namespace Xapian;
@@ -412,3 +418,551 @@ ValueCountMatchSpy::get_description() const {
     }
     return d;
 }
+
+/// The counts for one slot in a FacetCountMatchSpy.
+class FacetSlotCounts {
+    /// Don't allow assignment.
+    void operator=(const FacetSlotCounts &) = delete;
+
+    /// Don't allow copying (values points into ordinals).
+    FacetSlotCounts(const FacetSlotCounts &) = delete;
+
+    /// Ordinal value used to indicate "no ordinal".
+    static const unsigned NO_ORDINAL = unsigned(-1);
+
+    /// The ordinal of the value most recently added.
+    unsigned last_ordinal;
+
+  public:
+    /// The slot being counted.
+    Xapian::valueno slot;
+
+    /// The ordinal for each distinct value seen.
+    unordered_map<string, unsigned> ordinals;
+
+    /// The values seen, indexed by ordinal (these point to keys in ordinals).
+    vector<const string *> values;
+
+    /// The frequency of each value, indexed by ordinal.
+    vector<Xapian::doccount> counts;
+
+    explicit FacetSlotCounts(Xapian::valueno slot_)
+	: last_ordinal(NO_ORDINAL), slot(slot_) { }
+
+    /// Add @a freq to the count for @a value.
+    void add(const string & value, Xapian::doccount freq) {
+	// Matching documents often come in runs with the same value (e.g. when
+	// the slot is correlated with docid order) so check the value we
+	// added last before looking the value up.
+	if (last_ordinal == NO_ORDINAL || *values[last_ordinal] != value) {
+	    auto r = ordinals.insert(make_pair(value, unsigned(values.size())));
+	    if (r.second) {
+		values.push_back(&r.first->first);
+		counts.push_back(0);
+	    }
+	    last_ordinal = r.first->second;
+	}
+	counts[last_ordinal] += freq;
+    }
+};
+
+class Xapian::FacetCountMatchSpy::Internal
+    : public Xapian::Internal::intrusive_base {
+  public:
+    /// Total number of documents seen by the match spy.
+    Xapian::doccount total;
+
+    /** The counts for each slot, in the order the slots were added.
+     *
+     *  A deque is used so adding a slot doesn't move the existing ones.
+     */
+    deque<FacetSlotCounts> slots;
+
+    Internal() : total(0) { }
+
+    /// Find the counts for @a slot, or return NULL if it isn't counted.
+    FacetSlotCounts * find_slot(Xapian::valueno slot) {
+	for (auto & s : slots) {
+	    if (s.slot == slot) return &s;
+	}
+	return NULL;
+    }
+};
+
+/** Find the counts for @a slot in @a internal.
+ *
+ *  Throws InvalidArgumentError if @a slot isn't being counted.
+ */
+static const FacetSlotCounts &
+get_slot_counts(FacetCountMatchSpy::Internal * internal, Xapian::valueno slot)
+{
+    const FacetSlotCounts * counts = NULL;
+    if (internal) counts = internal->find_slot(slot);
+    if (!counts) {
+	throw InvalidArgumentError("FacetCountMatchSpy isn't counting slot " +
+				   str(slot));
+    }
+    return *counts;
+}
+
+FacetCountMatchSpy::FacetCountMatchSpy() { }
+
+FacetCountMatchSpy::~FacetCountMatchSpy() { }
+
+void
+FacetCountMatchSpy::add_slot(Xapian::valueno slot)
+{
+    if (!internal.get()) internal = new Internal;
+    if (!internal->find_slot(slot)) internal->slots.emplace_back(slot);
+}
+
+Xapian::doccount
+FacetCountMatchSpy::get_total() const
+{
+    return internal.get() ? internal->total : 0;
+}
+
+void
+FacetCountMatchSpy::operator()(const Document &doc, double) {
+    if (!internal.get()) return;
+    ++(internal->total);
+    for (auto & s : internal->slots) {
+	const string & val = doc.get_value(s.slot);
+	if (!val.empty()) s.add(val, 1);
+    }
+}
+
+TermIterator
+FacetCountMatchSpy::values_begin(Xapian::valueno slot) const
+{
+    const FacetSlotCounts & counts = get_slot_counts(internal.get(), slot);
+    AutoPtr<StringAndFreqTermList> termlist(new StringAndFreqTermList);
+    vector<unsigned> order(counts.values.size());
+    for (unsigned i = 0; i != order.size(); ++i) order[i] = i;
+    sort(order.begin(), order.end(),
+	 [&counts](unsigned a, unsigned b) {
+	     return *counts.values[a] < *counts.values[b];
+	 });
+    termlist->values.reserve(order.size());
+    for (unsigned i : order) {
+	termlist->values.push_back(StringAndFrequency(*counts.values[i],
+						      counts.counts[i]));
+    }
+    termlist->init();
+    return Xapian::TermIterator(termlist.release());
+}
+
+TermIterator
+FacetCountMatchSpy::top_values_begin(Xapian::valueno slot,
+				     size_t maxvalues) const
+{
+    const FacetSlotCounts & counts = get_slot_counts(internal.get(), slot);
+    // Select the most frequent ordinals first, so we only need to copy the
+    // strings for the values we return.
+    auto cmp = [&counts](unsigned a, unsigned b) {
+	if (counts.counts[a] != counts.counts[b])
+	    return counts.counts[a] > counts.counts[b];
+	return *counts.values[a] < *counts.values[b];
+    };
+    vector<unsigned> order(counts.values.size());
+    for (unsigned i = 0; i != order.size(); ++i) order[i] = i;
+    if (maxvalues < order.size()) {
+	partial_sort(order.begin(), order.begin() + maxvalues, order.end(),
+		     cmp);
+	order.resize(maxvalues);
+    } else {
+	sort(order.begin(), order.end(), cmp);
+    }
+
+    AutoPtr<StringAndFreqTermList> termlist(new StringAndFreqTermList);
+    termlist->values.reserve(order.size());
+    for (unsigned i : order) {
+	termlist->values.push_back(StringAndFrequency(*counts.values[i],
+						      counts.counts[i]));
+    }
+    termlist->init();
+    return Xapian::TermIterator(termlist.release());
+}
+
+MatchSpy *
+FacetCountMatchSpy::clone() const {
+    AutoPtr<FacetCountMatchSpy> spy(new FacetCountMatchSpy);
+    if (internal.get()) {
+	for (auto & s : internal->slots) {
+	    spy->add_slot(s.slot);
+	}
+    }
+    return spy.release();
+}
+
+string
+FacetCountMatchSpy::name() const {
+    return "Xapian::FacetCountMatchSpy";
+}
+
+string
+FacetCountMatchSpy::serialise() const {
+    string result;
+    if (!internal.get()) {
+	result += encode_length(0);
+	return result;
+    }
+    result += encode_length(internal->slots.size());
+    for (auto & s : internal->slots) {
+	result += encode_length(s.slot);
+    }
+    return result;
+}
+
+MatchSpy *
+FacetCountMatchSpy::unserialise(const string & s, const Registry &) const
+{
+    const char * p = s.data();
+    const char * end = p + s.size();
+
+    size_t n_slots;
+    decode_length(&p, end, n_slots);
+    AutoPtr<FacetCountMatchSpy> spy(new FacetCountMatchSpy);
+    while (n_slots--) {
+	valueno slot;
+	decode_length(&p, end, slot);
+	spy->add_slot(slot);
+    }
+    if (p != end) {
+	throw NetworkError("Junk at end of serialised FacetCountMatchSpy");
+    }
+
+    return spy.release();
+}
+
+string
+FacetCountMatchSpy::serialise_results() const {
+    LOGCALL(REMOTE, string, "FacetCountMatchSpy::serialise_results", NO_ARGS);
+    string result;
+    if (!internal.get()) {
+	result += encode_length(0);
+	RETURN(result);
+    }
+    result += encode_length(internal->total);
+    for (auto & s : internal->slots) {
+	result += encode_length(s.slot);
+	result += encode_length(s.values.size());
+	for (size_t i = 0; i != s.values.size(); ++i) {
+	    result += encode_length(s.values[i]->size());
+	    result += *s.values[i];
+	    result += encode_length(s.counts[i]);
+	}
+    }
+    RETURN(result);
+}
+
+void
+FacetCountMatchSpy::merge_results(const string & s) {
+    LOGCALL_VOID(REMOTE, "FacetCountMatchSpy::merge_results", s);
+    const char * p = s.data();
+    const char * end = p + s.size();
+
+    Xapian::doccount n;
+    decode_length(&p, end, n);
+    if (n == 0 && p == end) return;
+    if (!internal.get()) internal = new Internal;
+    internal->total += n;
+
+    while (p != end) {
+	valueno slot;
+	decode_length(&p, end, slot);
+	FacetSlotCounts * counts = internal->find_slot(slot);
+	if (!counts) {
+	    internal->slots.emplace_back(slot);
+	    counts = &internal->slots.back();
+	}
+	size_t items;
+	decode_length(&p, end, items);
+	while (items--) {
+	    size_t vallen;
+	    decode_length_and_check(&p, end, vallen);
+	    string val(p, vallen);
+	    p += vallen;
+	    doccount freq;
+	    decode_length(&p, end, freq);
+	    counts->add(val, freq);
+	}
+    }
+}
+
+string
+FacetCountMatchSpy::get_description() const {
+    string d = "FacetCountMatchSpy(";
+    if (internal.get()) {
+	d += str(internal->total);
+	d += " docs seen, counting ";
+	d += str(internal->slots.size());
+	d += " slots)";
+    } else {
+	d += ")";
+    }
+    return d;
+}
+
+/// Number of bits of the hash used to select a HyperLogLog register.
+#define HLL_PRECISION 14
+
+/// Number of HyperLogLog registers.
+#define HLL_REGISTERS (1 << HLL_PRECISION)
+
+/** Hash a value for DistinctCountMatchSpy.
+ *
+ *  This uses FNV-1a followed by the MurmurHash3 finaliser, since HyperLogLog
+ *  needs all the bits of the hash to be well mixed.  The hash must be the
+ *  same on every platform, as hashes are passed between remote servers.
+ */
+static uint64_t
+hash_value(const string & value)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char ch : value) {
+	h ^= ch;
+	h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+class Xapian::DistinctCountMatchSpy::Internal
+    : public Xapian::Internal::intrusive_base {
+    /// Add a hash to the HyperLogLog registers.
+    void add_to_registers(uint64_t h) {
+	size_t i = h >> (64 - HLL_PRECISION);
+	uint64_t w = h << HLL_PRECISION;
+	// The position of the first set bit in the rest of the hash.
+	unsigned char rank;
+	if (w == 0) {
+	    rank = 64 - HLL_PRECISION + 1;
+	} else {
+#ifdef HAVE_DO_CLZ
+	    rank = do_clz(static_cast<unsigned long long>(w)) + 1;
+#else
+	    rank = 1;
+	    while (!(w & (uint64_t(1) << 63))) {
+		w <<= 1;
+		++rank;
+	    }
+#endif
+	}
+	if (rank > static_cast<unsigned char>(registers[i]))
+	    registers[i] = char(rank);
+    }
+
+  public:
+    /// The slot to count.
+    Xapian::valueno slot;
+
+    /// The number of distinct values to count exactly.
+    Xapian::doccount exact_threshold;
+
+    /// Total number of documents seen by the match spy.
+    Xapian::doccount total;
+
+    /// Hashes of the distinct values seen, while counting exactly.
+    unordered_set<uint64_t> hashes;
+
+    /// The HyperLogLog registers, or empty while counting exactly.
+    string registers;
+
+    Internal(Xapian::valueno slot_, Xapian::doccount exact_threshold_)
+	: slot(slot_), exact_threshold(exact_threshold_), total(0) { }
+
+    /// Add the hash of a value.
+    void add(uint64_t h) {
+	if (!registers.empty()) {
+	    add_to_registers(h);
+	    return;
+	}
+	hashes.insert(h);
+	if (hashes.size() > exact_threshold) switch_to_estimate();
+    }
+
+    /// Stop counting exactly and start using HyperLogLog.
+    void switch_to_estimate() {
+	if (!registers.empty()) return;
+	registers.assign(HLL_REGISTERS, '\0');
+	for (uint64_t h : hashes) {
+	    add_to_registers(h);
+	}
+	// Free the memory used by the hash table.
+	unordered_set<uint64_t>().swap(hashes);
+    }
+
+    /// Return the exact count or the HyperLogLog estimate.
+    Xapian::doccount get_count() const {
+	if (registers.empty()) return hashes.size();
+
+	const double m = HLL_REGISTERS;
+	double sum = 0.0;
+	unsigned zeros = 0;
+	for (unsigned char r : registers) {
+	    sum += ldexp(1.0, -int(r));
+	    if (r == 0) ++zeros;
+	}
+	double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+	// For small cardinalities the raw estimate is biased, but linear
+	// counting on the empty registers is accurate.
+	if (estimate <= 2.5 * m && zeros != 0) {
+	    estimate = m * log(m / zeros);
+	}
+	return Xapian::doccount(estimate + 0.5);
+    }
+};
+
+DistinctCountMatchSpy::DistinctCountMatchSpy() { }
+
+DistinctCountMatchSpy::DistinctCountMatchSpy(Xapian::valueno slot,
+					     Xapian::doccount exact_threshold)
+    : internal(new Internal(slot, exact_threshold)) { }
+
+DistinctCountMatchSpy::~DistinctCountMatchSpy() { }
+
+Xapian::doccount
+DistinctCountMatchSpy::get_total() const
+{
+    return internal.get() ? internal->total : 0;
+}
+
+Xapian::doccount
+DistinctCountMatchSpy::get_distinct_count() const
+{
+    return internal.get() ? internal->get_count() : 0;
+}
+
+bool
+DistinctCountMatchSpy::is_exact() const
+{
+    return !internal.get() || internal->registers.empty();
+}
+
+void
+DistinctCountMatchSpy::operator()(const Document &doc, double) {
+    Assert(internal.get());
+    ++(internal->total);
+    const string & val = doc.get_value(internal->slot);
+    if (!val.empty()) internal->add(hash_value(val));
+}
+
+MatchSpy *
+DistinctCountMatchSpy::clone() const {
+    Assert(internal.get());
+    return new DistinctCountMatchSpy(internal->slot,
+				     internal->exact_threshold);
+}
+
+string
+DistinctCountMatchSpy::name() const {
+    return "Xapian::DistinctCountMatchSpy";
+}
+
+string
+DistinctCountMatchSpy::serialise() const {
+    Assert(internal.get());
+    string result;
+    result += encode_length(internal->slot);
+    result += encode_length(internal->exact_threshold);
+    return result;
+}
+
+MatchSpy *
+DistinctCountMatchSpy::unserialise(const string & s, const Registry &) const
+{
+    const char * p = s.data();
+    const char * end = p + s.size();
+
+    valueno new_slot;
+    decode_length(&p, end, new_slot);
+    Xapian::doccount new_exact_threshold;
+    decode_length(&p, end, new_exact_threshold);
+    if (p != end) {
+	throw NetworkError("Junk at end of serialised DistinctCountMatchSpy");
+    }
+
+    return new DistinctCountMatchSpy(new_slot, new_exact_threshold);
+}
+
+string
+DistinctCountMatchSpy::serialise_results() const {
+    LOGCALL(REMOTE, string, "DistinctCountMatchSpy::serialise_results", NO_ARGS);
+    Assert(internal.get());
+    string result;
+    result += encode_length(internal->total);
+    if (internal->registers.empty()) {
+	// Counting exactly, so send the hashes.
+	result += 'E';
+	result += encode_length(internal->hashes.size());
+	for (uint64_t h : internal->hashes) {
+	    for (int shift = 56; shift >= 0; shift -= 8) {
+		result += char(h >> shift);
+	    }
+	}
+    } else {
+	result += 'H';
+	result += internal->registers;
+    }
+    RETURN(result);
+}
+
+void
+DistinctCountMatchSpy::merge_results(const string & s) {
+    LOGCALL_VOID(REMOTE, "DistinctCountMatchSpy::merge_results", s);
+    Assert(internal.get());
+    const char * p = s.data();
+    const char * end = p + s.size();
+
+    Xapian::doccount n;
+    decode_length(&p, end, n);
+    internal->total += n;
+
+    if (p == end) {
+	throw NetworkError("Bad serialised DistinctCountMatchSpy results");
+    }
+    char type = *p++;
+    if (type == 'E') {
+	size_t count;
+	decode_length(&p, end, count);
+	if (size_t(end - p) != count * 8) {
+	    throw NetworkError("Bad serialised DistinctCountMatchSpy results");
+	}
+	while (p != end) {
+	    uint64_t h = 0;
+	    for (int i = 0; i != 8; ++i) {
+		h = (h << 8) | static_cast<unsigned char>(*p++);
+	    }
+	    internal->add(h);
+	}
+    } else if (type == 'H' && end - p == HLL_REGISTERS) {
+	internal->switch_to_estimate();
+	for (size_t i = 0; i != HLL_REGISTERS; ++i) {
+	    if (static_cast<unsigned char>(p[i]) >
+		static_cast<unsigned char>(internal->registers[i])) {
+		internal->registers[i] = p[i];
+	    }
+	}
+    } else {
+	throw NetworkError("Bad serialised DistinctCountMatchSpy results");
+    }
+}
+
+string
+DistinctCountMatchSpy::get_description() const {
+    string d = "DistinctCountMatchSpy(";
+    if (internal.get()) {
+	d += str(internal->total);
+	d += " docs seen, ";
+	d += str(internal->get_count());
+	d += is_exact() ? " distinct values)" : " distinct values (estimated))";
+    } else {
+	d += ")";
+    }
+    return d;
+}
@@ -0,0 +1,101 @@
+/** @file msetcache.cc
+ * @brief Cache of match results for repeated searches.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "msetcache.h"
+
+#include "debuglog.h"
+#include "omassert.h"
+
+using namespace std;
+
+Xapian::MSet::Internal *
+MSetCache::get(const string & key,
+	       Xapian::doccount first,
+	       Xapian::doccount maxitems,
+	       Xapian::doccount check_to)
+{
+    LOGCALL(MATCH, Xapian::MSet::Internal *, "MSetCache::get", key | first | maxitems | check_to);
+    index_type::iterator i = index.find(key);
+    if (i == index.end()) RETURN(NULL);
+
+    const Entry & entry = *i->second;
+    const Xapian::MSet::Internal & cached = *entry.mset;
+    // If fewer matches than asked for were found then the entry holds all
+    // the matches, and if the bounds agree, the estimate is exact.
+    bool all_matches = (cached.items.size() < entry.depth);
+    bool exact = (cached.matches_lower_bound == cached.matches_upper_bound);
+    if ((first + maxitems > entry.depth && !all_matches) ||
+	(check_to > entry.checked && !exact)) {
+	RETURN(NULL);
+    }
+
+    // Move the entry to the front of the LRU list.
+    lru.splice(lru.begin(), lru, i->second);
+
+    vector<Xapian::Internal::MSetItem> items;
+    if (first < cached.items.size()) {
+	Xapian::doccount last = min(Xapian::doccount(cached.items.size()),
+				    first + maxitems);
+	items.assign(cached.items.begin() + first, cached.items.begin() + last);
+    }
+    Xapian::MSet::Internal * mset =
+	new Xapian::MSet::Internal(first,
+				   cached.matches_upper_bound,
+				   cached.matches_lower_bound,
+				   cached.matches_estimated,
+				   cached.uncollapsed_upper_bound,
+				   cached.uncollapsed_lower_bound,
+				   cached.uncollapsed_estimated,
+				   cached.max_possible,
+				   cached.max_attained,
+				   items,
+				   cached.percent_factor);
+    mset->collapse_memory = cached.collapse_memory;
+    if (cached.stats)
+	mset->stats = new Xapian::Weight::Internal(*cached.stats);
+    RETURN(mset);
+}
+
+void
+MSetCache::add(const string & key, Xapian::MSet::Internal * mset,
+	       Xapian::doccount depth_, Xapian::doccount checked)
+{
+    LOGCALL_VOID(MATCH, "MSetCache::add", key | mset | depth_ | checked);
+    Assert(mset->firstitem == 0);
+    Assert(!mset->enquire.get());
+    if (max_entries == 0) return;
+
+    index_type::iterator i = index.find(key);
+    if (i != index.end()) {
+	lru.erase(i->second);
+	index.erase(i);
+    } else if (lru.size() == max_entries) {
+	index.erase(lru.back().key);
+	lru.pop_back();
+    }
+
+    lru.push_front(Entry());
+    Entry & entry = lru.front();
+    entry.key = key;
+    entry.mset = mset;
+    entry.depth = depth_;
+    entry.checked = checked;
+    index.insert(make_pair(key, lru.begin()));
+}
@@ -0,0 +1,104 @@
+/** @file msetcache.h
+ * @brief Cache of match results for repeated searches.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MSETCACHE_H
+#define XAPIAN_INCLUDED_MSETCACHE_H
+
+#include "api/omenquireinternal.h"
+
+#include <list>
+#include <map>
+#include <string>
+
+/** Cache of match results, keyed by the search and database revision.
+ *
+ *  Each entry holds the top matches for a search, calculated from the start
+ *  of the ranking, so requests for any page within that depth can be served
+ *  from it.
+ */
+class MSetCache {
+    struct Entry {
+	/// The key this entry is stored under.
+	std::string key;
+
+	/** The cached results, starting from rank 0.
+	 *
+	 *  The enquire member isn't set, as that would keep the Enquire
+	 *  which owns this cache alive.
+	 */
+	Xapian::Internal::intrusive_ptr<Xapian::MSet::Internal> mset;
+
+	/// The number of matches which were asked for.
+	Xapian::doccount depth;
+
+	/// The check_at_least value the results were calculated with.
+	Xapian::doccount checked;
+    };
+
+    /// Entries, most recently used first.
+    std::list<Entry> lru;
+
+    typedef std::map<std::string, std::list<Entry>::iterator> index_type;
+
+    /// Map from key to position in lru.
+    index_type index;
+
+    /// The maximum number of entries.
+    size_t max_entries;
+
+    /// Copying is not allowed.
+    MSetCache(const MSetCache &);
+
+    /// Assignment is not allowed.
+    void operator=(const MSetCache &);
+
+  public:
+    /// The minimum number of matches to calculate for each entry.
+    Xapian::doccount depth;
+
+    MSetCache(size_t max_entries_, Xapian::doccount depth_)
+	: max_entries(max_entries_), depth(depth_) { }
+
+    /** Look up results in the cache.
+     *
+     *  @param key		The key for the search.
+     *  @param first		The first rank wanted.
+     *  @param maxitems		The number of matches wanted.
+     *  @param check_to		The number of matches which need to have
+     *				been checked from the start of the ranking.
+     *
+     *  @return	A new MSet::Internal for the requested ranks, or NULL if
+     *		there's no suitable cached entry.
+     */
+    Xapian::MSet::Internal * get(const std::string & key,
+				 Xapian::doccount first,
+				 Xapian::doccount maxitems,
+				 Xapian::doccount check_to);
+
+    /** Add results to the cache.
+     *
+     *  @param key	The key for the search.
+     *  @param mset	The results, which must start from rank 0.
+     *  @param depth_	The number of matches which were asked for.
+     *  @param checked	The check_at_least value used.
+     */
+    void add(const std::string & key, Xapian::MSet::Internal * mset,
+	     Xapian::doccount depth_, Xapian::doccount checked);
+};
+
+#endif // XAPIAN_INCLUDED_MSETCACHE_H
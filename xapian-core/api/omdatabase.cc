@@ -223,6 +223,10 @@ Database::allterms_begin(const std::string & prefix) const
     } else {
 	tl = new MultiAllTermsList(internal, prefix);
     }
+    // Only an empty prefix can match reserved terms, and then we need to
+    // stop before them.
+    if (tl && prefix.empty())
+	tl = new UnreservedAllTermsList(tl);
     RETURN(TermIterator(tl));
 }
 
@@ -561,14 +565,34 @@ Database::get_spelling_suggestion(const string &word,
     LOGCALL(API, string, "Database::get_spelling_suggestion", word | max_edit_distance);
     if (word.size() <= 1) return string();
     AutoPtr<TermList> merger;
+    // If every subdatabase has a deletion index, we get a short list of
+    // candidates which we need to check exhaustively.
+    bool use_trigrams = false;
     for (size_t i = 0; i < internal.size(); ++i) {
-	TermList * tl = internal[i]->open_spelling_termlist(word);
-	LOGLINE(SPELLING, "Sub db " << i << " tl = " << (void*)tl);
-	if (tl) {
-	    if (merger.get()) {
-		merger.reset(new OrTermList(merger.release(), tl));
-	    } else {
-		merger.reset(tl);
+	TermList * tl = internal[i]->open_spelling_candidates(word,
+							      max_edit_distance);
+	LOGLINE(SPELLING, "Sub db " << i << " candidates tl = " << (void*)tl);
+	if (!tl) {
+	    use_trigrams = true;
+	    break;
+	}
+	if (merger.get()) {
+	    merger.reset(new OrTermList(merger.release(), tl));
+	} else {
+	    merger.reset(tl);
+	}
+    }
+    if (use_trigrams) {
+	merger.reset();
+	for (size_t i = 0; i < internal.size(); ++i) {
+	    TermList * tl = internal[i]->open_spelling_termlist(word);
+	    LOGLINE(SPELLING, "Sub db " << i << " tl = " << (void*)tl);
+	    if (tl) {
+		if (merger.get()) {
+		    merger.reset(new OrTermList(merger.release(), tl));
+		} else {
+		    merger.reset(tl);
+		}
 	    }
 	}
     }
@@ -578,6 +602,8 @@ Database::get_spelling_suggestion(const string &word,
     // Extra brackets needed to avoid this being misparsed as a function
     // prototype.
     vector<unsigned> utf32_word((Utf8Iterator(word)), Utf8Iterator());
+    // Build the bitmasks for the word once, rather than for every candidate.
+    EditDistanceCalculator edcalc(utf32_word.data(), int(utf32_word.size()));
 
     vector<unsigned> utf32_term;
 
@@ -596,7 +622,7 @@ Database::get_spelling_suggestion(const string &word,
 	Xapian::termcount score = merger->get_wdf();
 
 	LOGLINE(SPELLING, "Term \"" << term << "\" ngram score " << score);
-	if (score + TRIGRAM_SCORE_THRESHOLD >= best) {
+	if (!use_trigrams || score + TRIGRAM_SCORE_THRESHOLD >= best) {
 	    if (score > best) best = score;
 
 	    // There's no point considering a word where the difference
@@ -625,11 +651,8 @@ Database::get_spelling_suggestion(const string &word,
 		continue;
 	    }
 
-	    int edist = edit_distance_unsigned(&utf32_term[0],
-					       int(utf32_term.size()),
-					       &utf32_word[0],
-					       int(utf32_word.size()),
-					       edist_best);
+	    int edist = edcalc(utf32_term.data(), int(utf32_term.size()),
+			       edist_best);
 	    LOGLINE(SPELLING, "Edit distance " << edist);
 
 	    if (edist <= edist_best) {
@@ -849,6 +872,25 @@ WritableDatabase::add_document(const Document & document)
     RETURN(did);
 }
 
+Xapian::docid
+WritableDatabase::add_documents(const vector<Document> & docs,
+				unsigned num_threads)
+{
+    LOGCALL(API, Xapian::docid, "WritableDatabase::add_documents", docs.size() | num_threads);
+    size_t n_dbs = internal.size();
+    if (rare(n_dbs == 0))
+	no_subdatabases();
+    if (n_dbs == 1)
+	RETURN(internal[0]->add_documents(docs, num_threads));
+
+    Xapian::docid first_did = 0;
+    for (const Document & doc : docs) {
+	Xapian::docid did = add_document(doc);
+	if (first_did == 0) first_did = did;
+    }
+    RETURN(first_did);
+}
+
 void
 WritableDatabase::delete_document(Xapian::docid did)
 {
@@ -40,8 +40,11 @@
 #include "expand/esetinternal.h"
 #include "expand/expandweight.h"
 #include "matcher/multimatch.h"
+#include "msetcache.h"
 #include "omassert.h"
 #include "api/omenquireinternal.h"
+#include "pack.h"
+#include "serialise-double.h"
 #include "str.h"
 #include "weight/weightinternal.h"
 
@@ -179,7 +182,19 @@ MSet::fetch_(Xapian::doccount first, Xapian::doccount last) const
 {
     LOGCALL_VOID(API, "Xapian::MSet::fetch_", first | last);
     Assert(internal.get() != 0);
-    internal->fetch_items(first, last);
+    // fetch() passes (0, -1) to fetch the whole MSet, while the other
+    // overloads pass MSetIterator::off_from_end values - fetch(begin, end)
+    // passes an exclusive end, and fetch(item) passes the same value twice.
+    Xapian::doccount size = internal->items.size();
+    if (first < last) {
+	internal->fetch_items(0, Xapian::doccount(-1));
+	return;
+    }
+    if (first > size || first == 0) return;
+    Xapian::doccount begin = size - first;
+    Xapian::doccount end = begin;
+    if (first != last) end = size - last - 1;
+    internal->fetch_items(begin, end);
 }
 
 int
@@ -280,6 +295,13 @@ MSet::get_uncollapsed_matches_upper_bound() const
     return internal->uncollapsed_upper_bound;
 }
 
+size_t
+MSet::get_collapse_memory() const
+{
+    Assert(internal.get() != 0);
+    return internal->collapse_memory;
+}
+
 double
 MSet::get_max_possible() const
 {
@@ -378,16 +400,18 @@ MSet::Internal::fetch_items(Xapian::doccount first, Xapian::doccount last) const
     if (last > items.size() - 1)
 	last = items.size() - 1;
     for (Xapian::doccount i = first; i <= last; ++i) {
+	// The document cache is keyed by the index in the full results.
+	Xapian::doccount index = firstitem + i;
 	map<Xapian::doccount, Document>::const_iterator doc;
-	doc = indexeddocs.find(i);
+	doc = indexeddocs.find(index);
 	if (doc == indexeddocs.end()) {
 	    /* We don't have the document cached */
 	    set<Xapian::doccount>::const_iterator s;
-	    s = requested_docs.find(i);
+	    s = requested_docs.find(index);
 	    if (s == requested_docs.end()) {
 		/* We haven't even requested it yet - do so now. */
-		enquire->request_doc(items[i - firstitem]);
-		requested_docs.insert(i);
+		enquire->request_doc(items[i]);
+		requested_docs.insert(index);
 	    }
 	}
     }
@@ -594,8 +618,8 @@ Enquire::Internal::Internal(const Database &db_, ErrorHandler * errorhandler_)
   : db(db_), query(), collapse_key(Xapian::BAD_VALUENO), collapse_max(0),
     order(Enquire::ASCENDING), percent_cutoff(0), weight_cutoff(0),
     sort_key(Xapian::BAD_VALUENO), sort_by(REL), sort_value_forward(true),
-    sorter(0), time_limit(0.0), errorhandler(errorhandler_), weight(0),
-    eweightname("trad"), expand_k(1.0)
+    sorter(0), time_limit(0.0), max_threads(1), errorhandler(errorhandler_),
+    weight(0), eweightname("trad"), expand_k(1.0)
 {
     if (db.internal.empty()) {
 	throw InvalidArgumentError("Can't make an Enquire object from an uninitialised Database object.");
@@ -621,6 +645,52 @@ Enquire::Internal::get_query() const
     return query;
 }
 
+string
+Enquire::Internal::get_mset_cache_key(const RSet *rset,
+				      const MatchDecider *mdecider) const
+{
+    LOGCALL(MATCH, string, "Enquire::Internal::get_mset_cache_key", rset | mdecider);
+    // We can't tell if the results from any of these would be the same, and
+    // match spies need to see every match.  With a time limit, the results
+    // depend on how long the match takes.
+    if ((rset && !rset->empty()) || mdecider || sorter || !spies.empty() ||
+	time_limit > 0.0)
+	RETURN(string());
+
+    string key;
+    for (size_t i = 0; i != db.internal.size(); ++i) {
+	string revision = db.internal[i]->get_revision_key();
+	if (revision.empty()) RETURN(string());
+	// The revision alone doesn't identify the database contents, since
+	// the database could have been replaced (e.g. by a compacted copy)
+	// and reopened at the same revision.
+	string uuid = db.internal[i]->get_uuid();
+	if (uuid.empty()) RETURN(string());
+	pack_string(key, uuid);
+	pack_string(key, revision);
+    }
+
+    try {
+	pack_string(key, query.serialise());
+	pack_string(key, weight->name());
+	pack_string(key, weight->serialise());
+    } catch (const Xapian::UnimplementedError &) {
+	// The query or weighting scheme can't be serialised.
+	RETURN(string());
+    }
+    pack_uint(key, qlen);
+    pack_uint(key, collapse_key);
+    pack_uint(key, collapse_max);
+    pack_uint(key, unsigned(order));
+    pack_uint(key, unsigned(percent_cutoff));
+    key += serialise_double(weight_cutoff);
+    pack_uint(key, sort_key);
+    pack_uint(key, unsigned(sort_by));
+    pack_bool(key, sort_value_forward);
+    pack_uint(key, max_threads);
+    RETURN(key);
+}
+
 MSet
 Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 			    Xapian::doccount check_at_least, const RSet *rset,
@@ -637,12 +707,35 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     }
 
     Xapian::doccount first_orig = first;
-    {
-	Xapian::doccount docs = db.get_doccount();
-	first = min(first, docs);
-	maxitems = min(maxitems, docs);
-	check_at_least = min(check_at_least, docs);
-	check_at_least = max(check_at_least, maxitems);
+    Xapian::doccount docs = db.get_doccount();
+    first = min(first, docs);
+    maxitems = min(maxitems, docs);
+    check_at_least = min(check_at_least, docs);
+    check_at_least = max(check_at_least, maxitems);
+
+    string cache_key;
+    Xapian::doccount first_wanted = first;
+    // There can't be matches past rank docs - 1.
+    Xapian::doccount maxitems_wanted = min(maxitems, docs - first);
+    Xapian::doccount check_to = min(first + check_at_least, docs);
+    if (mset_cache.get()) {
+	cache_key = get_mset_cache_key(rset, mdecider);
+	if (!cache_key.empty()) {
+	    MSet retval;
+	    retval.internal = mset_cache->get(cache_key, first,
+					      maxitems_wanted, check_to);
+	    if (retval.internal.get()) {
+		retval.internal->firstitem = first_orig;
+		retval.internal->enquire = this;
+		RETURN(retval);
+	    }
+	    // Calculate the results from the start and to at least the
+	    // cache's depth, so they can be used for other pages.
+	    maxitems = min(max(first + maxitems_wanted, mset_cache->depth),
+			   docs);
+	    check_at_least = max(check_to, maxitems);
+	    first = 0;
+	}
     }
 
     AutoPtr<Xapian::Weight::Internal> stats(new Xapian::Weight::Internal);
@@ -652,27 +745,37 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		       order, sort_key, sort_by, sort_value_forward,
 		       time_limit, errorhandler, *(stats.get()), weight, spies,
 		       (sorter != NULL),
-		       (mdecider != NULL));
+		       (mdecider != NULL),
+		       max_threads);
     // Run query and put results into supplied Xapian::MSet object.
     MSet retval;
     match.get_mset(first, maxitems, check_at_least, retval,
 		   *(stats.get()), mdecider, sorter);
-    if (first_orig != first && retval.internal.get()) {
-	retval.internal->firstitem = first_orig;
-    }
 
     Assert(weight->name() != "bool" || retval.get_max_possible() == 0);
 
+    if (!retval.internal->stats) {
+	retval.internal->stats = stats.release();
+    }
+
+    if (!cache_key.empty()) {
+	mset_cache->add(cache_key, retval.internal.get(), maxitems,
+			check_at_least);
+	retval.internal = mset_cache->get(cache_key, first_wanted,
+					  maxitems_wanted, check_to);
+	Assert(retval.internal.get());
+    }
+
+    if (first_orig != first_wanted && retval.internal.get()) {
+	retval.internal->firstitem = first_orig;
+    }
+
     // The Xapian::MSet needs to have a pointer to ourselves, so that it can
     // retrieve the documents.  This is set here explicitly to avoid having
     // to pass it into the matcher, which gets messy particularly in the
     // networked case.
     retval.internal->enquire = this;
 
-    if (!retval.internal->stats) {
-	retval.internal->stats = stats.release();
-    }
-
     RETURN(retval);
 }
 
@@ -1019,6 +1122,24 @@ Enquire::set_time_limit(double time_limit)
     internal->time_limit = time_limit;
 }
 
+void
+Enquire::set_max_threads(unsigned max_threads)
+{
+    if (max_threads == 0)
+	throw Xapian::InvalidArgumentError("max_threads must be at least 1");
+    internal->max_threads = max_threads;
+}
+
+void
+Enquire::set_mset_cache(size_t max_entries, Xapian::doccount depth)
+{
+    if (max_entries == 0) {
+	internal->mset_cache.reset(NULL);
+    } else {
+	internal->mset_cache.reset(new MSetCache(max_entries, depth));
+    }
+}
+
 MSet
 Enquire::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		  Xapian::doccount check_at_least, const RSet *rset,
@@ -34,15 +34,18 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <map>
 #include <set>
 
+#include "autoptr.h"
 #include "weight/weightinternal.h"
 
 using namespace std;
 
 class OmExpand;
 class MultiMatch;
+class MSetCache;
 
 namespace Xapian {
 
@@ -58,15 +61,16 @@ namespace Internal {
 class MSetItem {
     public:
 	MSetItem(double wt_, Xapian::docid did_)
-		: wt(wt_), did(did_), collapse_count(0) {}
+		: wt(wt_), did(did_), collapse_count(0), sort_key_prefix(0) {}
 
 	MSetItem(double wt_, Xapian::docid did_, const string &key_)
-		: wt(wt_), did(did_), collapse_key(key_), collapse_count(0) {}
+		: wt(wt_), did(did_), collapse_key(key_), collapse_count(0),
+		  sort_key_prefix(0) {}
 
 	MSetItem(double wt_, Xapian::docid did_, const string &key_,
 		 Xapian::doccount collapse_count_)
 		: wt(wt_), did(did_), collapse_key(key_),
-		  collapse_count(collapse_count_) {}
+		  collapse_count(collapse_count_), sort_key_prefix(0) {}
 
 	void swap(MSetItem & o) {
 	    std::swap(wt, o.wt);
@@ -74,6 +78,7 @@ class MSetItem {
 	    std::swap(collapse_key, o.collapse_key);
 	    std::swap(collapse_count, o.collapse_count);
 	    std::swap(sort_key, o.sort_key);
+	    std::swap(sort_key_prefix, o.sort_key_prefix);
 	}
 
 	/** Weight calculated. */
@@ -106,6 +111,14 @@ class MSetItem {
 	/** Used when sorting by value. */
 	string sort_key;
 
+	/** The first 8 bytes of sort_key, packed big-endian.
+	 *
+	 *  The matcher sets this alongside sort_key so that most comparisons
+	 *  of sort keys can be done on an integer - sort_key only needs to be
+	 *  looked at when the prefixes are equal.
+	 */
+	uint64_t sort_key_prefix;
+
 	/// Return a string describing this object.
 	string get_description() const;
 };
@@ -154,6 +167,8 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	double time_limit;
 
+	unsigned max_threads;
+
 	/** The error handler, if set.  (0 if not set).
 	 */
 	ErrorHandler * errorhandler;
@@ -173,6 +188,9 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	vector<Xapian::Internal::opt_intrusive_ptr<MatchSpy>> spies;
 
+	/// Cache of match results, or NULL if caching is disabled.
+	mutable AutoPtr<MSetCache> mset_cache;
+
 	Internal(const Xapian::Database &databases, ErrorHandler * errorhandler_);
 	~Internal();
 
@@ -186,6 +204,13 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	Xapian::Document get_document(const Xapian::Internal::MSetItem &item) const;
 
+	/** Get the key to cache the results of the current search under.
+	 *
+	 *  Returns an empty string if the results can't be cached.
+	 */
+	string get_mset_cache_key(const RSet *omrset,
+				  const MatchDecider *mdecider) const;
+
 	void set_query(const Query & query_, termcount qlen_);
 	const Query & get_query() const;
 	MSet get_mset(Xapian::doccount first, Xapian::doccount maxitems,
@@ -255,6 +280,9 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 
 	double max_attained;
 
+	/// Peak memory used by the Collapser during the match (in bytes).
+	size_t collapse_memory;
+
 	Internal()
 		: percent_factor(0),
 		  stats(NULL),
@@ -266,7 +294,8 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 		  uncollapsed_estimated(0),
 		  uncollapsed_upper_bound(0),
 		  max_possible(0),
-		  max_attained(0) {}
+		  max_attained(0),
+		  collapse_memory(0) {}
 
 	/// Note: destroys parameter items.
 	Internal(Xapian::doccount firstitem_,
@@ -290,7 +319,8 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 		  uncollapsed_estimated(uncollapsed_estimated_),
 		  uncollapsed_upper_bound(uncollapsed_upper_bound_),
 		  max_possible(max_possible_),
-		  max_attained(max_attained_) {
+		  max_attained(max_attained_),
+		  collapse_memory(0) {
 	    std::swap(items, items_);
 	}
 
@@ -313,6 +343,10 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 	string get_description() const;
 
 	/** Fetch items specified into the document cache.
+	 *
+	 *  @param first	Index into items of the first item to fetch.
+	 *  @param last		Index into items of the last item to fetch
+	 *			(values past the end are clamped).
 	 */
 	void fetch_items(Xapian::doccount first, Xapian::doccount last) const;
 };
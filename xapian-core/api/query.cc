@@ -108,6 +108,21 @@ Query::Query(op op_,
 	     op combiner)
 {
     LOGCALL_CTOR(API, "Query", op_ | pattern | max_expansion | max_type | combiner);
+    if (op_ == OP_EDIT_DISTANCE) {
+	// Query(OP_EDIT_DISTANCE, word, edit_distance[, min_prefix_len])
+	// can end up here as the arguments fit this signature too.
+	if (rare(max_type < 0))
+	    throw Xapian::InvalidArgumentError("min_prefix_len must be >= 0");
+	if (rare(combiner != OP_SYNONYM))
+	    throw Xapian::InvalidArgumentError("OP_EDIT_DISTANCE takes max_expansion and max_type before combiner");
+	internal = new Xapian::Internal::QueryEditDistance(pattern,
+							   0,
+							   WILDCARD_LIMIT_ERROR,
+							   OP_SYNONYM,
+							   max_expansion,
+							   max_type);
+	return;
+    }
     if (rare(op_ != OP_WILDCARD))
 	throw Xapian::InvalidArgumentError("op must be OP_WILDCARD");
     if (rare(combiner != OP_SYNONYM && combiner != OP_MAX && combiner != OP_OR))
@@ -118,6 +133,27 @@ Query::Query(op op_,
 						   combiner);
 }
 
+Query::Query(op op_,
+	     const std::string & word,
+	     unsigned edit_distance,
+	     size_t min_prefix_len,
+	     Xapian::termcount max_expansion,
+	     int max_type,
+	     op combiner)
+{
+    LOGCALL_CTOR(API, "Query", op_ | word | edit_distance | min_prefix_len | max_expansion | max_type | combiner);
+    if (rare(op_ != OP_EDIT_DISTANCE))
+	throw Xapian::InvalidArgumentError("op must be OP_EDIT_DISTANCE");
+    if (rare(combiner != OP_SYNONYM && combiner != OP_MAX && combiner != OP_OR))
+	throw Xapian::InvalidArgumentError("combiner must be OP_SYNONYM or OP_MAX or OP_OR");
+    internal = new Xapian::Internal::QueryEditDistance(word,
+						       max_expansion,
+						       max_type,
+						       combiner,
+						       edit_distance,
+						       min_prefix_len);
+}
+
 const TermIterator
 Query::get_terms_begin() const
 {
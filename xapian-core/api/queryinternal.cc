@@ -25,6 +25,7 @@
 
 #include "xapian/postingsource.h"
 #include "xapian/query.h"
+#include "xapian/unicode.h"
 
 #include "matcher/const_database_wrapper.h"
 #include "leafpostlist.h"
@@ -45,10 +46,13 @@
 #include "net/length.h"
 #include "serialise-double.h"
 #include "termlist.h"
+#include "wildcardpattern.h"
 
 #include "autoptr.h"
 #include "debuglog.h"
+#include "editdistance.h"
 #include "omassert.h"
+#include "phrasebigrams.h"
 #include "str.h"
 #include "unicode/description_append.h"
 
@@ -68,6 +72,9 @@ using Xapian::Internal::AndContext;
 using Xapian::Internal::OrContext;
 using Xapian::Internal::XorContext;
 
+/// Bit mask for the WILDCARD_LIMIT_* part of OP_WILDCARD's max_type.
+static const int WILDCARD_LIMIT_MASK = 0x0f;
+
 namespace Xapian {
 
 namespace Internal {
@@ -517,6 +524,28 @@ Query::Internal::unserialise(const char ** p, const char * end,
 	}
 	case 0: {
 	    switch (ch & 0x0f) {
+		case 0x0a: { // Edit distance
+		    if (*p == end)
+			throw SerialisationError("not enough data");
+		    Xapian::termcount max_expansion;
+		    decode_length(p, end, max_expansion);
+		    if (end - *p < 2)
+			throw SerialisationError("not enough data");
+		    int max_type = static_cast<unsigned char>(*(*p)++);
+		    op combiner = static_cast<op>(*(*p)++);
+		    unsigned edit_distance;
+		    decode_length(p, end, edit_distance);
+		    size_t min_prefix_len;
+		    decode_length(p, end, min_prefix_len);
+		    size_t len;
+		    decode_length_and_check(p, end, len);
+		    string word(*p, len);
+		    *p += len;
+		    using Xapian::Internal::QueryEditDistance;
+		    return new QueryEditDistance(word, max_expansion, max_type,
+						 combiner, edit_distance,
+						 min_prefix_len);
+		}
 		case 0x0b: { // Wildcard
 		    if (*p == end)
 			throw SerialisationError("not enough data");
@@ -922,6 +951,49 @@ QueryValueGE::get_description() const
     return desc;
 }
 
+/** Build the postlist for the terms an expanding query expanded to.
+ *
+ *  Shared by OP_WILDCARD and OP_EDIT_DISTANCE, which differ only in how they
+ *  pick the terms.
+ */
+static PostingIterator::Internal *
+combine_expansion(QueryOptimiser * qopt, OrContext & ctx, Query::op op,
+		  double factor, int limit_type,
+		  Xapian::termcount max_expansion)
+{
+    if (limit_type == Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
+	// FIXME: open_lazy_post_list() results in the term getting registered
+	// for stats, so we still incur an avoidable cost from the full
+	// expansion size of the wildcard, which is most likely to be visible
+	// with the remote backend.  Perhaps we should split creating the lazy
+	// postlist from registering the term for stats.
+	if (ctx.size() > max_expansion)
+	    ctx.select_most_frequent(qopt, max_expansion);
+    }
+
+    if (factor != 0.0) {
+	if (op != Query::OP_SYNONYM) {
+	    qopt->set_total_subqs(qopt->get_total_subqs() + ctx.size());
+	} else {
+	    qopt->inc_total_subqs();
+	}
+    }
+
+    if (ctx.empty())
+	return new EmptyPostList;
+
+    if (op == Query::OP_MAX)
+	return ctx.postlist_max(qopt);
+
+    PostList * pl = ctx.postlist(qopt);
+    if (op == Query::OP_OR)
+	return pl;
+
+    // We build an OP_OR tree for OP_SYNONYM and then wrap it in a
+    // SynonymPostList, which supplies the weights.
+    return qopt->make_synonym_postlist(pl, factor);
+}
+
 PostingIterator::Internal *
 QueryWildcard::postlist(QueryOptimiser * qopt, double factor) const
 {
@@ -936,7 +1008,27 @@ QueryWildcard::postlist(QueryOptimiser * qopt, double factor) const
 	or_factor = factor;
     }
     OrContext ctx(0);
-    AutoPtr<TermList> t(qopt->db.open_allterms(pattern));
+    int limit_type = max_type & WILDCARD_LIMIT_MASK;
+    AutoPtr<TermList> t;
+    AutoPtr<WildcardPattern> glob;
+    if ((max_type & Xapian::Query::WILDCARD_PATTERN_GLOB) == 0) {
+	// The pattern is just a prefix.
+	t.reset(qopt->db.open_allterms(pattern));
+    } else {
+	glob.reset(new WildcardPattern(pattern, max_type));
+	if (glob->is_prefix_only()) {
+	    // No need to check each term against the pattern.
+	    t.reset(qopt->db.open_allterms(glob->get_fixed_prefix()));
+	    glob.reset();
+	} else {
+	    // Use the backend's wildcard index if it can narrow down the
+	    // candidate terms, otherwise check every term with the fixed
+	    // prefix.
+	    t.reset(qopt->db.open_wildcard_termlist(*glob));
+	    if (!t.get())
+		t.reset(qopt->db.open_allterms(glob->get_fixed_prefix()));
+	}
+    }
     Xapian::termcount expansions_left = max_expansion;
     // If there's no expansion limit, set expansions_left to the maximum
     // value Xapian::termcount can hold.
@@ -946,54 +1038,32 @@ QueryWildcard::postlist(QueryOptimiser * qopt, double factor) const
 	t->next();
 	if (t->at_end())
 	    break;
-	if (max_type < Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
+	const string & term = t->get_termname();
+	// Reserved terms sort after all others, so we're done if we reach
+	// one (which can only happen if there's no fixed prefix).
+	if (is_reserved_term(term))
+	    break;
+	if (glob.get() && !glob->match(term))
+	    continue;
+	if (limit_type < Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
 	    if (expansions_left-- == 0) {
-		if (max_type == Xapian::Query::WILDCARD_LIMIT_FIRST)
+		if (limit_type == Xapian::Query::WILDCARD_LIMIT_FIRST)
 		    break;
 		string msg("Wildcard ");
 		msg += pattern;
-		msg += "* expands to more than ";
+		if ((max_type & Xapian::Query::WILDCARD_PATTERN_GLOB) == 0)
+		    msg += '*';
+		msg += " expands to more than ";
 		msg += str(max_expansion);
 		msg += " terms";
 		throw Xapian::WildcardError(msg);
 	    }
 	}
-	const string & term = t->get_termname();
 	ctx.add_postlist(qopt->open_lazy_post_list(term, 1, or_factor));
     }
 
-    if (max_type == Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
-	// FIXME: open_lazy_post_list() results in the term getting registered
-	// for stats, so we still incur an avoidable cost from the full
-	// expansion size of the wildcard, which is most likely to be visible
-	// with the remote backend.  Perhaps we should split creating the lazy
-	// postlist from registering the term for stats.
-	if (ctx.size() > max_expansion)
-	    ctx.select_most_frequent(qopt, max_expansion);
-    }
-
-    if (factor != 0.0) {
-	if (op != Query::OP_SYNONYM) {
-	    qopt->set_total_subqs(qopt->get_total_subqs() + ctx.size());
-	} else {
-	    qopt->inc_total_subqs();
-	}
-    }
-
-    if (ctx.empty())
-	RETURN(new EmptyPostList);
-
-    if (op == Query::OP_MAX)
-	RETURN(ctx.postlist_max(qopt));
-
-    PostList * pl = ctx.postlist(qopt);
-    if (op == Query::OP_OR)
-	RETURN(pl);
-
-    // We build an OP_OR tree for OP_SYNONYM and then wrap it in a
-    // SynonymPostList, which supplies the weights.
-    PostingIterator::Internal * r = qopt->make_synonym_postlist(pl, factor);
-    RETURN(r);
+    RETURN(combine_expansion(qopt, ctx, op, factor, limit_type,
+			     max_expansion));
 }
 
 termcount
@@ -1045,6 +1115,133 @@ QueryWildcard::get_description() const
     return desc;
 }
 
+PostingIterator::Internal *
+QueryEditDistance::postlist(QueryOptimiser * qopt, double factor) const
+{
+    LOGCALL(QUERY, PostingIterator::Internal *, "QueryEditDistance::postlist", qopt | factor);
+    Query::op op = combiner;
+    double or_factor = 0.0;
+    if (factor == 0.0) {
+	// If we have a factor of 0, we don't care about the weights, so
+	// we're just like a normal OR query.
+	op = Query::OP_OR;
+    } else if (op != Query::OP_SYNONYM) {
+	or_factor = factor;
+    }
+    OrContext ctx(0);
+    int limit_type = max_type & WILDCARD_LIMIT_MASK;
+
+    // Split off the prefix which terms must match exactly - min_prefix_len
+    // is in characters, so find where that ends in bytes.
+    Utf8Iterator u(word);
+    for (size_t i = 0; i != min_prefix_len && u != Utf8Iterator(); ++i) ++u;
+    size_t prefix_len = u.raw() - word.data();
+    // Terms all start with the prefix, so we only need to compare the rest.
+    vector<unsigned> utf32_rest(u, Utf8Iterator());
+    size_t rest_bytes = word.size() - prefix_len;
+    EditDistanceCalculator edcalc(utf32_rest.data(), int(utf32_rest.size()));
+    vector<unsigned> utf32_term;
+
+    AutoPtr<TermList> t(qopt->db.open_allterms(word.substr(0, prefix_len)));
+    Xapian::termcount expansions_left = max_expansion;
+    // If there's no expansion limit, set expansions_left to the maximum
+    // value Xapian::termcount can hold.
+    if (expansions_left == 0)
+	--expansions_left;
+    while (true) {
+	t->next();
+	if (t->at_end())
+	    break;
+	const string & term = t->get_termname();
+	// Reserved terms sort after all others.
+	if (is_reserved_term(term))
+	    break;
+	// Each character is 1-4 bytes in UTF-8, so we can cheaply reject
+	// terms whose encoded length is too different.
+	size_t term_bytes = term.size() - prefix_len;
+	size_t len_diff = term_bytes > rest_bytes ?
+	    term_bytes - rest_bytes : rest_bytes - term_bytes;
+	if (len_diff > edit_distance * 4)
+	    continue;
+	utf32_term.assign(Utf8Iterator(term.data() + prefix_len, term_bytes),
+			  Utf8Iterator());
+	if (edcalc(utf32_term.data(), int(utf32_term.size()),
+		   int(edit_distance)) > int(edit_distance))
+	    continue;
+	if (limit_type < Xapian::Query::WILDCARD_LIMIT_MOST_FREQUENT) {
+	    if (expansions_left-- == 0) {
+		if (limit_type == Xapian::Query::WILDCARD_LIMIT_FIRST)
+		    break;
+		string msg("Fuzzy match for ");
+		msg += word;
+		msg += " expands to more than ";
+		msg += str(max_expansion);
+		msg += " terms";
+		throw Xapian::WildcardError(msg);
+	    }
+	}
+	ctx.add_postlist(qopt->open_lazy_post_list(term, 1, or_factor));
+    }
+
+    RETURN(combine_expansion(qopt, ctx, op, factor, limit_type,
+			     max_expansion));
+}
+
+termcount
+QueryEditDistance::get_length() const XAPIAN_NOEXCEPT
+{
+    // As for QueryWildcard, the expansion is conceptually one "virtual"
+    // term.
+    return 1;
+}
+
+void
+QueryEditDistance::serialise(string & result) const
+{
+    result += static_cast<char>(0x0a);
+    result += encode_length(max_expansion);
+    result += static_cast<unsigned char>(max_type);
+    result += static_cast<unsigned char>(combiner);
+    result += encode_length(edit_distance);
+    result += encode_length(min_prefix_len);
+    result += encode_length(word.size());
+    result += word;
+}
+
+Query::op
+QueryEditDistance::get_type() const XAPIAN_NOEXCEPT
+{
+    return Query::OP_EDIT_DISTANCE;
+}
+
+string
+QueryEditDistance::get_description() const
+{
+    string desc = "EDIT_DISTANCE ";
+    switch (combiner) {
+	case Query::OP_SYNONYM:
+	    desc += "SYNONYM ";
+	    break;
+	case Query::OP_MAX:
+	    desc += "MAX ";
+	    break;
+	case Query::OP_OR:
+	    desc += "OR ";
+	    break;
+	default:
+	    desc += "BAD ";
+	    break;
+    }
+    description_append(desc, word);
+    desc += '~';
+    desc += str(edit_distance);
+    if (min_prefix_len) {
+	desc += " prefix ";
+	desc += str(min_prefix_len);
+    }
+    return desc;
+}
+
 Xapian::termcount
 QueryBranch::get_length() const XAPIAN_NOEXCEPT
 {
@@ -1563,6 +1760,47 @@ QueryFilter::postlist_sub_and_like(AndContext& ctx, QueryOptimiser * qopt, doubl
     }
 }
 
+/** Add filters on any indexed pairs of adjacent terms in an exact phrase.
+ *
+ *  TermGenerator::FLAG_PHRASE_BIGRAMS indexes pairs of adjacent words as
+ *  reserved terms, and intersecting the postings for these first means we
+ *  only need to check positional data for documents which have every such
+ *  pair in the phrase.  This is only valid if every document in the database
+ *  was indexed with pairs, which we check for using the marker term.  If a
+ *  pair doesn't index any documents we can't tell that from the pair not
+ *  being indexed at all (e.g. because neither word is a stopword), so we only
+ *  use pairs which are present.
+ */
+static void
+add_bigram_filters(AndContext& ctx, QueryOptimiser * qopt,
+		   const QueryVector & subqueries)
+{
+    Xapian::doccount tf;
+    qopt->db.get_freqs(PHRASE_BIGRAM_MARKER_TERM, &tf, NULL);
+    if (tf == 0 || tf != qopt->db.get_doccount())
+	return;
+
+    bool old_need_positions = qopt->need_positions;
+    qopt->need_positions = false;
+    const string * prev = NULL;
+    QueryVector::const_iterator i;
+    for (i = subqueries.begin(); i != subqueries.end(); ++i) {
+	const string * term = NULL;
+	if ((*i).get_type() == Query::LEAF_TERM) {
+	    const QueryTerm * qt =
+		static_cast<const QueryTerm *>((*i).internal.get());
+	    if (!qt->get_term().empty()) term = &qt->get_term();
+	}
+	if (prev && term) {
+	    string pair = make_phrase_bigram_term(*prev, *term);
+	    qopt->db.get_freqs(pair, &tf, NULL);
+	    if (tf) ctx.add_postlist(qopt->open_post_list(pair, 1, 0.0));
+	}
+	prev = term;
+    }
+    qopt->need_positions = old_need_positions;
+}
+
 void
 QueryWindowed::postlist_windowed(Query::op op, AndContext& ctx, QueryOptimiser * qopt, double factor) const
 {
@@ -1580,6 +1818,9 @@ QueryWindowed::postlist_windowed(Query::op op, AndContext& ctx, QueryOptimiser *
 	// Record the positional filter to apply higher up the tree.
 	ctx.add_pos_filter(op, subqueries.size(), window);
 
+	if (op == Query::OP_PHRASE && window == subqueries.size())
+	    add_bigram_filters(ctx, qopt, subqueries);
+
 	qopt->need_positions = old_need_positions;
     } else {
 	QueryAndLike::postlist_sub_and_like(ctx, qopt, factor);
@@ -1734,6 +1975,12 @@ QueryWildcard::get_op() const
     return Xapian::Query::OP_WILDCARD;
 }
 
+Xapian::Query::op
+QueryEditDistance::get_op() const
+{
+    return Xapian::Query::OP_EDIT_DISTANCE;
+}
+
 string
 QueryAnd::get_description() const
 {
@@ -424,6 +424,49 @@ class QueryWildcard : public Query::Internal {
     std::string get_description() const;
 };
 
+class QueryEditDistance : public Query::Internal {
+    std::string word;
+
+    Xapian::termcount max_expansion;
+
+    int max_type;
+
+    Query::op combiner;
+
+    unsigned edit_distance;
+
+    size_t min_prefix_len;
+
+    Xapian::Query::op get_op() const;
+
+  public:
+    QueryEditDistance(const std::string &word_,
+		      Xapian::termcount max_expansion_,
+		      int max_type_,
+		      Query::op combiner_,
+		      unsigned edit_distance_,
+		      size_t min_prefix_len_)
+	: word(word_),
+	  max_expansion(max_expansion_),
+	  max_type(max_type_),
+	  combiner(combiner_),
+	  edit_distance(edit_distance_),
+	  min_prefix_len(min_prefix_len_)
+    { }
+
+    Xapian::Query::op get_type() const XAPIAN_NOEXCEPT XAPIAN_PURE_FUNCTION;
+
+    const std::string & get_word() const { return word; }
+
+    PostingIterator::Internal * postlist(QueryOptimiser * qopt, double factor) const;
+
+    termcount get_length() const XAPIAN_NOEXCEPT XAPIAN_PURE_FUNCTION;
+
+    void serialise(std::string & result) const;
+
+    std::string get_description() const;
+};
+
 }
 
 }
@@ -178,6 +178,10 @@ Registry::Internal::add_defaults()
     Xapian::MatchSpy * spy;
     spy = new Xapian::ValueCountMatchSpy();
     matchspies[spy->name()] = spy;
+    spy = new Xapian::FacetCountMatchSpy();
+    matchspies[spy->name()] = spy;
+    spy = new Xapian::DistinctCountMatchSpy();
+    matchspies[spy->name()] = spy;
 
     Xapian::LatLongMetric * metric;
     metric = new Xapian::GreatCircleMetric();
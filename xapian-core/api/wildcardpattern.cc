@@ -0,0 +1,102 @@
+/** @file wildcardpattern.cc
+ * @brief Parsing and matching of OP_WILDCARD patterns.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "wildcardpattern.h"
+
+#include "xapian/query.h"
+
+using namespace std;
+
+/// Return the offset of the UTF-8 character after the one at offset @a i.
+static inline size_t
+next_char(const string & s, size_t i)
+{
+    while (++i < s.size() && (static_cast<unsigned char>(s[i]) & 0xc0) == 0x80)
+	{ }
+    return i;
+}
+
+WildcardPattern::WildcardPattern(const string & pattern_, int flags)
+    : pattern(pattern_),
+      multi(flags & Xapian::Query::WILDCARD_PATTERN_MULTI),
+      single(flags & Xapian::Query::WILDCARD_PATTERN_SINGLE),
+      prefix_len(0)
+{
+    while (prefix_len != pattern.size() && !is_wildcard(pattern[prefix_len]))
+	++prefix_len;
+
+    anchored_start = (prefix_len != 0 || pattern.empty());
+    anchored_end = (pattern.empty() || !is_wildcard(pattern.back()));
+
+    string literal;
+    for (char ch : pattern) {
+	if (is_wildcard(ch)) {
+	    if (!literal.empty()) {
+		literals.push_back(literal);
+		literal.resize(0);
+	    }
+	} else {
+	    literal += ch;
+	}
+    }
+    if (!literal.empty())
+	literals.push_back(literal);
+}
+
+bool
+WildcardPattern::match(const string & term) const
+{
+    if (term.compare(0, prefix_len, pattern, 0, prefix_len) != 0)
+	return false;
+
+    // Greedy matching, backtracking to the most recent '*' on a mismatch.
+    size_t p = prefix_len, t = prefix_len;
+    size_t star_p = string::npos, star_t = 0;
+    while (t != term.size()) {
+	if (p != pattern.size()) {
+	    char ch = pattern[p];
+	    if (multi && ch == '*') {
+		star_p = ++p;
+		star_t = t;
+		continue;
+	    }
+	    if (single && ch == '?') {
+		++p;
+		t = next_char(term, t);
+		continue;
+	    }
+	    if (ch == term[t]) {
+		++p;
+		++t;
+		continue;
+	    }
+	}
+	if (star_p == string::npos)
+	    return false;
+	// Let the last '*' absorb one more character and try again.
+	p = star_p;
+	star_t = next_char(term, star_t);
+	t = star_t;
+    }
+
+    while (p != pattern.size() && multi && pattern[p] == '*')
+	++p;
+    return p == pattern.size();
+}
@@ -0,0 +1,93 @@
+/** @file wildcardpattern.h
+ * @brief Parsing and matching of OP_WILDCARD patterns.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_WILDCARDPATTERN_H
+#define XAPIAN_INCLUDED_WILDCARDPATTERN_H
+
+#include <string>
+#include <vector>
+
+/** A wildcard pattern, as used by OP_WILDCARD with WILDCARD_PATTERN_* flags.
+ *
+ *  If enabled by the flags, '*' matches zero or more characters and '?'
+ *  matches exactly one (UTF-8) character.  All other characters must match
+ *  exactly.
+ */
+class WildcardPattern {
+    /// The pattern.
+    std::string pattern;
+
+    /// Is '*' a wildcard?
+    bool multi;
+
+    /// Is '?' a wildcard?
+    bool single;
+
+    /// Length of the literal prefix before the first wildcard.
+    size_t prefix_len;
+
+    /// The runs of literal characters between wildcards.
+    std::vector<std::string> literals;
+
+    /// Must the first literal run be at the start of a matching term?
+    bool anchored_start;
+
+    /// Must the last literal run be at the end of a matching term?
+    bool anchored_end;
+
+    bool is_wildcard(char ch) const {
+	return (multi && ch == '*') || (single && ch == '?');
+    }
+
+  public:
+    /** Construct from a pattern.
+     *
+     *  @param pattern_	The pattern.
+     *  @param flags	Xapian::Query::WILDCARD_PATTERN_* flags (any other
+     *			bits are ignored).
+     */
+    WildcardPattern(const std::string & pattern_, int flags);
+
+    /// The literal prefix which all matching terms start with.
+    std::string get_fixed_prefix() const {
+	return pattern.substr(0, prefix_len);
+    }
+
+    /** Is this pattern a literal prefix followed by a single '*'?
+     *
+     *  If so, then every term with the fixed prefix matches.
+     */
+    bool is_prefix_only() const {
+	return multi && prefix_len == pattern.size() - 1 &&
+	       pattern[prefix_len] == '*';
+    }
+
+    /// The runs of literal characters between wildcards.
+    const std::vector<std::string> & get_literals() const { return literals; }
+
+    /// Must the first literal run be at the start of a matching term?
+    bool is_anchored_start() const { return anchored_start; }
+
+    /// Must the last literal run be at the end of a matching term?
+    bool is_anchored_end() const { return anchored_end; }
+
+    /// Test if @a term matches this pattern.
+    bool match(const std::string & term) const;
+};
+
+#endif // XAPIAN_INCLUDED_WILDCARDPATTERN_H
@@ -25,6 +25,7 @@
 #include <xapian/error.h>
 
 #include "omassert.h"
+#include "phrasebigrams.h"
 
 using namespace std;
 
@@ -53,3 +54,54 @@ AllTermsList::positionlist_begin() const
 {
     throw Xapian::InvalidOperationError("AllTermsList::positionlist_begin() isn't meaningful");
 }
+
+UnreservedAllTermsList::~UnreservedAllTermsList()
+{
+    delete real;
+}
+
+string
+UnreservedAllTermsList::get_termname() const
+{
+    return real->get_termname();
+}
+
+Xapian::doccount
+UnreservedAllTermsList::get_termfreq() const
+{
+    return real->get_termfreq();
+}
+
+Xapian::termcount
+UnreservedAllTermsList::get_collection_freq() const
+{
+    return real->get_collection_freq();
+}
+
+TermList *
+UnreservedAllTermsList::next()
+{
+    TermList * p = real->next();
+    if (p) {
+	delete real;
+	real = p;
+    }
+    return NULL;
+}
+
+TermList *
+UnreservedAllTermsList::skip_to(const string &term)
+{
+    TermList * p = real->skip_to(term);
+    if (p) {
+	delete real;
+	real = p;
+    }
+    return NULL;
+}
+
+bool
+UnreservedAllTermsList::at_end() const
+{
+    return real->at_end() || is_reserved_term(real->get_termname());
+}
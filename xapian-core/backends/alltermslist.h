@@ -83,4 +83,39 @@ class AllTermsList : public TermList {
     virtual Xapian::PositionIterator positionlist_begin() const;
 };
 
+/** Wrapper which hides reserved terms from an AllTermsList.
+ *
+ *  Reserved terms (see is_reserved_term()) sort after all other terms, so
+ *  we can just stop at the first one.
+ */
+class UnreservedAllTermsList : public AllTermsList {
+    /// The wrapped termlist.
+    TermList * real;
+
+  public:
+    /// Constructor - takes ownership of @a real_.
+    explicit UnreservedAllTermsList(TermList * real_) : real(real_) { }
+
+    /// Destructor.
+    ~UnreservedAllTermsList();
+
+    /// Return the termname at the current position.
+    std::string get_termname() const;
+
+    /// Return the term frequency for the term at the current position.
+    Xapian::doccount get_termfreq() const;
+
+    /// Return the collection frequency for the term at the current position.
+    Xapian::termcount get_collection_freq() const;
+
+    /// Advance the current position to the next term in the termlist.
+    TermList *next();
+
+    /// Skip forward to the specified term.
+    TermList *skip_to(const std::string &term);
+
+    /// Return true if the current position is past the last term in this list.
+    bool at_end() const;
+};
+
 #endif // XAPIAN_INCLUDED_ALLTERMSLIST_H
@@ -1015,6 +1015,13 @@ ChertDatabase::get_revision_info() const
     RETURN(buf);
 }
 
+string
+ChertDatabase::get_revision_key() const
+{
+    LOGCALL(DB, string, "ChertDatabase::get_revision_key", NO_ARGS);
+    RETURN(get_revision_info());
+}
+
 string
 ChertDatabase::get_uuid() const
 {
@@ -1686,6 +1693,15 @@ ChertWritableDatabase::clear_synonyms(const string & term) const
     synonym_table.clear_synonyms(term);
 }
 
+string
+ChertWritableDatabase::get_revision_key() const
+{
+    LOGCALL(DB, string, "ChertWritableDatabase::get_revision_key", NO_ARGS);
+    // Uncommitted changes are visible to searches, so the revision doesn't
+    // identify what we'd see.
+    RETURN(string());
+}
+
 void
 ChertWritableDatabase::set_metadata(const string & key, const string & value)
 {
@@ -301,6 +301,7 @@ class ChertDatabase : public Xapian::Database::Internal {
 				    bool need_whole_db,
 				    Xapian::ReplicationInfo * info);
 	string get_revision_info() const;
+	string get_revision_key() const;
 	string get_uuid() const;
 
 	void request_document(Xapian::docid /*did*/) const;
@@ -476,6 +477,8 @@ class ChertWritableDatabase : public ChertDatabase {
 	void remove_synonym(const string & word, const string & synonym) const;
 	void clear_synonyms(const string & word) const;
 
+	string get_revision_key() const;
+
 	void set_metadata(const string & key, const string & value);
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
 	//@}
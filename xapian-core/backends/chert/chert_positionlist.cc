@@ -106,7 +106,6 @@ ChertPositionList::read_data(const ChertTable * table, Xapian::docid did,
 
     have_started = false;
 
-    string data;
     if (!table->get_exact_entry(ChertPositionListTable::make_key(did, tname), data)) {
 	// There's no positional information for this term.
 	size = 0;
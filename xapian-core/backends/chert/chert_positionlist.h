@@ -76,6 +76,9 @@ class ChertPositionListTable : public ChertLazyTable {
 
 /** A position list in a chert database. */
 class ChertPositionList : public PositionList {
+    /// The encoded position list data, which rd reads from.
+    string data;
+
     /// Interpolative decoder.
     BitReader rd;
 
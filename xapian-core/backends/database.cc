@@ -73,6 +73,13 @@ Database::Internal::get_value_upper_bound(Xapian::valueno) const
     throw Xapian::UnimplementedError("This backend doesn't support get_value_upper_bound");
 }
 
+Xapian::doccount
+Database::Internal::estimate_value_freq(Xapian::valueno,
+					const string &, const string &) const
+{
+    return get_doccount() / 2;
+}
+
 Xapian::termcount
 Database::Internal::get_doclength_lower_bound() const
 {
@@ -183,6 +190,18 @@ Database::Internal::add_document(const Xapian::Document &)
     return 0;
 }
 
+Xapian::docid
+Database::Internal::add_documents(const vector<Xapian::Document> & docs,
+				  unsigned)
+{
+    Xapian::docid first_did = 0;
+    for (const Xapian::Document & doc : docs) {
+	Xapian::docid did = add_document(doc);
+	if (first_did == 0) first_did = did;
+    }
+    return first_did;
+}
+
 void
 Database::Internal::delete_document(Xapian::docid)
 {
@@ -231,6 +250,14 @@ Database::Internal::open_value_list(Xapian::valueno slot) const
     return new SlowValueList(this, slot);
 }
 
+TermList *
+Database::Internal::open_wildcard_termlist(const WildcardPattern &) const
+{
+    // Only implemented for some database backends - for others the caller
+    // will check every term which could match.
+    return NULL;
+}
+
 TermList *
 Database::Internal::open_spelling_termlist(const string &) const
 {
@@ -240,6 +267,14 @@ Database::Internal::open_spelling_termlist(const string &) const
     return NULL;
 }
 
+TermList *
+Database::Internal::open_spelling_candidates(const string &, unsigned) const
+{
+    // Only implemented for some database backends - for others the caller
+    // uses the trigram lists from open_spelling_termlist() instead.
+    return NULL;
+}
+
 TermList *
 Database::Internal::open_spelling_wordlist() const
 {
@@ -361,6 +396,12 @@ Database::Internal::get_revision_info() const
     throw Xapian::UnimplementedError("This backend doesn't provide access to revision information");
 }
 
+string
+Database::Internal::get_revision_key() const
+{
+    return string();
+}
+
 string
 Database::Internal::get_uuid() const
 {
@@ -26,6 +26,7 @@
 #define OM_HGUARD_DATABASE_H
 
 #include <string>
+#include <vector>
 
 #include "internaltypes.h"
 
@@ -41,6 +42,7 @@ using namespace std;
 
 class LeafPostList;
 class RemoteDatabase;
+class WildcardPattern;
 
 typedef Xapian::TermIterator::Internal TermList;
 typedef Xapian::PositionIterator::Internal PositionList;
@@ -191,6 +193,21 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual std::string get_value_upper_bound(Xapian::valueno slot) const;
 
+	/** Estimate how many documents have a value in a range.
+	 *
+	 *  The default implementation returns half the number of documents,
+	 *  which is only a fall-back for backends which don't keep suitable
+	 *  statistics.
+	 *
+	 *  @param slot	The value slot to examine.
+	 *  @param lo	The lower bound of the range.
+	 *  @param hi	The upper bound of the range, or empty for no upper
+	 *		bound.
+	 */
+	virtual Xapian::doccount estimate_value_freq(Xapian::valueno slot,
+						     const std::string & lo,
+						     const std::string & hi) const;
+
 	/// Get a lower bound on the length of a document in this DB.
 	virtual Xapian::termcount get_doclength_lower_bound() const;
 
@@ -264,6 +281,17 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual TermList * open_allterms(const string & prefix) const = 0;
 
+	/** Open a termlist of candidate terms for a wildcard pattern.
+	 *
+	 *  The returned list is in ascending term order and includes every
+	 *  term which matches @a pattern, but may also include terms which
+	 *  don't, so the caller needs to check each term.
+	 *
+	 *  If the backend has no index which can narrow down the candidates
+	 *  for @a pattern, returns NULL.
+	 */
+	virtual TermList * open_wildcard_termlist(const WildcardPattern & pattern) const;
+
 	/** Open a position list for the given term in the given document.
 	 *
 	 *  @param did    The document id for which a position list is being
@@ -304,6 +332,19 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual TermList * open_spelling_termlist(const string & word) const;
 
+	/** Open a list of candidate spelling corrections for @a word.
+	 *
+	 *  The list must include every spelling target within
+	 *  @a max_edit_distance edits of @a word, but may include others.
+	 *
+	 *  You can assume word.size() > 1.
+	 *
+	 *  If there's no suitable index to find the candidates, returns NULL
+	 *  and the caller falls back to open_spelling_termlist().
+	 */
+	virtual TermList * open_spelling_candidates(const string & word,
+						    unsigned max_edit_distance) const;
+
 	/** Return a termlist which returns the words which are spelling
 	 *  correction targets.
 	 *
@@ -437,6 +478,16 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual Xapian::docid add_document(const Xapian::Document & document);
 
+	/** Add several new documents to the database.
+	 *
+	 *  See WritableDatabase::add_documents() for more information.
+	 *
+	 *  The default implementation just calls add_document() for each
+	 *  document in turn.
+	 */
+	virtual Xapian::docid add_documents(const std::vector<Xapian::Document> & docs,
+					    unsigned num_threads);
+
 	/** Delete a document in the database.
 	 *
 	 *  See WritableDatabase::delete_document() for more information.
@@ -491,6 +542,16 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	/// Get a string describing the current revision of the database.
 	virtual string get_revision_info() const;
 
+	/** Get a string identifying the revision being searched.
+	 *
+	 *  This is used along with get_uuid() to check whether cached match
+	 *  results are still valid, so for a given UUID it must change whenever
+	 *  the documents seen through this object could have changed.  An empty
+	 *  string means results shouldn't be cached, which is what the default
+	 *  implementation returns.
+	 */
+	virtual string get_revision_key() const;
+
 	/** Get a UUID for the database.
 	 *
 	 *  The UUID will persist for the lifetime of the database.
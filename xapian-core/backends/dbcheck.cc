@@ -56,7 +56,8 @@ static const struct { char name[9]; } glass_tables[] = {
     { "postlist" },
     { "position" },
     { "spelling" },
-    { "synonym" }
+    { "synonym" },
+    { "wildcard" }
 };
 #endif
 
@@ -180,7 +181,8 @@ check_db_dir(const string & path, int opts, std::ostream *out)
 	    { "postlist" },
 	    { "position" },
 	    { "spelling" },
-	    { "synonym" }
+	    { "synonym" },
+	    { "wildcard" }
 	};
 	for (auto t : tables) {
 	    const char * name = t.name;
@@ -39,6 +39,7 @@
 #include <cstdlib> // For atoi().
 
 #ifdef XAPIAN_HAS_GLASS_BACKEND
+# include "glass/glass_blockcache.h"
 # include "glass/glass_database.h"
 #endif
 #ifdef XAPIAN_HAS_CHERT_BACKEND
@@ -56,6 +57,16 @@
 
 using namespace std;
 
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+/// Map Database constructor flags to the flags to open a GlassDatabase with.
+static int
+glass_read_flags(int flags)
+{
+    return (flags & Xapian::DB_MMAP) ? Xapian::DB_READONLY_MMAP_
+				     : Xapian::DB_READONLY_;
+}
+#endif
+
 static bool
 check_if_single_file_db(const struct stat & sb, const string & path,
 			int * fd_ptr = NULL)
@@ -100,6 +111,36 @@ InMemory::open() {
 }
 #endif
 
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+void
+Glass::set_block_cache_size(size_t size)
+{
+    LOGCALL_STATIC_VOID(API, "Glass::set_block_cache_size", size);
+    GlassBlockCache::get_instance().set_max_size(size);
+}
+
+size_t
+Glass::get_block_cache_size()
+{
+    LOGCALL_STATIC(API, size_t, "Glass::get_block_cache_size", NO_ARGS);
+    RETURN(GlassBlockCache::get_instance().get_max_size());
+}
+
+unsigned long long
+Glass::get_block_cache_hits()
+{
+    LOGCALL_STATIC(API, unsigned long long, "Glass::get_block_cache_hits", NO_ARGS);
+    RETURN(GlassBlockCache::get_instance().get_hits());
+}
+
+unsigned long long
+Glass::get_block_cache_misses()
+{
+    LOGCALL_STATIC(API, unsigned long long, "Glass::get_block_cache_misses", NO_ARGS);
+    RETURN(GlassBlockCache::get_instance().get_misses());
+}
+#endif
+
 static void
 open_stub(Database &db, const string &file)
 {
@@ -324,7 +365,7 @@ Database::Database(const string &path, int flags)
 #endif
 	case DB_BACKEND_GLASS:
 #ifdef XAPIAN_HAS_GLASS_BACKEND
-	    internal.push_back(new GlassDatabase(path));
+	    internal.push_back(new GlassDatabase(path, glass_read_flags(flags)));
 	    return;
 #else
 	    throw FeatureUnavailableError("Glass backend disabled");
@@ -344,7 +385,7 @@ Database::Database(const string &path, int flags)
 	int fd;
 	if (check_if_single_file_db(statbuf, path, &fd)) {
 	    // Single file glass format.
-	    internal.push_back(new GlassDatabase(fd));
+	    internal.push_back(new GlassDatabase(fd, glass_read_flags(flags)));
 	    return;
 	}
 
@@ -365,7 +406,7 @@ Database::Database(const string &path, int flags)
 
 #ifdef XAPIAN_HAS_GLASS_BACKEND
     if (file_exists(path + "/iamglass")) {
-	internal.push_back(new GlassDatabase(path));
+	internal.push_back(new GlassDatabase(path, glass_read_flags(flags)));
 	return;
     }
 #endif
@@ -405,7 +446,7 @@ Database::Database(int fd, int flags)
     int type = flags & DB_BACKEND_MASK_;
     switch (type) {
 	case 0: case DB_BACKEND_GLASS:
-	    internal.push_back(new GlassDatabase(fd));
+	    internal.push_back(new GlassDatabase(fd, glass_read_flags(flags)));
 	    return;
     }
 #else
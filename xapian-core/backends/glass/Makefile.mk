@@ -5,6 +5,7 @@ if BUILD_BACKEND_GLASS
 noinst_HEADERS +=\
 	backends/glass/glass_alldocspostlist.h\
 	backends/glass/glass_alltermslist.h\
+	backends/glass/glass_blockcache.h\
 	backends/glass/glass_changes.h\
 	backends/glass/glass_check.h\
 	backends/glass/glass_cursor.h\
@@ -29,11 +30,13 @@ noinst_HEADERS +=\
 	backends/glass/glass_termlisttable.h\
 	backends/glass/glass_valuelist.h\
 	backends/glass/glass_values.h\
-	backends/glass/glass_version.h
+	backends/glass/glass_version.h\
+	backends/glass/glass_wildcard.h
 
 lib_src +=\
 	backends/glass/glass_alldocspostlist.cc\
 	backends/glass/glass_alltermslist.cc\
+	backends/glass/glass_blockcache.cc\
 	backends/glass/glass_changes.cc\
 	backends/glass/glass_check.cc\
 	backends/glass/glass_compact.cc\
@@ -55,6 +58,7 @@ lib_src +=\
 	backends/glass/glass_termlisttable.cc\
 	backends/glass/glass_valuelist.cc\
 	backends/glass/glass_values.cc\
-	backends/glass/glass_version.cc
+	backends/glass/glass_version.cc\
+	backends/glass/glass_wildcard.cc
 
 endif
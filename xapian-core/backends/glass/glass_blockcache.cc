@@ -0,0 +1,192 @@
+/** @file glass_blockcache.cc
+ * @brief Process-wide cache of blocks read from glass tables.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "glass_blockcache.h"
+
+#include "unaligned.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+/// Read the initial size of the process-wide cache from the environment.
+static size_t
+initial_cache_size()
+{
+    const char *p = getenv("XAPIAN_GLASS_BLOCK_CACHE_SIZE");
+    if (!p)
+	return 0;
+    return strtoul(p, NULL, 10);
+}
+
+GlassBlockCache &
+GlassBlockCache::get_instance()
+{
+    // Initialisation of a function-local static is thread-safe in C++11.
+    static GlassBlockCache cache(initial_cache_size());
+    return cache;
+}
+
+bool
+GlassBlockCache::enabled() const
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    return max_size != 0;
+}
+
+void
+GlassBlockCache::evict(size_t extra)
+{
+    while (!lru.empty() && cur_size + extra > max_size) {
+	const Entry & victim = lru.back();
+	cur_size -= victim.data.size();
+	index.erase(victim.key);
+	lru.pop_back();
+    }
+}
+
+GlassBlockCache::lookup_result
+GlassBlockCache::get(const GlassBlockKey & key, glass_revision_number_t rev,
+		     byte * p, unsigned block_size)
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    index_type::iterator i = index.find(key);
+    if (i == index.end() || i->second->data.size() != block_size) {
+	++misses;
+	return MISS;
+    }
+    const Entry & entry = *i->second;
+    if (rev > entry.checked_rev)
+	return CHECK;
+    ++hits;
+    // Move to the front of the LRU list.
+    lru.splice(lru.begin(), lru, i->second);
+    memcpy(p, entry.data.data(), block_size);
+    return HIT;
+}
+
+bool
+GlassBlockCache::revalidate(const GlassBlockKey & key,
+			    glass_revision_number_t rev,
+			    glass_revision_number_t disk_rev,
+			    byte * p, unsigned block_size)
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    index_type::iterator i = index.find(key);
+    if (i == index.end() || i->second->data.size() != block_size) {
+	// Discarded since get() was called.
+	++misses;
+	return false;
+    }
+    Entry & entry = *i->second;
+    const byte * data = reinterpret_cast<const byte *>(entry.data.data());
+    // A block starts with the revision it was written at.
+    glass_revision_number_t cached_rev = getint4(data, 0);
+    if (disk_rev != cached_rev) {
+	// The block has been reused.
+	++misses;
+	cur_size -= entry.data.size();
+	lru.erase(i->second);
+	index.erase(i);
+	return false;
+    }
+    ++hits;
+    if (rev > entry.checked_rev) entry.checked_rev = rev;
+    lru.splice(lru.begin(), lru, i->second);
+    memcpy(p, data, block_size);
+    return true;
+}
+
+void
+GlassBlockCache::add(const GlassBlockKey & key, glass_revision_number_t rev,
+		     const byte * p, unsigned block_size)
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    if (block_size > max_size) return;
+    index_type::iterator i = index.find(key);
+    if (i != index.end()) {
+	// Another table handle read this block while we were reading it.
+	Entry & entry = *i->second;
+	if (entry.data.size() == block_size &&
+	    memcmp(entry.data.data(), p, block_size) == 0) {
+	    if (rev > entry.checked_rev) entry.checked_rev = rev;
+	    return;
+	}
+	cur_size -= entry.data.size();
+	lru.erase(i->second);
+	index.erase(i);
+    }
+    evict(block_size);
+    lru.push_front(Entry());
+    Entry & entry = lru.front();
+    entry.key = key;
+    entry.checked_rev = rev;
+    entry.data.assign(reinterpret_cast<const char *>(p), block_size);
+    index.insert(make_pair(key, lru.begin()));
+    cur_size += block_size;
+}
+
+void
+GlassBlockCache::set_max_size(size_t max_size_)
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    max_size = max_size_;
+    evict(0);
+}
+
+void
+GlassBlockCache::clear()
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    lru.clear();
+    index.clear();
+    cur_size = 0;
+    hits = misses = 0;
+}
+
+unsigned long long
+GlassBlockCache::get_hits() const
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    return hits;
+}
+
+unsigned long long
+GlassBlockCache::get_misses() const
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    return misses;
+}
+
+size_t
+GlassBlockCache::get_size() const
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    return cur_size;
+}
+
+size_t
+GlassBlockCache::get_max_size() const
+{
+    lock_guard<std::mutex> lock(cache_mutex);
+    return max_size;
+}
@@ -0,0 +1,217 @@
+/** @file glass_blockcache.h
+ * @brief Process-wide cache of blocks read from glass tables.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_GLASS_BLOCKCACHE_H
+#define XAPIAN_INCLUDED_GLASS_BLOCKCACHE_H
+
+#include "glass_defs.h"
+
+#include <sys/types.h>
+
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+/** Identifies a block of a glass table.
+ *
+ *  The database UUID is included as well as the inode since a database can be
+ *  overwritten in place, which restarts the revision numbering without
+ *  changing the inode.
+ */
+struct GlassBlockKey {
+    /// Device and inode of the file the table lives in.
+    unsigned long long dev, ino;
+
+    /// Offset of the table in the file (non-zero for single-file databases).
+    off_t offset;
+
+    /// The UUID of the database.
+    char uuid[16];
+
+    /// The block number.
+    uint4 n;
+
+    GlassBlockKey() : dev(0), ino(0), offset(0), n(0) {
+	std::memset(uuid, 0, sizeof(uuid));
+    }
+
+    bool operator<(const GlassBlockKey & o) const {
+	if (n != o.n) return n < o.n;
+	if (ino != o.ino) return ino < o.ino;
+	if (offset != o.offset) return offset < o.offset;
+	if (dev != o.dev) return dev < o.dev;
+	return std::memcmp(uuid, o.uuid, sizeof(uuid)) < 0;
+    }
+};
+
+/** A size-bounded, least-recently-used cache of blocks.
+ *
+ *  One instance (returned by get_instance()) is shared by all the read-only
+ *  glass tables in the process, so that several Database objects on the same
+ *  files don't each need to read the same branch and leaf blocks.
+ *
+ *  A block isn't modified once written until it has been freed and reused,
+ *  and reusing it stamps it with a later revision.  So each entry records the
+ *  highest revision it's known to be current for, and is used as is by
+ *  readers of that revision or earlier (an earlier reader which shouldn't see
+ *  the cached version will find its revision is too new, just as it would
+ *  reading from the file).  A reader of a later revision only needs to check
+ *  the revision stored at the start of the block on disk is unchanged, so
+ *  entries survive commits.
+ *
+ *  Methods may be called concurrently from different threads.  Blocks are
+ *  copied in and out under the lock, so a cached block is never referenced
+ *  from outside the cache and never needs to be pinned.
+ */
+class GlassBlockCache {
+    /// Don't allow copying.
+    GlassBlockCache(const GlassBlockCache &);
+
+    /// Don't allow assignment.
+    void operator=(const GlassBlockCache &);
+
+    struct Entry {
+	GlassBlockKey key;
+
+	/// The highest revision this block is known to be current for.
+	glass_revision_number_t checked_rev;
+
+	std::string data;
+    };
+
+    /// Protects all the other members.
+    mutable std::mutex cache_mutex;
+
+    /// Entries, with the most recently used at the front.
+    std::list<Entry> lru;
+
+    typedef std::map<GlassBlockKey, std::list<Entry>::iterator> index_type;
+
+    /// Map from key to position in lru.
+    index_type index;
+
+    /// Maximum number of bytes of block data to hold.
+    size_t max_size;
+
+    /// Number of bytes of block data currently held.
+    size_t cur_size;
+
+    /// Number of lookups which found the block, and which didn't.
+    unsigned long long hits, misses;
+
+    /// Discard least recently used entries until there's room for @a extra.
+    void evict(size_t extra);
+
+  public:
+    /** Construct a cache.
+     *
+     *  @param max_size_	Maximum number of bytes of block data to hold
+     *				(0 disables the cache).
+     */
+    explicit GlassBlockCache(size_t max_size_)
+	: max_size(max_size_), cur_size(0), hits(0), misses(0) { }
+
+    /** Return the process-wide cache.
+     *
+     *  Its initial size is set from the environment variable
+     *  XAPIAN_GLASS_BLOCK_CACHE_SIZE (in bytes) on first use, and defaults to
+     *  0, which disables caching.  It can be changed with
+     *  Xapian::Glass::set_block_cache_size().
+     */
+    static GlassBlockCache & get_instance();
+
+    /// Return true if this cache can hold any blocks.
+    bool enabled() const;
+
+    /// Result of looking up a block with get().
+    typedef enum {
+	/// The block isn't in the cache.
+	MISS,
+	/// The block was found and has been copied into the buffer.
+	HIT,
+	/** The block was found but may have changed since.
+	 *
+	 *  The caller should read the revision stored in the block on disk and
+	 *  pass it to revalidate().
+	 */
+	CHECK
+    } lookup_result;
+
+    /** Look up a block.
+     *
+     *  @param key		The block to look for.
+     *  @param rev		The revision the reading table has open.
+     *  @param p		Buffer to copy the block into if found.
+     *  @param block_size	Size of the block in bytes.
+     */
+    lookup_result get(const GlassBlockKey & key, glass_revision_number_t rev,
+		      byte * p, unsigned block_size);
+
+    /** Check a cached block found by get() to need checking.
+     *
+     *  @param key		The block.
+     *  @param rev		The revision the reading table has open.
+     *  @param disk_rev		The revision stored in the block on disk.
+     *  @param p		Buffer to copy the block into if still current.
+     *  @param block_size	Size of the block in bytes.
+     *
+     *  @return true if the cached block is still current (in which case it
+     *		has been copied into @a p); false if it's been discarded.
+     */
+    bool revalidate(const GlassBlockKey & key, glass_revision_number_t rev,
+		    glass_revision_number_t disk_rev,
+		    byte * p, unsigned block_size);
+
+    /** Add a copy of a block to the cache.
+     *
+     *  @param key		The block.
+     *  @param rev		The revision of the table the block was read by.
+     *  @param p		The block.
+     *  @param block_size	Size of the block in bytes.
+     */
+    void add(const GlassBlockKey & key, glass_revision_number_t rev,
+	     const byte * p, unsigned block_size);
+
+    /** Set the maximum size in bytes, discarding entries if necessary.
+     *
+     *  Tables decide whether to use the cache when they are opened, so
+     *  changing whether the cache is enabled only affects tables opened
+     *  afterwards.
+     */
+    void set_max_size(size_t max_size_);
+
+    /// Discard all entries and reset the statistics.
+    void clear();
+
+    /// Number of lookups which found the requested block.
+    unsigned long long get_hits() const;
+
+    /// Number of lookups which didn't find the requested block.
+    unsigned long long get_misses() const;
+
+    /// Number of bytes of block data currently held.
+    size_t get_size() const;
+
+    /// Maximum number of bytes of block data to hold.
+    size_t get_max_size() const;
+};
+
+#endif // XAPIAN_INCLUDED_GLASS_BLOCKCACHE_H
@@ -26,11 +26,11 @@
 #include "glass_replicate_internal.h"
 #include "fd.h"
 #include "io_utils.h"
+#include "omassert.h"
 #include "pack.h"
 #include "posixy_wrapper.h"
 #include "str.h"
 #include "stringutils.h"
-#include "unaligned.h"
 #include "xapian/constants.h"
 #include "xapian/error.h"
 
@@ -83,28 +83,93 @@ GlassChanges::start(glass_revision_number_t old_rev,
     }
 
     // Write header for changeset file.
-    string header = CHANGES_MAGIC_STRING;
-    header += char(CHANGES_VERSION);
-    pack_uint(header, old_rev);
-    pack_uint(header, rev);
+    string header;
+    encode_header(header, old_rev, rev, flags);
+    io_write(changes_fd, header.data(), header.size());
+    return this;
+}
+
+void
+GlassChanges::encode_header(string & buf,
+			    glass_revision_number_t old_rev,
+			    glass_revision_number_t rev,
+			    int flags)
+{
+    buf += CHANGES_MAGIC_STRING;
+    buf += char(CHANGES_VERSION);
+    pack_uint(buf, old_rev);
+    pack_uint(buf, rev);
 
     if (flags & Xapian::DB_DANGEROUS) {
-	header += '\x01'; // Changes can't be applied to a live database.
+	buf += '\x01'; // Changes can't be applied to a live database.
     } else {
-	header += '\x00'; // Changes can be applied to a live database.
+	buf += '\x00'; // Changes can be applied to a live database.
     }
+}
 
-    io_write(changes_fd, header.data(), header.size());
-    // FIXME: save the block stream as a single zlib stream...
+void
+GlassChanges::encode_block(string & buf,
+			   Glass::table_type table,
+			   glass_block_t n,
+			   const byte * p,
+			   unsigned block_size)
+{
+    // The block size is stored as log2(block_size / 2048).
+    unsigned v = 0;
+    while ((2048u << v) < block_size) ++v;
+    AssertEq(2048u << v, block_size);
+    AssertRel(v,<=,5);
+
+    buf += char(unsigned(table) | (v << 3));
+    pack_uint(buf, n);
+    pack_uint(buf, uint4(crc32(0, p, block_size)));
+
+    // Compress each block separately, so the replica can decode and apply
+    // blocks as they arrive.  A compressed length of 0 means the block is
+    // stored uncompressed, as compression didn't make it any smaller.
+    comp_stream.lazy_alloc_deflate_zstream();
+    comp_stream.compress(p, int(block_size));
+    if (comp_stream.zerr == Z_STREAM_END) {
+	size_t len = comp_stream.deflate_zstream->total_out;
+	pack_uint(buf, len);
+	buf.append(reinterpret_cast<const char *>(comp_stream.out), len);
+    } else {
+	pack_uint(buf, 0u);
+	buf.append(reinterpret_cast<const char *>(p), block_size);
+    }
+}
 
-    // bool compressed = CHANGES_VERSION != 1; FIXME: always true for glass, but make optional?
-    return this;
+void
+GlassChanges::encode_version_file(string & buf,
+				  glass_revision_number_t rev,
+				  const string & data)
+{
+    buf += '\xfe';
+    pack_uint(buf, rev);
+    pack_uint(buf, data.size());
+    const Bytef * p = reinterpret_cast<const Bytef *>(data.data());
+    pack_uint(buf, uint4(crc32(0, p, data.size())));
+    buf += data;
 }
 
 void
-GlassChanges::write_block(const char * p, size_t len)
+GlassChanges::write_block(Glass::table_type table,
+			  glass_block_t n,
+			  const byte * p,
+			  unsigned block_size)
 {
-    io_write(changes_fd, p, len);
+    string buf;
+    encode_block(buf, table, n, p, block_size);
+    io_write(changes_fd, buf.data(), buf.size());
+}
+
+void
+GlassChanges::write_version_file(glass_revision_number_t rev,
+				 const string & data)
+{
+    string buf;
+    encode_version_file(buf, rev, data);
+    io_write(changes_fd, buf.data(), buf.size());
 }
 
 void
@@ -230,6 +295,9 @@ GlassChanges::check(const string & changes_file)
 	    size_t len;
 	    if (!unpack_uint(&p, end, &len))
 		throw Xapian::DatabaseError("Changes file - bad version file length");
+	    uint4 checksum;
+	    if (!unpack_uint(&p, end, &checksum))
+		throw Xapian::DatabaseError("Changes file - bad version file checksum");
 	    if (len <= size_t(end - p)) {
 		p += len;
 	    } else {
@@ -242,7 +310,7 @@ GlassChanges::check(const string & changes_file)
 	}
 	unsigned table = (v & 0x7);
 	v >>= 3;
-	if (table > 5)
+	if (table >= Glass::MAX_)
 	    throw Xapian::DatabaseError("Changes file - bad table code");
 	// Changed block.
 	if (v > 5)
@@ -251,14 +319,22 @@ GlassChanges::check(const string & changes_file)
 	uint4 block_number;
 	if (!unpack_uint(&p, end, &block_number))
 	    throw Xapian::DatabaseError("Changes file - bad block number");
-	uint4 block_rev = getint4(reinterpret_cast<const unsigned char *>(p), 0);
-	(void)block_rev; // FIXME: Sanity check value.
-	unsigned level = (unsigned char)p[4];
-	(void)level; // FIXME: Sanity check value.
-	if (block_size <= unsigned(end - p)) {
-	    p += block_size;
+	uint4 checksum;
+	if (!unpack_uint(&p, end, &checksum))
+	    throw Xapian::DatabaseError("Changes file - bad block checksum");
+	size_t len;
+	if (!unpack_uint(&p, end, &len))
+	    throw Xapian::DatabaseError("Changes file - bad block length");
+	if (len == 0) {
+	    // Stored uncompressed.
+	    len = block_size;
+	} else if (len >= block_size) {
+	    throw Xapian::DatabaseError("Changes file - bad compressed block length");
+	}
+	if (len <= size_t(end - p)) {
+	    p += len;
 	} else {
-	    if (lseek(fd, block_size - (end - p), SEEK_CUR) == off_t(-1))
+	    if (lseek(fd, len - (end - p), SEEK_CUR) == off_t(-1))
 		throw Xapian::DatabaseError("Changes file - block data truncated");
 	    p = end = buf;
 	    n = 0;
@@ -23,6 +23,7 @@
 #define XAPIAN_INCLUDED_GLASS_CHANGES_H
 
 #include "glass_defs.h"
+#include "compression_stream.h"
 #include <string>
 
 class GlassChanges {
@@ -46,11 +47,15 @@ class GlassChanges {
      */
     glass_revision_number_t oldest_changeset;
 
+    /// Used to compress changed blocks.
+    CompressionStream comp_stream;
+
   public:
     GlassChanges(const std::string & db_dir)
 	: changes_fd(-1),
 	  changes_stem(db_dir + "/changes"),
-	  oldest_changeset(0) { }
+	  oldest_changeset(0),
+	  comp_stream(Z_DEFAULT_STRATEGY) { }
 
     ~GlassChanges();
 
@@ -58,11 +63,41 @@ class GlassChanges {
 			 glass_revision_number_t rev,
 			 int flags);
 
-    void write_block(const char * p, size_t len);
+    /** Append the header of a changeset to @a buf.
+     *
+     *  @param flags	Xapian::DB_DANGEROUS is checked for.
+     */
+    static void encode_header(std::string & buf,
+			      glass_revision_number_t old_rev,
+			      glass_revision_number_t rev,
+			      int flags);
 
-    void write_block(const std::string & s) {
-	write_block(s.data(), s.size());
-    }
+    /** Append a changed block to @a buf.
+     *
+     *  The block is compressed if that makes it smaller, and a checksum of
+     *  the uncompressed contents is included so the replica can detect
+     *  corruption in transit.
+     */
+    void encode_block(std::string & buf,
+		      Glass::table_type table,
+		      glass_block_t n,
+		      const byte * p,
+		      unsigned block_size);
+
+    /// Append a new version file to @a buf.
+    static void encode_version_file(std::string & buf,
+				    glass_revision_number_t rev,
+				    const std::string & data);
+
+    /// Write a changed block to the changeset.
+    void write_block(Glass::table_type table,
+		     glass_block_t n,
+		     const byte * p,
+		     unsigned block_size);
+
+    /// Write the new version file to the changeset.
+    void write_version_file(glass_revision_number_t rev,
+			    const std::string & data);
 
     void set_oldest_changeset(glass_revision_number_t rev) {
 	oldest_changeset = rev;
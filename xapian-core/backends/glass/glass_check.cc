@@ -285,6 +285,8 @@ GlassTableCheck::check(const char * tablename, const string & path, int fd,
 	tab_type = Glass::SPELLING;
     } else if (strcmp(tablename, "synonym") == 0) {
 	tab_type = Glass::SYNONYM;
+    } else if (strcmp(tablename, "wildcard") == 0) {
+	tab_type = Glass::WILDCARD;
     } else {
 	string e = "Unknown table: ";
 	e += tablename;
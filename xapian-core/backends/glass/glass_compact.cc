@@ -28,7 +28,13 @@
 
 #include "autoptr.h"
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <queue>
+#include <system_error>
+#include <thread>
 
 #include <cstdio>
 
@@ -39,6 +45,7 @@
 #include "glass_defs.h"
 #include "glass_table.h"
 #include "glass_cursor.h"
+#include "glass_values.h"
 #include "glass_version.h"
 #include "filetests.h"
 #include "internaltypes.h"
@@ -81,20 +88,32 @@ is_doclenchunk_key(const string & key)
 class PostlistCursor : private GlassCursor {
     Xapian::docid offset;
 
+    /// Stop at the first key >= this (empty for no limit).
+    string limit;
+
   public:
     string key, tag;
     Xapian::docid firstdid;
     Xapian::termcount tf, cf;
 
-    PostlistCursor(GlassTable *in, Xapian::docid offset_)
-	: GlassCursor(in), offset(offset_), firstdid(0)
+    /** Construct a cursor over the entries in [start, limit).
+     *
+     *  Call next() to move to the first entry.
+     */
+    PostlistCursor(GlassTable *in, Xapian::docid offset_,
+		   const string & start, const string & limit_)
+	: GlassCursor(in), offset(offset_), limit(limit_), firstdid(0)
     {
-	find_entry(string());
-	next();
+	if (start.empty()) {
+	    find_entry(string());
+	} else {
+	    find_entry_lt(start);
+	}
     }
 
     bool next() {
 	if (!GlassCursor::next()) return false;
+	if (!limit.empty() && current_key >= limit) return false;
 	// We put all chunks into the non-initial chunk form here, then fix up
 	// the first chunk for each term in the merged database as we merge.
 	read_tag();
@@ -102,7 +121,23 @@ class PostlistCursor : private GlassCursor {
 	tag = current_tag;
 	tf = cf = 0;
 	if (is_user_metadata_key(key)) return true;
-	if (is_valuestats_key(key)) return true;
+	if (is_valuestats_key(key)) {
+	    if (offset) {
+		// Adjust the docids in the sample of values.  The sample is
+		// ordered by a hash of the docid, so we need to rebuild it.
+		ValueStats stats;
+		Glass::decode_valuestats(tag, stats);
+		vector<pair<Xapian::docid, string> > sample;
+		swap(sample, stats.sample);
+		vector<pair<Xapian::docid, string> >::const_iterator i;
+		for (i = sample.begin(); i != sample.end(); ++i) {
+		    Glass::add_to_valuestats_sample(stats, i->first + offset,
+						    i->second);
+		}
+		tag = Glass::encode_valuestats(stats);
+	    }
+	    return true;
+	}
 	if (is_valuechunk_key(key)) {
 	    const char * p = key.data();
 	    const char * end = p + key.length();
@@ -172,25 +207,19 @@ class PostlistCursorGt {
     }
 };
 
-static string
-encode_valuestats(Xapian::doccount freq,
-		  const string & lbound, const string & ubound)
-{
-    string value;
-    pack_uint(value, freq);
-    pack_string(value, lbound);
-    // We don't store or count empty values, so neither of the bounds
-    // can be empty.  So we can safely store an empty upper bound when
-    // the bounds are equal.
-    if (lbound != ubound) value += ubound;
-    return value;
-}
-
+/** Merge postlist tables.
+ *
+ *  If @a start or @a limit are non-empty, only the entries with keys in the
+ *  range [start, limit) are merged - these must be keys for the initial
+ *  chunk of a term so that all the chunks for each term are merged together.
+ */
 static void
 merge_postlists(Xapian::Compactor * compactor,
 		GlassTable * out, vector<Xapian::docid>::const_iterator offset,
 		vector<GlassTable*>::const_iterator b,
-		vector<GlassTable*>::const_iterator e)
+		vector<GlassTable*>::const_iterator e,
+		const string & start = string(),
+		const string & limit = string())
 {
     priority_queue<PostlistCursor *, vector<PostlistCursor *>, PostlistCursorGt> pq;
     for ( ; b != e; ++b, ++offset) {
@@ -200,7 +229,12 @@ merge_postlists(Xapian::Compactor * compactor,
 	    continue;
 	}
 
-	pq.push(new PostlistCursor(in, *offset));
+	PostlistCursor * cur = new PostlistCursor(in, *offset, start, limit);
+	if (cur->next()) {
+	    pq.push(cur);
+	} else {
+	    delete cur;
+	}
     }
 
     string last_key;
@@ -258,8 +292,7 @@ merge_postlists(Xapian::Compactor * compactor,
 
     {
 	// Merge valuestats.
-	Xapian::doccount freq = 0;
-	string lbound, ubound;
+	ValueStats stats;
 
 	while (!pq.empty()) {
 	    PostlistCursor * cur = pq.top();
@@ -269,42 +302,30 @@ merge_postlists(Xapian::Compactor * compactor,
 		// For the first valuestats key, last_key will be the previous
 		// key we wrote, which we don't want to overwrite.  This is the
 		// only time that freq will be 0, so check that.
-		if (freq) {
-		    out->add(last_key, encode_valuestats(freq, lbound, ubound));
-		    freq = 0;
+		if (stats.freq) {
+		    out->add(last_key, Glass::encode_valuestats(stats));
+		    stats.clear();
 		}
 		last_key = key;
 	    }
 
-	    const string & tag = cur->tag;
-
-	    const char * pos = tag.data();
-	    const char * end = pos + tag.size();
-
-	    Xapian::doccount f;
-	    string l, u;
-	    if (!unpack_uint(&pos, end, &f)) {
-		if (*pos == 0) throw Xapian::DatabaseCorruptError("Incomplete stats item in value table");
-		throw Xapian::RangeError("Frequency statistic in value table is too large");
-	    }
-	    if (!unpack_string(&pos, end, l)) {
-		if (*pos == 0) throw Xapian::DatabaseCorruptError("Incomplete stats item in value table");
-		throw Xapian::RangeError("Lower bound in value table is too large");
-	    }
-	    size_t len = end - pos;
-	    if (len == 0) {
-		u = l;
+	    ValueStats s;
+	    Glass::decode_valuestats(cur->tag, s);
+	    if (stats.freq == 0) {
+		stats.lower_bound = s.lower_bound;
+		stats.upper_bound = s.upper_bound;
 	    } else {
-		u.assign(pos, len);
+		if (s.lower_bound < stats.lower_bound)
+		    stats.lower_bound = s.lower_bound;
+		if (s.upper_bound > stats.upper_bound)
+		    stats.upper_bound = s.upper_bound;
 	    }
-	    if (freq == 0) {
-		freq = f;
-		lbound = l;
-		ubound = u;
-	    } else {
-		freq += f;
-		if (l < lbound) lbound = l;
-		if (u > ubound) ubound = u;
+	    stats.freq += s.freq;
+	    // Insert every sampled value so the merged sample keeps the order
+	    // add_to_valuestats_sample() relies on.
+	    vector<pair<Xapian::docid, string> >::const_iterator i;
+	    for (i = s.sample.begin(); i != s.sample.end(); ++i) {
+		Glass::add_to_valuestats_sample(stats, i->first, i->second);
 	    }
 
 	    pq.pop();
@@ -315,8 +336,8 @@ merge_postlists(Xapian::Compactor * compactor,
 	    }
 	}
 
-	if (freq) {
-	    out->add(last_key, encode_valuestats(freq, lbound, ubound));
+	if (stats.freq) {
+	    out->add(last_key, Glass::encode_valuestats(stats));
 	}
     }
 
@@ -351,7 +372,9 @@ merge_postlists(Xapian::Compactor * compactor,
 		pack_uint(first_tag, cf);
 		pack_uint(first_tag, tags[0].first - 1);
 		string tag = tags[0].second;
-		tag[0] = (tags.size() == 1) ? '1' : '0';
+		// Update the "is last chunk" flag, keeping the "is bitmap
+		// chunk" flag.
+		tag[0] = char((tag[0] & ~1) | (tags.size() == 1 ? 1 : 0));
 		first_tag += tag;
 		out->add(last_key, first_tag);
 
@@ -367,7 +390,7 @@ merge_postlists(Xapian::Compactor * compactor,
 		i = tags.begin();
 		while (++i != tags.end()) {
 		    tag = i->second;
-		    tag[0] = (i + 1 == tags.end()) ? '1' : '0';
+		    tag[0] = char((tag[0] & ~1) | (i + 1 == tags.end() ? 1 : 0));
 		    out->add(pack_glass_postlist_key(term, i->first), tag);
 		}
 	    }
@@ -409,9 +432,13 @@ merge_spellings(GlassTable * out,
 		vector<GlassTable*>::const_iterator e)
 {
     priority_queue<MergeCursor *, vector<MergeCursor *>, CursorGt> pq;
+    // We can only keep the deletion index if every input has one.
+    bool keep_deletes = true;
     for ( ; b != e; ++b) {
 	GlassTable *in = *b;
 	if (!in->empty()) {
+	    if (!in->key_exists(Glass::SPELLING_DELETES_MARKER_KEY))
+		keep_deletes = false;
 	    pq.push(new MergeCursor(in));
 	}
     }
@@ -421,6 +448,17 @@ merge_spellings(GlassTable * out,
 	pq.pop();
 
 	string key = cur->current_key;
+	bool is_deletes_marker = (key == Glass::SPELLING_DELETES_MARKER_KEY);
+	if (!keep_deletes && (is_deletes_marker || key[0] == 'D')) {
+	    // Drop the incomplete deletion index.
+	    if (cur->next()) {
+		pq.push(cur);
+	    } else {
+		delete cur;
+	    }
+	    continue;
+	}
+
 	if (pq.empty() || pq.top()->current_key > key) {
 	    // No need to merge the tags, just copy the (possibly compressed)
 	    // tag value.
@@ -436,7 +474,21 @@ merge_spellings(GlassTable * out,
 
 	// Merge tag values with the same key:
 	string tag;
-	if (key[0] != 'W') {
+	if (is_deletes_marker) {
+	    // The marker tags are all the same, so just use the first.
+	    cur->read_tag();
+	    tag = cur->current_tag;
+	    while (true) {
+		if (cur->next()) {
+		    pq.push(cur);
+		} else {
+		    delete cur;
+		}
+		if (pq.empty() || pq.top()->current_key != key) break;
+		cur = pq.top();
+		pq.pop();
+	    }
+	} else if (key[0] != 'W') {
 	    // We just want the union of words, so copy over the first instance
 	    // and skip any identical ones.
 	    priority_queue<PrefixCompressedStringItor *,
@@ -650,6 +702,127 @@ multimerge_postlists(Xapian::Compactor * compactor,
     }
 }
 
+/** Choose where to split the postlist merge into parts.
+ *
+ *  The keys returned are for the initial chunk of a term, and are in strictly
+ *  ascending order.  We use the branch blocks of the largest input as a guide
+ *  to how the terms are distributed.
+ *
+ *  @param inputs	The postlist tables to be merged.
+ *  @param n		The number of parts wanted.
+ */
+static vector<string>
+choose_postlist_splits(const vector<GlassTable *> & inputs, size_t n)
+{
+    vector<string> splits;
+    GlassTable * biggest = NULL;
+    for (auto in : inputs) {
+	if (!biggest || in->get_entry_count() > biggest->get_entry_count())
+	    biggest = in;
+    }
+    if (!biggest || biggest->empty()) return splits;
+
+    vector<string> keys;
+    biggest->get_split_keys(n, keys);
+    GlassCursor cur(biggest);
+    for (const string & k : keys) {
+	// Split at the start of the first term at or after k.
+	cur.find_entry_ge(k);
+	if (cur.after_end()) break;
+	const string & key = cur.current_key;
+	if (is_user_metadata_key(key) || is_valuestats_key(key) ||
+	    is_valuechunk_key(key) || is_doclenchunk_key(key)) {
+	    continue;
+	}
+	const char * p = key.data();
+	const char * end = p + key.size();
+	string term;
+	if (!unpack_string_preserving_sort(&p, end, term))
+	    throw Xapian::DatabaseCorruptError("Bad postlist key");
+	string split = pack_glass_postlist_key(term);
+	if (splits.empty() || split > splits.back())
+	    splits.push_back(split);
+    }
+    return splits;
+}
+
+/// Append the entries from temporary table @a in to @a out.
+static void
+append_table(GlassTable * out, GlassTable * in)
+{
+    if (in->empty()) return;
+    GlassCursor cur(in);
+    cur.find_entry(string());
+    while (cur.next()) {
+	bool compressed = cur.read_tag(true);
+	out->add(cur.current_key, cur.current_tag, compressed);
+    }
+}
+
+/** Compactor which serialises calls to another compactor's methods.
+ *
+ *  Used when compacting with several threads, since user subclasses of
+ *  Xapian::Compactor needn't be thread-safe.
+ */
+class LockedCompactor : public Xapian::Compactor {
+    Xapian::Compactor & compactor;
+
+    mutex compactor_mutex;
+
+  public:
+    explicit LockedCompactor(Xapian::Compactor & compactor_)
+	: compactor(compactor_) { }
+
+    void set_status(const string & table, const string & status) {
+	lock_guard<mutex> guard(compactor_mutex);
+	compactor.set_status(table, status);
+    }
+
+    string resolve_duplicate_metadata(const string & key,
+				      size_t num_tags, const string tags[]) {
+	lock_guard<mutex> guard(compactor_mutex);
+	return compactor.resolve_duplicate_metadata(key, num_tags, tags);
+    }
+};
+
+/** A temporary table holding one part of a split postlist merge.
+ *
+ *  Owns the table and the copies of the input tables opened for this part,
+ *  and removes them when destroyed so nothing is left behind on disk if the
+ *  compaction fails part way through.
+ */
+class PostlistMergePart {
+    /// Don't allow assignment.
+    void operator=(const PostlistMergePart &);
+
+    /// Don't allow copying.
+    PostlistMergePart(const PostlistMergePart &);
+
+    /// The inputs shared with the main postlist merge, which we don't own.
+    const vector<GlassTable *> & shared_inputs;
+
+  public:
+    /// The temporary output table.
+    GlassTable * out;
+
+    /// The input tables for this part.
+    vector<GlassTable *> inputs;
+
+    explicit PostlistMergePart(const vector<GlassTable *> & shared_inputs_)
+	: shared_inputs(shared_inputs_), out(NULL) { }
+
+    ~PostlistMergePart() {
+	if (out) {
+	    unlink(out->get_path().c_str());
+	    delete out;
+	}
+	for (size_t j = 0; j != inputs.size(); ++j) {
+	    if (inputs[j] != shared_inputs[j])
+		delete inputs[j];
+	}
+    }
+};
+
 class PositionCursor : private GlassCursor {
     Xapian::docid offset;
 
@@ -777,7 +950,8 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 		       size_t block_size,
 		       Xapian::Compactor::compaction_level compaction,
 		       unsigned flags,
-		       Xapian::docid last_docid)
+		       Xapian::docid last_docid,
+		       unsigned max_threads)
 {
     struct table_list {
 	// The "base name" of the table.
@@ -797,7 +971,8 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	{ "termlist",	Glass::TERMLIST,	Z_DEFAULT_STRATEGY,	false },
 	{ "position",	Glass::POSITION,	DONT_COMPRESS,		true },
 	{ "spelling",	Glass::SPELLING,	Z_DEFAULT_STRATEGY,	true },
-	{ "synonym",	Glass::SYNONYM,		Z_DEFAULT_STRATEGY,	true }
+	{ "synonym",	Glass::SYNONYM,		Z_DEFAULT_STRATEGY,	true },
+	{ "wildcard",	Glass::WILDCARD,	Z_DEFAULT_STRATEGY,	true }
     };
     const table_list * tables_end = tables +
 	(sizeof(tables) / sizeof(tables[0]));
@@ -810,6 +985,9 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	// FIXME: Support this combination - we need to put temporary files
 	// somewhere.
 	multipass = false;
+	// The tables share the output file and its freelist, so they have to
+	// be written one after another.
+	max_threads = 1;
     }
 
     if (block_size < 2048 || block_size > 65536 ||
@@ -852,10 +1030,36 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	fl.pack(fl_serialised);
     }
 
+    // Calls to the compactor's methods need to be serialised if we're going
+    // to make them from several threads.
+    AutoPtr<LockedCompactor> locked_compactor;
+    if (compactor && max_threads > 1) {
+	locked_compactor.reset(new LockedCompactor(*compactor));
+	compactor = locked_compactor.get();
+    }
+
+    struct table_job {
+	const table_list * t;
+	string dest;
+	vector<GlassTable*> inputs;
+	GlassTable * out;
+	RootInfo * root_info;
+	off_t in_size;
+	// Sometimes stat can fail for benign reasons (e.g. >= 2GB file
+	// on certain systems).
+	bool bad_stat;
+	// We can't currently report input sizes if there's a single file DB
+	// amongst the inputs.
+	bool single_file_in;
+    };
+
     vector<GlassTable *> tabs;
     tabs.reserve(tables_end - tables);
     off_t prev_size = block_size;
-    for (const table_list * t = tables; t < tables_end; ++t) {
+
+    // Find the inputs for table t and create the output table.  Returns false
+    // if there's no output table to write.
+    auto setup = [&](const table_list * t, table_job & job) {
 	// The postlist table requires an N-way merge, adjusting the
 	// headers of various blocks.  The spelling and synonym tables also
 	// need special handling.  The other tables have keys sorted in
@@ -864,27 +1068,21 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	if (compactor)
 	    compactor->set_status(t->name, string());
 
-	string dest;
+	job.t = t;
 	if (!single_file) {
-	    dest = destdir;
-	    dest += '/';
-	    dest += t->name;
-	    dest += '.';
+	    job.dest = destdir;
+	    job.dest += '/';
+	    job.dest += t->name;
+	    job.dest += '.';
 	}
 
 	bool output_will_exist = !t->lazy;
 
-	// Sometimes stat can fail for benign reasons (e.g. >= 2GB file
-	// on certain systems).
-	bool bad_stat = false;
-
-	// We can't currently report input sizes if there's a single file DB
-	// amongst the inputs.
-	bool single_file_in = false;
+	job.bad_stat = false;
+	job.single_file_in = false;
+	job.in_size = 0;
 
-	off_t in_size = 0;
-
-	vector<GlassTable*> inputs;
+	vector<GlassTable*> & inputs = job.inputs;
 	inputs.reserve(sources.size());
 	size_t inputs_present = 0;
 	for (auto src : sources) {
@@ -909,9 +1107,12 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 		case Glass::SYNONYM:
 		    table = &(db->synonym_table);
 		    break;
+		case Glass::WILDCARD:
+		    table = &(db->wildcard_table);
+		    break;
 		default:
 		    Assert(false);
-		    return;
+		    return false;
 	    }
 
 	    if (db->single_file()) {
@@ -920,19 +1121,19 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 		} else {
 		    // FIXME: Find actual size somehow?
 		    // in_size += table->size() / 1024;
-		    single_file_in = true;
+		    job.single_file_in = true;
 		    output_will_exist = true;
 		    ++inputs_present;
 		}
 	    } else {
 		off_t db_size = file_size(table->get_path());
 		if (errno == 0) {
-		    in_size += db_size / 1024;
+		    job.in_size += db_size / 1024;
 		    output_will_exist = true;
 		    ++inputs_present;
 		} else if (errno != ENOENT) {
 		    // We get ENOENT for an optional table.
-		    bad_stat = true;
+		    job.bad_stat = true;
 		    output_will_exist = true;
 		    ++inputs_present;
 		}
@@ -940,8 +1141,10 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	    inputs.push_back(table);
 	}
 
-	// If any inputs lack a termlist table, suppress it in the output.
-	if (t->type == Glass::TERMLIST && inputs_present != sources.size()) {
+	// If any inputs lack a termlist table or wildcard index, suppress it
+	// in the output (the output wildcard index would be missing terms).
+	if ((t->type == Glass::TERMLIST || t->type == Glass::WILDCARD) &&
+	    inputs_present != sources.size()) {
 	    if (inputs_present != 0) {
 		if (compactor) {
 		    string m = str(inputs_present);
@@ -950,7 +1153,7 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 		    m += " inputs present, so suppressing output";
 		    compactor->set_status(t->name, m);
 		}
-		continue;
+		return false;
 	    }
 	    output_will_exist = false;
 	}
@@ -958,7 +1161,7 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	if (!output_will_exist) {
 	    if (compactor)
 		compactor->set_status(t->name, "doesn't exist");
-	    continue;
+	    return false;
 	}
 
 	GlassTable * out;
@@ -966,14 +1169,15 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	    out = new GlassTable(t->name, fd, version_file_out->get_offset(),
 				 false, t->compress_strategy, false);
 	} else {
-	    out = new GlassTable(t->name, dest,
+	    out = new GlassTable(t->name, job.dest,
 				 false, t->compress_strategy, t->lazy);
 	}
 	tabs.push_back(out);
-	RootInfo * root_info = NULL;
+	job.out = out;
+	job.root_info = NULL;
 	if (single_file) {
-	    root_info = version_file_out->root_to_set(t->type);
-	    root_info->set_free_list(fl_serialised);
+	    job.root_info = version_file_out->root_to_set(t->type);
+	    job.root_info->set_free_list(fl_serialised);
 	    out->open(FLAGS, version_file_out->get_root(t->type), version_file_out->get_revision());
 	} else {
 	    out->create_and_open(FLAGS, block_size);
@@ -981,8 +1185,14 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 
 	out->set_full_compaction(compaction != compactor->STANDARD);
 	if (compaction == compactor->FULLER) out->set_max_item_size(1);
+	return true;
+    };
 
-	switch (t->type) {
+    // Merge the inputs into the output table.
+    auto merge = [&](const table_job & job) {
+	GlassTable * out = job.out;
+	const vector<GlassTable*> & inputs = job.inputs;
+	switch (job.t->type) {
 	    case Glass::POSTLIST: {
 		if (multipass && inputs.size() > 3) {
 		    multimerge_postlists(compactor, out, destdir,
@@ -999,6 +1209,12 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	    case Glass::SYNONYM:
 		merge_synonyms(out, inputs.begin(), inputs.end());
 		break;
+	    case Glass::WILDCARD:
+		// The wildcard table has the same format as the spelling
+		// table's fragment lists (and no 'W' keys), so merging
+		// takes the union of the term lists.
+		merge_spellings(out, inputs.begin(), inputs.end());
+		break;
 	    case Glass::POSITION:
 		merge_positions(out, inputs, offset);
 		break;
@@ -1007,20 +1223,27 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 		merge_docid_keyed(out, inputs, offset);
 		break;
 	}
+    };
+
+    // Commit the output table and report how the size changed.
+    auto finish = [&](const table_job & job) {
+	const table_list * t = job.t;
+	GlassTable * out = job.out;
+	bool bad_stat = job.bad_stat;
 
 	// Commit as revision 1.
 	out->flush_db();
 	out->commit(1, version_file_out->root_to_set(t->type));
 	out->sync();
-	if (single_file) fl_serialised = root_info->get_free_list();
+	if (single_file) fl_serialised = job.root_info->get_free_list();
 
 	off_t out_size = 0;
-	if (!bad_stat && !single_file_in) {
+	if (!bad_stat && !job.single_file_in) {
 	    off_t db_size;
 	    if (single_file) {
 		db_size = file_size(fd);
 	    } else {
-		db_size = file_size(dest + GLASS_TABLE_EXTENSION);
+		db_size = file_size(job.dest + GLASS_TABLE_EXTENSION);
 	    }
 	    if (errno == 0) {
 		if (single_file) {
@@ -1036,10 +1259,11 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	if (bad_stat) {
 	    if (compactor)
 		compactor->set_status(t->name, "Done (couldn't stat all the DB files)");
-	} else if (single_file_in) {
+	} else if (job.single_file_in) {
 	    if (compactor)
 		compactor->set_status(t->name, "Done (table sizes unknown for single file DB input)");
 	} else {
+	    off_t in_size = job.in_size;
 	    string status;
 	    if (out_size == in_size) {
 		status = "Size unchanged (";
@@ -1066,6 +1290,158 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 	    if (compactor)
 		compactor->set_status(t->name, status);
 	}
+    };
+
+    if (max_threads <= 1) {
+	for (const table_list * t = tables; t < tables_end; ++t) {
+	    table_job job;
+	    if (!setup(t, job)) continue;
+	    merge(job);
+	    finish(job);
+	}
+    } else {
+	vector<table_job> jobs;
+	jobs.reserve(tables_end - tables);
+	for (const table_list * t = tables; t < tables_end; ++t) {
+	    jobs.push_back(table_job());
+	    if (!setup(t, jobs.back())) jobs.pop_back();
+	}
+
+	// The postlist table is usually by far the largest, so we split its
+	// merge into parts by term where we can, and append the parts to the
+	// output table at the end.  Part 0 is merged straight into the output
+	// table.  A GlassTable can't be read from more than one thread at
+	// once, so the other parts each open their own copies of the inputs.
+	table_job * postlist_job = NULL;
+	vector<string> splits;
+	if (!jobs.empty() && jobs[0].t->type == Glass::POSTLIST &&
+	    !(multipass && jobs[0].inputs.size() > 3)) {
+	    bool can_split = true;
+	    for (auto src : sources) {
+		GlassDatabase * db = static_cast<GlassDatabase*>(src);
+		if (db->single_file() || db->postlist_table.is_writable()) {
+		    can_split = false;
+		    break;
+		}
+	    }
+	    if (can_split) {
+		splits = choose_postlist_splits(jobs[0].inputs, max_threads);
+		if (!splits.empty()) postlist_job = &jobs[0];
+	    }
+	}
+
+	vector<AutoPtr<PostlistMergePart>> parts;
+	if (postlist_job) {
+	    if (compactor) {
+		string m = "Merging in ";
+		m += str(splits.size() + 1);
+		m += " parts";
+		compactor->set_status(postlist_job->t->name, m);
+	    }
+	    for (size_t i = 1; i <= splits.size(); ++i) {
+		parts.emplace_back(new PostlistMergePart(postlist_job->inputs));
+		PostlistMergePart & part = *parts.back();
+		string dest = destdir;
+		dest += "/tmppart";
+		dest += str(i);
+		dest += '.';
+		// Don't compress temporary tables, even if the final table
+		// would be.
+		part.out = new GlassTable("postlist", dest, false);
+		// Use maximum blocksize for temporary tables.
+		part.out->create_and_open(Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC,
+					  65536);
+
+		part.inputs.reserve(sources.size());
+		for (size_t j = 0; j != sources.size(); ++j) {
+		    GlassTable * in = postlist_job->inputs[j];
+		    if (in->empty()) {
+			part.inputs.push_back(in);
+			continue;
+		    }
+		    GlassDatabase * db = static_cast<GlassDatabase*>(sources[j]);
+		    part.inputs.push_back(new GlassTable("postlist",
+							 db->db_dir + "/postlist.",
+							 true));
+		    part.inputs.back()->open(Xapian::DB_READONLY_,
+					     db->version_file.get_root(Glass::POSTLIST),
+					     db->version_file.get_revision());
+		}
+	    }
+	}
+
+	vector<std::function<void()>> tasks;
+	if (postlist_job) {
+	    tasks.push_back([&]() {
+		merge_postlists(compactor, postlist_job->out, offset.begin(),
+				postlist_job->inputs.begin(),
+				postlist_job->inputs.end(),
+				string(), splits.empty() ? string() : splits[0]);
+	    });
+	}
+	for (size_t i = 1; i <= parts.size(); ++i) {
+	    tasks.push_back([&, i]() {
+		PostlistMergePart & part = *parts[i - 1];
+		const string & start = splits[i - 1];
+		const string & limit = (i == splits.size() ? string() : splits[i]);
+		merge_postlists(compactor, part.out, offset.begin(),
+				part.inputs.begin(), part.inputs.end(),
+				start, limit);
+		part.out->flush_db();
+		RootInfo rootinfo;
+		part.out->commit(1, &rootinfo);
+	    });
+	}
+	for (auto & job : jobs) {
+	    if (&job == postlist_job) continue;
+	    tasks.push_back([&]() {
+		merge(job);
+		finish(job);
+	    });
+	}
+
+	atomic<size_t> next_task(0);
+	mutex error_mutex;
+	exception_ptr error;
+	auto worker = [&]() {
+	    size_t i;
+	    while ((i = next_task++) < tasks.size()) {
+		try {
+		    tasks[i]();
+		} catch (...) {
+		    lock_guard<mutex> guard(error_mutex);
+		    if (!error) error = current_exception();
+		    // Don't start any more tasks.
+		    next_task = tasks.size();
+		}
+	    }
+	};
+
+	vector<thread> threads;
+	size_t n_threads = min(size_t(max_threads), tasks.size());
+	while (threads.size() + 1 < n_threads) {
+	    try {
+		threads.emplace_back(worker);
+	    } catch (const system_error &) {
+		// We failed to start a thread, so just make do with the
+		// threads we already have.
+		break;
+	    }
+	}
+	// The calling thread does its share of the work too.
+	worker();
+	for (auto & th : threads) {
+	    th.join();
+	}
+
+	if (error) rethrow_exception(error);
+	for (auto & part : parts) {
+	    append_table(postlist_job->out, part->out);
+	}
+	// Remove the temporary tables now rather than when parts goes out of
+	// scope.
+	parts.clear();
+	if (postlist_job) finish(*postlist_job);
     }
 
     // If compacting to a single file output and all the tables are empty, pad
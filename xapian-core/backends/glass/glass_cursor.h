@@ -26,6 +26,7 @@
 #include "glass_defs.h"
 
 #include "omassert.h"
+#include "xapian/intrusive_ptr.h"
 
 #include <algorithm>
 #include <cstring>
@@ -36,6 +37,31 @@ using std::string;
 
 namespace Glass {
 
+/** A memory mapping of a table's file.
+ *
+ *  Shared by the table and any cursors with blocks in the mapping, so it
+ *  stays mapped until none of them point into it.
+ */
+class Mapping : public Xapian::Internal::intrusive_base {
+    /// Don't allow assignment.
+    void operator=(const Mapping &);
+
+    /// Don't allow copying.
+    Mapping(const Mapping &);
+
+    /// Start of the mapping.
+    void * addr;
+
+    /// Size of the mapping in bytes.
+    size_t size;
+
+  public:
+    Mapping(void * addr_, size_t size_) : addr(addr_), size(size_) { }
+
+    /// Unmap the mapping.
+    ~Mapping();
+};
+
 class Cursor {
     private:
         // Prevent copying
@@ -45,13 +71,40 @@ class Cursor {
 	/// Pointer to reference counted data.
 	char * data;
 
+	/** Pointer to the current block.
+	 *
+	 *  Usually this points into data, but for a memory mapped table it
+	 *  can point into mapping instead.
+	 */
+	const byte * p;
+
+	/** The mapping p points into, or NULL.
+	 *
+	 *  If set, data is NULL.
+	 */
+	Xapian::Internal::intrusive_ptr<Mapping> mapping;
+
+	/// The block number if p points into mapping.
+	uint4 mapped_n;
+
+	/// Release our reference to data.
+	void release_data() {
+	    if (data) {
+		if (--refs() == 0)
+		    delete [] data;
+		data = NULL;
+		rewrite = false;
+	    }
+	}
+
     public:
 	/// Constructor.
-	Cursor() : data(0), c(-1), rewrite(false) { }
+	Cursor() : data(0), p(0), mapped_n(BLK_UNUSED), c(-1), rewrite(false) { }
 
 	~Cursor() { destroy(); }
 
 	byte * init(unsigned block_size) {
+	    mapping = NULL;
 	    if (data && refs() > 1) {
 		--refs();
 		data = NULL;
@@ -62,29 +115,52 @@ class Cursor {
 	    set_n(BLK_UNUSED);
 	    rewrite = false;
 	    c = -1;
-	    return reinterpret_cast<byte*>(data + 8);
+	    byte * q = reinterpret_cast<byte*>(data + 8);
+	    p = q;
+	    return q;
+	}
+
+	/** Set the cursor to use a block in a memory mapped table.
+	 *
+	 *  @param mapping_	The mapping the block is in.
+	 *  @param mapped	Pointer to the block in the mapping.
+	 */
+	const byte * init_mapped(Mapping * mapping_, const byte * mapped) {
+	    release_data();
+	    mapping = mapping_;
+	    mapped_n = BLK_UNUSED;
+	    rewrite = false;
+	    c = -1;
+	    p = mapped;
+	    return p;
 	}
 
 	const byte * clone(const Cursor & o) {
 	    if (data != o.data) {
-		destroy();
+		release_data();
 		data = o.data;
-		++refs();
+		if (data) ++refs();
 	    }
-	    return reinterpret_cast<byte*>(data + 8);
+	    mapping = o.mapping;
+	    mapped_n = o.mapped_n;
+	    p = o.p;
+	    return p;
 	}
 
 	void swap(Cursor & o) {
 	    std::swap(data, o.data);
+	    std::swap(p, o.p);
+	    mapping.swap(o.mapping);
+	    std::swap(mapped_n, o.mapped_n);
 	    std::swap(c, o.c);
 	    std::swap(rewrite, o.rewrite);
 	}
 
 	void destroy() {
-	    if (data) {
-		if (--refs() == 0)
-		    delete [] data;
-		data = NULL;
+	    if (data || mapping.get()) {
+		release_data();
+		mapping = NULL;
+		p = NULL;
 		rewrite = false;
 	    }
 	}
@@ -99,11 +175,16 @@ class Cursor {
 	 *  Returns BLK_UNUSED if no block is currently loaded.
 	 */
 	uint4 get_n() const {
+	    if (mapping.get()) return mapped_n;
 	    Assert(data);
 	    return *reinterpret_cast<uint4*>(data + 4);
 	}
 
 	void set_n(uint4 n) {
+	    if (mapping.get()) {
+		mapped_n = n;
+		return;
+	    }
 	    Assert(data);
 	    //Assert(refs() == 1);
 	    *reinterpret_cast<uint4*>(data + 4) = n;
@@ -114,18 +195,20 @@ class Cursor {
 	 * Returns NULL if no block is currently loaded.
 	 */
 	const byte * get_p() const {
-	    if (rare(!data)) return NULL;
-	    return reinterpret_cast<byte*>(data + 8);
+	    return p;
 	}
 
 	byte * get_modifiable_p(unsigned block_size) {
 	    if (rare(!data)) return NULL;
+	    // Memory mapped tables are only ever opened read-only.
+	    Assert(p == reinterpret_cast<byte*>(data + 8));
 	    if (refs() > 1) {
 		char * new_data = new char[block_size + 8];
 		std::memcpy(new_data, data, block_size + 8);
 		--refs();
 		data = new_data;
 		refs() = 1;
+		p = reinterpret_cast<byte*>(data + 8);
 	    }
 	    return reinterpret_cast<byte*>(data + 8);
 	}
@@ -59,6 +59,7 @@
 #include "posixy_wrapper.h"
 #include "str.h"
 #include "stringutils.h"
+#include "unaligned.h"
 #include "backends/valuestats.h"
 
 #include "safeerrno.h"
@@ -67,8 +68,16 @@
 
 #include <algorithm>
 #include "autoptr.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
 #include <string>
+#include <system_error>
+#include <thread>
 
 using namespace std;
 using namespace Xapian;
@@ -96,16 +105,19 @@ using Xapian::Internal::intrusive_ptr;
 GlassDatabase::GlassDatabase(const string &glass_dir, int flags,
 			     unsigned int block_size)
 	: db_dir(glass_dir),
-	  readonly(flags == Xapian::DB_READONLY_),
+	  readonly(flags == Xapian::DB_READONLY_ ||
+		   flags == Xapian::DB_READONLY_MMAP_),
 	  version_file(db_dir),
 	  postlist_table(db_dir, readonly),
 	  position_table(db_dir, readonly),
-	  // Note: (Xapian::DB_READONLY_ & Xapian::DB_NO_TERMLIST) is true,
-	  // so opening to read we always permit the termlist to be missing.
+	  // Note: (Xapian::DB_READONLY_ & Xapian::DB_NO_TERMLIST) is true (as is
+	  // (Xapian::DB_READONLY_MMAP_ & Xapian::DB_NO_TERMLIST)), so opening to
+	  // read we always permit the termlist to be missing.
 	  termlist_table(db_dir, readonly, (flags & Xapian::DB_NO_TERMLIST)),
 	  value_manager(&postlist_table, &termlist_table),
 	  synonym_table(db_dir, readonly),
 	  spelling_table(db_dir, readonly),
+	  wildcard_table(db_dir, readonly),
 	  docdata_table(db_dir, readonly),
 	  lock(db_dir),
 	  changes(db_dir)
@@ -162,7 +174,7 @@ GlassDatabase::GlassDatabase(const string &glass_dir, int flags,
     open_tables(flags);
 }
 
-GlassDatabase::GlassDatabase(int fd)
+GlassDatabase::GlassDatabase(int fd, int flags)
 	: db_dir(),
 	  readonly(true),
 	  version_file(fd),
@@ -172,12 +184,13 @@ GlassDatabase::GlassDatabase(int fd)
 	  value_manager(&postlist_table, &termlist_table),
 	  synonym_table(fd, version_file.get_offset(), readonly),
 	  spelling_table(fd, version_file.get_offset(), readonly),
+	  wildcard_table(fd, version_file.get_offset(), readonly),
 	  docdata_table(fd, version_file.get_offset(), readonly),
 	  lock(string()),
 	  changes(string())
 {
-    LOGCALL_CTOR(DB, "GlassDatabase", fd);
-    open_tables(Xapian::DB_READONLY_);
+    LOGCALL_CTOR(DB, "GlassDatabase", fd | flags);
+    open_tables(flags);
 }
 
 GlassDatabase::~GlassDatabase()
@@ -204,6 +217,7 @@ GlassDatabase::create_and_open_tables(int flags, unsigned int block_size)
     position_table.create_and_open(flags, block_size);
     synonym_table.create_and_open(flags, block_size);
     spelling_table.create_and_open(flags, block_size);
+    wildcard_table.create_and_open(flags, block_size);
     docdata_table.create_and_open(flags, block_size);
     termlist_table.create_and_open(flags, block_size);
     postlist_table.create_and_open(flags, block_size);
@@ -228,17 +242,35 @@ GlassDatabase::open_tables(int flags)
 	    GlassTable::throw_database_closed();
     }
 
+    char cur_uuid[16];
+    memcpy(cur_uuid, version_file.get_uuid(), sizeof(cur_uuid));
     version_file.read();
     glass_revision_number_t rev = version_file.get_revision();
-    if (cur_rev && cur_rev == rev) {
+    if (cur_rev && cur_rev == rev &&
+	memcmp(cur_uuid, version_file.get_uuid(), sizeof(cur_uuid)) == 0) {
 	// We're reopening a database and the revision hasn't changed so we
-	// don't need to do anything.
+	// don't need to do anything.  If the database has been replaced (e.g.
+	// by a compacted copy) the UUID will differ, and the revision can
+	// happen to be the same.
 	RETURN(false);
     }
 
+    if (readonly) {
+	// Allow the tables to share blocks via the process-wide block cache.
+	const char * uuid = version_file.get_uuid();
+	docdata_table.set_uuid(uuid);
+	spelling_table.set_uuid(uuid);
+	wildcard_table.set_uuid(uuid);
+	synonym_table.set_uuid(uuid);
+	termlist_table.set_uuid(uuid);
+	position_table.set_uuid(uuid);
+	postlist_table.set_uuid(uuid);
+    }
+
     docdata_table.open(flags, version_file.get_root(Glass::DOCDATA), rev);
     spelling_table.open(flags, version_file.get_root(Glass::SPELLING), rev);
     synonym_table.open(flags, version_file.get_root(Glass::SYNONYM), rev);
+    wildcard_table.open(flags, version_file.get_root(Glass::WILDCARD), rev);
     termlist_table.open(flags, version_file.get_root(Glass::TERMLIST), rev);
     position_table.open(flags, version_file.get_root(Glass::POSITION), rev);
     postlist_table.open(flags, version_file.get_root(Glass::POSTLIST), rev);
@@ -258,6 +290,7 @@ GlassDatabase::open_tables(int flags)
 	termlist_table.set_changes(p);
 	synonym_table.set_changes(p);
 	spelling_table.set_changes(p);
+	wildcard_table.set_changes(p);
 	docdata_table.set_changes(p);
     }
     return true;
@@ -344,6 +377,7 @@ GlassDatabase::set_revision_number(int flags, glass_revision_number_t new_revisi
     termlist_table.flush_db();
     synonym_table.flush_db();
     version_file.set_spelling_wordfreq_upper_bound(spelling_table.flush_db());
+    wildcard_table.flush_db();
     docdata_table.flush_db();
 
     postlist_table.commit(new_revision, version_file.root_to_set(Glass::POSTLIST));
@@ -351,6 +385,7 @@ GlassDatabase::set_revision_number(int flags, glass_revision_number_t new_revisi
     termlist_table.commit(new_revision, version_file.root_to_set(Glass::TERMLIST));
     synonym_table.commit(new_revision, version_file.root_to_set(Glass::SYNONYM));
     spelling_table.commit(new_revision, version_file.root_to_set(Glass::SPELLING));
+    wildcard_table.commit(new_revision, version_file.root_to_set(Glass::WILDCARD));
     docdata_table.commit(new_revision, version_file.root_to_set(Glass::DOCDATA));
 
     const string & tmpfile = version_file.write(new_revision, flags);
@@ -359,6 +394,7 @@ GlassDatabase::set_revision_number(int flags, glass_revision_number_t new_revisi
 	!termlist_table.sync() ||
 	!synonym_table.sync() ||
 	!spelling_table.sync() ||
+	!wildcard_table.sync() ||
 	!docdata_table.sync() ||
 	!version_file.sync(tmpfile, new_revision, flags)) {
 	(void)unlink(tmpfile.c_str());
@@ -372,6 +408,58 @@ void
 GlassDatabase::request_document(Xapian::docid did) const
 {
     docdata_table.readahead_for_document(did);
+    // A writable database could change before the document is collected,
+    // so we only read documents in batches when read-only.
+    if (readonly)
+	requested_docs.push_back(did);
+}
+
+void
+GlassDatabase::read_requested_documents() const
+{
+    LOGCALL_VOID(DB, "GlassDatabase::read_requested_documents", NO_ARGS);
+    vector<Xapian::docid> dids;
+    swap(dids, requested_docs);
+    sort(dids.begin(), dids.end());
+    dids.erase(unique(dids.begin(), dids.end()), dids.end());
+
+    // Discard anything left from an earlier batch which wasn't collected.
+    fetched_docdata.clear();
+    intrusive_ptr<const GlassDatabase> ptrtothis(this);
+    for (Xapian::docid did : dids) {
+	try {
+	    // Check the document exists, as open_document() does when not
+	    // lazy.
+	    (void)postlist_table.get_doclength(did, ptrtothis);
+	} catch (const Xapian::DocNotFoundError &) {
+	    // collect_document() will report this if it is asked for did.
+	    continue;
+	}
+	fetched_docdata.insert(fetched_docdata.end(),
+			       make_pair(did,
+					 docdata_table.get_document_data(did)));
+    }
+}
+
+Xapian::Document::Internal *
+GlassDatabase::collect_document(Xapian::docid did) const
+{
+    LOGCALL(DB, Xapian::Document::Internal *, "GlassDatabase::collect_document", did);
+    Assert(did != 0);
+    if (!requested_docs.empty())
+	read_requested_documents();
+
+    map<Xapian::docid, string>::iterator i = fetched_docdata.find(did);
+    if (i == fetched_docdata.end())
+	RETURN(open_document(did, false));
+
+    intrusive_ptr<const Database::Internal> ptrtothis(this);
+    AutoPtr<GlassDocument> doc(new GlassDocument(ptrtothis, did,
+						 &value_manager,
+						 &docdata_table));
+    doc->set_fetched_data(i->second);
+    fetched_docdata.erase(i);
+    RETURN(doc.release());
 }
 
 void
@@ -390,6 +478,8 @@ GlassDatabase::reopen()
 {
     LOGCALL(DB, bool, "GlassDatabase::reopen", NO_ARGS);
     if (!readonly) RETURN(false);
+    requested_docs.clear();
+    fetched_docdata.clear();
     RETURN(open_tables(postlist_table.get_flags()));
 }
 
@@ -402,6 +492,7 @@ GlassDatabase::close()
     termlist_table.close(true);
     synonym_table.close(true);
     spelling_table.close(true);
+    wildcard_table.close(true);
     docdata_table.close(true);
     lock.release();
 }
@@ -446,6 +537,7 @@ GlassDatabase::send_whole_database(RemoteConnection & conn, double end_time)
 	"termlist." GLASS_TABLE_EXTENSION "\0"
 	"synonym." GLASS_TABLE_EXTENSION "\0"
 	"spelling." GLASS_TABLE_EXTENSION "\0"
+	"wildcard." GLASS_TABLE_EXTENSION "\0"
 	"docdata." GLASS_TABLE_EXTENSION "\0"
 	"position." GLASS_TABLE_EXTENSION "\0"
 	"postlist." GLASS_TABLE_EXTENSION "\0"
@@ -465,6 +557,116 @@ GlassDatabase::send_whole_database(RemoteConnection & conn, double end_time)
     } while (*p);
 }
 
+/// Close a temporary file when it goes out of scope.
+class TmpFileCloser {
+    FILE * f;
+
+  public:
+    explicit TmpFileCloser(FILE * f_) : f(f_) { }
+
+    ~TmpFileCloser() { fclose(f); }
+};
+
+glass_revision_number_t
+GlassDatabase::send_changed_blocks(RemoteConnection & conn,
+				   glass_revision_number_t start_rev)
+{
+    LOGCALL(DB, glass_revision_number_t, "GlassDatabase::send_changed_blocks", conn | start_rev);
+    if (single_file())
+	RETURN(0);
+
+    // Read the current version file, which we send unchanged at the end of
+    // the changeset.
+    GlassVersion version(db_dir);
+    string version_data;
+    try {
+	version.read(&version_data);
+    } catch (const Xapian::DatabaseError &) {
+	RETURN(0);
+    }
+    // Check the database hasn't been replaced.
+    if (memcmp(version.get_uuid(), version_file.get_uuid(), 16) != 0)
+	RETURN(0);
+    glass_revision_number_t rev = version.get_revision();
+    if (rev <= start_rev)
+	RETURN(0);
+
+    // The changeset has to be sent as a single message, and we don't know
+    // its size until we've built it, so build it in a temporary file.
+    FILE * tmp = tmpfile();
+    if (!tmp)
+	RETURN(0);
+    TmpFileCloser closer(tmp);
+    int tmp_fd = fileno(tmp);
+
+    string buf;
+    GlassChanges::encode_header(buf, start_rev, rev, 0);
+
+    static const char * const table_names[Glass::MAX_] = {
+	"/postlist." GLASS_TABLE_EXTENSION,
+	"/docdata." GLASS_TABLE_EXTENSION,
+	"/termlist." GLASS_TABLE_EXTENSION,
+	"/position." GLASS_TABLE_EXTENSION,
+	"/spelling." GLASS_TABLE_EXTENSION,
+	"/synonym." GLASS_TABLE_EXTENSION,
+	"/wildcard." GLASS_TABLE_EXTENSION
+    };
+    // Number of blocks to read at once.
+    const unsigned BATCH = 64;
+    for (unsigned t = 0; t != Glass::MAX_; ++t) {
+	Glass::table_type table = static_cast<Glass::table_type>(t);
+	unsigned block_size = version.get_root(table).get_blocksize();
+	string path = db_dir;
+	path += table_names[t];
+	FD fd(posixy_open(path.c_str(), O_RDONLY | O_CLOEXEC));
+	if (fd < 0) {
+	    // A lazy table which hasn't been created yet.
+	    if (errno == ENOENT) continue;
+	    RETURN(0);
+	}
+	string blocks(block_size * BATCH, '\0');
+	glass_block_t n = 0;
+	while (true) {
+	    size_t got = io_read(fd, &blocks[0], blocks.size(), 0);
+	    // Ignore any partial block at the end - it's being written for a
+	    // later revision.
+	    size_t count = got / block_size;
+	    for (size_t i = 0; i != count; ++i, ++n) {
+		const byte * p =
+		    reinterpret_cast<const byte *>(blocks.data()) +
+		    i * block_size;
+		glass_revision_number_t block_rev = getint4(p, 0);
+		// Freelist blocks may be appended to in place during the
+		// commit after the revision they're marked with, so we also
+		// need to send blocks marked with start_rev.
+		if (block_rev < start_rev) continue;
+		if (block_rev > rev) {
+		    // The writer can't reuse blocks which rev needs until the
+		    // revision after next is being written, so a block from
+		    // rev + 1 was free in rev and can be ignored.  Anything
+		    // later and rev may have been overwritten.
+		    if (block_rev == rev + 1) continue;
+		    RETURN(0);
+		}
+		changes.encode_block(buf, table, n, p, block_size);
+		if (buf.size() >= 65536) {
+		    io_write(tmp_fd, buf.data(), buf.size());
+		    buf.resize(0);
+		}
+	    }
+	    if (got < blocks.size()) break;
+	}
+    }
+    GlassChanges::encode_version_file(buf, rev, version_data);
+    buf += '\xff';
+    io_write(tmp_fd, buf.data(), buf.size());
+
+    if (lseek(tmp_fd, 0, SEEK_SET) == off_t(-1))
+	RETURN(0);
+    conn.send_file(REPL_REPLY_CHANGESET, tmp_fd, 0.0);
+    RETURN(rev);
+}
+
 void
 GlassDatabase::write_changesets_to_fd(int fd,
 				      const string & revision,
@@ -581,9 +783,22 @@ GlassDatabase::write_changesets_to_fd(int fd,
 			info->changed = true;
 		}
 	    } else {
-		// The changeset doesn't exist: leave the revision number as it
-		// is, and mark for doing a full database copy.
-		need_whole_db = true;
+		// The changeset doesn't exist, so try sending just the blocks
+		// which have changed since start_rev_num.  If that isn't
+		// possible, leave the revision number as it is, and mark for
+		// doing a full database copy.
+		glass_revision_number_t new_rev_num =
+		    send_changed_blocks(conn, start_rev_num);
+		if (new_rev_num == 0) {
+		    need_whole_db = true;
+		    continue;
+		}
+		start_rev_num = new_rev_num;
+		if (info != NULL) {
+		    ++(info->changeset_count);
+		    if (start_rev_num >= needed_rev_num)
+			info->changed = true;
+		}
 	    }
 	}
     }
@@ -607,6 +822,7 @@ GlassDatabase::modifications_failed(glass_revision_number_t new_revision,
 	docdata_table.open(flags, version_file.get_root(Glass::DOCDATA), old_revision);
 	spelling_table.open(flags, version_file.get_root(Glass::SPELLING), old_revision);
 	synonym_table.open(flags, version_file.get_root(Glass::SYNONYM), old_revision);
+	wildcard_table.open(flags, version_file.get_root(Glass::WILDCARD), old_revision);
 	termlist_table.open(flags, version_file.get_root(Glass::TERMLIST), old_revision);
 	position_table.open(flags, version_file.get_root(Glass::POSITION), old_revision);
 	postlist_table.open(flags, version_file.get_root(Glass::POSTLIST), old_revision);
@@ -637,6 +853,7 @@ GlassDatabase::modifications_failed(glass_revision_number_t new_revision,
     termlist_table.set_changes(p);
     synonym_table.set_changes(p);
     spelling_table.set_changes(p);
+    wildcard_table.set_changes(p);
     docdata_table.set_changes(p);
 }
 
@@ -650,6 +867,7 @@ GlassDatabase::apply()
 	!value_manager.is_modified() &&
 	!synonym_table.is_modified() &&
 	!spelling_table.is_modified() &&
+	!wildcard_table.is_modified() &&
 	!docdata_table.is_modified()) {
 	return;
     }
@@ -675,6 +893,7 @@ GlassDatabase::apply()
     termlist_table.set_changes(p);
     synonym_table.set_changes(p);
     spelling_table.set_changes(p);
+    wildcard_table.set_changes(p);
     docdata_table.set_changes(p);
 }
 
@@ -690,6 +909,7 @@ GlassDatabase::cancel()
     value_manager.cancel();
     synonym_table.cancel(version_file.get_root(Glass::SYNONYM), rev);
     spelling_table.cancel(version_file.get_root(Glass::SPELLING), rev);
+    wildcard_table.cancel(version_file.get_root(Glass::WILDCARD), rev);
     docdata_table.cancel(version_file.get_root(Glass::DOCDATA), rev);
 
     Xapian::termcount ub = version_file.get_spelling_wordfreq_upper_bound();
@@ -775,6 +995,14 @@ GlassDatabase::get_value_upper_bound(Xapian::valueno slot) const
     RETURN(value_manager.get_value_upper_bound(slot));
 }
 
+Xapian::doccount
+GlassDatabase::estimate_value_freq(Xapian::valueno slot,
+				   const string & lo, const string & hi) const
+{
+    LOGCALL(DB, Xapian::doccount, "GlassDatabase::estimate_value_freq", slot | lo | hi);
+    RETURN(value_manager.estimate_value_freq(slot, lo, hi));
+}
+
 Xapian::termcount
 GlassDatabase::get_doclength_lower_bound() const
 {
@@ -882,12 +1110,25 @@ GlassDatabase::open_allterms(const string & prefix) const
 				 prefix));
 }
 
+TermList *
+GlassDatabase::open_wildcard_termlist(const WildcardPattern & pattern) const
+{
+    return wildcard_table.open_termlist(pattern);
+}
+
 TermList *
 GlassDatabase::open_spelling_termlist(const string & word) const
 {
     return spelling_table.open_termlist(word);
 }
 
+TermList *
+GlassDatabase::open_spelling_candidates(const string & word,
+					unsigned max_edit_distance) const
+{
+    return spelling_table.open_deletes_termlist(word, max_edit_distance);
+}
+
 TermList *
 GlassDatabase::open_spelling_wordlist() const
 {
@@ -948,6 +1189,13 @@ GlassDatabase::get_revision_info() const
     RETURN(buf);
 }
 
+string
+GlassDatabase::get_revision_key() const
+{
+    LOGCALL(DB, string, "GlassDatabase::get_revision_key", NO_ARGS);
+    RETURN(get_revision_info());
+}
+
 string
 GlassDatabase::get_uuid() const
 {
@@ -985,6 +1233,7 @@ GlassWritableDatabase::GlassWritableDatabase(const string &dir, int flags,
 	: GlassDatabase(dir, flags, block_size),
 	  change_count(0),
 	  flush_threshold(0),
+	  flush_memory(0),
 	  modify_shortcut_document(NULL),
 	  modify_shortcut_docid(0)
 {
@@ -994,7 +1243,31 @@ GlassWritableDatabase::GlassWritableDatabase(const string &dir, int flags,
     if (p)
 	flush_threshold = atoi(p);
     if (flush_threshold == 0)
-	flush_threshold = 10000;
+	flush_threshold = Xapian::doccount(-1);
+
+    // XAPIAN_FLUSH_MEMORY is in megabytes.
+    p = getenv("XAPIAN_FLUSH_MEMORY");
+    if (p)
+	flush_memory = size_t(atoi(p)) << 20;
+    if (flush_memory == 0)
+	flush_memory = size_t(GLASS_DEFAULT_FLUSH_MEMORY_MB) << 20;
+
+    // Once a wildcard index exists, we must keep it up to date even if
+    // DB_WILDCARD_INDEX isn't specified.
+    if (flags & Xapian::DB_WILDCARD_INDEX) {
+	if (!wildcard_table.is_open())
+	    create_wildcard_index();
+	inverter.set_wildcard_table(&wildcard_table);
+    } else if (wildcard_table.is_open()) {
+	inverter.set_wildcard_table(&wildcard_table);
+    }
+
+    if (flags & Xapian::DB_SPELLING_DELETION_INDEX) {
+	// As for the wildcard index, commit straight away so the deletion
+	// index always covers all the spelling words.
+	spelling_table.create_deletion_index();
+	apply();
+    }
 }
 
 GlassWritableDatabase::~GlassWritableDatabase()
@@ -1018,10 +1291,46 @@ GlassWritableDatabase::flush_postlist_changes() const
     version_file.set_oldest_changeset(changes.get_oldest_changeset());
     inverter.flush(postlist_table);
     inverter.flush_pos_lists(position_table);
+    value_manager.merge_changes();
 
     change_count = 0;
 }
 
+void
+GlassWritableDatabase::create_wildcard_index()
+{
+    LOGCALL_VOID(DB, "GlassWritableDatabase::create_wildcard_index", NO_ARGS);
+    AutoPtr<GlassCursor> cursor(postlist_table.cursor_get());
+    (void)cursor->find_entry_ge(string("\x00\xff", 2));
+    string term;
+    while (!cursor->after_end()) {
+	const char *p = cursor->current_key.data();
+	const char *pend = p + cursor->current_key.size();
+	if (!unpack_string_preserving_sort(&p, pend, term)) {
+	    throw Xapian::DatabaseCorruptError("PostList table key has unexpected format");
+	}
+	// Only the key for the first chunk of a postlist is just the term.
+	if (p == pend)
+	    wildcard_table.toggle_term(term);
+	cursor->next();
+    }
+    // Commit the index straight away so that it's always in step with the
+    // postlist table.
+    apply();
+}
+
+void
+GlassWritableDatabase::change_made()
+{
+    ++change_count;
+    if (change_count >= flush_threshold ||
+	inverter.get_memory_used() + value_manager.get_memory_used() >=
+	    flush_memory) {
+	flush_postlist_changes();
+	if (!transaction_active()) apply();
+    }
+}
+
 void
 GlassWritableDatabase::close()
 {
@@ -1099,17 +1408,207 @@ GlassWritableDatabase::add_document_(Xapian::docid did,
 	throw;
     }
 
-    // FIXME: this should be done by checking memory usage, not the number of
-    // changes.  We could also look at the amount of data the inverter object
-    // currently holds.
-    if (++change_count >= flush_threshold) {
-	flush_postlist_changes();
-	if (!transaction_active()) apply();
-    }
+    change_made();
 
     RETURN(did);
 }
 
+/// A document encoded by add_documents(), ready to add to the tables.
+struct GlassEncodedDocument {
+    /// The document data.
+    string data;
+
+    /// The terms in the document and their wdfs.
+    vector<pair<string, Xapian::termcount>> postings;
+
+    /// The positional data for each term which has any.
+    vector<pair<string, string>> positions;
+
+    /// The termlist table entry.
+    string termlist;
+
+    /// The document length.
+    Xapian::termcount doclen;
+
+    /// Any exception thrown while encoding the document.
+    std::exception_ptr error;
+
+    /// Has encoding finished?
+    bool ready;
+
+    GlassEncodedDocument() : doclen(0), ready(false) { }
+};
+
+/** Encode a document for add_documents().
+ *
+ *  This doesn't touch any of the database's tables or any shared state, so
+ *  can run in any thread.
+ */
+static void
+encode_document(const GlassPositionListTable & position_table,
+		const Xapian::Document & document,
+		bool need_termlist,
+		GlassEncodedDocument & encoded)
+{
+    Xapian::termcount doclen = 0;
+    Xapian::TermIterator term = document.termlist_begin();
+    for ( ; term != document.termlist_end(); ++term) {
+	termcount wdf = term.get_wdf();
+	doclen += wdf;
+
+	string tname = *term;
+	if (tname.size() > MAX_SAFE_TERM_LENGTH)
+	    throw Xapian::InvalidArgumentError("Term too long (> " STRINGIZE(MAX_SAFE_TERM_LENGTH) "): " + tname);
+
+	const vector<Xapian::termpos> * ptr;
+	ptr = term.internal->get_vector_termpos();
+	vector<Xapian::termpos> posvec;
+	if (!ptr) {
+	    posvec.assign(term.positionlist_begin(), term.positionlist_end());
+	    ptr = &posvec;
+	}
+	if (!ptr->empty()) {
+	    string s;
+	    position_table.pack(s, *ptr);
+	    encoded.positions.push_back(make_pair(tname, string()));
+	    swap(encoded.positions.back().second, s);
+	}
+
+	encoded.postings.push_back(make_pair(string(), wdf));
+	swap(encoded.postings.back().first, tname);
+    }
+    encoded.doclen = doclen;
+
+    if (need_termlist)
+	GlassTermListTable::encode_termlist(encoded.termlist, document, doclen);
+}
+
+void
+GlassWritableDatabase::add_encoded_document(Xapian::docid did,
+					    const Xapian::Document & document,
+					    GlassEncodedDocument & encoded)
+{
+    LOGCALL_VOID(DB, "GlassWritableDatabase::add_encoded_document", did | document);
+    Assert(did != 0);
+    try {
+	docdata_table.replace_document_data(did, encoded.data);
+
+	value_manager.add_document(did, document, value_stats);
+
+	for (auto & posting : encoded.postings) {
+	    version_file.check_wdf(posting.second);
+	    inverter.add_posting(did, posting.first, posting.second);
+	}
+	for (auto & positions : encoded.positions) {
+	    inverter.set_packed_positionlist(did, positions.first,
+					     positions.second);
+	}
+
+	if (termlist_table.is_open())
+	    termlist_table.set_encoded_termlist(did, encoded.termlist);
+
+	inverter.set_doclength(did, encoded.doclen, true);
+	version_file.add_document(encoded.doclen);
+    } catch (...) {
+	// As for add_document_(), discard the modifications so far.
+	cancel();
+	throw;
+    }
+
+    change_made();
+}
+
+Xapian::docid
+GlassWritableDatabase::add_documents(const vector<Xapian::Document> & docs,
+				     unsigned num_threads)
+{
+    LOGCALL(DB, Xapian::docid, "GlassWritableDatabase::add_documents", docs.size() | num_threads);
+    if (num_threads <= 1 || docs.size() <= 1)
+	RETURN(Database::Internal::add_documents(docs, num_threads));
+
+    // Make sure the docid counter doesn't overflow.
+    if (GLASS_MAX_DOCID - version_file.get_last_docid() < docs.size())
+	throw Xapian::DatabaseError("Run out of docids - you'll have to use copydatabase to eliminate any gaps before you can add more documents");
+
+    vector<GlassEncodedDocument> encoded(docs.size());
+    // Do anything which might need to read from a database here, as that
+    // isn't safe to do from other threads.
+    for (size_t i = 0; i != docs.size(); ++i) {
+	encoded[i].data = docs[i].get_data();
+	(void)docs[i].termlist_count();
+    }
+
+    // The other threads encode documents, while this thread adds the encoded
+    // documents to the tables in order (encoding documents itself if it has
+    // to wait).
+    bool need_termlist = termlist_table.is_open();
+    atomic<size_t> next_to_encode(0);
+    mutex ready_mutex;
+    condition_variable ready_cond;
+    auto encode_next = [&]() {
+	size_t i = next_to_encode++;
+	if (i >= docs.size()) return false;
+	try {
+	    encode_document(position_table, docs[i], need_termlist,
+			    encoded[i]);
+	} catch (...) {
+	    encoded[i].error = std::current_exception();
+	}
+	lock_guard<mutex> guard(ready_mutex);
+	encoded[i].ready = true;
+	ready_cond.notify_one();
+	return true;
+    };
+
+    vector<thread> threads;
+    auto join_threads = [&]() {
+	// Make sure the threads stop after the document they're on.
+	next_to_encode = docs.size();
+	for (auto & t : threads) t.join();
+	threads.clear();
+    };
+    try {
+	while (threads.size() + 1 < num_threads) {
+	    threads.push_back(thread([&]() { while (encode_next()) { } }));
+	}
+    } catch (const system_error &) {
+	// Just use the threads we managed to create.
+    }
+
+    Xapian::docid first_did = version_file.get_last_docid() + 1;
+    try {
+	for (size_t i = 0; i != docs.size(); ++i) {
+	    while (true) {
+		{
+		    unique_lock<mutex> guard(ready_mutex);
+		    if (encoded[i].ready) break;
+		    if (next_to_encode >= docs.size()) {
+			ready_cond.wait(guard, [&]() {
+			    return encoded[i].ready;
+			});
+			break;
+		    }
+		}
+		(void)encode_next();
+	    }
+	    if (encoded[i].error) {
+		// Mirror add_document() failing for this document.
+		cancel();
+		rethrow_exception(encoded[i].error);
+	    }
+	    add_encoded_document(version_file.get_next_docid(), docs[i],
+				 encoded[i]);
+	    // Free the memory as we go.
+	    encoded[i] = GlassEncodedDocument();
+	}
+    } catch (...) {
+	join_threads();
+	throw;
+    }
+    join_threads();
+    RETURN(first_did);
+}
+
 void
 GlassWritableDatabase::delete_document(Xapian::docid did)
 {
@@ -1171,10 +1670,7 @@ GlassWritableDatabase::delete_document(Xapian::docid did)
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
-	flush_postlist_changes();
-	if (!transaction_active()) apply();
-    }
+    change_made();
 }
 
 void
@@ -1331,10 +1827,7 @@ GlassWritableDatabase::replace_document(Xapian::docid did,
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
-	flush_postlist_changes();
-	if (!transaction_active()) apply();
-    }
+    change_made();
 }
 
 Xapian::Document::Internal *
@@ -1405,6 +1898,19 @@ GlassWritableDatabase::get_value_upper_bound(Xapian::valueno slot) const
     RETURN(GlassDatabase::get_value_upper_bound(slot));
 }
 
+Xapian::doccount
+GlassWritableDatabase::estimate_value_freq(Xapian::valueno slot,
+					   const string & lo,
+					   const string & hi) const
+{
+    LOGCALL(DB, Xapian::doccount, "GlassWritableDatabase::estimate_value_freq", slot | lo | hi);
+    map<Xapian::valueno, ValueStats>::const_iterator i;
+    i = value_stats.find(slot);
+    if (i != value_stats.end())
+	RETURN(Glass::estimate_value_freq(i->second, lo, hi));
+    RETURN(GlassDatabase::estimate_value_freq(slot, lo, hi));
+}
+
 bool
 GlassWritableDatabase::term_exists(const string & tname) const
 {
@@ -1501,6 +2007,23 @@ GlassWritableDatabase::open_allterms(const string & prefix) const
     RETURN(GlassDatabase::open_allterms(prefix));
 }
 
+TermList *
+GlassWritableDatabase::open_wildcard_termlist(const WildcardPattern & pattern) const
+{
+    LOGCALL(DB, TermList *, "GlassWritableDatabase::open_wildcard_termlist", NO_ARGS);
+    if (change_count) {
+	// Terms may have been added or removed, so flush the posting list
+	// changes to bring the wildcard index up to date (but don't commit -
+	// there may be a transaction in progress).
+	inverter.flush_post_lists(postlist_table, string());
+	inverter.flush_pos_lists(position_table);
+	// The document length and stats haven't been written, so set
+	// change_count to 1.
+	change_count = 1;
+    }
+    RETURN(GlassDatabase::open_wildcard_termlist(pattern));
+}
+
 void
 GlassWritableDatabase::cancel()
 {
@@ -1558,6 +2081,15 @@ GlassWritableDatabase::clear_synonyms(const string & term) const
     synonym_table.clear_synonyms(term);
 }
 
+string
+GlassWritableDatabase::get_revision_key() const
+{
+    LOGCALL(DB, string, "GlassWritableDatabase::get_revision_key", NO_ARGS);
+    // Uncommitted changes are visible to searches, so the revision doesn't
+    // identify what we'd see.
+    RETURN(string());
+}
+
 void
 GlassWritableDatabase::set_metadata(const string & key, const string & value)
 {
@@ -37,6 +37,7 @@
 #include "glass_termlisttable.h"
 #include "glass_values.h"
 #include "glass_version.h"
+#include "glass_wildcard.h"
 #include "../flint_lock.h"
 #include "glass_defs.h"
 #include "backends/valuestats.h"
@@ -47,9 +48,11 @@
 #include "xapian/constants.h"
 
 #include <map>
+#include <vector>
 
 class GlassTermList;
 class GlassAllDocsPostList;
+struct GlassEncodedDocument;
 class RemoteConnection;
 
 /** A backend designed for efficient indexing and retrieval, using
@@ -103,6 +106,10 @@ class GlassDatabase : public Xapian::Database::Internal {
 	 */
 	mutable GlassSpellingTable spelling_table;
 
+	/** Table storing the wildcard index.
+	 */
+	mutable GlassWildcardTable wildcard_table;
+
 	/** Table storing document data.
 	 */
 	GlassDocDataTable docdata_table;
@@ -113,6 +120,26 @@ class GlassDatabase : public Xapian::Database::Internal {
 	/// Replication changesets.
 	GlassChanges changes;
 
+	/** Documents passed to request_document() which haven't been read.
+	 *
+	 *  Only used for a read-only database.
+	 */
+	mutable std::vector<Xapian::docid> requested_docs;
+
+	/** Document data read for requested documents which haven't yet been
+	 *  collected.
+	 */
+	mutable std::map<Xapian::docid, std::string> fetched_docdata;
+
+	/** Read the data for the documents in requested_docs.
+	 *
+	 *  The documents are read in ascending docid order, so the B-tree
+	 *  blocks in the cursors are reused between neighbouring documents
+	 *  rather than each document needing a separate descent of the
+	 *  table.
+	 */
+	void read_requested_documents() const;
+
 	/** Return true if a database exists at the path specified for this
 	 *  database.
 	 */
@@ -198,6 +225,25 @@ class GlassDatabase : public Xapian::Database::Internal {
 	 */
 	void send_whole_database(RemoteConnection & conn, double end_time);
 
+	/** Send a changeset of the blocks which changed after a revision.
+	 *
+	 *  This is used when the changesets needed to update a replica are
+	 *  no longer available.  Each block records the revision it was last
+	 *  written at, so scanning the tables finds the blocks which differ
+	 *  from the replica's copy, and usually transfers much less data
+	 *  than a copy of the whole database.
+	 *
+	 *  @param start_rev	The revision the replica is at.
+	 *
+	 *  @return The revision the changeset updates the replica to, or 0 if
+	 *	    a changeset couldn't be built (e.g. because the database was
+	 *	    modified too much during the scan), in which case the caller
+	 *	    should fall back to sending the whole database.
+	 */
+	glass_revision_number_t send_changed_blocks(
+		RemoteConnection & conn,
+		glass_revision_number_t start_rev);
+
 	/** Get the revision stored in a changeset.
 	 */
 	void get_changeset_revisions(const string & path,
@@ -227,7 +273,12 @@ class GlassDatabase : public Xapian::Database::Internal {
 	explicit GlassDatabase(const string &db_dir_, int flags = Xapian::DB_READONLY_,
 		      unsigned int block_size = 0u);
 
-	explicit GlassDatabase(int fd);
+	/** Open a single-file database read-only.
+	 *
+	 *  @param fd	 File descriptor open on the database file.
+	 *  @param flags Xapian::DB_READONLY_ or Xapian::DB_READONLY_MMAP_.
+	 */
+	explicit GlassDatabase(int fd, int flags = Xapian::DB_READONLY_);
 
 	~GlassDatabase();
 
@@ -257,6 +308,9 @@ class GlassDatabase : public Xapian::Database::Internal {
 	Xapian::doccount get_value_freq(Xapian::valueno slot) const;
 	std::string get_value_lower_bound(Xapian::valueno slot) const;
 	std::string get_value_upper_bound(Xapian::valueno slot) const;
+	Xapian::doccount estimate_value_freq(Xapian::valueno slot,
+					     const std::string & lo,
+					     const std::string & hi) const;
 	Xapian::termcount get_doclength_lower_bound() const;
 	Xapian::termcount get_doclength_upper_bound() const;
 	Xapian::termcount get_wdf_upper_bound(const string & term) const;
@@ -270,8 +324,11 @@ class GlassDatabase : public Xapian::Database::Internal {
 	PositionList * open_position_list(Xapian::docid did, const string & term) const;
 	TermList * open_term_list(Xapian::docid did) const;
 	TermList * open_allterms(const string & prefix) const;
+	TermList * open_wildcard_termlist(const WildcardPattern & pattern) const;
 
 	TermList * open_spelling_termlist(const string & word) const;
+	TermList * open_spelling_candidates(const string & word,
+					    unsigned max_edit_distance) const;
 	TermList * open_spelling_wordlist() const;
 	Xapian::doccount get_spelling_frequency(const string & word) const;
 
@@ -285,9 +342,11 @@ class GlassDatabase : public Xapian::Database::Internal {
 				    bool need_whole_db,
 				    Xapian::ReplicationInfo * info);
 	string get_revision_info() const;
+	string get_revision_key() const;
 	string get_uuid() const;
 
-	void request_document(Xapian::docid /*did*/) const;
+	void request_document(Xapian::docid did) const;
+	Xapian::Document::Internal * collect_document(Xapian::docid did) const;
 	void readahead_for_query(const Xapian::Query &query);
 	//@}
 
@@ -311,7 +370,8 @@ class GlassDatabase : public Xapian::Database::Internal {
 			    size_t block_size,
 			    Xapian::Compactor::compaction_level compaction,
 			    unsigned flags,
-			    Xapian::docid last_docid);
+			    Xapian::docid last_docid,
+			    unsigned max_threads = 1);
 };
 
 /** A writable glass database.
@@ -326,9 +386,19 @@ class GlassWritableDatabase : public GlassDatabase {
 	 */
 	mutable Xapian::doccount change_count;
 
-	/// If change_count reaches this threshold we automatically flush.
+	/** If change_count reaches this threshold we automatically flush.
+	 *
+	 *  By default there's no limit on the number of changes, and we flush
+	 *  based on memory use instead, but XAPIAN_FLUSH_THRESHOLD can be set
+	 *  in the environment to also flush every so many changes.
+	 */
 	Xapian::doccount flush_threshold;
 
+	/** If the buffered changes use more memory than this (in bytes) we
+	 *  automatically flush.
+	 */
+	size_t flush_memory;
+
 	/** A pointer to the last document which was returned by
 	 *  open_document(), or NULL if there is no such valid document.  This
 	 *  is used purely for comparing with a supplied document to help with
@@ -344,6 +414,25 @@ class GlassWritableDatabase : public GlassDatabase {
 	/// Flush any unflushed postlist changes, but don't commit them.
 	void flush_postlist_changes() const;
 
+	/// Build and commit a wildcard index of the existing terms.
+	void create_wildcard_index();
+
+	/** Count a change, and flush if enough changes are buffered.
+	 *
+	 *  Called after each document is added, deleted, or replaced.
+	 */
+	void change_made();
+
+	/** Add a document encoded by add_documents() to the tables.
+	 *
+	 *  @param did		The docid to use.
+	 *  @param document	The document (which is used for its values).
+	 *  @param encoded	The encoded terms, positions and data.
+	 */
+	void add_encoded_document(Xapian::docid did,
+				  const Xapian::Document & document,
+				  GlassEncodedDocument & encoded);
+
 	/// Close all the tables permanently.
 	void close();
 
@@ -361,6 +450,8 @@ class GlassWritableDatabase : public GlassDatabase {
 
 	Xapian::docid add_document(const Xapian::Document & document);
 	Xapian::docid add_document_(Xapian::docid did, const Xapian::Document & document);
+	Xapian::docid add_documents(const std::vector<Xapian::Document> & docs,
+				    unsigned num_threads);
 	// Stop the default implementation of delete_document(term) and
 	// replace_document(term) from being hidden.  This isn't really
 	// a problem as we only try to call them through the base class
@@ -403,6 +494,9 @@ class GlassWritableDatabase : public GlassDatabase {
 	Xapian::doccount get_value_freq(Xapian::valueno slot) const;
 	std::string get_value_lower_bound(Xapian::valueno slot) const;
 	std::string get_value_upper_bound(Xapian::valueno slot) const;
+	Xapian::doccount estimate_value_freq(Xapian::valueno slot,
+					     const std::string & lo,
+					     const std::string & hi) const;
 	bool term_exists(const string & tname) const;
 	bool has_positions() const;
 
@@ -411,6 +505,7 @@ class GlassWritableDatabase : public GlassDatabase {
 	PositionList * open_position_list(Xapian::docid did, const string & term) const;
 	TermList * open_term_list(Xapian::docid did) const;
 	TermList * open_allterms(const string & prefix) const;
+	TermList * open_wildcard_termlist(const WildcardPattern & pattern) const;
 
 	void add_spelling(const string & word, Xapian::termcount freqinc) const;
 	void remove_spelling(const string & word, Xapian::termcount freqdec) const;
@@ -421,6 +516,8 @@ class GlassWritableDatabase : public GlassDatabase {
 	void remove_synonym(const string & word, const string & synonym) const;
 	void clear_synonyms(const string & word) const;
 
+	string get_revision_key() const;
+
 	void set_metadata(const string & key, const string & value);
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
 	//@}
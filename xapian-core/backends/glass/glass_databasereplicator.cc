@@ -62,10 +62,11 @@ static const char * dbnames =
 	"/termlist." GLASS_TABLE_EXTENSION "\0"
 	"/position." GLASS_TABLE_EXTENSION "\0"
 	"/spelling." GLASS_TABLE_EXTENSION "\0"
-	"/synonym." GLASS_TABLE_EXTENSION;
+	"/synonym." GLASS_TABLE_EXTENSION "\0\0"
+	"/wildcard." GLASS_TABLE_EXTENSION;
 
 GlassDatabaseReplicator::GlassDatabaseReplicator(const string & db_dir_)
-    : db_dir(db_dir_)
+    : db_dir(db_dir_), comp_stream(Z_DEFAULT_STRATEGY)
 {
     std::fill_n(fds, sizeof(fds) / sizeof(fds[0]), -1);
 }
@@ -135,6 +136,10 @@ GlassDatabaseReplicator::process_changeset_chunk_version(string & buf,
     if (!unpack_uint(&ptr, end, &size))
 	throw NetworkError("Invalid version file size in changeset");
 
+    uint4 checksum;
+    if (!unpack_uint(&ptr, end, &checksum))
+	throw NetworkError("Invalid version file checksum in changeset");
+
     // Get the new version file into buf.
     buf.erase(0, ptr - buf.data());
     int res = conn.get_message_chunk(buf, size, end_time);
@@ -144,6 +149,10 @@ GlassDatabaseReplicator::process_changeset_chunk_version(string & buf,
 	throw NetworkError("Unexpected end of changeset (6)");
     }
 
+    const Bytef * data = reinterpret_cast<const Bytef *>(buf.data());
+    if (crc32(0, data, size) != checksum)
+	throw NetworkError("Checksum mismatch for version file in changeset");
+
     // Write size bytes from start of buf to new version file.
     string tmpfile = db_dir;
     tmpfile += "/v.rtmp";
@@ -196,6 +205,15 @@ GlassDatabaseReplicator::process_changeset_chunk_blocks(Glass::table_type table,
     if (!unpack_uint(&ptr, end, &block_number))
 	throw NetworkError("Invalid block number in changeset");
 
+    uint4 checksum;
+    if (!unpack_uint(&ptr, end, &checksum))
+	throw NetworkError("Invalid block checksum in changeset");
+
+    // A length of 0 means the block is stored uncompressed.
+    size_t len;
+    if (!unpack_uint(&ptr, end, &len) || len >= changeset_blocksize)
+	throw NetworkError("Invalid compressed block length in changeset");
+
     buf.erase(0, ptr - buf.data());
 
     int fd = fds[table];
@@ -211,15 +229,38 @@ GlassDatabaseReplicator::process_changeset_chunk_blocks(Glass::table_type table,
 	fds[table] = fd;
     }
 
-    int res = conn.get_message_chunk(buf, changeset_blocksize, end_time);
+    size_t stored_len = len ? len : changeset_blocksize;
+    int res = conn.get_message_chunk(buf, stored_len, end_time);
     if (res <= 0) {
 	if (res < 0)
 	    throw_connection_closed_unexpectedly();
 	throw NetworkError("Unexpected end of changeset (4)");
     }
 
-    io_write_block(fd, buf.data(), changeset_blocksize, block_number);
-    buf.erase(0, changeset_blocksize);
+    const char * block = buf.data();
+    if (len) {
+	if (block_buf.size() < changeset_blocksize)
+	    block_buf.resize(changeset_blocksize);
+	comp_stream.lazy_alloc_inflate_zstream();
+	z_stream * zs = comp_stream.inflate_zstream;
+	zs->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(block));
+	zs->avail_in = uInt(len);
+	zs->next_out = reinterpret_cast<Bytef *>(&block_buf[0]);
+	zs->avail_out = uInt(changeset_blocksize);
+	int err = inflate(zs, Z_FINISH);
+	if (err != Z_STREAM_END || zs->total_out != changeset_blocksize) {
+	    if (err == Z_MEM_ERROR) throw std::bad_alloc();
+	    throw NetworkError("Invalid compressed block in changeset");
+	}
+	block = block_buf.data();
+    }
+
+    const Bytef * data = reinterpret_cast<const Bytef *>(block);
+    if (crc32(0, data, changeset_blocksize) != checksum)
+	throw NetworkError("Checksum mismatch for block in changeset");
+
+    io_write_block(fd, block, changeset_blocksize, block_number);
+    buf.erase(0, stored_len);
 }
 
 string
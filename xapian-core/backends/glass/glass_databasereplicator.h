@@ -25,6 +25,7 @@
 
 #include "backends/databasereplicator.h"
 #include "glass_defs.h"
+#include "compression_stream.h"
 
 class GlassDatabaseReplicator : public Xapian::DatabaseReplicator {
     private:
@@ -38,6 +39,12 @@ class GlassDatabaseReplicator : public Xapian::DatabaseReplicator {
 	 */
 	mutable int fds[Glass::MAX_];
 
+	/// Used to decompress changed blocks.
+	CompressionStream comp_stream;
+
+	/// Buffer to decompress changed blocks into.
+	mutable std::string block_buf;
+
 	/** Process a chunk which holds a version file.
 	 */
 	void process_changeset_chunk_version(std::string & buf,
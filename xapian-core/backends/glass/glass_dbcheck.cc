@@ -24,14 +24,15 @@
 
 #include "glass_dbcheck.h"
 
-#include "bitstream.h"
-
 #include "internaltypes.h"
 
 #include "glass_check.h"
 #include "glass_cursor.h"
 #include "glass_defs.h"
+#include "glass_positionlist.h"
+#include "glass_postlist.h"
 #include "glass_table.h"
+#include "glass_values.h"
 #include "glass_version.h"
 #include "pack.h"
 #include "backends/valuestats.h"
@@ -183,6 +184,13 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		    continue;
 		}
 		lastdid += did;
+		Xapian::termcount max_doclen, actual_max_doclen = 0;
+		if (!unpack_uint(&pos, end, &max_doclen)) {
+		    if (out)
+			*out << "Failed to unpack max doclen" << endl;
+		    ++errors;
+		    continue;
+		}
 		bool bad = false;
 		while (true) {
 		    Xapian::termcount doclen;
@@ -195,6 +203,7 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		    }
 
 		    ++num_doclens;
+		    if (doclen > actual_max_doclen) actual_max_doclen = doclen;
 
 		    if (did > db_last_docid) {
 			if (out)
@@ -243,6 +252,12 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		if (bad) {
 		    continue;
 		}
+		if (max_doclen != actual_max_doclen) {
+		    if (out)
+			*out << "max doclen " << max_doclen << " != largest "
+				"doclen " << actual_max_doclen << endl;
+		    ++errors;
+		}
 		if (is_last_chunk) {
 		    if (did != lastdid) {
 			if (out)
@@ -269,39 +284,38 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		}
 
 		cursor->read_tag();
-		p = cursor->current_tag.data();
-		end = p + cursor->current_tag.size();
 
 		VStats & v = valuestats[slot];
-		if (!unpack_uint(&p, end, &v.freq)) {
-		    if (out) {
-			if (*p == 0) {
-			    *out << "Incomplete stats item in value table";
-			} else {
-			    *out << "Frequency statistic in value table is too large";
-			}
-			*out << endl;
-		    }
+		try {
+		    Glass::decode_valuestats(cursor->current_tag, v);
+		} catch (const Xapian::Error & e) {
+		    if (out)
+			*out << e.get_msg() << endl;
 		    ++errors;
 		    continue;
 		}
-		if (!unpack_string(&p, end, v.lower_bound)) {
-		    if (out) {
-			if (*p == 0) {
-			    *out << "Incomplete stats item in value table";
-			} else {
-			    *out << "Lower bound statistic in value table is too large";
-			}
-			*out << endl;
-		    }
+		if (v.sample.size() > GLASS_VALUESTATS_SAMPLE_SIZE) {
+		    if (out)
+			*out << "Value slot " << slot << " has too many "
+				"sampled values" << endl;
 		    ++errors;
-		    continue;
 		}
-		size_t len = end - p;
-		if (len == 0) {
-		    v.upper_bound = v.lower_bound;
-		} else {
-		    v.upper_bound.assign(p, len);
+		if (!Glass::valuestats_sample_is_ordered(v)) {
+		    if (out)
+			*out << "Value slot " << slot << " has sampled "
+				"values out of order" << endl;
+		    ++errors;
+		}
+		vector<pair<Xapian::docid, string> >::const_iterator i;
+		for (i = v.sample.begin(); i != v.sample.end(); ++i) {
+		    if (i->second < v.lower_bound ||
+			i->second > v.upper_bound) {
+			if (out)
+			    *out << "Value slot " << slot << " has sampled "
+				    "value outside bounds: '" << i->second
+				 << "'" << endl;
+			++errors;
+		    }
 		}
 
 		continue;
@@ -339,6 +353,16 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		p = cursor->current_tag.data();
 		end = p + cursor->current_tag.size();
 
+		string chunk_lower, chunk_upper;
+		if (!unpack_string(&p, end, chunk_lower) ||
+		    !unpack_string(&p, end, chunk_upper)) {
+		    if (out)
+			*out << "Failed to unpack bounds from value chunk"
+			     << endl;
+		    ++errors;
+		    continue;
+		}
+
 		while (true) {
 		    string value;
 		    if (!unpack_string(&p, end, value)) {
@@ -350,6 +374,14 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 
 		    ++v.freq_real;
 
+		    if (value < chunk_lower || value > chunk_upper) {
+			if (out)
+			    *out << "Value slot " << slot << " has value "
+				    "outside the bounds of its chunk: '"
+				 << value << "'" << endl;
+			++errors;
+		    }
+
 		    // FIXME: Cross-check that docid did has value slot (and
 		    // vice versa - that there's a value here if the slot entry
 		    // says so).
@@ -497,13 +529,17 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		end = pos + cursor->current_tag.size();
 	    }
 
-	    bool is_last_chunk;
-	    if (!unpack_bool(&pos, end, &is_last_chunk)) {
+	    unsigned flags = (pos == end) ? ~0u : unsigned(*pos - '0');
+	    if ((flags & ~7u) || (flags & 6) == 6) {
 		if (out)
-		    *out << "Failed to unpack last chunk flag" << endl;
+		    *out << "Failed to unpack chunk flags" << endl;
 		++errors;
 		continue;
 	    }
+	    ++pos;
+	    bool is_last_chunk = (flags & 1);
+	    bool is_bitmap_chunk = (flags & 2);
+	    bool is_packed_chunk = (flags & 4);
 	    // Read what the final document ID in this chunk is.
 	    if (!unpack_uint(&pos, end, &lastdid)) {
 		if (out)
@@ -512,8 +548,61 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		continue;
 	    }
 	    lastdid += did;
+	    Xapian::termcount max_wdf, actual_max_wdf = 0;
+	    if (!unpack_uint(&pos, end, &max_wdf)) {
+		if (out)
+		    *out << "Failed to unpack max wdf" << endl;
+		++errors;
+		continue;
+	    }
 	    bool bad = false;
-	    while (true) {
+	    if (is_packed_chunk) {
+		if (pos == end) {
+		    if (out)
+			*out << "Packed chunk has no entries" << endl;
+		    ++errors;
+		    continue;
+		}
+		Xapian::docid first_did = did;
+		Xapian::docid block_did[GLASS_POSTLIST_BLOCK_SIZE];
+		Xapian::termcount block_wdf[GLASS_POSTLIST_BLOCK_SIZE];
+		--did;
+		try {
+		    while (pos != end) {
+			unsigned n =
+			    GlassPostList::decode_packed_block(&pos, end,
+							       first_did, did,
+							       block_did,
+							       block_wdf);
+			if (did < first_did && block_did[0] != first_did) {
+			    if (out)
+				*out << "First docid in packed chunk is "
+				     << block_did[0] << " not " << first_did
+				     << endl;
+			    ++errors;
+			}
+			for (unsigned i = 0; i != n; ++i) {
+			    ++tf;
+			    cf += block_wdf[i];
+			    if (block_wdf[i] > actual_max_wdf)
+				actual_max_wdf = block_wdf[i];
+			}
+			did = block_did[n - 1];
+		    }
+		} catch (const Xapian::DatabaseCorruptError & e) {
+		    if (out)
+			*out << e.get_msg() << endl;
+		    ++errors;
+		    continue;
+		}
+		if (did != lastdid) {
+		    if (out)
+			*out << "Last docid in packed chunk is " << did
+			     << " not " << lastdid << endl;
+		    ++errors;
+		    did = lastdid;
+		}
+	    } else while (true) {
 		Xapian::termcount wdf;
 		if (!unpack_uint(&pos, end, &wdf)) {
 		    if (out)
@@ -522,8 +611,40 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		    bad = true;
 		    break;
 		}
+		if (is_bitmap_chunk) {
+		    // The bitmap has a bit for each docid from the first to the
+		    // last in the chunk, and both of those must be set.
+		    Xapian::docid span = lastdid - did;
+		    if (size_t(end - pos) != span / 8 + 1) {
+			if (out)
+			    *out << "Bitmap chunk has length " << (end - pos)
+				 << ", expected " << (span / 8 + 1) << endl;
+			++errors;
+			bad = true;
+			break;
+		    }
+		    if (!(pos[0] & 1) ||
+			(static_cast<unsigned char>(pos[span / 8]) >> (span % 8)) != 1) {
+			if (out)
+			    *out << "Bitmap chunk doesn't start and end with "
+				    "an entry, or has bits after the end" << endl;
+			++errors;
+		    }
+		    while (pos != end) {
+			unsigned ch = static_cast<unsigned char>(*pos++);
+			while (ch) {
+			    ch &= ch - 1;
+			    ++tf;
+			    cf += wdf;
+			}
+		    }
+		    actual_max_wdf = wdf;
+		    did = lastdid;
+		    break;
+		}
 		++tf;
 		cf += wdf;
+		if (wdf > actual_max_wdf) actual_max_wdf = wdf;
 
 		if (pos == end) break;
 
@@ -547,6 +668,12 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 	    if (bad) {
 		continue;
 	    }
+	    if (max_wdf != actual_max_wdf) {
+		if (out)
+		    *out << "max wdf " << max_wdf << " != largest wdf "
+			 << actual_max_wdf << endl;
+		++errors;
+	    }
 	    if (is_last_chunk) {
 		if (tf != termfreq) {
 		    if (out)
@@ -889,31 +1016,23 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 
 	    cursor->read_tag();
 
-	    const string & data = cursor->current_tag;
-	    pos = data.data();
-	    end = pos + data.size();
-
-	    Xapian::termpos pos_last;
-	    if (!unpack_uint(&pos, end, &pos_last)) {
-		if (out)
-		    *out << tablename << " table: Position list data corrupt"
-			 << endl;
-		++errors;
-		continue;
-	    }
-	    if (pos == end) {
-		// Special case for single entry position list.
-	    } else {
-		// Skip the header we just read.
-		BitReader rd(data, pos - data.data());
-		Xapian::termpos pos_first = rd.decode(pos_last);
-		Xapian::termpos pos_size = rd.decode(pos_last - pos_first) + 2;
-		rd.decode_interpolative(0, pos_size - 1, pos_first, pos_last);
-		Xapian::termpos p = rd.decode_interpolative_next();
+	    GlassPositionList pl;
+	    try {
+		if (!pl.read_data(cursor->current_tag)) {
+		    // Glass doesn't store empty position lists.
+		    if (out)
+			*out << tablename << " table: Empty position list"
+			     << endl;
+		    ++errors;
+		    continue;
+		}
+		pl.next();
+		Xapian::termpos p = pl.get_position();
+		pl.next();
 		bool ok = true;
-		while (p != pos_last) {
+		while (!pl.at_end()) {
 		    Xapian::termpos pos_prev = p;
-		    p = rd.decode_interpolative_next();
+		    p = pl.get_position();
 		    if (p <= pos_prev) {
 			if (out)
 			    *out << tablename << " table: Positions not "
@@ -922,13 +1041,19 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 			ok = false;
 			break;
 		    }
+		    pl.next();
 		}
-		if (ok && !rd.check_all_gone()) {
+		if (ok && !pl.check_all_gone()) {
 		    if (out)
 			*out << tablename << " table: Junk after position data"
 			     << endl;
-		    ++errors ;
+		    ++errors;
 		}
+	    } catch (const Xapian::DatabaseCorruptError &) {
+		if (out)
+		    *out << tablename << " table: Position list data corrupt"
+			 << endl;
+		++errors;
 	    }
 	}
     } else {
@@ -29,6 +29,9 @@
 /// Default B-tree block size.
 #define GLASS_DEFAULT_BLOCKSIZE 8192
 
+/// Default limit on memory used by buffered changes before we flush (in MB).
+#define GLASS_DEFAULT_FLUSH_MEMORY_MB 64
+
 /** The largest docid value supported by glass.
  *
  *  The disk format supports 64-bit docids, but if Xapian::docid is narrower
@@ -44,6 +47,7 @@ namespace Glass {
 	POSITION,
 	SPELLING,
 	SYNONYM,
+	WILDCARD,
 	MAX_
     };
 }
@@ -57,4 +61,16 @@ typedef uint4 glass_revision_number_t;
 /// How many entries there are in a table.
 typedef unsigned long long glass_tablesize_t;
 
+/** Approximate memory overhead of an entry in a std::map.
+ *
+ *  Used when estimating how much memory buffered changes are using.
+ */
+#define GLASS_MAP_ENTRY_OVERHEAD (4 * sizeof(void*) + 16)
+
+/** Maximum number of values sampled in the statistics for each value slot.
+ *
+ *  The sample is used to estimate how many documents match a value range.
+ */
+#define GLASS_VALUESTATS_SAMPLE_SIZE 64
+
 #endif // XAPIAN_INCLUDED_GLASS_DEFS_H
@@ -55,5 +55,6 @@ string
 GlassDocument::do_get_data() const
 {
     LOGCALL(DB, string, "GlassDocument::do_get_data", NO_ARGS);
+    if (data_fetched) RETURN(data);
     RETURN(docdata_table->get_document_data(did));
 }
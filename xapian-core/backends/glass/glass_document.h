@@ -40,6 +40,12 @@ class GlassDocument : public Xapian::Document::Internal {
     /// Used for lazy access to document data.
     const GlassDocDataTable *docdata_table;
 
+    /// Has the document data already been read into data?
+    bool data_fetched;
+
+    /// The document data, if data_fetched is true.
+    string data;
+
     /// GlassDatabase::open_document() needs to call our private constructor.
     friend class GlassDatabase;
 
@@ -49,7 +55,14 @@ class GlassDocument : public Xapian::Document::Internal {
 		  const GlassValueManager *value_manager_,
 		  const GlassDocDataTable *docdata_table_)
 	: Xapian::Document::Internal(db, did_),
-	  value_manager(value_manager_), docdata_table(docdata_table_) { }
+	  value_manager(value_manager_), docdata_table(docdata_table_),
+	  data_fetched(false) { }
+
+    /// Supply the document data, which has already been read.
+    void set_fetched_data(string & data_) {
+	swap(data, data_);
+	data_fetched = true;
+    }
 
   public:
     /** Implementation of virtual methods @{ */
@@ -24,14 +24,56 @@
 
 #include "glass_postlist.h"
 #include "glass_positionlist.h"
+#include "glass_wildcard.h"
 
 #include "api/termlist.h"
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
+/// Order postlist changes by docid only, so stable sorting keeps their order.
+static bool
+docid_lt(const pair<Xapian::docid, Xapian::termcount> & a,
+	 const pair<Xapian::docid, Xapian::termcount> & b)
+{
+    return a.first < b.first;
+}
+
+void
+Inverter::PostingChanges::sort_changes()
+{
+    if (sorted) return;
+    stable_sort(pl_changes.begin(), pl_changes.end(), docid_lt);
+    // Where there are several changes for a docid, keep only the last.
+    vector<pair<Xapian::docid, Xapian::termcount> >::iterator i, out;
+    out = pl_changes.begin();
+    for (i = out + 1; i != pl_changes.end(); ++i) {
+	if (i->first == out->first) {
+	    out->second = i->second;
+	} else {
+	    *++out = *i;
+	}
+    }
+    pl_changes.erase(out + 1, pl_changes.end());
+    sorted = true;
+}
+
+void
+Inverter::flush_changes(GlassPostListTable & table,
+			map<string, PostingChanges>::iterator i)
+{
+    i->second.sort_changes();
+    if (table.merge_changes(i->first, i->second) && wildcard_table)
+	wildcard_table->toggle_term(i->first);
+    postlist_changes_memory -= term_memory(i->first);
+    postlist_changes_memory -= i->second.get_memory_used();
+}
+
 void
 Inverter::store_positions(const GlassPositionListTable & position_table,
 			  Xapian::docid did,
@@ -50,6 +92,8 @@ Inverter::store_positions(const GlassPositionListTable & position_table,
 	    j = m.find(did);
 	    if (j != m.end()) {
 		// Update existing entry.
+		pos_changes_memory += s.size();
+		pos_changes_memory -= j->second.size();
 		swap(j->second, s);
 		return;
 	    }
@@ -96,8 +140,24 @@ Inverter::set_positionlist(Xapian::docid did,
 			   const string & term,
 			   const string & s)
 {
-    pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
-	.first->second[did] = s;
+    map<string, map<Xapian::docid, string> >::iterator i;
+    i = pos_changes.find(term);
+    if (i == pos_changes.end()) {
+	i = pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
+	    .first;
+	pos_changes_memory += GLASS_MAP_ENTRY_OVERHEAD + sizeof(string) +
+			      sizeof(i->second) + term.size();
+    }
+    pair<map<Xapian::docid, string>::iterator, bool> r;
+    r = i->second.insert(make_pair(did, s));
+    if (r.second) {
+	pos_changes_memory += GLASS_MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+			      sizeof(string) + s.size();
+    } else {
+	pos_changes_memory += s.size();
+	pos_changes_memory -= r.first->second.size();
+	r.first->second = s;
+    }
 }
 
 void
@@ -165,18 +225,19 @@ Inverter::flush_post_list(GlassPostListTable & table, const string & term)
     if (i == postlist_changes.end()) return;
 
     // Flush buffered changes for just this term's postlist.
-    table.merge_changes(term, i->second);
+    flush_changes(table, i);
     postlist_changes.erase(i);
 }
 
 void
 Inverter::flush_all_post_lists(GlassPostListTable & table)
 {
-    map<string, PostingChanges>::const_iterator i;
+    map<string, PostingChanges>::iterator i;
     for (i = postlist_changes.begin(); i != postlist_changes.end(); ++i) {
-	table.merge_changes(i->first, i->second);
+	flush_changes(table, i);
     }
     postlist_changes.clear();
+    Assert(postlist_changes_memory == 0);
 }
 
 void
@@ -190,7 +251,7 @@ Inverter::flush_post_lists(GlassPostListTable & table, const string & pfx)
     end = postlist_changes.upper_bound(pfx);
 
     for (i = begin; i != end; ++i) {
-	table.merge_changes(i->first, i->second);
+	flush_changes(table, i);
     }
 
     // Erase all the entries in one go, as that's:
@@ -223,4 +284,5 @@ Inverter::flush_pos_lists(GlassPositionListTable & table)
 	}
     }
     pos_changes.clear();
+    pos_changes_memory = 0;
 }
@@ -27,12 +27,14 @@
 #include <string>
 #include <vector>
 
+#include "glass_defs.h"
 #include "omassert.h"
 #include "str.h"
 #include "xapian/error.h"
 
 class GlassPostListTable;
 class GlassPositionListTable;
+class GlassWildcardTable;
 
 namespace Xapian {
 class TermIterator;
@@ -55,38 +57,41 @@ class Inverter {
 	/// Change in collection frequency.
 	Xapian::termcount_diff cf_delta;
 
-	/// Changes to this term's postlist.
-	std::map<Xapian::docid, Xapian::termcount> pl_changes;
-
-      public:
-	/// Constructor for an added posting.
-	PostingChanges(Xapian::docid did, Xapian::termcount wdf)
-	    : tf_delta(1), cf_delta(Xapian::termcount_diff(wdf))
-	{
-	    pl_changes.insert(std::make_pair(did, wdf));
+	/** Changes to this term's postlist.
+	 *
+	 *  New changes are appended, so this is only in docid order if
+	 *  @a sorted is true, and may contain several entries for the same
+	 *  docid, in which case the last one is the one which counts.  A
+	 *  vector uses much less memory per entry than a std::map, and the
+	 *  common case of adding new documents appends in docid order.
+	 */
+	std::vector<std::pair<Xapian::docid, Xapian::termcount> > pl_changes;
+
+	/// Are the entries in pl_changes in strictly ascending docid order?
+	bool sorted;
+
+	/// Record the new wdf for @a did (DELETED_POSTING for a deletion).
+	void set_wdf(Xapian::docid did, Xapian::termcount wdf) {
+	    if (!pl_changes.empty()) {
+		Xapian::docid last_did = pl_changes.back().first;
+		if (did == last_did) {
+		    pl_changes.back().second = wdf;
+		    return;
+		}
+		if (did < last_did) sorted = false;
+	    }
+	    pl_changes.push_back(std::make_pair(did, wdf));
 	}
 
-	/// Constructor for a removed posting.
-	PostingChanges(Xapian::docid did, Xapian::termcount wdf, bool)
-	    : tf_delta(-1), cf_delta(-Xapian::termcount_diff(wdf))
-	{
-	    pl_changes.insert(std::make_pair(did, DELETED_POSTING));
-	}
-
-	/// Constructor for an updated posting.
-	PostingChanges(Xapian::docid did, Xapian::termcount old_wdf,
-		       Xapian::termcount new_wdf)
-	    : tf_delta(0), cf_delta(Xapian::termcount_diff(new_wdf - old_wdf))
-	{
-	    pl_changes.insert(std::make_pair(did, new_wdf));
-	}
+      public:
+	PostingChanges() : tf_delta(0), cf_delta(0), sorted(true) { }
 
 	/// Add a posting.
 	void add_posting(Xapian::docid did, Xapian::termcount wdf) {
 	    ++tf_delta;
 	    cf_delta += wdf;
 	    // Add did to term's postlist
-	    pl_changes[did] = wdf;
+	    set_wdf(did, wdf);
 	}
 
 	/// Remove a posting.
@@ -94,21 +99,33 @@ class Inverter {
 	    --tf_delta;
 	    cf_delta -= wdf;
 	    // Remove did from term's postlist.
-	    pl_changes[did] = DELETED_POSTING;
+	    set_wdf(did, DELETED_POSTING);
 	}
 
 	/// Update a posting.
 	void update_posting(Xapian::docid did, Xapian::termcount old_wdf,
 			    Xapian::termcount new_wdf) {
 	    cf_delta += new_wdf - old_wdf;
-	    pl_changes[did] = new_wdf;
+	    set_wdf(did, new_wdf);
 	}
 
+	/** Sort the postlist changes into docid order.
+	 *
+	 *  Only the last change for each docid is kept.  This needs to be
+	 *  called before the changes are merged into the postlist table.
+	 */
+	void sort_changes();
+
 	/// Get the term frequency delta.
 	Xapian::termcount_diff get_tfdelta() const { return tf_delta; }
 
 	/// Get the collection frequency delta.
 	Xapian::termcount_diff get_cfdelta() const { return cf_delta; }
+
+	/// Get the memory used by the buffered postlist changes.
+	size_t get_memory_used() const {
+	    return pl_changes.capacity() * sizeof(pl_changes[0]);
+	}
     };
 
     /// Buffered changes to postlists.
@@ -117,6 +134,40 @@ class Inverter {
     /// Buffered changes to positional data.
     std::map<std::string, std::map<Xapian::docid, std::string> > pos_changes;
 
+    /// Approximate memory used by postlist_changes.
+    size_t postlist_changes_memory;
+
+    /// Approximate memory used by pos_changes.
+    size_t pos_changes_memory;
+
+    /** Wildcard index to update when terms are created or removed.
+     *
+     *  NULL if there isn't one to maintain.
+     */
+    GlassWildcardTable * wildcard_table;
+
+    /// Get the changes for @a term, creating an entry if there isn't one.
+    PostingChanges & get_changes(const std::string & term) {
+	std::map<std::string, PostingChanges>::iterator i;
+	i = postlist_changes.find(term);
+	if (i == postlist_changes.end()) {
+	    i = postlist_changes.insert(
+		    std::make_pair(term, PostingChanges())).first;
+	    postlist_changes_memory += term_memory(term);
+	}
+	return i->second;
+    }
+
+    /// Memory used by an entry for @a term, excluding the changes.
+    static size_t term_memory(const std::string & term) {
+	return GLASS_MAP_ENTRY_OVERHEAD + sizeof(std::string) +
+	       sizeof(PostingChanges) + term.size();
+    }
+
+    /// Merge the changes for postlist_changes entry @a i into @a table.
+    void flush_changes(GlassPostListTable & table,
+		       std::map<std::string, PostingChanges>::iterator i);
+
     void store_positions(const GlassPositionListTable & position_table,
 			 Xapian::docid did,
 			 const std::string & tname,
@@ -132,41 +183,38 @@ class Inverter {
     std::map<Xapian::docid, Xapian::termcount> doclen_changes;
 
   public:
+    Inverter()
+	: postlist_changes_memory(0), pos_changes_memory(0),
+	  wildcard_table(NULL) { }
+
+    /// Set the wildcard index to maintain (NULL for none).
+    void set_wildcard_table(GlassWildcardTable * table) {
+	wildcard_table = table;
+    }
+
     void add_posting(Xapian::docid did, const std::string & term,
 		     Xapian::doccount wdf) {
-	std::map<std::string, PostingChanges>::iterator i;
-	i = postlist_changes.find(term);
-	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf)));
-	} else {
-	    i->second.add_posting(did, wdf);
-	}
+	PostingChanges & changes = get_changes(term);
+	size_t old_memory = changes.get_memory_used();
+	changes.add_posting(did, wdf);
+	postlist_changes_memory += changes.get_memory_used() - old_memory;
     }
 
     void remove_posting(Xapian::docid did, const std::string & term,
 			Xapian::doccount wdf) {
-	std::map<std::string, PostingChanges>::iterator i;
-	i = postlist_changes.find(term);
-	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf, false)));
-	} else {
-	    i->second.remove_posting(did, wdf);
-	}
+	PostingChanges & changes = get_changes(term);
+	size_t old_memory = changes.get_memory_used();
+	changes.remove_posting(did, wdf);
+	postlist_changes_memory += changes.get_memory_used() - old_memory;
     }
 
     void update_posting(Xapian::docid did, const std::string & term,
 			Xapian::termcount old_wdf,
 			Xapian::termcount new_wdf) {
-	std::map<std::string, PostingChanges>::iterator i;
-	i = postlist_changes.find(term);
-	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf)));
-	} else {
-	    i->second.update_posting(did, old_wdf, new_wdf);
-	}
+	PostingChanges & changes = get_changes(term);
+	size_t old_memory = changes.get_memory_used();
+	changes.update_posting(did, old_wdf, new_wdf);
+	postlist_changes_memory += changes.get_memory_used() - old_memory;
     }
 
     void set_positionlist(const GlassPositionListTable & position_table,
@@ -175,6 +223,17 @@ class Inverter {
 			  const Xapian::TermIterator & term,
 			  bool modifying = false);
 
+    /** Set the positional data for a term in a new document.
+     *
+     *  @param s	The positional data, as encoded by
+     *			GlassPositionListTable::pack().
+     */
+    void set_packed_positionlist(Xapian::docid did,
+				 const std::string & term,
+				 const std::string & s) {
+	set_positionlist(did, term, s);
+    }
+
     void delete_positionlist(Xapian::docid did,
 			     const std::string & term);
 
@@ -188,6 +247,19 @@ class Inverter {
 	doclen_changes.clear();
 	postlist_changes.clear();
 	pos_changes.clear();
+	postlist_changes_memory = 0;
+	pos_changes_memory = 0;
+    }
+
+    /** Get the approximate memory used by the buffered changes.
+     *
+     *  This is used to decide when to flush the changes.
+     */
+    size_t get_memory_used() const {
+	return postlist_changes_memory + pos_changes_memory +
+	       doclen_changes.size() * (GLASS_MAP_ENTRY_OVERHEAD +
+					sizeof(Xapian::docid) +
+					sizeof(Xapian::termcount));
     }
 
     void set_doclength(Xapian::docid did, Xapian::termcount doclen, bool add) {
@@ -28,6 +28,7 @@
 #include "debuglog.h"
 #include "pack.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -46,8 +47,36 @@ GlassPositionListTable::pack(string & s,
 	BitWriter wr(s);
 	wr.encode(vec[0], vec.back());
 	wr.encode(vec.size() - 2, vec.back() - vec[0]);
-	wr.encode_interpolative(vec, 0, vec.size() - 1);
+	size_t last_index = vec.size() - 1;
+	if (last_index <= GLASS_POSITIONLIST_BLOCK_SIZE) {
+	    wr.encode_interpolative(vec, 0, last_index);
+	    swap(s, wr.freeze());
+	    return;
+	}
 	swap(s, wr.freeze());
+
+	// Encode each block separately, and for each block except the last,
+	// add a skip pointer giving the block's last entry (as a difference
+	// from its first) and the length of its encoded data.
+	string skips, blocks;
+	size_t j = 0;
+	while (true) {
+	    size_t k = min(j + GLASS_POSITIONLIST_BLOCK_SIZE, last_index);
+	    BitWriter block_wr;
+	    block_wr.encode_interpolative(vec, j, k);
+	    const string & block = block_wr.freeze();
+	    if (k == last_index) {
+		blocks += block;
+		break;
+	    }
+	    pack_uint(skips, vec[k] - vec[j]);
+	    pack_uint(skips, block.size());
+	    blocks += block;
+	    j = k;
+	}
+	pack_uint(s, skips.size());
+	s += skips;
+	s += blocks;
     }
 }
 
@@ -83,22 +112,31 @@ GlassPositionListTable::positionlist_count(Xapian::docid did,
 ///////////////////////////////////////////////////////////////////////////
 
 bool
-GlassPositionList::read_data(const string & data)
+GlassPositionList::read_data(const string & data_)
 {
-    LOGCALL(DB, bool, "GlassPositionList::read_data", data);
+    LOGCALL(DB, bool, "GlassPositionList::read_data", data_);
+    data = data_;
+    RETURN(read_data(data.data(), data.data() + data.size()));
+}
+
+bool
+GlassPositionList::read_data(const char * pos, const char * end)
+{
+    LOGCALL(DB, bool, "GlassPositionList::read_data", (const void*)pos | (const void*)end);
 
     have_started = false;
+    skip_ptr = skip_end = end;
+    data_end = end;
 
-    if (data.empty()) {
+    if (pos == end) {
 	// There's no positional information for this term.
 	size = 0;
 	last = 0;
 	current_pos = 1;
+	rd.init(end, end);
 	RETURN(false);
     }
 
-    const char * pos = data.data();
-    const char * end = pos + data.size();
     Xapian::termpos pos_last;
     if (!unpack_uint(&pos, end, &pos_last)) {
 	throw Xapian::DatabaseCorruptError("Position list data corrupt");
@@ -106,20 +144,67 @@ GlassPositionList::read_data(const string & data)
     if (pos == end) {
 	// Special case for single entry position list.
 	size = 1;
-	current_pos = last = pos_last;
+	current_pos = last = block_last = pos_last;
+	rd.init(end, end);
 	RETURN(true);
     }
     // Skip the header we just read.
-    rd.init(data, pos - data.data());
+    rd.init(pos, end);
     Xapian::termpos pos_first = rd.decode(pos_last);
     Xapian::termpos pos_size = rd.decode(pos_last - pos_first) + 2;
-    rd.decode_interpolative(0, pos_size - 1, pos_first, pos_last);
     size = pos_size;
     last = pos_last;
     current_pos = pos_first;
+    if (pos_size - 1 <= GLASS_POSITIONLIST_BLOCK_SIZE) {
+	// The entries follow in the same bit stream.
+	block_last = pos_last;
+	block_first_index = 0;
+	next_block = end;
+	rd.decode_interpolative(0, pos_size - 1, pos_first, pos_last);
+	RETURN(true);
+    }
+
+    // The header is followed by the skip pointers and then the blocks.
+    pos = rd.align();
+    size_t skips_len;
+    if (!unpack_uint(&pos, end, &skips_len) ||
+	skips_len > size_t(end - pos)) {
+	throw Xapian::DatabaseCorruptError("Position list data corrupt");
+    }
+    skip_ptr = pos;
+    skip_end = pos + skips_len;
+    start_block(pos_first, 0, skip_end);
     RETURN(true);
 }
 
+void
+GlassPositionList::start_block(Xapian::termpos first,
+			       Xapian::termcount first_index,
+			       const char * block)
+{
+    LOGCALL_VOID(DB, "GlassPositionList::start_block", first | first_index | (const void*)block);
+    Xapian::termcount n = min(size - 1 - first_index,
+			      Xapian::termcount(GLASS_POSITIONLIST_BLOCK_SIZE));
+    const char * block_end = data_end;
+    if (skip_ptr != skip_end) {
+	Xapian::termpos delta;
+	size_t len;
+	if (!unpack_uint(&skip_ptr, skip_end, &delta) ||
+	    !unpack_uint(&skip_ptr, skip_end, &len) ||
+	    len > size_t(data_end - block)) {
+	    throw Xapian::DatabaseCorruptError("Position list data corrupt");
+	}
+	block_last = first + delta;
+	block_end = block + len;
+    } else {
+	block_last = last;
+    }
+    rd.init(block, block_end);
+    rd.decode_interpolative(0, n, first, block_last);
+    block_first_index = first_index;
+    next_block = block_end;
+}
+
 bool
 GlassPositionList::read_data(const GlassTable * table, Xapian::docid did,
 			     const string & tname)
@@ -130,9 +215,12 @@ GlassPositionList::read_data(const GlassTable * table, Xapian::docid did,
     }
     if (cursor.get() &&
 	cursor->find_exact(GlassPositionListTable::make_key(did, tname))) {
-	RETURN(read_data(cursor->current_tag));
+	// Read the tag in place - the cursor isn't used again until the next
+	// call to this method.
+	const string & tag = cursor->current_tag;
+	RETURN(read_data(tag.data(), tag.data() + tag.size()));
     }
-    RETURN(read_data(string()));
+    RETURN(read_data(NULL, NULL));
 }
 
 Xapian::termcount
@@ -163,7 +251,7 @@ GlassPositionList::next()
 	current_pos = 1;
 	return;
     }
-    current_pos = rd.decode_interpolative_next();
+    advance();
 }
 
 void
@@ -180,13 +268,18 @@ GlassPositionList::skip_to(Xapian::termpos termpos)
 	current_pos = 1;
 	return;
     }
+    if (current_pos >= termpos) return;
+    // Jump over any blocks which end before termpos.  We know termpos < last
+    // so the final block won't be skipped.
+    while (block_last <= termpos) {
+	current_pos = block_last;
+	start_block(block_last,
+		    block_first_index + GLASS_POSITIONLIST_BLOCK_SIZE,
+		    next_block);
+	if (current_pos == termpos) return;
+    }
     while (current_pos < termpos) {
-	if (current_pos == last) {
-	    last = 0;
-	    current_pos = 1;
-	    return;
-	}
-	current_pos = rd.decode_interpolative_next();
+	advance();
     }
 }
 
@@ -34,6 +34,15 @@
 
 using namespace std;
 
+/** How many positions there are between skip pointers.
+ *
+ *  Position lists with more entries than this are split into blocks of this
+ *  many entries which are encoded separately, with skip pointers to allow
+ *  GlassPositionList::skip_to() to jump over whole blocks.  Changing this
+ *  changes the format of the position table.
+ */
+#define GLASS_POSITIONLIST_BLOCK_SIZE 64
+
 class GlassPositionListTable : public GlassLazyTable {
   public:
     static string make_key(Xapian::docid did, const string & term) {
@@ -83,9 +92,12 @@ class GlassPositionListTable : public GlassLazyTable {
 
 /** A position list in a glass database. */
 class GlassPositionList : public PositionList {
-    /// Interpolative decoder.
+    /// Interpolative decoder for the current block.
     BitReader rd;
 
+    /// Copy of the data passed to read_data(const string &).
+    string data;
+
     /// Current entry.
     Xapian::termpos current_pos;
 
@@ -95,6 +107,24 @@ class GlassPositionList : public PositionList {
     /// Number of entries.
     Xapian::termcount size;
 
+    /// The last entry in the current block.
+    Xapian::termpos block_last;
+
+    /// The index of the first entry in the current block.
+    Xapian::termcount block_first_index;
+
+    /// The skip pointers for the blocks after the current one.
+    const char * skip_ptr;
+
+    /// The end of the skip pointers.
+    const char * skip_end;
+
+    /// The encoded data for the next block.
+    const char * next_block;
+
+    /// The end of the encoded data.
+    const char * data_end;
+
     /// Cursor for locating multiple entries efficiently.
     AutoPtr<GlassCursor> cursor;
 
@@ -107,6 +137,33 @@ class GlassPositionList : public PositionList {
     /// Assignment is not allowed.
     void operator=(const GlassPositionList &);
 
+    /** Fill list with data, and move the position to the start.
+     *
+     *  The data isn't copied, so must remain valid while we're reading it.
+     *
+     *  @return true if position data was read.
+     */
+    bool read_data(const char * pos, const char * end);
+
+    /** Start decoding a block.
+     *
+     *  @param first		The first entry in the block.
+     *  @param first_index	The index of @a first in the list.
+     *  @param block		The encoded data for the block.
+     */
+    void start_block(Xapian::termpos first, Xapian::termcount first_index,
+		     const char * block);
+
+    /// Move to the next entry, which must exist.
+    void advance() {
+	if (current_pos == block_last) {
+	    start_block(block_last,
+			block_first_index + GLASS_POSITIONLIST_BLOCK_SIZE,
+			next_block);
+	}
+	current_pos = rd.decode_interpolative_next();
+    }
+
   public:
     /// Default constructor.
     GlassPositionList() { }
@@ -148,6 +205,14 @@ class GlassPositionList : public PositionList {
 
     /// True if we're off the end of the list
     bool at_end() const;
+
+    /** Check all the data has been read.
+     *
+     *  Only meaningful once we've iterated off the end of the list.
+     */
+    bool check_all_gone() const {
+	return skip_ptr == skip_end && rd.check_all_gone();
+    }
 };
 
 #endif /* XAPIAN_HGUARD_GLASS_POSITIONLIST_H */
@@ -27,11 +27,14 @@
 #include "glass_cursor.h"
 #include "glass_database.h"
 #include "debuglog.h"
+#include "internaltypes.h"
 #include "noreturn.h"
 #include "pack.h"
 #include "str.h"
 #include "unicode/description_append.h"
 
+#include <algorithm>
+
 using Xapian::Internal::intrusive_ptr;
 
 void
@@ -104,10 +107,11 @@ class Glass::PostlistChunkWriter {
 
 	/// Append a block of raw entries to this chunk.
 	void raw_append(Xapian::docid first_did_, Xapian::docid current_did_,
-			const string & s) {
+			Xapian::termcount max_wdf_, const string & s) {
 	    Assert(!started);
 	    first_did = first_did_;
 	    current_did = current_did_;
+	    max_wdf = max_wdf_;
 	    if (!s.empty()) {
 		chunk.append(s);
 		started = true;
@@ -130,6 +134,9 @@ class Glass::PostlistChunkWriter {
 	Xapian::docid first_did;
 	Xapian::docid current_did;
 
+	/// The largest wdf in this chunk.
+	Xapian::termcount max_wdf;
+
 	string chunk;
 };
 
@@ -223,20 +230,323 @@ read_wdf(const char ** posptr, const char * end, Xapian::termcount * wdf_ptr)
     if (!unpack_uint(posptr, end, wdf_ptr)) report_read_error(*posptr);
 }
 
+/** Find the next entry in a bitmap chunk.
+ *
+ *  @param bitmap	The start of the bitmap.
+ *  @param end		The end of the bitmap.
+ *  @param bit		The first bit to consider.
+ *
+ *  @return The index of the first set bit at or after @a bit.
+ */
+static inline Xapian::docid
+find_next_bit(const char * bitmap, const char * end, Xapian::docid bit)
+{
+    size_t i = bit / 8;
+    if (rare(i >= size_t(end - bitmap))) report_read_error(NULL);
+    unsigned ch = static_cast<unsigned char>(bitmap[i]) >> (bit % 8);
+    if (ch == 0) {
+	do {
+	    if (rare(++i == size_t(end - bitmap))) report_read_error(NULL);
+	    ch = static_cast<unsigned char>(bitmap[i]);
+	} while (ch == 0);
+	bit = i * 8;
+    }
+    while ((ch & 1) == 0) {
+	ch >>= 1;
+	++bit;
+    }
+    return bit;
+}
+
+/** Try to encode the entries of a chunk as a bitmap.
+ *
+ *  A bitmap chunk stores the wdf (which must be the same for all the entries)
+ *  followed by a bitmap with a bit for each docid from the first to the last
+ *  in the chunk.  This is used if it's smaller than the standard encoding,
+ *  which is the case for dense postlists such as those for boolean filter
+ *  terms.
+ *
+ *  @param first_did	The first docid in the chunk.
+ *  @param last_did	The last docid in the chunk.
+ *  @param chunk	The entries in the standard encoding.
+ *  @param bitmap_chunk	Set to the entries encoded as a bitmap, if we
+ *			return true.
+ *
+ *  @return true if the entries should be stored as a bitmap.
+ */
+static bool
+encode_as_bitmap(Xapian::docid first_did, Xapian::docid last_did,
+		 const string & chunk, string & bitmap_chunk)
+{
+    // Each entry takes at least 2 bytes in the standard encoding, so don't
+    // bother decoding the entries unless the bitmap could be smaller.
+    Xapian::docid span = last_did - first_did;
+    if (span / 8 + 2 >= chunk.size()) return false;
+
+    const char * pos = chunk.data();
+    const char * end = pos + chunk.size();
+    Xapian::termcount wdf;
+    read_wdf(&pos, end, &wdf);
+    string bitmap(span / 8 + 1, '\0');
+    Xapian::docid did = first_did;
+    while (true) {
+	Xapian::docid bit = did - first_did;
+	bitmap[bit / 8] |= char(1 << (bit % 8));
+	if (pos == end) break;
+	read_did_increase(&pos, end, &did);
+	Xapian::termcount entry_wdf;
+	read_wdf(&pos, end, &entry_wdf);
+	if (entry_wdf != wdf) return false;
+    }
+    Assert(did == last_did);
+
+    bitmap_chunk.resize(0);
+    pack_uint(bitmap_chunk, wdf);
+    bitmap_chunk += bitmap;
+    return bitmap_chunk.size() < chunk.size();
+}
+
+/// The number of bytes needed to store @a n values of @a bits bits each.
+static inline size_t
+packed_size(unsigned n, unsigned bits)
+{
+    return (size_t(n) * bits + 7) / 8;
+}
+
+/// The number of bits needed to store @a value.
+static inline unsigned
+bits_needed(uint8 value)
+{
+    unsigned bits = 0;
+    while (value) {
+	++bits;
+	value >>= 1;
+    }
+    return bits;
+}
+
+/// Append @a n values to @a s, packed into @a bits bits each.
+template<typename T>
+static void
+append_packed(string & s, const T * values, unsigned n, unsigned bits)
+{
+    uint8 acc = 0;
+    unsigned acc_bits = 0;
+    for (unsigned i = 0; i != n; ++i) {
+	acc |= uint8(values[i]) << acc_bits;
+	acc_bits += bits;
+	while (acc_bits >= 8) {
+	    s += char(acc & 0xff);
+	    acc >>= 8;
+	    acc_bits -= 8;
+	}
+    }
+    if (acc_bits) s += char(acc);
+}
+
+/** Unpack @a n values of @a bits bits each.
+ *
+ *  The caller must check that there are packed_size(n, bits) bytes available.
+ */
+template<typename T>
+static void
+unpack_packed(const char * p, unsigned n, unsigned bits, T * values)
+{
+    if (bits == 0) {
+	fill_n(values, n, T(0));
+	return;
+    }
+    const unsigned char * q = reinterpret_cast<const unsigned char *>(p);
+    const uint8 mask = (uint8(1) << bits) - 1;
+    uint8 acc = 0;
+    unsigned acc_bits = 0;
+    for (unsigned i = 0; i != n; ++i) {
+	while (acc_bits < bits) {
+	    acc |= uint8(*q++) << acc_bits;
+	    acc_bits += 8;
+	}
+	values[i] = T(acc & mask);
+	acc >>= bits;
+	acc_bits -= bits;
+    }
+}
+
+/** Read the header of a block in a packed chunk.
+ *
+ *  @param posptr	Pointer to the start of the block, which is updated to
+ *			point to the packed docid increases.
+ *  @param end		The end of the chunk.
+ *  @param first_did	The first docid in the chunk.
+ *  @param last_did_ptr	Set to the last docid in the block.
+ *  @param did_bits_ptr	Set to the number of bits per docid increase.
+ *  @param wdf_bits_ptr	Set to the number of bits per wdf.
+ *
+ *  @return The number of entries in the block.
+ */
+static unsigned
+read_packed_block_header(const char ** posptr, const char * end,
+			 Xapian::docid first_did,
+			 Xapian::docid * last_did_ptr,
+			 unsigned * did_bits_ptr, unsigned * wdf_bits_ptr)
+{
+    unsigned n;
+    Xapian::docid increase_to_last;
+    if (!unpack_uint(posptr, end, &n) ||
+	!unpack_uint(posptr, end, &increase_to_last))
+	report_read_error(*posptr);
+    if (rare(end - *posptr < 2)) report_read_error(NULL);
+    unsigned did_bits = static_cast<unsigned char>(*(*posptr)++);
+    unsigned wdf_bits = static_cast<unsigned char>(*(*posptr)++);
+    if (rare(n >= GLASS_POSTLIST_BLOCK_SIZE || did_bits > 32 || wdf_bits > 32))
+	throw Xapian::DatabaseCorruptError("Bad block header in packed posting list chunk");
+    ++n;
+    if (rare(size_t(end - *posptr) <
+	     packed_size(n, did_bits) + packed_size(n, wdf_bits)))
+	report_read_error(NULL);
+    *last_did_ptr = first_did + increase_to_last;
+    *did_bits_ptr = did_bits;
+    *wdf_bits_ptr = wdf_bits;
+    return n;
+}
+
+unsigned
+GlassPostList::decode_packed_block(const char ** posptr, const char * end,
+				   Xapian::docid first_did,
+				   Xapian::docid prev_did,
+				   Xapian::docid * dids,
+				   Xapian::termcount * wdfs)
+{
+    Xapian::docid last_did;
+    unsigned did_bits, wdf_bits;
+    unsigned n = read_packed_block_header(posptr, end, first_did, &last_did,
+					  &did_bits, &wdf_bits);
+    unpack_packed(*posptr, n, did_bits, dids);
+    *posptr += packed_size(n, did_bits);
+    unpack_packed(*posptr, n, wdf_bits, wdfs);
+    *posptr += packed_size(n, wdf_bits);
+    // The docid increases are stored less one, so turn them into docids.
+    for (unsigned i = 0; i != n; ++i) {
+	prev_did += dids[i] + 1;
+	dids[i] = prev_did;
+    }
+    if (rare(prev_did != last_did))
+	throw Xapian::DatabaseCorruptError("Last docid in packed posting list block doesn't match its header");
+    return n;
+}
+
+/** Try to encode the entries of a chunk as packed blocks.
+ *
+ *  The entries are split into blocks of up to GLASS_POSTLIST_BLOCK_SIZE, and
+ *  each block stores the number of entries less one, the difference between
+ *  its last docid and the first in the chunk, the bit widths used for docid
+ *  increases and wdfs, then the docid increases (less one) and the wdfs
+ *  packed into those widths.  Whole blocks can be decoded without branching
+ *  on each entry, and blocks which end before a docid being skipped to don't
+ *  need to be decoded at all.
+ *
+ *  @param first_did	The first docid in the chunk.
+ *  @param chunk	The entries in the standard encoding.
+ *  @param packed_chunk	Set to the entries encoded as packed blocks, if we
+ *			return true.
+ *
+ *  @return true if the entries should be stored as packed blocks.
+ */
+static bool
+encode_as_packed(Xapian::docid first_did, const string & chunk,
+		 string & packed_chunk)
+{
+    const char * pos = chunk.data();
+    const char * end = pos + chunk.size();
+    Xapian::docid did = first_did;
+    Xapian::docid prev_did = first_did - 1;
+    Xapian::docid increase[GLASS_POSTLIST_BLOCK_SIZE];
+    Xapian::termcount wdf[GLASS_POSTLIST_BLOCK_SIZE];
+    packed_chunk.resize(0);
+    while (pos != end) {
+	unsigned n = 0;
+	uint8 max_increase = 0, max_wdf = 0;
+	do {
+	    if (pos != chunk.data()) read_did_increase(&pos, end, &did);
+	    increase[n] = did - prev_did - 1;
+	    read_wdf(&pos, end, &wdf[n]);
+	    max_increase = max(max_increase, uint8(increase[n]));
+	    max_wdf = max(max_wdf, uint8(wdf[n]));
+	    prev_did = did;
+	} while (++n != GLASS_POSTLIST_BLOCK_SIZE && pos != end);
+
+	unsigned did_bits = bits_needed(max_increase);
+	unsigned wdf_bits = bits_needed(max_wdf);
+	// Values wider than this are rare enough that it's not worth handling
+	// them.
+	if (did_bits > 32 || wdf_bits > 32) return false;
+	pack_uint(packed_chunk, n - 1);
+	pack_uint(packed_chunk, did - first_did);
+	packed_chunk += char(did_bits);
+	packed_chunk += char(wdf_bits);
+	append_packed(packed_chunk, increase, n, did_bits);
+	append_packed(packed_chunk, wdf, n, wdf_bits);
+	// Give up as soon as the packed form can't be smaller.
+	if (packed_chunk.size() > size_t(pos - chunk.data())) return false;
+    }
+    return true;
+}
+
+/** Convert the entries of a packed chunk to the standard encoding.
+ *
+ *  @param first_did	The first docid in the chunk.
+ *  @param packed_chunk	The entries encoded as packed blocks.
+ *
+ *  @return The entries in the standard encoding.
+ */
+static string
+decode_packed_chunk(Xapian::docid first_did, const string & packed_chunk)
+{
+    const char * pos = packed_chunk.data();
+    const char * end = pos + packed_chunk.size();
+    Xapian::docid did[GLASS_POSTLIST_BLOCK_SIZE];
+    Xapian::termcount wdf[GLASS_POSTLIST_BLOCK_SIZE];
+    Xapian::docid prev_did = first_did - 1;
+    string chunk;
+    while (pos != end) {
+	unsigned n = GlassPostList::decode_packed_block(&pos, end, first_did,
+							prev_did, did, wdf);
+	for (unsigned i = 0; i != n; ++i) {
+	    if (!chunk.empty()) pack_uint(chunk, did[i] - prev_did - 1);
+	    pack_uint(chunk, wdf[i]);
+	    prev_did = did[i];
+	}
+    }
+    return chunk;
+}
+
 /// Read the start of a chunk.
 static Xapian::docid
 read_start_of_chunk(const char ** posptr,
 		    const char * end,
 		    Xapian::docid first_did_in_chunk,
-		    bool * is_last_chunk_ptr)
+		    bool * is_last_chunk_ptr,
+		    bool * is_bitmap_chunk_ptr,
+		    bool * is_packed_chunk_ptr,
+		    Xapian::termcount * max_wdf_ptr)
 {
-    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr));
+    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr) | reinterpret_cast<const void*>(is_bitmap_chunk_ptr) | reinterpret_cast<const void*>(is_packed_chunk_ptr) | reinterpret_cast<const void*>(max_wdf_ptr));
     Assert(is_last_chunk_ptr);
-
-    // Read whether this is the last chunk
-    if (!unpack_bool(posptr, end, is_last_chunk_ptr))
-	report_read_error(*posptr);
+    Assert(is_bitmap_chunk_ptr);
+    Assert(is_packed_chunk_ptr);
+    Assert(max_wdf_ptr);
+
+    // Read whether this is the last chunk, and how the entries are encoded.
+    if (rare(*posptr == end)) report_read_error(NULL);
+    unsigned flags = static_cast<unsigned char>(**posptr) - '0';
+    if (rare((flags & ~7u) || (flags & 6) == 6))
+	throw Xapian::DatabaseCorruptError("Bad flags in posting list chunk");
+    ++*posptr;
+    *is_last_chunk_ptr = (flags & 1);
+    *is_bitmap_chunk_ptr = (flags & 2);
+    *is_packed_chunk_ptr = (flags & 4);
     LOGVALUE(DB, *is_last_chunk_ptr);
+    LOGVALUE(DB, *is_bitmap_chunk_ptr);
+    LOGVALUE(DB, *is_packed_chunk_ptr);
 
     // Read what the final document ID in this chunk is.
     Xapian::docid increase_to_last;
@@ -244,6 +554,11 @@ read_start_of_chunk(const char ** posptr,
 	report_read_error(*posptr);
     Xapian::docid last_did_in_chunk = first_did_in_chunk + increase_to_last;
     LOGVALUE(DB, last_did_in_chunk);
+
+    // Read the largest wdf in this chunk.
+    if (!unpack_uint(posptr, end, max_wdf_ptr))
+	report_read_error(*posptr);
+    LOGVALUE(DB, *max_wdf_ptr);
     RETURN(last_did_in_chunk);
 }
 
@@ -259,17 +574,31 @@ class Glass::PostlistChunkReader {
 
     bool at_end;
 
+    /// True if the entries are encoded as a bitmap.
+    bool is_bitmap;
+
+    Xapian::docid first_did;
+    Xapian::docid last_did;
     Xapian::docid did;
     Xapian::termcount wdf;
 
   public:
     /** Initialise the postlist chunk reader.
      *
-     *  @param first_did  First document id in this chunk.
-     *  @param data       The tag string with the header removed.
+     *  @param first_did_	First document id in this chunk.
+     *  @param last_did_	Last document id in this chunk.
+     *  @param is_bitmap_	True if the entries are encoded as a bitmap.
+     *  @param is_packed	True if the entries are encoded as packed
+     *			blocks (these are converted to the standard
+     *			encoding).
+     *  @param data_		The tag string with the header removed.
      */
-    PostlistChunkReader(Xapian::docid first_did, const string & data_)
-	: data(data_), pos(data.data()), end(pos + data.length()), at_end(data.empty()), did(first_did)
+    PostlistChunkReader(Xapian::docid first_did_, Xapian::docid last_did_,
+			bool is_bitmap_, bool is_packed, const string & data_)
+	: data(is_packed ? decode_packed_chunk(first_did_, data_) : data_),
+	  pos(data.data()), end(pos + data.length()),
+	  at_end(data.empty()), is_bitmap(is_bitmap_),
+	  first_did(first_did_), last_did(last_did_), did(first_did_)
     {
 	if (!at_end) read_wdf(&pos, end, &wdf);
     }
@@ -295,7 +624,13 @@ using Glass::PostlistChunkReader;
 void
 PostlistChunkReader::next()
 {
-    if (pos == end) {
+    if (is_bitmap) {
+	if (did == last_did) {
+	    at_end = true;
+	} else {
+	    did = first_did + find_next_bit(pos, end, did - first_did + 1);
+	}
+    } else if (pos == end) {
 	at_end = true;
     } else {
 	read_did_increase(&pos, end, &did);
@@ -310,7 +645,8 @@ PostlistChunkWriter::PostlistChunkWriter(const string &orig_key_,
 	: orig_key(orig_key_),
 	  tname(tname_), is_first_chunk(is_first_chunk_),
 	  is_last_chunk(is_last_chunk_),
-	  started(false)
+	  started(false),
+	  max_wdf(0)
 {
     LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_);
 }
@@ -332,6 +668,7 @@ PostlistChunkWriter::append(GlassTable * table, Xapian::docid did,
 	    is_last_chunk = save_is_last_chunk;
 	    is_first_chunk = false;
 	    first_did = did;
+	    max_wdf = 0;
 	    chunk.resize(0);
 	    orig_key = GlassPostListTable::make_key(tname, first_did);
 	} else {
@@ -340,6 +677,7 @@ PostlistChunkWriter::append(GlassTable * table, Xapian::docid did,
     }
     current_did = did;
     pack_uint(chunk, wdf);
+    if (wdf > max_wdf) max_wdf = wdf;
 }
 
 /** Make the data to go at the start of the very first chunk.
@@ -360,13 +698,20 @@ make_start_of_first_chunk(Xapian::doccount entries,
  */
 static inline string
 make_start_of_chunk(bool new_is_last_chunk,
+		    bool new_is_bitmap_chunk,
+		    bool new_is_packed_chunk,
 		    Xapian::docid new_first_did,
-		    Xapian::docid new_final_did)
+		    Xapian::docid new_final_did,
+		    Xapian::termcount new_max_wdf)
 {
     Assert(new_final_did >= new_first_did);
+    Assert(!(new_is_bitmap_chunk && new_is_packed_chunk));
     string chunk;
-    pack_bool(chunk, new_is_last_chunk);
+    chunk += char('0' | (new_is_packed_chunk ? 4 : 0) |
+		  (new_is_bitmap_chunk ? 2 : 0) |
+		  (new_is_last_chunk ? 1 : 0));
     pack_uint(chunk, new_final_did - new_first_did);
+    pack_uint(chunk, new_max_wdf);
     return chunk;
 }
 
@@ -375,15 +720,20 @@ write_start_of_chunk(string & chunk,
 		     unsigned int start_of_chunk_header,
 		     unsigned int end_of_chunk_header,
 		     bool is_last_chunk,
+		     bool is_bitmap_chunk,
+		     bool is_packed_chunk,
 		     Xapian::docid first_did_in_chunk,
-		     Xapian::docid last_did_in_chunk)
+		     Xapian::docid last_did_in_chunk,
+		     Xapian::termcount max_wdf)
 {
     Assert((size_t)(end_of_chunk_header - start_of_chunk_header) <= chunk.size());
 
     chunk.replace(start_of_chunk_header,
 		  end_of_chunk_header - start_of_chunk_header,
-		  make_start_of_chunk(is_last_chunk, first_did_in_chunk,
-				      last_did_in_chunk));
+		  make_start_of_chunk(is_last_chunk, is_bitmap_chunk,
+				      is_packed_chunk,
+				      first_did_in_chunk, last_did_in_chunk,
+				      max_wdf));
 }
 
 void
@@ -473,10 +823,12 @@ PostlistChunkWriter::flush(GlassTable *table)
 	    const char *tagend = tagpos + cursor->current_tag.size();
 
 	    // Read the chunk header
-	    bool new_is_last_chunk;
+	    bool new_is_last_chunk, new_is_bitmap_chunk, new_is_packed_chunk;
+	    Xapian::termcount new_max_wdf;
 	    Xapian::docid new_last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, new_first_did,
-				    &new_is_last_chunk);
+				    &new_is_last_chunk, &new_is_bitmap_chunk,
+				    &new_is_packed_chunk, &new_max_wdf);
 
 	    string chunk_data(tagpos, tagend);
 
@@ -487,8 +839,11 @@ PostlistChunkWriter::flush(GlassTable *table)
 	    string tag;
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, new_first_did);
 	    tag += make_start_of_chunk(new_is_last_chunk,
-					      new_first_did,
-					      new_last_did_in_chunk);
+				       new_is_bitmap_chunk,
+				       new_is_packed_chunk,
+				       new_first_did,
+				       new_last_did_in_chunk,
+				       new_max_wdf);
 	    tag += chunk_data;
 	    table->add(orig_key, tag);
 	    return;
@@ -535,11 +890,13 @@ PostlistChunkWriter::flush(GlassTable *table)
 		if (!unpack_uint_preserving_sort(&keypos, keyend, &first_did_in_chunk))
 		    report_read_error(keypos);
 	    }
-	    bool wrong_is_last_chunk;
+	    bool wrong_is_last_chunk, is_bitmap_chunk, is_packed_chunk;
+	    Xapian::termcount chunk_max_wdf;
 	    string::size_type start_of_chunk_header = tagpos - tag.data();
 	    Xapian::docid last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, first_did_in_chunk,
-				    &wrong_is_last_chunk);
+				    &wrong_is_last_chunk, &is_bitmap_chunk,
+				    &is_packed_chunk, &chunk_max_wdf);
 	    string::size_type end_of_chunk_header = tagpos - tag.data();
 
 	    // write new is_last flag
@@ -547,8 +904,11 @@ PostlistChunkWriter::flush(GlassTable *table)
 				 start_of_chunk_header,
 				 end_of_chunk_header,
 				 true, // is_last_chunk
+				 is_bitmap_chunk,
+				 is_packed_chunk,
 				 first_did_in_chunk,
-				 last_did_in_chunk);
+				 last_did_in_chunk,
+				 chunk_max_wdf);
 	    table->add(cursor->current_key, tag);
 	}
     } else {
@@ -561,6 +921,17 @@ PostlistChunkWriter::flush(GlassTable *table)
 	 */
 	string tag;
 
+	// Store the entries as a bitmap or in packed blocks if that's more
+	// compact.  We don't do this for the doclen list, which is rarely
+	// dense, and where lookups jump to single entries so decoding a whole
+	// block would mostly be wasted work.
+	string encoded_chunk;
+	bool is_bitmap_chunk = !tname.empty() &&
+	    encode_as_bitmap(first_did, current_did, chunk, encoded_chunk);
+	bool is_packed_chunk = !tname.empty() && !is_bitmap_chunk &&
+	    encode_as_packed(first_did, chunk, encoded_chunk);
+	if (is_bitmap_chunk || is_packed_chunk) chunk.swap(encoded_chunk);
+
 	/* First write the header, which depends on whether this is the
 	 * first chunk.
 	 */
@@ -586,7 +957,9 @@ PostlistChunkWriter::flush(GlassTable *table)
 
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, first_did);
 
-	    tag += make_start_of_chunk(is_last_chunk, first_did, current_did);
+	    tag += make_start_of_chunk(is_last_chunk, is_bitmap_chunk,
+				       is_packed_chunk, first_did, current_did,
+				       max_wdf);
 	    tag += chunk;
 	    table->add(key, tag);
 	    return;
@@ -626,7 +999,9 @@ PostlistChunkWriter::flush(GlassTable *table)
 	}
 
 	// ...and write the start of this chunk.
-	tag = make_start_of_chunk(is_last_chunk, first_did, current_did);
+	tag = make_start_of_chunk(is_last_chunk, is_bitmap_chunk,
+				  is_packed_chunk, first_did, current_did,
+				  max_wdf);
 
 	tag += chunk;
 	table->add(new_key, tag);
@@ -657,11 +1032,25 @@ void GlassPostList::read_number_of_entries(const char ** posptr,
  *
  *  A chunk (except for the first chunk) contains:
  *
- *  1)  bool - true if this is the last chunk.
+ *  1)  flags - '0' + (1 if this is the last chunk) + (2 if the entries are
+ *      stored as a bitmap) + (4 if the entries are stored in packed blocks).
  *  2)  difference between final docid in chunk and first docid.
- *  3)  wdf for the first item.
- *  4)  increment in docid to next item, followed by wdf for the item.
- *  5)  (4) repeatedly.
+ *  3)  the largest wdf of any item in the chunk.
+ *  4)  wdf for the first item.
+ *  5)  increment in docid to next item, followed by wdf for the item.
+ *  6)  (5) repeatedly.
+ *
+ *  If the entries are stored as a bitmap, (4) is the wdf for every item, and
+ *  is followed by a bitmap (least significant bit first in each byte) with a
+ *  bit set for each docid in the chunk, starting from the first docid.
+ *
+ *  If the entries are stored in packed blocks, (4) onwards are replaced by a
+ *  sequence of blocks of up to GLASS_POSTLIST_BLOCK_SIZE entries.  Each block
+ *  has a header giving the number of entries less one, the difference between
+ *  the final docid in the block and the first docid in the chunk, and a byte
+ *  each for the number of bits used to store each docid increment (less one)
+ *  and each wdf, followed by the increments and then the wdfs packed into
+ *  those widths (least significant bit first).
  *
  *  The first chunk begins with the number of entries, the collection
  *  frequency, then the docid of the first document, then has the header of a
@@ -674,7 +1063,9 @@ GlassPostList::GlassPostList(intrusive_ptr<const GlassDatabase> this_db_,
 	  this_db(keep_reference ? this_db_ : NULL),
 	  have_started(false),
 	  is_at_end(false),
-	  cursor(this_db_->postlist_table.cursor_get())
+	  cursor(this_db_->postlist_table.cursor_get()),
+	  max_weight_wdf(0),
+	  wdf_max_weight(-1.0)
 {
     LOGCALL_CTOR(DB, "GlassPostList", this_db_.get() | term_ | keep_reference);
     init();
@@ -687,7 +1078,9 @@ GlassPostList::GlassPostList(intrusive_ptr<const GlassDatabase> this_db_,
 	  this_db(this_db_),
 	  have_started(false),
 	  is_at_end(false),
-	  cursor(cursor_)
+	  cursor(cursor_),
+	  max_weight_wdf(0),
+	  wdf_max_weight(-1.0)
 {
     LOGCALL_CTOR(DB, "GlassPostList", this_db_.get() | term_ | cursor_);
     init();
@@ -715,8 +1108,9 @@ GlassPostList::init()
     did = read_start_of_first_chunk(&pos, end, &number_of_entries, NULL);
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &is_bitmap_chunk,
+					    &is_packed_chunk, &chunk_max_wdf);
+    read_first_entry_in_chunk();
     LOGLINE(DB, "Initial docid " << did);
 }
 
@@ -754,10 +1148,51 @@ GlassPostList::get_unique_terms() const
     RETURN(this_db->get_unique_terms(did));
 }
 
+void
+GlassPostList::read_first_entry_in_chunk()
+{
+    if (is_packed_chunk) {
+	read_packed_block(first_did_in_chunk - 1);
+    } else {
+	read_wdf(&pos, end, &wdf);
+    }
+}
+
+void
+GlassPostList::read_packed_block(Xapian::docid prev_did)
+{
+    block_size = decode_packed_block(&pos, end, first_did_in_chunk, prev_did,
+				     block_did, block_wdf);
+    block_index = 0;
+    did = block_did[0];
+    wdf = block_wdf[0];
+}
+
 bool
 GlassPostList::next_in_chunk()
 {
     LOGCALL(DB, bool, "GlassPostList::next_in_chunk", NO_ARGS);
+    if (is_packed_chunk) {
+	if (block_index + 1 == block_size) {
+	    if (pos == end) RETURN(false);
+	    read_packed_block(did);
+	} else {
+	    ++block_index;
+	    did = block_did[block_index];
+	    wdf = block_wdf[block_index];
+	}
+	Assert(did <= last_did_in_chunk);
+	RETURN(true);
+    }
+
+    if (is_bitmap_chunk) {
+	if (did == last_did_in_chunk) RETURN(false);
+	did = first_did_in_chunk +
+	    find_next_bit(pos, end, did - first_did_in_chunk + 1);
+	Assert(did <= last_did_in_chunk);
+	RETURN(true);
+    }
+
     if (pos == end) RETURN(false);
 
     read_did_increase(&pos, end, &did);
@@ -813,8 +1248,9 @@ GlassPostList::next_chunk()
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &is_bitmap_chunk,
+					    &is_packed_chunk, &chunk_max_wdf);
+    read_first_entry_in_chunk();
 }
 
 PositionList *
@@ -838,7 +1274,6 @@ PostList *
 GlassPostList::next(double w_min)
 {
     LOGCALL(DB, PostList *, "GlassPostList::next", w_min);
-    (void)w_min; // no warning
 
     if (!have_started) {
 	have_started = true;
@@ -846,6 +1281,8 @@ GlassPostList::next(double w_min)
 	if (!next_in_chunk()) next_chunk();
     }
 
+    if (w_min > 0.0) skip_chunks_below(w_min);
+
     if (is_at_end) {
 	LOGLINE(DB, "Moved to end");
     } else {
@@ -906,8 +1343,9 @@ GlassPostList::move_to_chunk_containing(Xapian::docid desired_did)
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &is_bitmap_chunk,
+					    &is_packed_chunk, &chunk_max_wdf);
+    read_first_entry_in_chunk();
 
     // Possible, since desired_did might be after end of this chunk and before
     // the next.
@@ -921,6 +1359,49 @@ GlassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
     if (did >= desired_did)
 	RETURN(true);
 
+    if (is_packed_chunk) {
+	if (desired_did > last_did_in_chunk) {
+	    pos = end;
+	    block_index = block_size - 1;
+	    RETURN(false);
+	}
+	if (desired_did > block_did[block_size - 1]) {
+	    // Skip over blocks which end before desired_did without decoding
+	    // them.
+	    Xapian::docid prev_did = block_did[block_size - 1];
+	    while (true) {
+		const char * p = pos;
+		Xapian::docid block_last_did;
+		unsigned did_bits, wdf_bits;
+		unsigned n = read_packed_block_header(&p, end,
+						      first_did_in_chunk,
+						      &block_last_did,
+						      &did_bits, &wdf_bits);
+		if (block_last_did >= desired_did) break;
+		pos = p + packed_size(n, did_bits) + packed_size(n, wdf_bits);
+		prev_did = block_last_did;
+	    }
+	    read_packed_block(prev_did);
+	}
+	block_index = lower_bound(block_did + block_index,
+				  block_did + block_size,
+				  desired_did) - block_did;
+	Assert(block_index < block_size);
+	did = block_did[block_index];
+	wdf = block_wdf[block_index];
+	RETURN(true);
+    }
+
+    if (is_bitmap_chunk) {
+	if (desired_did > last_did_in_chunk) {
+	    did = last_did_in_chunk;
+	    RETURN(false);
+	}
+	did = first_did_in_chunk +
+	    find_next_bit(pos, end, desired_did - first_did_in_chunk);
+	RETURN(true);
+    }
+
     if (desired_did <= last_did_in_chunk) {
 	while (pos != end) {
 	    read_did_increase(&pos, end, &did);
@@ -940,11 +1421,29 @@ GlassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
     RETURN(false);
 }
 
+void
+GlassPostList::skip_chunks_below(double w_min)
+{
+    LOGCALL_VOID(DB, "GlassPostList::skip_chunks_below", w_min);
+    if (!weight) return;
+
+    while (!is_at_end) {
+	// Chunks of the same postlist often have the same largest wdf, so
+	// remember the bound for the last one.
+	if (chunk_max_wdf != max_weight_wdf || wdf_max_weight < 0.0) {
+	    max_weight_wdf = chunk_max_wdf;
+	    wdf_max_weight = get_maxweight_for_wdf(chunk_max_wdf);
+	}
+	if (wdf_max_weight >= w_min) return;
+	LOGLINE(DB, "Skipping chunk ending at docid " << last_did_in_chunk);
+	next_chunk();
+    }
+}
+
 PostList *
 GlassPostList::skip_to(Xapian::docid desired_did, double w_min)
 {
     LOGCALL(DB, PostList *, "GlassPostList::skip_to", desired_did | w_min);
-    (void)w_min; // no warning
     // We've started now - if we hadn't already, we're already positioned
     // at start so there's no need to actually do anything.
     have_started = true;
@@ -965,6 +1464,8 @@ GlassPostList::skip_to(Xapian::docid desired_did, double w_min)
     (void)have_document;
     Assert(have_document);
 
+    if (w_min > 0.0) skip_chunks_below(w_min);
+
     if (is_at_end) {
 	LOGLINE(DB, "Skipped to end");
     } else {
@@ -1063,20 +1564,28 @@ GlassPostListTable::get_chunk(const string &tname,
 	}
     }
 
-    bool is_last_chunk;
+    bool is_last_chunk, is_bitmap_chunk, is_packed_chunk;
+    Xapian::termcount max_wdf;
     Xapian::docid last_did_in_chunk;
-    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk, &is_last_chunk);
+    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
+					    &is_last_chunk, &is_bitmap_chunk,
+					    &is_packed_chunk, &max_wdf);
     *to = new PostlistChunkWriter(cursor->current_key, is_first_chunk, tname,
 				  is_last_chunk);
-    if (did > last_did_in_chunk) {
+    if (did > last_did_in_chunk && !is_bitmap_chunk) {
 	// This is the shortcut.  Not very pretty, but I'll leave refactoring
 	// until I've a clearer picture of everything which needs to be done.
 	// (FIXME)
 	*from = NULL;
-	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk,
-			  string(pos, end));
+	string data(pos, end);
+	if (is_packed_chunk)
+	    data = decode_packed_chunk(first_did_in_chunk, data);
+	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk, max_wdf,
+			  data);
     } else {
-	*from = new PostlistChunkReader(first_did_in_chunk, string(pos, end));
+	*from = new PostlistChunkReader(first_did_in_chunk, last_did_in_chunk,
+					is_bitmap_chunk, is_packed_chunk,
+					string(pos, end));
     }
     if (is_last_chunk) RETURN(Xapian::docid(-1));
 
@@ -1115,7 +1624,7 @@ GlassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
     if (!key_exists(current_key)) {
 	LOGLINE(DB, "Adding dummy first chunk");
 	string newtag = make_start_of_first_chunk(0, 0, 0);
-	newtag += make_start_of_chunk(true, 0, 0);
+	newtag += make_start_of_chunk(true, false, false, 0, 0, 0);
 	add(current_key, newtag);
     }
 
@@ -1167,16 +1676,17 @@ next_doclen_chunk:
     delete to;
 }
 
-void
+bool
 GlassPostListTable::merge_changes(const string &term,
 				  const Inverter::PostingChanges & changes)
 {
+    bool existed;
     {
 	// Rewrite the first chunk of this posting list with the updated
 	// termfreq and collfreq.
 	string current_key = make_key(term);
 	string tag;
-	(void)get_exact_entry(current_key, tag);
+	existed = get_exact_entry(current_key, tag);
 
 	// Read start of first chunk to get termfreq and collfreq.
 	const char *pos = tag.data();
@@ -1184,18 +1694,24 @@ GlassPostListTable::merge_changes(const string &term,
 	Xapian::doccount termfreq;
 	Xapian::termcount collfreq;
 	Xapian::docid firstdid, lastdid;
-	bool islast;
+	bool islast, isbitmap, ispacked;
+	Xapian::termcount maxwdf;
 	if (pos == end) {
 	    termfreq = 0;
 	    collfreq = 0;
 	    firstdid = 0;
 	    lastdid = 0;
 	    islast = true;
+	    isbitmap = false;
+	    ispacked = false;
+	    maxwdf = 0;
 	} else {
 	    firstdid = read_start_of_first_chunk(&pos, end,
 						 &termfreq, &collfreq);
 	    // Handle the generic start of chunk header.
-	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast);
+	    lastdid = read_start_of_chunk(&pos, end, firstdid,
+					  &islast, &isbitmap, &ispacked,
+					  &maxwdf);
 	}
 
 	termfreq += changes.get_tfdelta();
@@ -1205,24 +1721,25 @@ GlassPostListTable::merge_changes(const string &term,
 	    if (islast) {
 		// Only one entry for this posting list.
 		del(current_key);
-		return;
+		return existed;
 	    }
 	    MutableGlassCursor cursor(this);
 	    bool found = cursor.find_entry(current_key);
 	    Assert(found);
-	    if (!found) return; // Reduce damage!
+	    if (!found) return existed; // Reduce damage!
 	    while (cursor.del()) {
 		const char *kpos = cursor.current_key.data();
 		const char *kend = kpos + cursor.current_key.size();
 		if (!check_tname_in_key_lite(&kpos, kend, term)) break;
 	    }
-	    return;
+	    return existed;
 	}
 	collfreq += changes.get_cfdelta();
 
 	// Rewrite start of first chunk to update termfreq and collfreq.
 	string newhdr = make_start_of_first_chunk(termfreq, collfreq, firstdid);
-	newhdr += make_start_of_chunk(islast, firstdid, lastdid);
+	newhdr += make_start_of_chunk(islast, isbitmap, ispacked,
+				      firstdid, lastdid, maxwdf);
 	if (pos == end) {
 	    add(current_key, newhdr);
 	} else {
@@ -1231,8 +1748,9 @@ GlassPostListTable::merge_changes(const string &term,
 	    add(current_key, tag);
 	}
     }
-    map<Xapian::docid, Xapian::termcount>::const_iterator j;
+    vector<pair<Xapian::docid, Xapian::termcount> >::const_iterator j;
     j = changes.pl_changes.begin();
+    Assert(changes.sorted);
     Assert(j != changes.pl_changes.end()); // This case is caught above.
 
     Xapian::docid max_did;
@@ -1278,6 +1796,7 @@ next_chunk:
     }
     to->flush(this);
     delete to;
+    return !existed;
 }
 
 void
@@ -1327,6 +1846,9 @@ GlassPostListTable::get_used_docid_range(Xapian::docid & first,
 	}
     }
 
-    bool dummy;
-    last = read_start_of_chunk(&p, e, start_of_last_chunk, &dummy);
+    bool dummy, dummy_bitmap, dummy_packed;
+    Xapian::termcount dummy_max_wdf;
+    last = read_start_of_chunk(&p, e, start_of_last_chunk,
+			       &dummy, &dummy_bitmap, &dummy_packed,
+			       &dummy_max_wdf);
 }
@@ -39,6 +39,9 @@
 
 using namespace std;
 
+/// The maximum number of entries in each block of a packed postlist chunk.
+#define GLASS_POSTLIST_BLOCK_SIZE 128
+
 class GlassCursor;
 class GlassDatabase;
 
@@ -85,8 +88,11 @@ class GlassPostListTable : public GlassTable {
 	    GlassTable::open(flags_, root_info, rev);
 	}
 
-	/// Merge changes for a term.
-	void merge_changes(const string &term, const Inverter::PostingChanges & changes);
+	/** Merge changes for a term.
+	 *
+	 *  @return true if the term was created or removed by the changes.
+	 */
+	bool merge_changes(const string &term, const Inverter::PostingChanges & changes);
 
 	/// Merge document length changes.
 	void merge_doclen_changes(const map<Xapian::docid, Xapian::termcount> & doclens);
@@ -152,6 +158,12 @@ class GlassPostList : public LeafPostList {
 	/// True if this is the last chunk.
 	bool is_last_chunk;
 
+	/// True if the entries in the current chunk are stored as a bitmap.
+	bool is_bitmap_chunk;
+
+	/// True if the entries in the current chunk are stored in packed blocks.
+	bool is_packed_chunk;
+
 	/// Whether we've run off the end of the list yet.
 	bool is_at_end;
 
@@ -164,6 +176,9 @@ class GlassPostList : public LeafPostList {
 	/// The last document id in this chunk.
 	Xapian::docid last_did_in_chunk;
 
+	/// The largest wdf in this chunk.
+	Xapian::termcount chunk_max_wdf;
+
 	/// Position of iteration through current chunk.
 	const char * pos;
 
@@ -179,12 +194,47 @@ class GlassPostList : public LeafPostList {
 	/// The number of entries in the posting list.
 	Xapian::doccount number_of_entries;
 
+	/// The number of entries in the current block of a packed chunk.
+	unsigned block_size;
+
+	/// The index of the current entry in the current block.
+	unsigned block_index;
+
+	/// The document ids of the entries in the current block.
+	Xapian::docid block_did[GLASS_POSTLIST_BLOCK_SIZE];
+
+	/// The wdfs of the entries in the current block.
+	Xapian::termcount block_wdf[GLASS_POSTLIST_BLOCK_SIZE];
+
+	/// The wdf which wdf_max_weight was last calculated for.
+	Xapian::termcount max_weight_wdf;
+
+	/** Upper bound on the weight of an entry with wdf max_weight_wdf.
+	 *
+	 *  Negative if not yet calculated.
+	 */
+	double wdf_max_weight;
+
 	/// Copying is not allowed.
 	GlassPostList(const GlassPostList &);
 
 	/// Assignment is not allowed.
 	void operator=(const GlassPostList &);
 
+	/** Read the first entry in the current chunk.
+	 *
+	 *  This must be called with pos pointing just after the chunk header.
+	 */
+	void read_first_entry_in_chunk();
+
+	/** Decode the block of a packed chunk which pos points to, and move
+	 *  to its first entry.
+	 *
+	 *  @param prev_did	The document id of the entry before the block
+	 *			(or one less than the first in the chunk).
+	 */
+	void read_packed_block(Xapian::docid prev_did);
+
 	/** Move to the next item in the chunk, if possible.
 	 *  If already at the end of the chunk, returns false.
 	 */
@@ -230,6 +280,14 @@ class GlassPostList : public LeafPostList {
 	 */
 	bool move_forward_in_chunk_to_at_least(Xapian::docid desired_did);
 
+	/** Skip over chunks which can't contain a document with weight
+	 *  @a w_min or more.
+	 *
+	 *  Each chunk stores the largest wdf in it, which gives an upper
+	 *  bound on the weight of its entries.
+	 */
+	void skip_chunks_below(double w_min);
+
 	GlassPostList(Xapian::Internal::intrusive_ptr<const GlassDatabase> this_db_,
 		      const string & term,
 		      GlassCursor * cursor_);
@@ -298,6 +356,28 @@ class GlassPostList : public LeafPostList {
 					   const char * end,
 					   Xapian::doccount * number_of_entries_ptr,
 					   Xapian::termcount * collection_freq_ptr);
+
+	/** Decode a block of entries from a packed chunk.
+	 *
+	 *  @param posptr	Pointer to the start of the block, which is
+	 *			updated to point to the end of it.
+	 *  @param end		The end of the chunk.
+	 *  @param first_did	The first document id in the chunk.
+	 *  @param prev_did	The document id of the entry before the block
+	 *			(or first_did - 1 for the first block).
+	 *  @param dids		Array of GLASS_POSTLIST_BLOCK_SIZE elements to
+	 *			store the document ids in.
+	 *  @param wdfs		Array of GLASS_POSTLIST_BLOCK_SIZE elements to
+	 *			store the wdfs in.
+	 *
+	 *  @return The number of entries in the block.
+	 */
+	static unsigned decode_packed_block(const char ** posptr,
+					    const char * end,
+					    Xapian::docid first_did,
+					    Xapian::docid prev_did,
+					    Xapian::docid * dids,
+					    Xapian::termcount * wdfs);
 };
 
 #endif /* OM_HGUARD_GLASS_POSTLIST_H */
@@ -31,7 +31,9 @@
 // 2  - compressed changesets
 // 3  - store (block_size / 2048)
 // 4  - reworked for switch from base files to version file
-#define CHANGES_VERSION 4u
+// 5  - blocks compressed individually, and checksums for blocks and version
+//      file
+#define CHANGES_VERSION 5u
 
 // Must be big enough to ensure that the start of the changeset (up to the new
 // revision number) will fit in this much space.
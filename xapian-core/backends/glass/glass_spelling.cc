@@ -23,7 +23,10 @@
 #include <xapian/error.h>
 #include <xapian/types.h>
 
+#include "api/vectortermlist.h"
+#include "autoptr.h"
 #include "expand/expandweight.h"
+#include "glass_cursor.h"
 #include "glass_spelling.h"
 #include "omassert.h"
 #include "expand/ortermlist.h"
@@ -41,58 +44,116 @@
 using namespace Glass;
 using namespace std;
 
+/** The deletion index.
+ *
+ *  Each word is stored under "D" + every variant of it with up to
+ *  DELETES_MAX_DISTANCE characters deleted (including the word itself), and
+ *  the SPELLING_DELETES_MARKER_KEY entry records that the index exists and
+ *  the edit distance it covers.  Two words within N edits of each other
+ *  always share a variant with at most N deletions from each, so looking up
+ *  the variants of a misspelling finds all the candidate corrections.
+ */
+#define DELETES_MAX_DISTANCE 2
+
+/** Add the variants of @a word with up to @a max_deletes characters deleted.
+ *
+ *  @a word itself is included.  Characters are UTF-8 encoded, and we delete
+ *  whole characters.
+ */
+static void
+generate_deletes(const string & word, unsigned max_deletes,
+		 set<string> & result)
+{
+    if (!result.insert(word).second) {
+	// A variant always has the same number of deletions however we
+	// reach it, so we've already generated everything below it.
+	return;
+    }
+    if (max_deletes == 0) return;
+
+    size_t i = 0;
+    while (i < word.size()) {
+	size_t j = i + 1;
+	while (j < word.size() &&
+	       (static_cast<unsigned char>(word[j]) & 0xc0) == 0x80) {
+	    ++j;
+	}
+	string variant(word, 0, i);
+	variant.append(word, j, string::npos);
+	generate_deletes(variant, max_deletes - 1, result);
+	i = j;
+    }
+}
+
 void
-GlassSpellingTable::merge_changes()
+GlassSpellingTable::merge_word_list(const string & key,
+				    const set<string> & changes)
 {
-    map<fragment, set<string> >::const_iterator i;
-    for (i = termlist_deltas.begin(); i != termlist_deltas.end(); ++i) {
-	string key = i->first;
-	const set<string> & changes = i->second;
-
-	set<string>::const_iterator d = changes.begin();
-	if (d == changes.end()) continue;
-
-	string updated;
-	string current;
-	PrefixCompressedStringWriter out(updated);
-	if (get_exact_entry(key, current)) {
-	    PrefixCompressedStringItor in(current);
-	    updated.reserve(current.size()); // FIXME plus some?
-	    while (!in.at_end() && d != changes.end()) {
-		const string & word = *in;
-		Assert(d != changes.end());
-		int cmp = word.compare(*d);
-		if (cmp < 0) {
-		    out.append(word);
-		    ++in;
-		} else if (cmp > 0) {
-		    out.append(*d);
-		    ++d;
-		} else {
-		    // If an existing entry is in the changes list, that means
-		    // we should remove it.
-		    ++in;
-		    ++d;
-		}
-	    }
-	    if (!in.at_end()) {
-		// FIXME : easy to optimise this to a fix-up and substring copy.
-		while (!in.at_end()) {
-		    out.append(*in++);
-		}
+    set<string>::const_iterator d = changes.begin();
+    if (d == changes.end()) return;
+
+    string updated;
+    string current;
+    PrefixCompressedStringWriter out(updated);
+    if (get_exact_entry(key, current)) {
+	PrefixCompressedStringItor in(current);
+	updated.reserve(current.size()); // FIXME plus some?
+	while (!in.at_end() && d != changes.end()) {
+	    const string & word = *in;
+	    Assert(d != changes.end());
+	    int cmp = word.compare(*d);
+	    if (cmp < 0) {
+		out.append(word);
+		++in;
+	    } else if (cmp > 0) {
+		out.append(*d);
+		++d;
+	    } else {
+		// If an existing entry is in the changes list, that means
+		// we should remove it.
+		++in;
+		++d;
 	    }
 	}
-	while (d != changes.end()) {
-	    out.append(*d++);
-	}
-	if (!updated.empty()) {
-	    add(key, updated);
-	} else {
-	    del(key);
+	if (!in.at_end()) {
+	    // FIXME : easy to optimise this to a fix-up and substring copy.
+	    while (!in.at_end()) {
+		out.append(*in++);
+	    }
 	}
     }
+    while (d != changes.end()) {
+	out.append(*d++);
+    }
+    if (!updated.empty()) {
+	add(key, updated);
+    } else {
+	del(key);
+    }
+}
+
+void
+GlassSpellingTable::merge_changes()
+{
+    map<fragment, set<string> >::const_iterator i;
+    for (i = termlist_deltas.begin(); i != termlist_deltas.end(); ++i) {
+	merge_word_list(i->first, i->second);
+    }
     termlist_deltas.clear();
 
+    map<string, set<string> >::const_iterator k;
+    for (k = deletes_deltas.begin(); k != deletes_deltas.end(); ++k) {
+	merge_word_list("D" + k->first, k->second);
+    }
+    deletes_deltas.clear();
+
+    if (deletes_marker_pending) {
+	string tag;
+	pack_uint_last(tag, unsigned(DELETES_MAX_DISTANCE));
+	add(SPELLING_DELETES_MARKER_KEY, tag);
+	deletes_marker_pending = false;
+    }
+
     map<string, Xapian::termcount>::const_iterator j;
     for (j = wordfreq_changes.begin(); j != wordfreq_changes.end(); ++j) {
 	string key = "W" + j->first;
@@ -205,9 +266,46 @@ GlassSpellingTable::remove_word(const string & word, Xapian::termcount freqdec)
     toggle_word(word);
 }
 
+bool
+GlassSpellingTable::have_deletion_index() const
+{
+    if (deletes_distance < 0) {
+	string data;
+	deletes_distance = 0;
+	if (get_exact_entry(SPELLING_DELETES_MARKER_KEY, data)) {
+	    const char * p = data.data();
+	    unsigned distance;
+	    if (!unpack_uint_last(&p, p + data.size(), &distance)) {
+		throw Xapian::DatabaseCorruptError("Bad spelling deletion index marker");
+	    }
+	    deletes_distance = int(distance);
+	}
+    }
+    return deletes_distance > 0;
+}
+
+void
+GlassSpellingTable::toggle_deletes(const string & word)
+{
+    set<string> variants;
+    generate_deletes(word, DELETES_MAX_DISTANCE, variants);
+    set<string>::const_iterator v;
+    for (v = variants.begin(); v != variants.end(); ++v) {
+	set<string> & words = deletes_deltas[*v];
+	pair<set<string>::iterator, bool> res = words.insert(word);
+	if (!res.second) {
+	    // word is already in the set, so remove it.
+	    words.erase(res.first);
+	}
+    }
+}
+
 void
 GlassSpellingTable::toggle_word(const string & word)
 {
+    if (have_deletion_index())
+	toggle_deletes(word);
+
     fragment buf;
     // Head:
     buf[0] = 'H';
@@ -371,6 +469,62 @@ GlassSpellingTable::open_termlist(const string & word)
     }
 }
 
+void
+GlassSpellingTable::create_deletion_index()
+{
+    if (have_deletion_index()) return;
+
+    // Make sure all the words are on disk so we only need to look there.
+    merge_changes();
+
+    AutoPtr<GlassCursor> cursor(cursor_get());
+    if (cursor.get()) {
+	cursor->find_entry_ge("W");
+	while (!cursor->after_end()) {
+	    const string & key = cursor->current_key;
+	    if (key.empty() || key[0] != 'W') break;
+	    toggle_deletes(key.substr(1));
+	    cursor->next();
+	}
+    }
+
+    deletes_distance = DELETES_MAX_DISTANCE;
+    deletes_marker_pending = true;
+}
+
+TermList *
+GlassSpellingTable::open_deletes_termlist(const string & word,
+					  unsigned max_edit_distance)
+{
+    // Merge any pending changes to disk, but don't call commit() so they
+    // won't be switched live.
+    if (!wordfreq_changes.empty() || deletes_marker_pending) merge_changes();
+
+    // Check for the marker rather than using have_deletion_index() since
+    // another writer may have added the index since we last checked.
+    string data;
+    if (!get_exact_entry(SPELLING_DELETES_MARKER_KEY, data)) return NULL;
+    const char * p = data.data();
+    unsigned distance;
+    if (!unpack_uint_last(&p, p + data.size(), &distance)) {
+	throw Xapian::DatabaseCorruptError("Bad spelling deletion index marker");
+    }
+    if (max_edit_distance > distance) return NULL;
+
+    set<string> variants;
+    generate_deletes(word, max_edit_distance, variants);
+    set<string> candidates;
+    set<string>::const_iterator v;
+    for (v = variants.begin(); v != variants.end(); ++v) {
+	if (!get_exact_entry("D" + *v, data)) continue;
+	PrefixCompressedStringItor in(data);
+	while (!in.at_end()) {
+	    candidates.insert(*in++);
+	}
+    }
+    return new VectorTermList(candidates.begin(), candidates.end());
+}
+
 Xapian::doccount
 GlassSpellingTable::get_word_frequency(const string & word) const
 {
@@ -56,6 +56,12 @@ struct fragment {
     }
 };
 
+/** Key in the spelling table which marks that it has a deletion index.
+ *
+ *  The tag is the edit distance which the deletion index covers.
+ */
+const char SPELLING_DELETES_MARKER_KEY[] = "I";
+
 }
 
 using Glass::RootInfo;
@@ -63,6 +69,11 @@ using Glass::RootInfo;
 class GlassSpellingTable : public GlassLazyTable {
     void toggle_word(const std::string & word);
     void toggle_fragment(Glass::fragment frag, const std::string & word);
+    void toggle_deletes(const std::string & word);
+
+    /// Merge @a changes into the word list stored under @a key.
+    void merge_word_list(const std::string & key,
+			 const std::set<std::string> & changes);
 
     std::map<std::string, Xapian::termcount> wordfreq_changes;
 
@@ -76,6 +87,26 @@ class GlassSpellingTable : public GlassLazyTable {
      */
     std::map<Glass::fragment, std::set<std::string> > termlist_deltas;
 
+    /** Changes to make to the deletion index word lists.
+     *
+     *  Keyed by deletion variant, and xor-ed with the lists on disk in the
+     *  same way as termlist_deltas.
+     */
+    std::map<std::string, std::set<std::string> > deletes_deltas;
+
+    /** Edit distance the deletion index covers.
+     *
+     *  0 means there's no deletion index, and -1 means we haven't checked
+     *  yet.
+     */
+    mutable int deletes_distance = -1;
+
+    /// True if the deletion index marker needs writing.
+    bool deletes_marker_pending = false;
+
+    /// Does this table have a deletion index which needs maintaining?
+    bool have_deletion_index() const;
+
     /** Used to track an upper bound on wordfreq. */
     Xapian::termcount wordfreq_upper_bound = 0;
 
@@ -107,6 +138,24 @@ class GlassSpellingTable : public GlassLazyTable {
 
     TermList * open_termlist(const std::string & word);
 
+    /** Build a deletion index for the words currently in the table.
+     *
+     *  Does nothing if there's already a deletion index.  Once added, the
+     *  deletion index is maintained by add_word() and remove_word().
+     */
+    void create_deletion_index();
+
+    /** Open a list of the candidate corrections for @a word.
+     *
+     *  The list contains every word within @a max_edit_distance edits of
+     *  @a word (and some which aren't, so the caller needs to check).
+     *
+     *  Returns NULL if there's no deletion index, or it doesn't cover
+     *  @a max_edit_distance edits.
+     */
+    TermList * open_deletes_termlist(const std::string & word,
+				     unsigned max_edit_distance);
+
     Xapian::doccount get_word_frequency(const std::string & word) const;
 
     void set_wordfreq_upper_bound(Xapian::termcount ub) {
@@ -121,7 +170,8 @@ class GlassSpellingTable : public GlassLazyTable {
      */
 
     bool is_modified() const {
-	return !wordfreq_changes.empty() || GlassTable::is_modified();
+	return !wordfreq_changes.empty() || !deletes_deltas.empty() ||
+	       deletes_marker_pending || GlassTable::is_modified();
     }
 
     /** Returns updated wordfreq upper bound. */
@@ -135,6 +185,9 @@ class GlassSpellingTable : public GlassLazyTable {
 	// Discard batched-up changes.
 	wordfreq_changes.clear();
 	termlist_deltas.clear();
+	deletes_deltas.clear();
+	deletes_marker_pending = false;
+	deletes_distance = -1;
 
 	GlassTable::cancel(root_info, rev);
     }
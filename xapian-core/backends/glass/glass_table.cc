@@ -31,14 +31,19 @@
 
 #include "omassert.h"
 #include "posixy_wrapper.h"
+#include "safesysstat.h"
 #include "str.h"
 #include "stringutils.h" // For STRINGIZE().
 
 #include <sys/types.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include <cstring>   /* for memmove */
 #include <climits>   /* for CHAR_BIT */
 
+#include "glass_blockcache.h"
 #include "glass_freelist.h"
 #include "glass_changes.h"
 #include "glass_cursor.h"
@@ -53,6 +58,7 @@
 #include "unaligned.h"
 
 #include <algorithm>  // for std::min()
+#include <cstdint>
 #include <string>
 
 #include "xapian/constants.h"
@@ -63,6 +69,16 @@ using namespace std;
 // Only try to compress tags longer than this many bytes.
 const size_t COMPRESS_MIN = 4;
 
+#ifdef HAVE_MMAP
+/// Return the system page size.
+static size_t
+get_page_size()
+{
+    static size_t page_size = sysconf(_SC_PAGESIZE);
+    return page_size;
+}
+#endif
+
 //#define BTREE_DEBUG_FULL 1
 #undef BTREE_DEBUG_FULL
 
@@ -159,6 +175,13 @@ static inline byte *zeroed_new(size_t size)
 
 #define BYTE_PAIR_RANGE (1 << 2 * CHAR_BIT)
 
+Glass::Mapping::~Mapping()
+{
+#ifdef HAVE_MMAP
+    (void)munmap(addr, size);
+#endif
+}
+
 /// read_block(n, p) reads block n of the DB file to address p.
 void
 GlassTable::read_block(uint4 n, byte * p) const
@@ -169,7 +192,11 @@ GlassTable::read_block(uint4 n, byte * p) const
 	GlassTable::throw_database_closed();
     AssertRel(n,<,free_list.get_first_unused_block());
 
-    io_read_block(handle, reinterpret_cast<char *>(p), block_size, n, offset);
+    if (n < mapped_block_count) {
+	memcpy(p, mapped_blocks + size_t(n) * block_size, block_size);
+    } else {
+	read_block_from_file(n, p);
+    }
 
     if (GET_LEVEL(p) != LEVEL_FREELIST) {
 	int dir_end = DIR_END(p);
@@ -181,6 +208,73 @@ GlassTable::read_block(uint4 n, byte * p) const
     }
 }
 
+/// Read block n from the file to p, via the block cache if in use.
+void
+GlassTable::read_block_from_file(uint4 n, byte * p) const
+{
+    GlassBlockKey key;
+    if (use_block_cache) {
+	key = cache_key;
+	key.n = n;
+	GlassBlockCache & cache = GlassBlockCache::get_instance();
+	switch (cache.get(key, revision_number, p, block_size)) {
+	    case GlassBlockCache::HIT:
+		return;
+	    case GlassBlockCache::CHECK: {
+		// The cached copy is current unless the block has since been
+		// reused, which would have changed the revision stored at its
+		// start, so that's all we need to read.
+		byte rev_buf[4];
+		io_read_block(handle, reinterpret_cast<char *>(rev_buf), 4, 0,
+			      offset + off_t(n) * block_size);
+		if (cache.revalidate(key, revision_number, REVISION(rev_buf),
+				     p, block_size))
+		    return;
+		break;
+	    }
+	    case GlassBlockCache::MISS:
+		break;
+	}
+    }
+
+    io_read_block(handle, reinterpret_cast<char *>(p), block_size, n, offset);
+
+    // Don't cache a block newer than our revision - it may be from a writer
+    // which hasn't committed yet and so could still change in place, and
+    // we're about to reject it anyway.
+    if (use_block_cache && GET_LEVEL(p) != LEVEL_FREELIST &&
+	REVISION(p) <= revision_number) {
+	int dir_end = DIR_END(p);
+	// Leave read_block() to report a corrupt block.
+	if (usual(dir_end >= DIR_START && unsigned(dir_end) <= block_size))
+	    GlassBlockCache::get_instance().add(key, revision_number, p,
+						block_size);
+    }
+}
+
+/** Load block n into cursor cur.
+ *
+ *  If the table is memory mapped, the cursor is pointed at the block in the
+ *  mapping rather than the block being copied.
+ */
+const byte *
+GlassTable::load_block(Glass::Cursor & cur, uint4 n) const
+{
+    if (n < mapped_block_count) {
+	const byte * p = mapped_blocks + size_t(n) * block_size;
+	int dir_end = DIR_END(p);
+	if (rare(dir_end < DIR_START || unsigned(dir_end) > block_size)) {
+	    string msg("dir_end invalid in block ");
+	    msg += str(n);
+	    throw Xapian::DatabaseCorruptError(msg);
+	}
+	return cur.init_mapped(mapping.get(), p);
+    }
+    byte * q = cur.init(block_size);
+    read_block(n, q);
+    return q;
+}
+
 /** write_block(n, p, appending) writes block n in the DB file from address p.
  *
  *  If appending is true (not specified it defaults to false), then this
@@ -226,47 +320,27 @@ GlassTable::write_block(uint4 n, const byte * p, bool appending) const
 
     if (!changes_obj) return;
 
-    unsigned char v;
+    Glass::table_type table;
     // FIXME: track table_type in this class?
     if (strcmp(tablename, "position") == 0) {
-	v = int(Glass::POSITION);
+	table = Glass::POSITION;
     } else if (strcmp(tablename, "postlist") == 0) {
-	v = int(Glass::POSTLIST);
+	table = Glass::POSTLIST;
     } else if (strcmp(tablename, "docdata") == 0) {
-	v = int(Glass::DOCDATA);
+	table = Glass::DOCDATA;
     } else if (strcmp(tablename, "spelling") == 0) {
-	v = int(Glass::SPELLING);
+	table = Glass::SPELLING;
     } else if (strcmp(tablename, "synonym") == 0) {
-	v = int(Glass::SYNONYM);
+	table = Glass::SYNONYM;
     } else if (strcmp(tablename, "termlist") == 0) {
-	v = int(Glass::TERMLIST);
+	table = Glass::TERMLIST;
+    } else if (strcmp(tablename, "wildcard") == 0) {
+	table = Glass::WILDCARD;
     } else {
 	return; // FIXME
     }
 
-    if (block_size == 2048) {
-	v |= 0 << 3;
-    } else if (block_size == 4096) {
-	v |= 1 << 3;
-    } else if (block_size == 8192) {
-	v |= 2 << 3;
-    } else if (block_size == 16384) {
-	v |= 3 << 3;
-    } else if (block_size == 32768) {
-	v |= 4 << 3;
-    } else if (block_size == 65536) {
-	v |= 5 << 3;
-    } else {
-	return; // FIXME
-    }
-
-    string buf;
-    buf += char(v);
-    // Write the block number to the file
-    pack_uint(buf, n);
-
-    changes_obj->write_block(buf);
-    changes_obj->write_block(reinterpret_cast<const char *>(p), block_size);
+    changes_obj->write_block(table, n, p, block_size);
 }
 
 /* A note on cursors:
@@ -329,9 +403,7 @@ GlassTable::block_to_cursor(Glass::Cursor * C_, int j, uint4 n) const
     if (n == C[j].get_n()) {
 	p = C_[j].clone(C[j]);
     } else {
-	byte * q = C_[j].init(block_size);
-	read_block(n, q);
-	p = q;
+	p = load_block(C_[j], n);
 	C_[j].set_n(n);
     }
 
@@ -1403,6 +1475,52 @@ GlassTable::del(const string &key)
     RETURN(true);
 }
 
+void
+GlassTable::get_split_keys(size_t n, vector<string> & keys) const
+{
+    LOGCALL_VOID(DB, "GlassTable::get_split_keys", n | (void*)&keys);
+    keys.clear();
+    if (n <= 1 || handle < 0 || level == 0)
+	return;
+
+    // Collect the keys from a level of branch blocks, starting at the root
+    // and working down until we have several candidates for each split or
+    // reach the level above the leaves.
+    vector<string> candidates;
+    vector<uint4> blocks(1, root);
+    vector<byte> buf(block_size);
+    for (int j = level; j > 0; --j) {
+	vector<uint4> children;
+	candidates.clear();
+	for (uint4 n_block : blocks) {
+	    read_block(n_block, buf.data());
+	    const byte * p = buf.data();
+	    int dir_end = DIR_END(p);
+	    for (int c = DIR_START; c < dir_end; c += D2) {
+		BItem item(p, c);
+		children.push_back(item.block_given_by());
+		// The first key in a branch block can be null, and otherwise
+		// duplicates the key which points to the block.
+		if (c == DIR_START) continue;
+		string key;
+		item.key().read(&key);
+		candidates.push_back(key);
+	    }
+	}
+	if (candidates.size() >= n * 4) break;
+	swap(blocks, children);
+    }
+
+    if (candidates.size() < n) {
+	swap(keys, candidates);
+	return;
+    }
+    keys.reserve(n - 1);
+    for (size_t i = 1; i != n; ++i) {
+	keys.push_back(candidates[i * candidates.size() / n]);
+    }
+}
+
 bool
 GlassTable::readahead_key(const string &key) const
 {
@@ -1437,6 +1555,17 @@ GlassTable::readahead_key(const string &key) const
     // cursor.
     if (n != last_readahead && n != C[level - 1].get_n()) {
 	last_readahead = n;
+#if defined HAVE_MMAP && defined HAVE_MADVISE
+	if (n < mapped_block_count) {
+	    // madvise() needs a page-aligned address.
+	    uintptr_t start = uintptr_t(mapped_blocks + size_t(n) * block_size);
+	    uintptr_t page_offset = start % get_page_size();
+	    if (madvise(reinterpret_cast<void*>(start - page_offset),
+			block_size + page_offset, MADV_WILLNEED) != 0)
+		RETURN(false);
+	    RETURN(true);
+	}
+#endif
 	if (!io_readahead_block(handle, block_size, n, offset))
 	    RETURN(false);
     }
@@ -1746,7 +1875,12 @@ GlassTable::GlassTable(const char * tablename_, const string & path_,
 	  comp_stream(compress_strategy_),
 	  lazy(lazy_),
 	  last_readahead(BLK_UNUSED),
-	  offset(0)
+	  offset(0),
+	  use_block_cache(false),
+	  have_uuid(false),
+	  mapping(NULL),
+	  mapped_blocks(NULL),
+	  mapped_block_count(0)
 {
     LOGCALL_CTOR(DB, "GlassTable", tablename_ | path_ | readonly_ | compress_strategy_ | lazy_);
 }
@@ -1781,7 +1915,12 @@ GlassTable::GlassTable(const char * tablename_, int fd, off_t offset_,
 	  comp_stream(compress_strategy_),
 	  lazy(lazy_),
 	  last_readahead(BLK_UNUSED),
-	  offset(offset_)
+	  offset(offset_),
+	  use_block_cache(false),
+	  have_uuid(false),
+	  mapping(NULL),
+	  mapped_blocks(NULL),
+	  mapped_block_count(0)
 {
     LOGCALL_CTOR(DB, "GlassTable", tablename_ | fd | offset_ | readonly_ | compress_strategy_ | lazy_);
 }
@@ -1831,6 +1970,16 @@ GlassTable::~GlassTable() {
 void GlassTable::close(bool permanent) {
     LOGCALL_VOID(DB, "GlassTable::close", permanent);
 
+    use_block_cache = false;
+
+    if (mapping.get() && !permanent) {
+	// Cursors with blocks in the mapping hold their own references to it,
+	// so it's only unmapped once they've all moved off it.
+	mapping = NULL;
+	mapped_blocks = NULL;
+	mapped_block_count = 0;
+    }
+
     if (handle >= 0) {
 	if (single_file()) {
 	    handle = -3 - handle;
@@ -1990,6 +2139,30 @@ GlassTable::cancel(const RootInfo & root_info, glass_revision_number_t rev)
 
 /************ B-tree reading ************/
 
+void
+GlassTable::map_file()
+{
+    LOGCALL_VOID(DB, "GlassTable::map_file", NO_ARGS);
+#ifdef HAVE_MMAP
+    struct stat sb;
+    if (fstat(handle, &sb) < 0 || sb.st_size <= offset)
+	return;
+
+    // The offset passed to mmap() must be a multiple of the page size, but a
+    // table in a single-file database need not start on a page boundary.
+    off_t start = offset - offset % get_page_size();
+    size_t len = sb.st_size - start;
+    void * p = mmap(NULL, len, PROT_READ, MAP_SHARED, handle, start);
+    if (p == MAP_FAILED) {
+	// Just fall back to reading blocks with pread().
+	return;
+    }
+    mapping = new Glass::Mapping(p, len);
+    mapped_blocks = static_cast<const byte *>(p) + (offset - start);
+    mapped_block_count = (sb.st_size - offset) / block_size;
+#endif
+}
+
 void
 GlassTable::do_open_to_read(const RootInfo * root_info,
 			    glass_revision_number_t rev)
@@ -2016,6 +2189,25 @@ GlassTable::do_open_to_read(const RootInfo * root_info,
 	}
     }
 
+    if (flags == Xapian::DB_READONLY_MMAP_)
+	map_file();
+
+    // Blocks read by a writer may be stale versions of blocks it has since
+    // modified, so only tables opened read-only share the block cache.  There's
+    // no point caching blocks we can access directly in a mapping.
+    use_block_cache = false;
+    if (have_uuid && !mapping.get() && GlassBlockCache::get_instance().enabled()) {
+	struct stat sb;
+	// Some platforms (e.g. Windows) don't give a meaningful inode number,
+	// in which case we can't safely identify the file.
+	if (fstat(handle, &sb) == 0 && sb.st_ino != 0) {
+	    cache_key.dev = sb.st_dev;
+	    cache_key.ino = sb.st_ino;
+	    cache_key.offset = offset;
+	    use_block_cache = true;
+	}
+    }
+
     basic_open(root_info, rev);
 
     read_root();
@@ -2074,9 +2266,7 @@ GlassTable::prev_for_sequential(Glass::Cursor * C_, int /*dummy*/) const
 		// Block isn't in the built-in cursor, so the form on disk
 		// is valid, so read it to check if it's the next level 0
 		// block.
-		byte * q = C_[0].init(block_size);
-		read_block(n, q);
-		p = q;
+		p = load_block(C_[0], n);
 		C_[0].set_n(n);
 	    }
 	    if (REVISION(p) > revision_number + writable) {
@@ -2133,9 +2323,7 @@ GlassTable::next_for_sequential(Glass::Cursor * C_, int /*dummy*/) const
 		    p = q;
 		}
 	    } else {
-		byte * q = C_[0].init(block_size);
-		read_block(n, q);
-		p = q;
+		p = load_block(C_[0], n);
 	    }
 	    if (REVISION(p) > revision_number + writable) {
 		set_overwritten();
@@ -27,6 +27,7 @@
 #include <xapian/constants.h>
 #include <xapian/error.h>
 
+#include "glass_blockcache.h"
 #include "glass_freelist.h"
 #include "glass_cursor.h"
 #include "glass_defs.h"
@@ -41,7 +42,10 @@
 #include "common/compression_stream.h"
 
 #include <algorithm>
+#include <cstring>
 #include <string>
+#include <utility>
+#include <vector>
 
 #define DONT_COMPRESS -1
 
@@ -628,6 +632,18 @@ class GlassTable {
 	    return item_count;
 	}
 
+	/** Find keys which split the table into roughly equal parts.
+	 *
+	 *  The keys are taken from the committed branch blocks, so this
+	 *  doesn't need to read the leaf blocks.  The keys returned are in
+	 *  ascending order and needn't exist in the table.
+	 *
+	 *  @param n	The number of parts wanted.
+	 *  @param keys	Vector to return at most @a n - 1 keys in (fewer if
+	 *		the table is small).
+	 */
+	void get_split_keys(size_t n, std::vector<std::string> & keys) const;
+
 	/// Return true if there are no entries in the table.
 	bool empty() const {
 	    return (item_count == 0);
@@ -669,6 +685,16 @@ class GlassTable {
 	    changes_obj = changes;
 	}
 
+	/** Set the UUID of the database this table belongs to.
+	 *
+	 *  This needs to be called before open() for a read-only table to use
+	 *  the process-wide block cache.
+	 */
+	void set_uuid(const char * uuid) {
+	    std::memcpy(cache_key.uuid, uuid, sizeof(cache_key.uuid));
+	    have_uuid = true;
+	}
+
 	/// Throw an exception indicating that the database is closed.
 	XAPIAN_NORETURN(static void throw_database_closed());
 
@@ -691,6 +717,9 @@ class GlassTable {
 	bool find(Glass::Cursor *) const;
 	int delete_kt();
 	void read_block(uint4 n, byte *p) const;
+	void read_block_from_file(uint4 n, byte *p) const;
+	const byte * load_block(Glass::Cursor & cur, uint4 n) const;
+	void map_file();
 	void write_block(uint4 n, const byte *p, bool appending = false) const;
 	XAPIAN_NORETURN(void set_overwritten() const);
 	void block_to_cursor(Glass::Cursor *C_, int j, uint4 n) const;
@@ -858,6 +887,36 @@ class GlassTable {
 	/// offset to start of table in file.
 	off_t offset;
 
+	/** True if blocks are read via the process-wide GlassBlockCache.
+	 *
+	 *  Only set for tables opened read-only.
+	 */
+	bool use_block_cache;
+
+	/// True if set_uuid() has been called.
+	bool have_uuid;
+
+	/// Identifies this table's file in the block cache.
+	GlassBlockKey cache_key;
+
+	/** Memory mapping of the table's file, or NULL if not mapped.
+	 *
+	 *  Only used if the table was opened with Xapian::DB_MMAP.  Cursors
+	 *  with blocks in the mapping hold a reference to it, so it stays
+	 *  mapped after the table is reopened until they move off it.
+	 */
+	Xapian::Internal::intrusive_ptr<Glass::Mapping> mapping;
+
+	/// Pointer to block 0 of the table in mapping.
+	const byte * mapped_blocks;
+
+	/** Number of blocks of the table in mapping.
+	 *
+	 *  Blocks past the end of the mapping (which may have been added since
+	 *  the table was opened) are read from the file as usual.
+	 */
+	uint4 mapped_block_count;
+
 	/* Debugging methods */
 //	void report_block_full(int m, int n, const byte * p);
 };
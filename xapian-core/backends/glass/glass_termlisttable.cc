@@ -43,17 +43,28 @@ GlassTermListTable::set_termlist(Xapian::docid did,
     LOGCALL_VOID(DB, "GlassTermListTable::set_termlist", did | doc | doclen);
 
     string tag;
-    pack_uint(tag, doclen);
+    encode_termlist(tag, doc, doclen);
+    add(make_key(did), tag);
+}
 
+void
+GlassTermListTable::encode_termlist(string & tag,
+				    const Xapian::Document & doc,
+				    Xapian::termcount doclen)
+{
+    LOGCALL_STATIC_VOID(DB, "GlassTermListTable::encode_termlist", tag | doc | doclen);
+
+    tag.resize(0);
     Xapian::doccount termlist_size = doc.termlist_count();
     if (termlist_size == 0) {
 	// doclen is sum(wdf) so should be zero if there are no terms.
 	Assert(doclen == 0);
 	Assert(doc.termlist_begin() == doc.termlist_end());
-	add(make_key(did), string());
 	return;
     }
 
+    pack_uint(tag, doclen);
+
     Xapian::TermIterator t = doc.termlist_begin();
     if (t != doc.termlist_end()) {
 	pack_uint(tag, termlist_size);
@@ -105,5 +116,4 @@ GlassTermListTable::set_termlist(Xapian::docid did,
 	}
     }
     Assert(termlist_size == 0);
-    add(make_key(did), tag);
 }
@@ -69,6 +69,29 @@ class GlassTermListTable : public GlassTable {
     void set_termlist(Xapian::docid did, const Xapian::Document & doc,
 		      Xapian::termcount doclen);
 
+    /** Encode the termlist data for a document.
+     *
+     *  This doesn't access the table, so may be called from any thread.
+     *
+     *  @param tag	String to store the encoded termlist data in.
+     *  @param doc	The Xapian::Document object to read term data from.
+     *  @param doclen	The document length.
+     */
+    static void encode_termlist(std::string & tag,
+				const Xapian::Document & doc,
+				Xapian::termcount doclen);
+
+    /** Set the termlist data for document @a did from encode_termlist().
+     *
+     *  Any existing data is replaced.
+     *
+     *  @param did	The docid to set the termlist data for.
+     *  @param tag	The encoded termlist data.
+     */
+    void set_encoded_termlist(Xapian::docid did, const std::string & tag) {
+	add(make_key(did), tag);
+    }
+
     /** Delete the termlist data for document @a did.
      *
      *  @param did  The docid to delete the termlist data for.
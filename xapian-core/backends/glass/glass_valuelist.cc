@@ -42,6 +42,26 @@ GlassValueList::update_reader()
     return true;
 }
 
+bool
+GlassValueList::skip_chunks_outside(const string & lo, const string & hi)
+{
+    while (cursor) {
+	const string & chunk_lo = reader.get_lower_bound();
+	const string & chunk_hi = reader.get_upper_bound();
+	if (chunk_hi >= lo && (hi.empty() || chunk_lo <= hi)) {
+	    return chunk_lo >= lo && (hi.empty() || chunk_hi <= hi);
+	}
+
+	// No value in this chunk can be in the range.
+	if (!cursor->next() || !update_reader()) {
+	    // We've reached the end.
+	    delete cursor;
+	    cursor = NULL;
+	}
+    }
+    return false;
+}
+
 GlassValueList::~GlassValueList()
 {
     delete cursor;
@@ -162,6 +182,21 @@ GlassValueList::check(Xapian::docid did)
     return true;
 }
 
+bool
+GlassValueList::next_in_range(const string & lo, const string & hi)
+{
+    next();
+    return skip_chunks_outside(lo, hi);
+}
+
+bool
+GlassValueList::skip_to_in_range(Xapian::docid did,
+				 const string & lo, const string & hi)
+{
+    skip_to(did);
+    return skip_chunks_outside(lo, hi);
+}
+
 string
 GlassValueList::get_description() const
 {
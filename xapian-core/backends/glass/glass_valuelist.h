@@ -46,6 +46,12 @@ class GlassValueList : public Xapian::ValueIterator::Internal {
     /// Update @a reader to use the chunk currently pointed to by @a cursor.
     bool update_reader();
 
+    /** Skip over any chunks which contain no values in a range.
+     *
+     *  @return true if all the values in the current chunk are in the range.
+     */
+    bool skip_chunks_outside(const std::string & lo, const std::string & hi);
+
   public:
     GlassValueList(Xapian::valueno slot_,
 		   Xapian::Internal::intrusive_ptr<const GlassDatabase> db_)
@@ -67,6 +73,11 @@ class GlassValueList : public Xapian::ValueIterator::Internal {
 
     bool check(Xapian::docid did);
 
+    bool next_in_range(const std::string & lo, const std::string & hi);
+
+    bool skip_to_in_range(Xapian::docid did,
+			  const std::string & lo, const std::string & hi);
+
     std::string get_description() const;
 };
 
@@ -35,6 +35,7 @@
 
 #include <algorithm>
 #include "autoptr.h"
+#include <vector>
 
 using namespace Glass;
 using namespace std;
@@ -68,12 +69,158 @@ make_valuestats_key(Xapian::valueno slot)
     RETURN(key);
 }
 
+/// Hash a docid to decide if its value is included in the sample.
+static inline uint4
+sample_hash(Xapian::docid did)
+{
+    // The finalisation step from MurmurHash3, which spreads the bits of
+    // consecutive docids.
+    uint4 h = uint4(did);
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+namespace Glass {
+
+string
+encode_valuestats(const ValueStats & stats)
+{
+    Assert(stats.freq != 0);
+    string value;
+    pack_uint(value, stats.freq);
+    pack_string(value, stats.lower_bound);
+    // We don't store or count empty values, so neither of the bounds
+    // can be empty.  So we can safely store an empty upper bound when
+    // the bounds are equal.
+    if (stats.lower_bound != stats.upper_bound) {
+	pack_string(value, stats.upper_bound);
+    } else {
+	pack_string(value, string());
+    }
+    vector<pair<Xapian::docid, string> >::const_iterator i;
+    for (i = stats.sample.begin(); i != stats.sample.end(); ++i) {
+	pack_uint(value, i->first);
+	pack_string(value, i->second);
+    }
+    return value;
+}
+
+void
+decode_valuestats(const string & tag, ValueStats & stats)
+{
+    const char * pos = tag.data();
+    const char * end = pos + tag.size();
+
+    if (!unpack_uint(&pos, end, &(stats.freq))) {
+	if (*pos == 0) throw Xapian::DatabaseCorruptError("Incomplete stats item in value table");
+	throw Xapian::RangeError("Frequency statistic in value table is too large");
+    }
+    if (!unpack_string(&pos, end, stats.lower_bound)) {
+	if (*pos == 0) throw Xapian::DatabaseCorruptError("Incomplete stats item in value table");
+	throw Xapian::RangeError("Lower bound in value table is too large");
+    }
+    if (!unpack_string(&pos, end, stats.upper_bound)) {
+	if (*pos == 0) throw Xapian::DatabaseCorruptError("Incomplete stats item in value table");
+	throw Xapian::RangeError("Upper bound in value table is too large");
+    }
+    if (stats.upper_bound.empty()) {
+	stats.upper_bound = stats.lower_bound;
+    }
+    stats.sample.clear();
+    while (pos != end) {
+	Xapian::docid did;
+	string value;
+	if (!unpack_uint(&pos, end, &did) ||
+	    !unpack_string(&pos, end, value)) {
+	    throw Xapian::DatabaseCorruptError("Bad value sample in value table");
+	}
+	stats.sample.push_back(make_pair(did, value));
+    }
+}
+
+void
+add_to_valuestats_sample(ValueStats & stats,
+			 Xapian::docid did, const string & value)
+{
+    // The sample is kept in ascending order of docid hash.
+    vector<pair<Xapian::docid, string> > & sample = stats.sample;
+    uint4 h = sample_hash(did);
+    vector<pair<Xapian::docid, string> >::iterator i = sample.begin();
+    while (i != sample.end() && sample_hash(i->first) < h) ++i;
+    if (i != sample.end() && i->first == did) {
+	i->second = value;
+	return;
+    }
+    if (i == sample.end() && sample.size() >= GLASS_VALUESTATS_SAMPLE_SIZE)
+	return;
+    sample.insert(i, make_pair(did, value));
+    if (sample.size() > GLASS_VALUESTATS_SAMPLE_SIZE)
+	sample.pop_back();
+}
+
+void
+remove_from_valuestats_sample(ValueStats & stats, Xapian::docid did)
+{
+    vector<pair<Xapian::docid, string> > & sample = stats.sample;
+    vector<pair<Xapian::docid, string> >::iterator i;
+    for (i = sample.begin(); i != sample.end(); ++i) {
+	if (i->first == did) {
+	    sample.erase(i);
+	    return;
+	}
+    }
+}
+
+bool
+valuestats_sample_is_ordered(const ValueStats & stats)
+{
+    const vector<pair<Xapian::docid, string> > & sample = stats.sample;
+    for (size_t i = 1; i < sample.size(); ++i) {
+	if (sample_hash(sample[i - 1].first) >= sample_hash(sample[i].first))
+	    return false;
+    }
+    return true;
+}
+
+Xapian::doccount
+estimate_value_freq(const ValueStats & stats,
+		    const string & lo, const string & hi)
+{
+    if (stats.freq == 0) return 0;
+    if (lo > stats.upper_bound || (!hi.empty() && hi < stats.lower_bound))
+	return 0;
+    if (lo <= stats.lower_bound && (hi.empty() || hi >= stats.upper_bound))
+	return stats.freq;
+    const vector<pair<Xapian::docid, string> > & sample = stats.sample;
+    if (sample.empty()) return stats.freq / 2;
+
+    size_t count = 0;
+    vector<pair<Xapian::docid, string> >::const_iterator i;
+    for (i = sample.begin(); i != sample.end(); ++i) {
+	const string & v = i->second;
+	if (v >= lo && (hi.empty() || v <= hi)) ++count;
+    }
+    // The range doesn't cover all the values, so don't let the estimate
+    // reach 0 or freq just because the sample is small.
+    double est = (count + 0.5) * stats.freq / (sample.size() + 1);
+    return Xapian::doccount(est + 0.5);
+}
+
+}
+
 void
 ValueChunkReader::assign(const char * p_, size_t len, Xapian::docid did_)
 {
     p = p_;
     end = p_ + len;
     did = did_;
+    if (!unpack_string(&p, end, lower_bound) ||
+	!unpack_string(&p, end, upper_bound))
+	throw Xapian::DatabaseCorruptError("Failed to unpack value chunk bounds");
     if (!unpack_string(&p, end, value))
 	throw Xapian::DatabaseCorruptError("Failed to unpack first value");
 }
@@ -129,6 +276,22 @@ ValueChunkReader::skip_to(Xapian::docid target)
     p = NULL;
 }
 
+void
+GlassValueManager::set_change(map<Xapian::docid, string> & slot_changes,
+			      Xapian::docid did, const string & val)
+{
+    pair<map<Xapian::docid, string>::iterator, bool> r;
+    r = slot_changes.insert(make_pair(did, val));
+    if (r.second) {
+	changes_memory += GLASS_MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+			  sizeof(string) + val.size();
+    } else {
+	changes_memory += val.size();
+	changes_memory -= r.first->second.size();
+	r.first->second = val;
+    }
+}
+
 void
 GlassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
 			     const string & val)
@@ -138,7 +301,7 @@ GlassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
     if (i == changes.end()) {
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
-    i->second[did] = val;
+    set_change(i->second, did, val);
 }
 
 void
@@ -149,7 +312,7 @@ GlassValueManager::remove_value(Xapian::docid did, Xapian::valueno slot)
     if (i == changes.end()) {
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
-    i->second[did] = string();
+    set_change(i->second, did, string());
 }
 
 Xapian::docid
@@ -214,13 +377,26 @@ class ValueUpdater {
 
     Xapian::docid last_allowed_did;
 
+    /// Lower bound on the values in tag.
+    string lower_bound;
+
+    /// Upper bound on the values in tag.
+    string upper_bound;
+
     void append_to_stream(Xapian::docid did, const string & value) {
 	Assert(did);
 	if (tag.empty()) {
 	    new_first_did = did;
+	    lower_bound = value;
+	    upper_bound = value;
 	} else {
 	    AssertRel(did,>,prev_did);
 	    pack_uint(tag, did - prev_did - 1);
+	    if (value < lower_bound) {
+		lower_bound = value;
+	    } else if (value > upper_bound) {
+		upper_bound = value;
+	    }
 	}
 	prev_did = did;
 	pack_string(tag, value);
@@ -233,7 +409,13 @@ class ValueUpdater {
 	    table->del(make_valuechunk_key(slot, first_did));
 	}
 	if (!tag.empty()) {
-	    table->add(make_valuechunk_key(slot, new_first_did), tag);
+	    // The chunk starts with bounds on the values it contains, which
+	    // allows range filters to skip over whole chunks.
+	    string chunk;
+	    pack_string(chunk, lower_bound);
+	    pack_string(chunk, upper_bound);
+	    chunk += tag;
+	    table->add(make_valuechunk_key(slot, new_first_did), chunk);
 	}
 	first_did = 0;
 	tag.resize(0);
@@ -351,6 +533,7 @@ GlassValueManager::merge_changes()
 	    }
 	}
 	changes.clear();
+	changes_memory = 0;
     }
 }
 
@@ -390,6 +573,7 @@ GlassValueManager::add_document(Xapian::docid did, const Xapian::Document &doc,
                 stats.upper_bound = value;
             }
         }
+	add_to_valuestats_sample(stats, did, value);
 
 	add_value(did, slot, value);
 	if (termlist_table->is_open()) {
@@ -441,8 +625,9 @@ GlassValueManager::delete_document(Xapian::docid did,
         // Now, modify the stored statistics.
         AssertRelParanoid(stats.freq, >, 0);
         if (--(stats.freq) == 0) {
-            stats.lower_bound.resize(0);
-            stats.upper_bound.resize(0);
+            stats.clear();
+        } else {
+            remove_from_valuestats_sample(stats, did);
         }
  
 	remove_value(did, slot);
@@ -538,23 +723,7 @@ GlassValueManager::get_value_stats(Xapian::valueno slot, ValueStats & stats) con
 
     string tag;
     if (postlist_table->get_exact_entry(make_valuestats_key(slot), tag)) {
-	const char * pos = tag.data();
-	const char * end = pos + tag.size();
-
-	if (!unpack_uint(&pos, end, &(stats.freq))) {
-	    if (*pos == 0) throw Xapian::DatabaseCorruptError("Incomplete stats item in value table");
-	    throw Xapian::RangeError("Frequency statistic in value table is too large");
-	}
-	if (!unpack_string(&pos, end, stats.lower_bound)) {
-	    if (*pos == 0) throw Xapian::DatabaseCorruptError("Incomplete stats item in value table");
-	    throw Xapian::RangeError("Lower bound in value table is too large");
-	}
-	size_t len = end - pos;
-	if (len == 0) {
-	    stats.upper_bound = stats.lower_bound;
-	} else {
-	    stats.upper_bound.assign(pos, len);
-	}
+	decode_valuestats(tag, stats);
     } else {
 	stats.clear();
     }
@@ -571,15 +740,7 @@ GlassValueManager::set_value_stats(map<Xapian::valueno, ValueStats> & value_stat
 	string key = make_valuestats_key(i->first);
 	const ValueStats & stats = i->second;
 	if (stats.freq != 0) {
-	    string new_value;
-	    pack_uint(new_value, stats.freq);
-	    pack_string(new_value, stats.lower_bound);
-	    // We don't store or count empty values, so neither of the bounds
-	    // can be empty.  So we can safely store an empty upper bound when
-	    // the bounds are equal.
-	    if (stats.lower_bound != stats.upper_bound)
-		new_value += stats.upper_bound;
-	    postlist_table->add(key, new_value);
+	    postlist_table->add(key, encode_valuestats(stats));
 	} else {
 	    postlist_table->del(key);
 	}
@@ -22,6 +22,7 @@
 #ifndef XAPIAN_INCLUDED_GLASS_VALUES_H
 #define XAPIAN_INCLUDED_GLASS_VALUES_H
 
+#include "glass_defs.h"
 #include "pack.h"
 #include "backends/valuestats.h"
 
@@ -64,6 +65,48 @@ docid_from_key(Xapian::valueno required_slot, const std::string & key)
     return did;
 }
 
+/** Encode the statistics for a value slot.
+ *
+ *  @param stats	The statistics to encode.  stats.freq must be non-zero.
+ */
+std::string encode_valuestats(const ValueStats & stats);
+
+/** Decode the statistics for a value slot.
+ *
+ *  @param tag		The encoded statistics.
+ *  @param stats	ValueStats object to fill in.
+ */
+void decode_valuestats(const std::string & tag, ValueStats & stats);
+
+/** Update the sample of values for a slot when a value is added.
+ *
+ *  The sample holds the values for the documents whose docids have the
+ *  lowest hash values, so it's a deterministic sample which isn't upset by
+ *  documents being replaced.
+ */
+void add_to_valuestats_sample(ValueStats & stats,
+			      Xapian::docid did, const std::string & value);
+
+/// Update the sample of values for a slot when a value is removed.
+void remove_from_valuestats_sample(ValueStats & stats, Xapian::docid did);
+
+/// Check the sample is in the order add_to_valuestats_sample() keeps it in.
+bool valuestats_sample_is_ordered(const ValueStats & stats);
+
+/** Estimate how many documents have a value in a range.
+ *
+ *  The sorted sample of values is in effect an equi-depth histogram, so we
+ *  estimate from the proportion of the sampled values in the range.
+ *
+ *  @param stats	The statistics for the value slot.
+ *  @param lo		The lower bound of the range.
+ *  @param hi		The upper bound of the range, or empty for no upper
+ *			bound.
+ */
+Xapian::doccount estimate_value_freq(const ValueStats & stats,
+				     const std::string & lo,
+				     const std::string & hi);
+
 }
 
 namespace Xapian {
@@ -72,7 +115,6 @@ namespace Xapian {
 
 class GlassPostListTable;
 class GlassTermListTable;
-struct ValueStats;
 
 class GlassValueManager {
     /** The value number for the most recently used value statistics.
@@ -93,8 +135,15 @@ class GlassValueManager {
 
     std::map<Xapian::valueno, std::map<Xapian::docid, std::string> > changes;
 
+    /// Approximate memory used by the entries in changes.
+    size_t changes_memory;
+
     mutable AutoPtr<GlassCursor> cursor;
 
+    /// Record the new value for @a did in the changes for a slot.
+    void set_change(std::map<Xapian::docid, std::string> & slot_changes,
+		    Xapian::docid did, const std::string & val);
+
     void add_value(Xapian::docid did, Xapian::valueno slot,
 		   const std::string & val);
 
@@ -115,7 +164,8 @@ class GlassValueManager {
 		      GlassTermListTable * termlist_table_)
 	: mru_slot(Xapian::BAD_VALUENO),
 	  postlist_table(postlist_table_),
-	  termlist_table(termlist_table_) { }
+	  termlist_table(termlist_table_),
+	  changes_memory(0) { }
 
     // Merge in batched-up changes.
     void merge_changes();
@@ -149,6 +199,13 @@ class GlassValueManager {
 	return mru_valstats.upper_bound;
     }
 
+    Xapian::doccount estimate_value_freq(Xapian::valueno slot,
+					 const std::string & lo,
+					 const std::string & hi) const {
+	if (mru_slot != slot) get_value_stats(slot);
+	return Glass::estimate_value_freq(mru_valstats, lo, hi);
+    }
+
     /** Write the updated statistics to the table.
      *
      *  If the @a freq member of the statistics for a particular slot is 0, the
@@ -167,10 +224,18 @@ class GlassValueManager {
 	return !changes.empty();
     }
 
+    /// Get the approximate memory used by the batched-up changes.
+    size_t get_memory_used() const {
+	return changes_memory +
+	       slots.size() * (GLASS_MAP_ENTRY_OVERHEAD +
+			       sizeof(Xapian::docid) + sizeof(std::string));
+    }
+
     void cancel() {
 	// Discard batched-up changes.
 	slots.clear();
 	changes.clear();
+	changes_memory = 0;
     }
 };
 
@@ -184,6 +249,12 @@ class ValueChunkReader {
 
     std::string value;
 
+    /// Lower bound on the values in this chunk.
+    std::string lower_bound;
+
+    /// Upper bound on the values in this chunk.
+    std::string upper_bound;
+
   public:
     /// Create a ValueChunkReader which is already at_end().
     ValueChunkReader() : p(NULL) { }
@@ -200,6 +271,12 @@ class ValueChunkReader {
 
     const std::string & get_value() const { return value; }
 
+    /// Get a lower bound on the values in this chunk.
+    const std::string & get_lower_bound() const { return lower_bound; }
+
+    /// Get an upper bound on the values in this chunk.
+    const std::string & get_upper_bound() const { return upper_bound; }
+
     void next();
 
     void skip_to(Xapian::docid target);
@@ -49,7 +49,15 @@
 using namespace std;
 
 /// Glass format version (date of change):
-#define GLASS_FORMAT_VERSION DATE_TO_VERSION(2015,12,24)
+#define GLASS_FORMAT_VERSION DATE_TO_VERSION(2016,1,8)
+// 2016,1,8 1.3.4 Postlist chunk headers store the largest wdf in the chunk
+// 2016,1,7 1.3.4 Postlist chunks optionally stored as bit-packed blocks
+// 2016,1,6 1.3.4 Optional deletion index in the spelling table
+// 2016,1,5 1.3.4 Optional wildcard table
+// 2016,1,4 1.3.4 Dense postlist chunks with a single wdf stored as bitmaps
+// 2015,12,31 1.3.4 Value stats store a sample of the values in the slot
+// 2015,12,30 1.3.4 Value chunks start with bounds on the values they contain
+// 2015,12,29 1.3.4 Position lists with >64 entries split into blocks with skip pointers
 // 2015,12,24 1.3.4 2 bytes "components_of" per item eliminated, and much more
 // 2014,11,21 1.3.2 Brass renamed to Glass
 
@@ -92,9 +100,9 @@ GlassVersion::~GlassVersion()
 }
 
 void
-GlassVersion::read()
+GlassVersion::read(string * raw)
 {
-    LOGCALL_VOID(DB, "GlassVersion::read", NO_ARGS);
+    LOGCALL_VOID(DB, "GlassVersion::read", raw);
     FD close_fd(-1);
     int fd_in;
     if (single_file()) {
@@ -120,6 +128,7 @@ GlassVersion::read()
 
     const char * p = buf;
     const char * end = p + io_read(fd_in, buf, sizeof(buf), 33);
+    if (raw) raw->assign(buf, end - buf);
 
     if (memcmp(buf, GLASS_VERSION_MAGIC, GLASS_VERSION_MAGIC_LEN) != 0)
 	throw Xapian::DatabaseCorruptError("Rev file magic incorrect");
@@ -307,14 +316,8 @@ GlassVersion::write(glass_revision_number_t new_rev, int flags)
 	throw;
     }
 
-    if (changes) {
-	string changes_buf;
-	changes_buf += '\xfe';
-	pack_uint(changes_buf, new_rev);
-	pack_uint(changes_buf, s.size());
-	changes->write_block(changes_buf);
-	changes->write_block(s);
-    }
+    if (changes)
+	changes->write_version_file(new_rev, s);
 
     RETURN(tmpfile);
 }
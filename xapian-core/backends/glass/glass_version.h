@@ -172,8 +172,12 @@ class GlassVersion {
     /** Read the version file and check it's a version we understand.
      *
      *  On failure, an exception is thrown.
+     *
+     *  @param raw	If non-NULL, the raw contents of the version file are
+     *			stored here (for a single-file database this will
+     *			include some data which follows it).
      */
-    void read();
+    void read(std::string * raw = NULL);
 
     void cancel();
 
@@ -0,0 +1,191 @@
+/** @file glass_wildcard.cc
+ * @brief N-gram index of terms for wildcard expansion in a glass database.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "glass_wildcard.h"
+
+#include "api/wildcardpattern.h"
+#include "debuglog.h"
+#include "omassert.h"
+#include "phrasebigrams.h"
+
+#include "../prefix_compressed_strings.h"
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace Glass;
+using namespace std;
+
+void
+GlassWildcardTable::merge_changes()
+{
+    map<fragment, set<string> >::const_iterator i;
+    for (i = termlist_deltas.begin(); i != termlist_deltas.end(); ++i) {
+	string key = i->first;
+	const set<string> & changes = i->second;
+
+	set<string>::const_iterator d = changes.begin();
+	if (d == changes.end()) continue;
+
+	string updated;
+	string current;
+	PrefixCompressedStringWriter out(updated);
+	if (get_exact_entry(key, current)) {
+	    PrefixCompressedStringItor in(current);
+	    updated.reserve(current.size());
+	    while (!in.at_end() && d != changes.end()) {
+		const string & term = *in;
+		int cmp = term.compare(*d);
+		if (cmp < 0) {
+		    out.append(term);
+		    ++in;
+		} else if (cmp > 0) {
+		    out.append(*d);
+		    ++d;
+		} else {
+		    // If an existing entry is in the changes list, that means
+		    // we should remove it.
+		    ++in;
+		    ++d;
+		}
+	    }
+	    while (!in.at_end()) {
+		out.append(*in++);
+	    }
+	}
+	while (d != changes.end()) {
+	    out.append(*d++);
+	}
+	if (!updated.empty()) {
+	    add(key, updated);
+	} else {
+	    del(key);
+	}
+    }
+    termlist_deltas.clear();
+}
+
+void
+GlassWildcardTable::toggle_fragment(fragment frag, const string & term)
+{
+    map<fragment, set<string> >::iterator i = termlist_deltas.find(frag);
+    if (i == termlist_deltas.end()) {
+	i = termlist_deltas.insert(make_pair(frag, set<string>())).first;
+    }
+    pair<set<string>::iterator, bool> res = i->second.insert(term);
+    if (!res.second) {
+	// term is already in the set, so remove it.
+	i->second.erase(res.first);
+    }
+}
+
+void
+GlassWildcardTable::toggle_term(const string & term)
+{
+    // Reserved terms are never wildcard expansions, so don't index them.
+    if (term.size() < 2 || is_reserved_term(term)) return;
+
+    fragment buf;
+    // Head:
+    buf[0] = 'H';
+    buf[1] = term[0];
+    buf[2] = term[1];
+    buf[3] = '\0';
+    toggle_fragment(buf, term);
+
+    // Tail:
+    buf[0] = 'T';
+    buf[1] = term[term.size() - 2];
+    buf[2] = term[term.size() - 1];
+    toggle_fragment(buf, term);
+
+    if (term.size() > 2) {
+	set<fragment> done;
+	// Middles:
+	buf[0] = 'M';
+	for (size_t start = 0; start <= term.size() - 3; ++start) {
+	    memcpy(buf.data + 1, term.data() + start, 3);
+	    // Don't toggle the same fragment twice or it will cancel out.
+	    if (done.insert(buf).second)
+		toggle_fragment(buf, term);
+	}
+    }
+}
+
+TermList *
+GlassWildcardTable::open_termlist(const WildcardPattern & pattern)
+{
+    LOGCALL(DB, TermList *, "GlassWildcardTable::open_termlist", NO_ARGS);
+    // Merge any pending changes to disk, but don't call commit() so they
+    // won't be switched live.
+    if (!termlist_deltas.empty()) merge_changes();
+
+    // If the table doesn't exist or is empty then there's no index to use.
+    if (!is_open() || empty()) RETURN(NULL);
+
+    // Work out which fragments every matching term must contain.
+    vector<string> keys;
+    const vector<string> & literals = pattern.get_literals();
+    for (size_t i = 0; i != literals.size(); ++i) {
+	const string & literal = literals[i];
+	if (literal.size() < 2) continue;
+	fragment buf;
+	buf[3] = '\0';
+	if (i == 0 && pattern.is_anchored_start()) {
+	    buf[0] = 'H';
+	    buf[1] = literal[0];
+	    buf[2] = literal[1];
+	    keys.push_back(buf);
+	}
+	if (i == literals.size() - 1 && pattern.is_anchored_end()) {
+	    buf[0] = 'T';
+	    buf[1] = literal[literal.size() - 2];
+	    buf[2] = literal[literal.size() - 1];
+	    keys.push_back(buf);
+	}
+	buf[0] = 'M';
+	for (size_t start = 0; start + 3 <= literal.size(); ++start) {
+	    memcpy(buf.data + 1, literal.data() + start, 3);
+	    keys.push_back(buf);
+	}
+    }
+    if (keys.empty()) RETURN(NULL);
+
+    // Use the shortest list - the caller checks each candidate against the
+    // pattern anyway, so there's little to gain from intersecting them.
+    string best;
+    bool have_best = false;
+    for (const string & key : keys) {
+	string data;
+	if (!get_exact_entry(key, data)) {
+	    // No term contains this fragment, so nothing can match.
+	    best.resize(0);
+	    break;
+	}
+	if (!have_best || data.size() < best.size()) {
+	    swap(best, data);
+	    have_best = true;
+	}
+    }
+    RETURN(new GlassSpellingTermList(best));
+}
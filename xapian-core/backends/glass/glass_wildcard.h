@@ -0,0 +1,111 @@
+/** @file glass_wildcard.h
+ * @brief N-gram index of terms for wildcard expansion in a glass database.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_GLASS_WILDCARD_H
+#define XAPIAN_INCLUDED_GLASS_WILDCARD_H
+
+#include "glass_lazytable.h"
+#include "glass_spelling.h"
+#include "api/termlist.h"
+
+#include <map>
+#include <set>
+#include <string>
+
+class WildcardPattern;
+
+/** Table mapping trigrams to the terms which contain them.
+ *
+ *  This uses the same keys and encoding as the fragment lists in the
+ *  spelling table: 'H' + the first two bytes of the term, 'T' + the last two
+ *  bytes, and 'M' + each three byte sequence in the term, each mapping to a
+ *  sorted, prefix-compressed list of terms.  Terms shorter than two bytes
+ *  aren't indexed.
+ */
+class GlassWildcardTable : public GlassLazyTable {
+    void toggle_fragment(Glass::fragment frag, const std::string & term);
+
+    /** Changes to make to the term lists.
+     *
+     *  This list is essentially xor-ed with the list on disk, so an entry
+     *  here either means a new entry needs to be added on disk, or an
+     *  existing entry on disk needs to be removed.
+     */
+    std::map<Glass::fragment, std::set<std::string> > termlist_deltas;
+
+  public:
+    /** Create a new GlassWildcardTable object.
+     *
+     *  This method does not create or open the table on disk - you
+     *  must call the create() or open() methods respectively!
+     *
+     *  @param dbdir		The directory the glass database is stored in.
+     *  @param readonly		true if we're opening read-only, else false.
+     */
+    GlassWildcardTable(const std::string & dbdir, bool readonly)
+	: GlassLazyTable("wildcard", dbdir + "/wildcard.", readonly,
+			 Z_DEFAULT_STRATEGY) { }
+
+    GlassWildcardTable(int fd, off_t offset_, bool readonly)
+	: GlassLazyTable("wildcard", fd, offset_, readonly,
+			 Z_DEFAULT_STRATEGY) { }
+
+    /** Add @a term to the index, or remove it if it's already there.
+     *
+     *  Called when a term gains its first posting or loses its last one.
+     *  Reserved terms (see is_reserved_term()) are ignored.
+     */
+    void toggle_term(const std::string & term);
+
+    /// Merge in batched-up changes.
+    void merge_changes();
+
+    /** Open a list of the candidate terms for @a pattern.
+     *
+     *  Returns NULL if @a pattern doesn't have any literal runs long enough
+     *  to narrow down the candidates.
+     */
+    TermList * open_termlist(const WildcardPattern & pattern);
+
+    /** Override methods of GlassTable.
+     *
+     *  NB: these aren't virtual, but we always call them on the subclass in
+     *  cases where it matters.
+     *  @{
+     */
+
+    bool is_modified() const {
+	return !termlist_deltas.empty() || GlassTable::is_modified();
+    }
+
+    void flush_db() {
+	merge_changes();
+	GlassTable::flush_db();
+    }
+
+    void cancel(const RootInfo & root_info, glass_revision_number_t rev) {
+	// Discard batched-up changes.
+	termlist_deltas.clear();
+
+	GlassTable::cancel(root_info, rev);
+    }
+
+    // @}
+};
+
+#endif // XAPIAN_INCLUDED_GLASS_WILDCARD_H
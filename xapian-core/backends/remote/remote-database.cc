@@ -43,6 +43,7 @@
 #include "stringutils.h" // For STRINGIZE().
 #include "weight/weightinternal.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -75,6 +76,8 @@ RemoteDatabase::RemoteDatabase(int fd, double timeout_,
 	  cached_stats_valid(),
 	  mru_valstats(),
 	  mru_slot(Xapian::BAD_VALUENO),
+	  fetched_bytes(0),
+	  max_reply_size(0),
 	  timeout(timeout_)
 {
 #ifndef __WIN32__
@@ -304,15 +307,10 @@ RemoteDatabase::close()
 // during the remote match and passed across with the MSet.  So we can safely
 // ignore "lazy" here for now without any performance penalty during the match
 // process.
-Xapian::Document::Internal *
-RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
+void
+RemoteDatabase::read_document(DocContents & contents) const
 {
-    Assert(did);
-
-    send_message(MSG_DOCUMENT, encode_length(did));
-    string doc_data;
-    map<Xapian::valueno, string> values;
-    get_message(doc_data, REPLY_DOCDATA);
+    get_message(contents.data, REPLY_DOCDATA);
 
     reply_type type;
     string message;
@@ -321,12 +319,155 @@ RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
 	const char * p_end = p + message.size();
 	Xapian::valueno slot;
 	decode_length(&p, p_end, slot);
-	values.insert(make_pair(slot, string(p, p_end)));
+	contents.values.insert(make_pair(slot, string(p, p_end)));
     }
     if (type != REPLY_DONE)
 	throw_bad_message(context);
 
-    return new RemoteDocument(this, did, doc_data, values);
+    contents.size = contents.data.size();
+    map<Xapian::valueno, string>::const_iterator i;
+    for (i = contents.values.begin(); i != contents.values.end(); ++i)
+	contents.size += i->second.size();
+    max_reply_size = max(max_reply_size, contents.size);
+}
+
+Xapian::Document::Internal *
+RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
+{
+    Assert(did);
+
+    send_message(MSG_DOCUMENT, encode_length(did));
+    DocContents contents;
+    read_document(contents);
+    return new RemoteDocument(this, did, contents.data, contents.values);
+}
+
+/** The most document requests we allow to be outstanding.
+ *
+ *  The server doesn't read the next request until it has sent the replies to
+ *  the previous one, so if we sent an unlimited number of requests before
+ *  reading any replies, both ends could end up blocked writing.  The requests
+ *  are only a few bytes each, so this many will easily fit in the socket
+ *  buffers.
+ */
+const size_t MAX_PENDING_DOCS = 1000;
+
+/** The most reply data we aim to leave unread, in bytes.
+ *
+ *  If the replies to the outstanding requests fit in the socket buffers, the
+ *  server can send them all without blocking.  We can't know how big a reply
+ *  is until we read it, so we estimate using the largest reply seen so far
+ *  (or DOC_REPLY_SIZE_GUESS if that's smaller).
+ */
+const size_t MAX_PENDING_BYTES = 256 * 1024;
+
+/// Assumed minimum size of a reply to MSG_DOCUMENT, in bytes.
+const size_t DOC_REPLY_SIZE_GUESS = 4096;
+
+/// The most document data we hold in fetched_docs before we stop prefetching.
+const size_t MAX_FETCHED_BYTES = 16 * 1024 * 1024;
+
+void
+RemoteDatabase::request_document(Xapian::docid did) const
+{
+    Assert(did);
+
+    if (pending_docs.empty() && !fetched_docs.empty()) {
+	// Any documents left over from an earlier batch may be out of date.
+	fetched_docs.clear();
+	fetched_bytes = 0;
+    }
+
+    size_t max_pending =
+	MAX_PENDING_BYTES / max(max_reply_size, DOC_REPLY_SIZE_GUESS);
+    max_pending = min(max(max_pending, size_t(1)), MAX_PENDING_DOCS);
+    while (pending_docs.size() >= max_pending) {
+	if (fetched_bytes >= MAX_FETCHED_BYTES) {
+	    // collect_document() will just fetch this document when it's
+	    // asked for.
+	    return;
+	}
+	// Read the oldest reply to make room for this request.
+	read_pending_document();
+    }
+
+    // Don't use send_message() as that would discard the pending requests.
+    double end_time = RealTime::end_time(timeout);
+    link.send_message(static_cast<unsigned char>(MSG_DOCUMENT),
+		      encode_length(did), end_time);
+    pending_docs.push_back(did);
+}
+
+void
+RemoteDatabase::read_pending_document() const
+{
+    Xapian::docid did = pending_docs.front();
+    pending_docs.pop_front();
+    DocContents contents;
+    try {
+	read_document(contents);
+    } catch (const Xapian::NetworkError &) {
+	pending_docs.clear();
+	throw;
+    } catch (const Xapian::Error &) {
+	// The error will be reported if this document is collected, as we'll
+	// request it again then.
+	return;
+    }
+    DocContents & slot = fetched_docs[did];
+    fetched_bytes -= slot.size;
+    fetched_bytes += contents.size;
+    swap(slot, contents);
+}
+
+Xapian::Document::Internal *
+RemoteDatabase::collect_document(Xapian::docid did) const
+{
+    Assert(did);
+
+    map<Xapian::docid, DocContents>::iterator i = fetched_docs.find(did);
+    if (i == fetched_docs.end()) {
+	// Read replies until we get the one for did, keeping any others we
+	// read on the way as they're probably about to be collected too.
+	while (!pending_docs.empty()) {
+	    if (pending_docs.front() == did) {
+		pending_docs.pop_front();
+		DocContents contents;
+		read_document(contents);
+		return new RemoteDocument(this, did,
+					  contents.data, contents.values);
+	    }
+	    read_pending_document();
+	}
+	// We didn't request this document (or didn't read it successfully),
+	// so just fetch it.
+	return open_document(did, false);
+    }
+
+    AutoPtr<Xapian::Document::Internal> doc(
+	new RemoteDocument(this, did, i->second.data, i->second.values));
+    fetched_bytes -= i->second.size;
+    fetched_docs.erase(i);
+    return doc.release();
+}
+
+void
+RemoteDatabase::discard_pending_documents() const
+{
+    fetched_docs.clear();
+    fetched_bytes = 0;
+    while (!pending_docs.empty()) {
+	pending_docs.pop_front();
+	DocContents contents;
+	try {
+	    read_document(contents);
+	} catch (const Xapian::NetworkError &) {
+	    pending_docs.clear();
+	    throw;
+	} catch (const Xapian::Error &) {
+	    // E.g. DocNotFoundError for a document nobody collected.
+	}
+    }
 }
 
 bool
@@ -587,6 +728,11 @@ RemoteDatabase::get_message(string &result, reply_type required_type) const
 void
 RemoteDatabase::send_message(message_type type, const string &message) const
 {
+    // The server replies to messages in the order it receives them, so we
+    // need to read the replies to any pipelined requests first.
+    if (!pending_docs.empty() || !fetched_docs.empty())
+	discard_pending_documents();
+
     double end_time = RealTime::end_time(timeout);
     link.send_message(static_cast<unsigned char>(type), message, end_time);
 }
@@ -30,6 +30,9 @@
 #include "backends/valuestats.h"
 #include "xapian/weight.h"
 
+#include <deque>
+#include <map>
+
 namespace Xapian {
     class RSet;
 }
@@ -87,6 +90,48 @@ class RemoteDatabase : public Xapian::Database::Internal {
      */
     mutable Xapian::valueno mru_slot;
 
+    /** Documents requested by request_document() whose replies we haven't
+     *  read yet, in the order the requests were sent.
+     */
+    mutable std::deque<Xapian::docid> pending_docs;
+
+    /// The data and values of a document fetched from the server.
+    struct DocContents {
+	std::string data;
+	std::map<Xapian::valueno, std::string> values;
+	/// The total size of data and values in bytes.
+	size_t size;
+
+	DocContents() : size(0) { }
+    };
+
+    /** Documents read from the server before they were collected.
+     *
+     *  These are replies read while looking for the reply to a later
+     *  request, or to limit how many replies are left unread.
+     */
+    mutable std::map<Xapian::docid, DocContents> fetched_docs;
+
+    /// The total size of the documents in fetched_docs.
+    mutable size_t fetched_bytes;
+
+    /// The size of the largest MSG_DOCUMENT reply we've read.
+    mutable size_t max_reply_size;
+
+    /// Read the replies to an MSG_DOCUMENT message.
+    void read_document(DocContents & contents) const;
+
+    /// Read the reply to the oldest pending request into fetched_docs.
+    void read_pending_document() const;
+
+    /** Discard any pending document requests.
+     *
+     *  This reads and throws away the replies to any requests from
+     *  request_document() which haven't been collected, which we need to do
+     *  before we can send any other message.
+     */
+    void discard_pending_documents() const;
+
     bool update_stats(message_type msg_code = MSG_UPDATE,
 		      const std::string & body = std::string()) const;
 
@@ -201,6 +246,16 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// Get a remote document.
     Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
+    /** Request a document.
+     *
+     *  This sends the request to the server without waiting for the reply,
+     *  so requests for several documents can be pipelined.
+     */
+    void request_document(Xapian::docid did) const;
+
+    /// Collect a document requested by request_document().
+    Xapian::Document::Internal * collect_document(Xapian::docid did) const;
+
     /// Get the document count.
     Xapian::doccount get_doccount() const;
 
@@ -33,4 +33,20 @@ ValueIterator::Internal::check(Xapian::docid did)
     return true;
 }
 
+bool
+ValueIterator::Internal::next_in_range(const std::string &, const std::string &)
+{
+    next();
+    return false;
+}
+
+bool
+ValueIterator::Internal::skip_to_in_range(Xapian::docid did,
+					  const std::string &,
+					  const std::string &)
+{
+    skip_to(did);
+    return false;
+}
+
 }
@@ -92,6 +92,38 @@ class Xapian::ValueIterator::Internal : public Xapian::Internal::intrusive_base
      */
     virtual bool check(Xapian::docid did);
 
+    /** Advance to the next entry which may have a value in a range.
+     *
+     *  This acts like next(), except that backends which store bounds on
+     *  the values in each chunk of a value stream may skip over chunks which
+     *  can't contain any values in the range.  The caller still needs to
+     *  check the value at the new position, unless true is returned.
+     *
+     *  The default implementation calls next() and returns false.
+     *
+     *  @param lo	The lower bound of the range.
+     *  @param hi	The upper bound of the range, or empty for no upper
+     *			bound.
+     *
+     *  @return true if the value at the new position is known to be in the
+     *		range.
+     */
+    virtual bool next_in_range(const std::string & lo, const std::string & hi);
+
+    /** Skip forward to an entry which may have a value in a range.
+     *
+     *  This acts like skip_to() in the same way that next_in_range() acts
+     *  like next().
+     *
+     *  The default implementation calls skip_to() and returns false.
+     *
+     *  @return true if the value at the new position is known to be in the
+     *		range.
+     */
+    virtual bool skip_to_in_range(Xapian::docid did,
+				  const std::string & lo,
+				  const std::string & hi);
+
     /// Return a string description of this object.
     virtual std::string get_description() const = 0;
 };
@@ -23,6 +23,8 @@
 #define XAPIAN_INCLUDED_VALUESTATS_H
 
 #include <string>
+#include <utility>
+#include <vector>
 #include "xapian/types.h"
 
 /** Class to hold statistics for a given slot. */
@@ -40,6 +42,12 @@ struct ValueStats {
      */
     std::string upper_bound;
 
+    /** A sample of the values stored in the slot, as (docid, value) pairs.
+     *
+     *  Only some backends maintain this, and it's empty for others.
+     */
+    std::vector<std::pair<Xapian::docid, std::string> > sample;
+
     /// Construct an empty ValueStats object.
     ValueStats() : freq(0), lower_bound(), upper_bound() {}
 
@@ -49,6 +57,7 @@ struct ValueStats {
 	freq = 0;
 	lower_bound.resize(0);
 	upper_bound.resize(0);
+	sample.clear();
     }
 };
 
@@ -37,6 +37,7 @@ using namespace std;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 #define OPT_NO_RENUMBER 3
+#define OPT_THREADS 4
 
 static void show_usage() {
     cout << "Usage: " PROG_NAME " [OPTIONS] SOURCE_DATABASE... DESTINATION_DATABASE\n\n"
@@ -55,6 +56,8 @@ static void show_usage() {
 "                     option is only supported when merging databases if they\n"
 "                     have disjoint ranges of used document ids\n"
 "  -s, --single-file  Produce a single file database (not supported for chert)\n"
+"      --threads=N    Use up to N threads to compact tables in parallel (only\n"
+"                     supported for glass, and not with --single-file)\n"
 "  --help             display this help and exit\n"
 "  --version          output version information and exit" << endl;
 }
@@ -62,11 +65,19 @@ static void show_usage() {
 class MyCompactor : public Xapian::Compactor {
     bool quiet;
 
+    /// Tables may be compacted in parallel, so don't show partial lines.
+    bool threaded;
+
   public:
-    MyCompactor() : quiet(false) { }
+    MyCompactor() : quiet(false), threaded(false) { }
 
     void set_quiet(bool quiet_) { quiet = quiet_; }
 
+    void set_threads(unsigned threads) {
+	set_max_threads(threads);
+	threaded = (threads > 1);
+    }
+
     void set_status(const string & table, const string & status);
 
     string
@@ -82,7 +93,7 @@ MyCompactor::set_status(const string & table, const string & status)
 	return;
     if (!status.empty())
 	cout << '\r' << table << ": " << status << endl;
-    else
+    else if (!threaded)
 	cout << table << " ..." << flush;
 }
 
@@ -112,6 +123,7 @@ main(int argc, char **argv)
 	{"blocksize",	required_argument, 0, 'b'},
 	{"no-renumber", no_argument, 0, OPT_NO_RENUMBER},
 	{"single-file", no_argument, 0, 's'},
+	{"threads",	required_argument, 0, OPT_THREADS},
 	{"quiet",	no_argument, 0, 'q'},
 	{"help",	no_argument, 0, OPT_HELP},
 	{"version",	no_argument, 0, OPT_VERSION},
@@ -157,6 +169,16 @@ main(int argc, char **argv)
 	    case 's':
 		flags |= Xapian::DBCOMPACT_SINGLE_FILE;
 		break;
+	    case OPT_THREADS: {
+		int n = atoi(optarg);
+		if (n <= 0) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for threads, must be at least 1" << endl;
+		    exit(1);
+		}
+		compactor.set_threads(n);
+		break;
+	    }
 	    case 'q':
 		compactor.set_quiet(true);
 		break;
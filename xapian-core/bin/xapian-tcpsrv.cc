@@ -56,13 +56,14 @@ const int MSECS_ACTIVE_TIMEOUT_DEFAULT = 15000;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 
-static const char * opts = "I:p:a:i:t:oqw";
+static const char * opts = "I:p:a:i:t:T:oqw";
 static const struct option long_opts[] = {
     {"interface",	required_argument,	0, 'I'},
     {"port",		required_argument,	0, 'p'},
     {"active-timeout",	required_argument,	0, 'a'},
     {"idle-timeout",	required_argument,	0, 'i'},
     {"timeout",		required_argument,	0, 't'},
+    {"threads",		required_argument,	0, 'T'},
     {"one-shot",	no_argument,		0, 'o'},
     {"quiet",		no_argument,		0, 'q'},
     {"writable",	no_argument,		0, 'w'},
@@ -80,6 +81,9 @@ static void show_usage() {
 "  --idle-timeout MSECS    set timeout for idle connections (default " STRINGIZE(MSECS_IDLE_TIMEOUT_DEFAULT) "ms)\n"
 "  --active-timeout MSECS  set timeout for active connections (default " STRINGIZE(MSECS_ACTIVE_TIMEOUT_DEFAULT) "ms)\n"
 "  --timeout MSECS         set both timeout values\n"
+"  --threads N             serve up to N connections at once using threads in\n"
+"                          this process, reusing opened databases, rather than\n"
+"                          forking a process for each connection\n"
 "  --one-shot              serve a single connection and exit\n"
 "  --quiet                 disable information messages to stdout\n"
 "  --writable              allow updates (only one database directory allowed)\n"
@@ -93,6 +97,7 @@ int main(int argc, char **argv) {
     double active_timeout = MSECS_ACTIVE_TIMEOUT_DEFAULT * 1e-3;
     double idle_timeout   = MSECS_IDLE_TIMEOUT_DEFAULT * 1e-3;
 
+    unsigned num_threads = 0;
     bool one_shot = false;
     bool verbose = true;
     bool writable = false;
@@ -129,6 +134,16 @@ int main(int argc, char **argv) {
 	    case 't':
 		active_timeout = idle_timeout = atoi(optarg) * 1e-3;
 		break;
+	    case 'T': {
+		int n = atoi(optarg);
+		if (n <= 0) {
+		    cerr << "Error: --threads must be at least 1.  "
+			    "We actually got " << optarg << endl;
+		    exit(1);
+		}
+		num_threads = n;
+		break;
+	    }
 	    case 'o':
 		one_shot = true;
 		break;
@@ -192,6 +207,8 @@ int main(int argc, char **argv) {
 
 	if (one_shot) {
 	    server.run_once();
+	} else if (num_threads) {
+	    server.run_threads(num_threads);
 	} else {
 	    server.run();
 	}
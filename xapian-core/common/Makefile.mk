@@ -20,6 +20,7 @@ noinst_HEADERS +=\
 	common/output.h\
 	common/output-internal.h\
 	common/pack.h\
+	common/phrasebigrams.h\
 	common/posixy_wrapper.h\
 	common/pretty.h\
 	common/realtime.h\
@@ -23,6 +23,7 @@
 
 #include "bitstream.h"
 
+#include <xapian/error.h>
 #include <xapian/types.h>
 
 #include "omassert.h"
@@ -156,17 +157,17 @@ BitReader::decode(Xapian::termpos outof, bool force)
     size_t bits = highest_order_bit(outof - 1);
     const size_t spare = (1 << bits) - outof;
     const size_t mid_start = (outof - spare) / 2;
-    Xapian::termpos p;
+    Xapian::termpos value;
     if (spare) {
-	p = read_bits(bits - 1);
-	if (p < mid_start) {
-	    if (read_bits(1)) p += mid_start + spare;
+	value = read_bits(bits - 1);
+	if (value < mid_start) {
+	    if (read_bits(1)) value += mid_start + spare;
 	}
     } else {
-	p = read_bits(bits);
+	value = read_bits(bits);
     }
-    Assert(p < outof);
-    return p;
+    Assert(value < outof);
+    return value;
 }
 
 unsigned int
@@ -183,8 +184,9 @@ BitReader::read_bits(int count)
 	return result | (read_bits(count - 16) << 16);
     }
     while (n_bits < count) {
-	Assert(idx < buf.size());
-	acc |= static_cast<unsigned char>(buf[idx++]) << n_bits;
+	if (rare(p == end))
+	    throw Xapian::DatabaseCorruptError("Bit stream data truncated");
+	acc |= static_cast<unsigned char>(*p++) << n_bits;
 	n_bits += 8;
     }
     result = acc & ((1u << count) - 1);
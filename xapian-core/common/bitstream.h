@@ -60,10 +60,17 @@ class BitWriter {
     void encode_interpolative(const std::vector<Xapian::termpos> &pos, int j, int k);
 };
 
-/// Read a stream created by BitWriter.
+/** Read a stream created by BitWriter.
+ *
+ *  The data isn't copied, so it must remain valid while it is being read.
+ */
 class BitReader {
-    std::string buf;
-    size_t idx;
+    /// The next byte to read.
+    const char * p;
+
+    /// The end of the data.
+    const char * end;
+
     int n_bits;
     unsigned int acc;
 
@@ -117,24 +124,36 @@ class BitReader {
     // Construct.
     BitReader() { }
 
-    // Construct with the contents of buf_.
-    explicit BitReader(const std::string &buf_)
-	: buf(buf_), idx(0), n_bits(0), acc(0) { }
-
-    // Construct with the contents of buf_, skipping some bytes.
-    BitReader(const std::string &buf_, size_t skip)
-	: buf(buf_, skip), idx(0), n_bits(0), acc(0) { }
+    // Construct to read buf_, optionally skipping some bytes.
+    explicit BitReader(const std::string &buf_, size_t skip = 0)
+	: p(buf_.data() + skip), end(buf_.data() + buf_.size()),
+	  n_bits(0), acc(0) { }
 
-    // Initialise from buf_, optionally skipping some bytes.
-    void init(const std::string &buf_, size_t skip = 0) {
-	buf.assign(buf_, skip, std::string::npos);
-	idx = 0;
+    // Initialise to read the data between p_ and end_.
+    void init(const char * p_, const char * end_) {
+	p = p_;
+	end = end_;
 	n_bits = 0;
 	acc = 0;
 	di_stack.clear();
 	di_current.uninit();
     }
 
+    // Initialise to read buf_, optionally skipping some bytes.
+    void init(const std::string &buf_, size_t skip = 0) {
+	init(buf_.data() + skip, buf_.data() + buf_.size());
+    }
+
+    /** Discard any unread bits in the current byte.
+     *
+     *  @return	Pointer to the next unread byte.
+     */
+    const char * align() {
+	n_bits = 0;
+	acc = 0;
+	return p;
+    }
+
     // Decode value, known to be less than outof.
     Xapian::termpos decode(Xapian::termpos outof, bool force = false);
 
@@ -143,7 +162,7 @@ class BitReader {
     // there's less than a byte left and that all remaining bits are
     // zero.
     bool check_all_gone() const {
-	return (idx == buf.size() && n_bits <= 7 && acc == 0);
+	return (p == end && n_bits <= 7 && acc == 0);
     }
 
     /// Perform interpolative decoding between elements between j and k.
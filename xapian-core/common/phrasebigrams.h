@@ -0,0 +1,60 @@
+/** @file phrasebigrams.h
+ * @brief Reserved terms used to index phrase bigrams.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_PHRASEBIGRAMS_H
+#define XAPIAN_INCLUDED_PHRASEBIGRAMS_H
+
+#include <string>
+
+#include "stringutils.h"
+
+/** Lead byte of terms reserved for Xapian's internal use.
+ *
+ *  This byte can't start a valid UTF-8 sequence, so it won't clash with
+ *  terms generated from text, and it sorts after every other lead byte so
+ *  reserved terms all come at the end of the term list.
+ */
+#define RESERVED_TERM_CHAR '\xff'
+
+/** Marker term indexed (with wdf 0) in every document which
+ *  TermGenerator::FLAG_PHRASE_BIGRAMS has been used on.
+ *
+ *  The matcher only uses the pair terms to filter phrase queries if every
+ *  document in a database has this marker.
+ */
+#define PHRASE_BIGRAM_MARKER_TERM "\xff"
+
+/// Is @a term reserved for internal use?
+inline bool
+is_reserved_term(const std::string & term)
+{
+    return startswith(term, RESERVED_TERM_CHAR);
+}
+
+/// Return the reserved term used to index the word pair @a a @a b.
+inline std::string
+make_phrase_bigram_term(const std::string & a, const std::string & b)
+{
+    std::string result(1, RESERVED_TERM_CHAR);
+    result += a;
+    result += ' ';
+    result += b;
+    return result;
+}
+
+#endif // XAPIAN_INCLUDED_PHRASEBIGRAMS_H
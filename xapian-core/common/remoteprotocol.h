@@ -49,8 +49,10 @@
 // 37: 1.3.1 Prefix-compress termlists.
 // 38: 1.3.2 Stats serialisation now includes collection freq, and more...
 // 39: 1.3.3 New query operator OP_WILDCARD; sort keys in serialised MSet.
+// 39.1: 1.3.4 OP_WILDCARD's max_type can include WILDCARD_PATTERN_* flags.
+// 39.2: 1.3.4 New query operator OP_EDIT_DISTANCE.
 #define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 39
-#define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
+#define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 2
 
 /** Message types (client -> server).
  *
@@ -75,6 +75,14 @@ class SubMatch : public Xapian::Internal::intrusive_base {
     /// Get PostList.
     virtual PostList * get_postlist(MultiMatch *matcher,
 				    Xapian::termcount * total_subqs_ptr) = 0;
+
+    /** Get the factor to use to convert weights to percentages.
+     *
+     *  This is only meaningful for subclasses whose get_postlist() returns
+     *  the entries of an MSet (rather than counting the number of
+     *  subqueries), and is only valid after get_postlist() has been called.
+     */
+    virtual double get_percent_factor() const { return 0.0; }
 };
 
 #endif /* XAPIAN_INCLUDED_SUBMATCH_H */
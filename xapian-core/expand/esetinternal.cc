@@ -31,6 +31,7 @@
 #include "expandweight.h"
 #include "omassert.h"
 #include "ortermlist.h"
+#include "phrasebigrams.h"
 #include "str.h"
 #include "api/termlist.h"
 #include "unicode/description_append.h"
@@ -168,6 +169,9 @@ ESet::Internal::expand(Xapian::termcount max_esize,
 
 	string term = tree->get_termname();
 
+	// Terms reserved for internal use aren't useful expansions.
+	if (is_reserved_term(term)) continue;
+
 	// If there's an ExpandDecider, see if it accepts the term.
 	if (edecider && !(*edecider)(term)) continue;
 
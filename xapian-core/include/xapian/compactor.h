@@ -50,6 +50,9 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
     /// @internal Reference counted internals.
     Xapian::Internal::intrusive_ptr<Internal> internal;
 
+    /// Database::compact_() needs to read the settings in internal.
+    friend class Database;
+
     void set_flags_(unsigned flags, unsigned mask = 0);
 
   public:
@@ -108,6 +111,27 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
 	set_flags_(compaction, ~unsigned(STANDARD|FULL|FULLER));
     }
 
+    /** Set the maximum number of threads to use.
+     *
+     *  For glass databases, tables can be compacted in parallel, and the
+     *  postlist table can be split by term into ranges which are merged in
+     *  parallel and then joined together.  Currently threads aren't used
+     *  when compacting to a single file database, and the postlist table
+     *  isn't split in multipass mode or if any input is a single file
+     *  database.  Chert databases are always compacted in the calling
+     *  thread.
+     *
+     *  If threads are used, set_status() and resolve_duplicate_metadata()
+     *  may be called from threads other than the one which started the
+     *  compaction (but never from more than one thread at once).
+     *
+     *  @param max_threads  The maximum number of threads to use
+     *			(including the calling thread).  The default is
+     *			1, which means all the work is done in the calling
+     *			thread.
+     */
+    void set_max_threads(unsigned max_threads);
+
     /** Set where to write the output.
      *
      *  @deprecated Use Database::compact(destdir[, compactor]) instead.
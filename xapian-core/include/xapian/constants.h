@@ -144,6 +144,22 @@ const int DB_NO_TERMLIST	 = 0x20;
  */
 const int DB_RETRY_LOCK		 = 0x40;
 
+/** Access the database files using memory mapping when opening to read.
+ *
+ *  For backends which support it (currently glass), when opening a Database
+ *  this flag means the table files are mapped into memory with mmap(), and
+ *  blocks are read directly from the mapping rather than being copied into
+ *  buffers with pread().  This is most useful for databases which fit in RAM.
+ *
+ *  Only use this flag with databases which aren't being modified while they
+ *  are open - a concurrent writer can change or truncate the mapped files, in
+ *  which case the process may read inconsistent data or be killed by SIGBUS.
+ *
+ *  On platforms without mmap(), and for WritableDatabase, this flag is
+ *  ignored.
+ */
+const int DB_MMAP		 = 0x80;
+
 /** Use the glass backend.
  *
  *  When opening a WritableDatabase, this means create a glass database if a
@@ -178,12 +194,49 @@ const int DB_BACKEND_CHERT	 = 0x200;
  */
 const int DB_BACKEND_STUB	 = 0x300;
 
+/** Maintain an index of term fragments for wildcard expansion.
+ *
+ *  For backends which support it (currently glass), this creates and
+ *  maintains an auxiliary table which maps the trigrams in each term to the
+ *  terms containing them.  This allows OP_WILDCARD patterns using
+ *  Xapian::Query::WILDCARD_PATTERN_MULTI or
+ *  Xapian::Query::WILDCARD_PATTERN_SINGLE which don't start with a fixed
+ *  prefix (e.g. "*ology" or "in*tion") to be expanded without checking every
+ *  term in the database.
+ *
+ *  If the database already has terms but no wildcard index, opening it with
+ *  this flag builds the index and commits it straight away.  Once a database
+ *  has a wildcard index, it is kept up to date whether or not this flag is
+ *  specified.  To remove the index, delete wildcard.*.
+ */
+const int DB_WILDCARD_INDEX	 = 0x400;
+
+/** Maintain a deletion index for spelling correction.
+ *
+ *  For backends which support it (currently glass), this stores each
+ *  spelling word in the spelling table under every variant of it with up to
+ *  two characters deleted.  Database::get_spelling_suggestion() can then
+ *  find the candidate corrections with a few exact lookups rather than
+ *  checking the edit distance to every word which shares a trigram with
+ *  the misspelling.  The catch is that the spelling table becomes several
+ *  times larger.
+ *
+ *  If the database already has spelling data but no deletion index, opening
+ *  it with this flag builds the index and commits it straight away.  Once a
+ *  database has a deletion index, it is kept up to date whether or not this
+ *  flag is specified.
+ */
+const int DB_SPELLING_DELETION_INDEX = 0x800;
+
 #ifdef XAPIAN_LIB_BUILD
 /** @internal Bit mask for backend codes. */
 const int DB_BACKEND_MASK_	 = 0x300;
 
 /** @internal Used internally to signify opening read-only. */
 const int DB_READONLY_		 = -1;
+
+/** @internal Used internally to signify opening read-only with DB_MMAP. */
+const int DB_READONLY_MMAP_	 = -2;
 #endif
 
 
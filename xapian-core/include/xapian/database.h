@@ -813,11 +813,16 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 *
 	 *  Note that commit() need not be called explicitly: it will be called
 	 *  automatically when the database is closed, or when a sufficient
-	 *  number of modifications have been made.  By default, this is every
-	 *  10000 documents added, deleted, or modified.  This value is rather
-	 *  conservative, and if you have a machine with plenty of memory,
-	 *  you can improve indexing throughput dramatically by setting
-	 *  XAPIAN_FLUSH_THRESHOLD in the environment to a larger value.
+	 *  number of modifications have been made.  For the glass backend,
+	 *  this happens when the buffered changes use about 64MB of memory,
+	 *  and you can set XAPIAN_FLUSH_MEMORY in the environment to a
+	 *  different number of megabytes - if you have a machine with plenty
+	 *  of memory, a larger value can improve indexing throughput
+	 *  dramatically.  Setting XAPIAN_FLUSH_THRESHOLD in the environment
+	 *  additionally limits the number of documents added, deleted, or
+	 *  modified between commits.  For the chert backend, the default is
+	 *  every 10000 documents added, deleted, or modified, and only
+	 *  XAPIAN_FLUSH_THRESHOLD is used.
 	 *
 	 *  This method was new in Xapian 1.1.0 - in earlier versions it was
 	 *  called flush().
@@ -962,6 +967,38 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 */
 	Xapian::docid add_document(const Xapian::Document & document);
 
+	/** Add several new documents to the database.
+	 *
+	 *  The effect is the same as calling add_document() for each document
+	 *  in turn, so the documents are given consecutive document IDs in the
+	 *  order they appear in @a docs.  However, some backends (currently
+	 *  glass) can encode the documents (their termlists, positional data,
+	 *  etc) in parallel using several threads, while the calling thread
+	 *  writes the encoded documents to the database.
+	 *
+	 *  The documents mustn't be used by any other thread during this call.
+	 *
+	 *  If an exception is thrown while adding a document, this behaves as
+	 *  add_document() does, so any uncommitted changes (including those
+	 *  for earlier documents in @a docs) are discarded.
+	 *
+	 *  @param docs		The new documents to be added.
+	 *  @param num_threads	The maximum number of threads to use (including
+	 *			the calling thread).  The default is to use
+	 *			just the calling thread.
+	 *
+	 *  @return	The document ID of the first newly added document, or 0
+	 *		if @a docs is empty.
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if a problem occurs
+	 *             while writing to the database.
+	 *
+	 *  @exception Xapian::DatabaseCorruptError will be thrown if the
+	 *             database is in a corrupt state.
+	 */
+	Xapian::docid add_documents(const std::vector<Xapian::Document> & docs,
+				    unsigned num_threads = 1);
+
 	/** Delete a document from the database.
 	 *
 	 *  This method removes the document with the specified document ID
@@ -149,6 +149,43 @@ open(const std::string &dir, int action, int block_size)
 }
 #endif
 
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+/// Settings for the glass backend.
+namespace Glass {
+
+/** Set the size of the block cache shared by read-only glass databases.
+ *
+ *  All the glass databases opened read-only within the process share this
+ *  cache, so that several Database objects on the same database don't each
+ *  need to read the same blocks from disk.  The least recently used blocks
+ *  are discarded once the cache reaches this size.
+ *
+ *  Whether a database uses the cache is decided when it is opened (or
+ *  reopened), so enabling or disabling the cache only affects databases
+ *  opened afterwards.
+ *
+ *  @param size	The maximum size of the cache in bytes.  0 disables the
+ *		cache, which is the default unless the environment variable
+ *		XAPIAN_GLASS_BLOCK_CACHE_SIZE is set.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_block_cache_size(size_t size);
+
+/// Return the maximum size of the glass block cache in bytes.
+XAPIAN_VISIBILITY_DEFAULT
+size_t get_block_cache_size();
+
+/// Return the number of block lookups which were found in the glass block cache.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long long get_block_cache_hits();
+
+/// Return the number of block lookups which weren't found in the glass block cache.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long long get_block_cache_misses();
+
+}
+#endif
+
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
 /// Database factory functions for the remote backend.
 namespace Remote {
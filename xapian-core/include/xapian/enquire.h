@@ -623,6 +623,62 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
 	 */
 	void set_time_limit(double time_limit);
 
+	/** Set the maximum number of threads to use for the match.
+	 *
+	 *  When the Database being searched contains several local
+	 *  sub-databases, each can be searched in a separate thread, and the
+	 *  results then merged in the same way as for remote databases.
+	 *  The threads share the minimum weight needed to get into the
+	 *  results, so each can skip documents which can't make it.
+	 *
+	 *  @param max_threads  The maximum number of threads to use
+	 *			(including the calling thread).  The default
+	 *			is 1, which means all matching is done in the
+	 *			calling thread.
+	 *
+	 *  Limitations:
+	 *
+	 *  Threads aren't used if a MatchSpy, MatchDecider or KeyMaker is in
+	 *  use (since these aren't required to be thread-safe), if the query
+	 *  uses a PostingSource which doesn't support serialisation, or if the
+	 *  same sub-database appears more than once.  Each thread uses one of
+	 *  the sub-databases, so they must not be used by any other thread at
+	 *  the same time.  As with remote databases, terms from a wildcard
+	 *  expansion may get slightly different weights.
+	 */
+	void set_max_threads(unsigned max_threads);
+
+	/** Cache the results of get_mset().
+	 *
+	 *  If the same query is run again with the same settings, and the
+	 *  database hasn't changed, the results are returned from the cache.
+	 *  Each cached result holds the top @a depth matches (or more if
+	 *  more were asked for), so requests for later pages of results
+	 *  can be served from the same cache entry.
+	 *
+	 *  Entries are checked against the revision of each sub-database, so
+	 *  calling Database::reopen() to move to a new revision means old
+	 *  entries are no longer used.
+	 *
+	 *  @param max_entries  The maximum number of results to cache.  The
+	 *			least recently used entry is discarded to make
+	 *			room for a new one.  The default is 0, which
+	 *			disables the cache (any cached entries are
+	 *			discarded).
+	 *  @param depth	The minimum number of matches to calculate and
+	 *			cache for each query (default 100).
+	 *
+	 *  Limitations:
+	 *
+	 *  Results aren't cached when searching a WritableDatabase (since
+	 *  uncommitted changes are visible to the search), a remote or
+	 *  inmemory database, or when a MatchSpy, MatchDecider, KeyMaker or
+	 *  non-empty RSet is used, or when a time limit is set (since the
+	 *  results then depend on how long the match takes).  Nor are they
+	 *  cached if the query or weighting scheme can't be serialised.
+	 */
+	void set_mset_cache(size_t max_entries, Xapian::doccount depth = 100);
+
 	/** Get (a portion of) the match set for the current query.
 	 *
 	 *  @param first     the first item in the result set to return.
@@ -34,6 +34,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 namespace Xapian {
 
@@ -276,6 +277,184 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
     virtual std::string get_description() const;
 };
 
+
+/** Class for counting the frequencies of values in several slots at once.
+ *
+ *  This gives the same counts as using a ValueCountMatchSpy for each slot,
+ *  but is cheaper when faceting on several slots.  Each distinct value seen
+ *  in a slot is given a small integer ordinal the first time it is seen, and
+ *  the frequencies are counted in an array indexed by ordinal, so after the
+ *  first occurrence of a value no map lookup or allocation is needed for
+ *  runs of documents with the same value.
+ *
+ *  If Enquire::set_max_threads() allows several local sub-databases to be
+ *  searched in parallel, each thread counts into its own copy of this spy
+ *  and the counts are merged at the end of the match.
+ */
+class XAPIAN_VISIBILITY_DEFAULT FacetCountMatchSpy : public MatchSpy {
+  public:
+    /// Class representing the counts - this is an implementation detail.
+    class Internal;
+
+  protected:
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr<Internal> internal;
+
+  public:
+    /** Construct a FacetCountMatchSpy.
+     *
+     *  Use add_slot() to specify which slots to count.
+     */
+    FacetCountMatchSpy();
+
+    /// Destructor.
+    ~FacetCountMatchSpy();
+
+    /** Add a slot to count the values in.
+     *
+     *  This must be called before the match.  Adding a slot which is already
+     *  being counted has no effect.
+     *
+     *  @param slot	The slot to count.
+     */
+    void add_slot(Xapian::valueno slot);
+
+    /** Return the total number of documents tallied. */
+    Xapian::doccount get_total() const;
+
+    /** Get an iterator over the values seen in a slot.
+     *
+     *  Items will be returned in ascending alphabetical order.
+     *
+     *  During the iteration, the frequency of the current value can be
+     *  obtained with the get_termfreq() method on the iterator.
+     *
+     *  @param slot	The slot to return values for.  An
+     *			InvalidArgumentError is thrown if this slot isn't
+     *			being counted.
+     */
+    TermIterator values_begin(Xapian::valueno slot) const;
+
+    /** End iterator corresponding to values_begin() */
+    TermIterator XAPIAN_NOTHROW(values_end(Xapian::valueno) const) {
+	return TermIterator();
+    }
+
+    /** Get an iterator over the most frequent values seen in a slot.
+     *
+     *  Items will be returned in descending order of frequency.  Values with
+     *  the same frequency will be returned in ascending alphabetical order.
+     *
+     *  During the iteration, the frequency of the current value can be
+     *  obtained with the get_termfreq() method on the iterator.
+     *
+     *  @param slot	The slot to return values for.  An
+     *			InvalidArgumentError is thrown if this slot isn't
+     *			being counted.
+     *  @param maxvalues The maximum number of values to return.
+     */
+    TermIterator top_values_begin(Xapian::valueno slot,
+				  size_t maxvalues) const;
+
+    /** End iterator corresponding to top_values_begin() */
+    TermIterator XAPIAN_NOTHROW(top_values_end(Xapian::valueno,
+					       size_t) const) {
+	return TermIterator();
+    }
+
+    /** Implementation of virtual operator().
+     *
+     *  This implementation tallies the values in each slot for a matching
+     *  document.
+     *
+     *  @param doc	The document to tally values for.
+     *  @param wt	The weight of the document (ignored by this class).
+     */
+    void operator()(const Xapian::Document &doc, double wt);
+
+    virtual MatchSpy * clone() const;
+    virtual std::string name() const;
+    virtual std::string serialise() const;
+    virtual MatchSpy * unserialise(const std::string & serialised,
+				   const Registry & context) const;
+    virtual std::string serialise_results() const;
+    virtual void merge_results(const std::string & serialised);
+    virtual std::string get_description() const;
+};
+
+
+/** Class for counting the distinct values in a slot in the matching
+ *  documents.
+ *
+ *  The count is exact up to a threshold number of distinct values.  Beyond
+ *  that, the count is estimated using the HyperLogLog algorithm, which has a
+ *  typical relative error of about 0.8%.  Either way, the memory used is
+ *  bounded regardless of how many documents match.
+ *
+ *  Documents with no value in the slot aren't counted as a distinct value.
+ */
+class XAPIAN_VISIBILITY_DEFAULT DistinctCountMatchSpy : public MatchSpy {
+  public:
+    /// Class representing the counts - this is an implementation detail.
+    class Internal;
+
+  protected:
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr<Internal> internal;
+
+  public:
+    /// Construct an empty DistinctCountMatchSpy.
+    DistinctCountMatchSpy();
+
+    /** Construct a DistinctCountMatchSpy which counts the distinct values
+     *  in a slot.
+     *
+     *  @param slot		The slot to count.
+     *  @param exact_threshold	The number of distinct values to count
+     *				exactly before switching to an estimate
+     *				(default: 1000).  Up to 8 bytes per value
+     *				(plus hash table overhead) is used while
+     *				counting exactly; the estimate always uses
+     *				16KB.
+     */
+    explicit DistinctCountMatchSpy(Xapian::valueno slot,
+				   Xapian::doccount exact_threshold = 1000);
+
+    /// Destructor.
+    ~DistinctCountMatchSpy();
+
+    /** Return the total number of documents tallied. */
+    Xapian::doccount get_total() const;
+
+    /** Return the number of distinct values seen.
+     *
+     *  If is_exact() returns false, this is an estimate.
+     */
+    Xapian::doccount get_distinct_count() const;
+
+    /** Return true if get_distinct_count() is exact. */
+    bool is_exact() const;
+
+    /** Implementation of virtual operator().
+     *
+     *  This implementation tallies the value in the slot for a matching
+     *  document.
+     *
+     *  @param doc	The document to tally the value for.
+     *  @param wt	The weight of the document (ignored by this class).
+     */
+    void operator()(const Xapian::Document &doc, double wt);
+
+    virtual MatchSpy * clone() const;
+    virtual std::string name() const;
+    virtual std::string serialise() const;
+    virtual MatchSpy * unserialise(const std::string & serialised,
+				   const Registry & context) const;
+    virtual std::string serialise_results() const;
+    virtual void merge_results(const std::string & serialised);
+    virtual std::string get_description() const;
+};
+
 }
 
 #endif // XAPIAN_INCLUDED_MATCHSPY_H
@@ -92,6 +92,20 @@ class XAPIAN_VISIBILITY_DEFAULT MSet {
     Xapian::doccount get_uncollapsed_matches_estimated() const;
     Xapian::doccount get_uncollapsed_matches_upper_bound() const;
 
+    /** Get the memory used to track collapse key values (in bytes).
+     *
+     *  This is the peak memory used by the table of collapse key values
+     *  during the match, or 0 if collapsing wasn't used.  The table's size is
+     *  limited (to 64MB by default, which can be changed by setting
+     *  XAPIAN_COLLAPSE_MEMORY in the environment to a number of megabytes) by
+     *  forgetting about collapse key values which can no longer affect the
+     *  results, though this isn't always possible.
+     *
+     *  For a remote database, this only reports the memory used when merging
+     *  the results on the client.
+     */
+    size_t get_collapse_memory() const;
+
     double get_max_attained() const;
     double get_max_possible() const;
 
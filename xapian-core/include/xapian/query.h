@@ -111,6 +111,19 @@ class XAPIAN_VISIBILITY_DEFAULT Query {
 	OP_MAX = 14,
 	OP_WILDCARD = 15,
 
+	/** Match terms within a given edit distance of a word.
+	 *
+	 *  This expands to the terms in the database which are within the
+	 *  specified edit distance of the word, which are then combined in
+	 *  the same way as for OP_WILDCARD.  It's useful for "fuzzy" matching
+	 *  of misspelled words.
+	 *
+	 *  The edit distance counts insertions, deletions, substitutions and
+	 *  transpositions of adjacent characters, and is measured in Unicode
+	 *  characters rather than bytes.
+	 */
+	OP_EDIT_DISTANCE = 16,
+
 	LEAF_TERM = 100,
 	LEAF_POSTING_SOURCE,
 	LEAF_MATCH_ALL,
@@ -142,6 +155,34 @@ class XAPIAN_VISIBILITY_DEFAULT Query {
 	WILDCARD_LIMIT_MOST_FREQUENT
     };
 
+    enum {
+	/** Support '*' anywhere in an OP_WILDCARD pattern.
+	 *
+	 *  '*' matches zero or more characters.  Bitwise-or this into the
+	 *  @a max_type argument of the OP_WILDCARD constructor.  The pattern
+	 *  then has to include any trailing '*' explicitly.
+	 *
+	 *  Patterns which don't start with a fixed prefix are resolved
+	 *  efficiently if the database has a wildcard index (see
+	 *  Xapian::DB_WILDCARD_INDEX), and by checking every term in the
+	 *  database otherwise.
+	 */
+	WILDCARD_PATTERN_MULTI = 0x10,
+
+	/** Support '?' anywhere in an OP_WILDCARD pattern.
+	 *
+	 *  '?' matches exactly one character.  Bitwise-or this into the
+	 *  @a max_type argument of the OP_WILDCARD constructor.
+	 */
+	WILDCARD_PATTERN_SINGLE = 0x20,
+
+	/** Support both '*' and '?' in an OP_WILDCARD pattern.
+	 *
+	 *  This is the same as WILDCARD_PATTERN_MULTI|WILDCARD_PATTERN_SINGLE.
+	 */
+	WILDCARD_PATTERN_GLOB = 0x30
+    };
+
     /// Default constructor.
     XAPIAN_NOTHROW(Query())
 	: internal(0) { }
@@ -203,15 +244,19 @@ class XAPIAN_VISIBILITY_DEFAULT Query {
     /** Query constructor for OP_WILDCARD queries.
      *
      *  @param op	Must be OP_WILDCARD
-     *  @param pattern	The wildcard pattern - currently this is just a string
-     *			and the wildcard expands to terms which start with
-     *			exactly this string.
+     *  @param pattern	The wildcard pattern - by default this is just a
+     *			string and the wildcard expands to terms which start
+     *			with exactly this string.  If @a max_type includes
+     *			WILDCARD_PATTERN_MULTI and/or WILDCARD_PATTERN_SINGLE
+     *			then the pattern is a glob where '*' and/or '?'
+     *			(respectively) are wildcards.
      *	@param max_expansion	The maximum number of terms to expand to
      *				(default: 0, which means no limit)
      *	@param max_type	How to enforce max_expansion - one of
      *			@a WILDCARD_LIMIT_ERROR (the default),
      *			@a WILDCARD_LIMIT_FIRST or
-     *			@a WILDCARD_LIMIT_MOST_FREQUENT.
+     *			@a WILDCARD_LIMIT_MOST_FREQUENT, optionally
+     *			bitwise-ored with WILDCARD_PATTERN_* flags.
      *			When searching multiple databases, the expansion limit
      *			is currently applied independently for each database,
      *			so the total number of terms may be higher than the
@@ -226,6 +271,39 @@ class XAPIAN_VISIBILITY_DEFAULT Query {
 	  int max_type = WILDCARD_LIMIT_ERROR,
 	  op combiner = OP_SYNONYM);
 
+    /** Query constructor for OP_EDIT_DISTANCE queries.
+     *
+     *  @param op	Must be OP_EDIT_DISTANCE
+     *  @param word	The word to find terms close to.
+     *	@param edit_distance	The maximum edit distance between @a word
+     *				and the terms it expands to.
+     *	@param min_prefix_len	The number of characters at the start of
+     *				@a word which terms must match exactly
+     *				(default: 0).  Using a prefix greatly reduces
+     *				the number of terms which need to be checked,
+     *				and can also be used to restrict expansion to
+     *				terms with a particular term prefix.
+     *	@param max_expansion	The maximum number of terms to expand to
+     *				(default: 0, which means no limit)
+     *	@param max_type	How to enforce max_expansion - one of
+     *			@a WILDCARD_LIMIT_ERROR (the default),
+     *			@a WILDCARD_LIMIT_FIRST or
+     *			@a WILDCARD_LIMIT_MOST_FREQUENT.
+     *	@param combiner The @op to combine the terms with - one of
+     *			@a OP_SYNONYM (the default), @a OP_OR or @a OP_MAX.
+     *
+     *  A call which only passes @a word and @a edit_distance (and perhaps
+     *  @a min_prefix_len) may match the OP_WILDCARD constructor instead,
+     *  which handles OP_EDIT_DISTANCE in the same way.
+     */
+    Query(op op_,
+	  const std::string & word,
+	  unsigned edit_distance,
+	  size_t min_prefix_len,
+	  Xapian::termcount max_expansion = 0,
+	  int max_type = WILDCARD_LIMIT_ERROR,
+	  op combiner = OP_SYNONYM);
+
     template<typename I>
     Query(op op_, I begin, I end, Xapian::termcount window = 0)
     {
@@ -453,7 +453,9 @@ class XAPIAN_VISIBILITY_DEFAULT QueryParser {
 	FLAG_BOOLEAN_ANY_CASE = 8,
 	/** Support wildcards.
 	 *
-	 *  At present only right truncation (e.g. Xap*) is supported.
+	 *  By default only right truncation (e.g. Xap*) is supported - see
+	 *  FLAG_WILDCARD_MULTI and FLAG_WILDCARD_SINGLE for more general
+	 *  patterns.
 	 *
 	 *  Currently you can't use wildcards with boolean filter prefixes,
 	 *  or in a phrase (either an explicitly quoted one, or one implicitly
@@ -543,6 +545,28 @@ class XAPIAN_VISIBILITY_DEFAULT QueryParser {
 	 */
 	FLAG_CJK_NGRAM = 2048,
 
+	/** Support '*' anywhere in a term (e.g. *ology or in*tion).
+	 *
+	 *  '*' matches zero or more characters.  Patterns which don't start
+	 *  with a literal prefix are much more efficient to expand from
+	 *  a glass database opened with Xapian::DB_WILDCARD_INDEX.
+	 *
+	 *  Added in Xapian 1.3.4.
+	 */
+	FLAG_WILDCARD_MULTI = 4096,
+
+	/** Support '?' in a term, matching exactly one character (e.g. wom?n).
+	 *
+	 *  Added in Xapian 1.3.4.
+	 */
+	FLAG_WILDCARD_SINGLE = 8192,
+
+	/** Support both '*' and '?' wildcards anywhere in a term.
+	 *
+	 *  Added in Xapian 1.3.4.
+	 */
+	FLAG_WILDCARD_GLOB = FLAG_WILDCARD_MULTI|FLAG_WILDCARD_SINGLE,
+
 	/** The default flags.
 	 *
 	 *  Used if you don't explicitly pass any to @a parse_query().
@@ -106,7 +106,35 @@ class XAPIAN_VISIBILITY_DEFAULT TermGenerator {
 	 *  enabled in 1.2.8 and later by setting environment variable
 	 *  XAPIAN_CJK_NGRAM.
 	 */
-	FLAG_CJK_NGRAM = 2048 // Value matches QueryParser flag.
+	FLAG_CJK_NGRAM = 2048, // Value matches QueryParser flag.
+
+	/** Index pairs of adjacent words to speed up phrase searches.
+	 *
+	 *  With this enabled, a term is generated for each pair of adjacent
+	 *  words which includes a stopword (as identified by the Stopper
+	 *  set with set_stopper(), or every pair of adjacent words if there
+	 *  isn't a Stopper).  The term is formed from the positional terms
+	 *  for the two words joined by a space, with a reserved byte
+	 *  (0xff) in front so it can't clash with other terms.  Words from
+	 *  separate index_text() calls are paired if they're adjacent.
+	 *  A marker term (just the 0xff byte) is also added to the
+	 *  document.  All these terms have wdf 0 and are skipped by
+	 *  Database::allterms_begin(), wildcard expansion and query
+	 *  expansion.
+	 *
+	 *  A phrase search which contains such a pair checks the pair's
+	 *  postings before looking at positional data, which makes phrases
+	 *  of common words much faster to search for.  The stopwords should
+	 *  therefore be the most frequent words in your documents.
+	 *
+	 *  The pairs are only used for a database if every document in it
+	 *  has the marker term, so documents indexed without this flag
+	 *  still match phrase searches (but the searches don't get any
+	 *  faster).  Indexing a document with it requires all its
+	 *  positional terms to come from the TermGenerator, and you should
+	 *  use the same stopwords for every document.
+	 */
+	FLAG_PHRASE_BIGRAMS = 4096
     };
 
     /// Stemming strategies, for use with set_stemming_strategy().
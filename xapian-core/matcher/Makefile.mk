@@ -17,6 +17,7 @@ noinst_HEADERS +=\
 	matcher/multixorpostlist.h\
 	matcher/nearpostlist.h\
 	matcher/orpostlist.h\
+	matcher/parallelsubmatch.h\
 	matcher/phrasepostlist.h\
 	matcher/queryoptimiser.h\
 	matcher/remotesubmatch.h\
@@ -55,6 +56,7 @@ lib_src +=\
 	matcher/multixorpostlist.cc\
 	matcher/nearpostlist.cc\
 	matcher/orpostlist.cc\
+	matcher/parallelsubmatch.cc\
 	matcher/phrasepostlist.cc\
 	matcher/selectpostlist.cc\
 	matcher/synonympostlist.cc\
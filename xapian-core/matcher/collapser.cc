@@ -25,9 +25,64 @@
 #include "omassert.h"
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 using namespace std;
 
+/// The longest collapse key value stored in a table entry.
+const size_t MAX_PACKED_KEY_LEN = sizeof(uint64_t);
+
+/// The number of slots to start with.
+const size_t INITIAL_SLOTS = 32;
+
+/// Mix the bits of @a h (the 64-bit MurmurHash3 finaliser).
+static inline uint64_t
+mix_hash(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/** Hash a collapse key value.
+ *
+ *  @param key		The collapse key value.
+ *  @param[out] packed	Set to @a key packed into a word if it's short
+ *			enough.
+ */
+static inline uint64_t
+hash_key(const string & key, uint64_t & packed)
+{
+    size_t len = key.size();
+    if (len <= MAX_PACKED_KEY_LEN) {
+	packed = 0;
+	memcpy(&packed, key.data(), len);
+	return mix_hash(packed ^ (uint64_t(len) << 56));
+    }
+    // FNV-1a.
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i != len; ++i) {
+	h ^= static_cast<unsigned char>(key[i]);
+	h *= 0x100000001b3ULL;
+    }
+    return mix_hash(h);
+}
+
+double
+CollapseData::get_best_weight() const
+{
+    double best = 0;
+    vector<Xapian::Internal::MSetItem>::const_iterator i;
+    for (i = items.begin(); i != items.end(); ++i) {
+	if (i->wt > best) best = i->wt;
+    }
+    return best;
+}
+
 collapse_result
 CollapseData::add_item(const Xapian::Internal::MSetItem & item,
 		       Xapian::doccount collapse_max, const MSetCmp & mcmp,
@@ -66,6 +121,56 @@ CollapseData::add_item(const Xapian::Internal::MSetItem & item,
     return REPLACED;
 }
 
+Collapser::Collapser(Xapian::valueno slot_, Xapian::doccount collapse_max_)
+    : entry_count(0), no_collapse_key(0), dups_ignored(0),
+      docs_considered(0), slot(slot_), collapse_max(collapse_max_),
+      memory_limit(size_t(COLLAPSER_DEFAULT_MEMORY_MB) << 20),
+      peak_memory(0), old_item(0, 0)
+{
+    if (collapse_max) {
+	// XAPIAN_COLLAPSE_MEMORY is in megabytes.
+	const char * p = getenv("XAPIAN_COLLAPSE_MEMORY");
+	if (p && atoi(p) > 0)
+	    memory_limit = size_t(atoi(p)) << 20;
+    }
+    prune_threshold = memory_limit;
+}
+
+size_t
+Collapser::find_slot(const string & key, uint64_t hash, uint64_t packed) const
+{
+    Assert(!slots.empty());
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    while (slots[i]) {
+	const Entry & entry = table[slots[i] - 1];
+	if (entry.hash == hash && entry.key_len == key.size()) {
+	    if (key.size() <= MAX_PACKED_KEY_LEN) {
+		if (entry.key == packed) break;
+	    } else if (memcmp(key_buf.data() + entry.key, key.data(),
+			      key.size()) == 0) {
+		break;
+	    }
+	}
+	i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void
+Collapser::rehash(size_t new_size)
+{
+    AssertEq(new_size & (new_size - 1), 0);
+    vector<uint32_t> new_slots(new_size);
+    size_t mask = new_size - 1;
+    for (size_t e = 0; e != table.size(); ++e) {
+	size_t i = table[e].hash & mask;
+	while (new_slots[i]) i = (i + 1) & mask;
+	new_slots[i] = e + 1;
+    }
+    swap(slots, new_slots);
+}
+
 collapse_result
 Collapser::process(Xapian::Internal::MSetItem & item,
 		   PostList * postlist,
@@ -82,46 +187,96 @@ Collapser::process(Xapian::Internal::MSetItem & item,
 	item.collapse_key = vsdoc.get_value(slot);
     }
 
-    if (item.collapse_key.empty()) {
+    const string & key = item.collapse_key;
+    if (key.empty()) {
 	// We don't collapse items with an empty collapse key.
 	++no_collapse_key;
 	return EMPTY;
     }
 
-    map<string, CollapseData>::iterator oldkey;
-    oldkey = table.find(item.collapse_key);
-    if (oldkey == table.end()) {
+    // Keep the load factor at most 1/2 so probe sequences stay short.
+    if ((table.size() + 1) * 2 > slots.size()) {
+	rehash(slots.empty() ? INITIAL_SLOTS : slots.size() * 2);
+    }
+
+    uint64_t packed = 0;
+    uint64_t hash = hash_key(key, packed);
+    size_t i = find_slot(key, hash, packed);
+    if (!slots[i]) {
 	// We've not seen this collapse key before.
-	table.insert(make_pair(item.collapse_key, CollapseData(item)));
+	if (key.size() > MAX_PACKED_KEY_LEN) {
+	    packed = key_buf.size();
+	    key_buf += key;
+	}
+	table.push_back(Entry(hash, packed, key.size(), item));
+	slots[i] = table.size();
 	++entry_count;
+	update_peak_memory();
 	return ADDED;
     }
 
     collapse_result res;
-    CollapseData & collapse_data = oldkey->second;
+    CollapseData & collapse_data = table[slots[i] - 1].data;
     res = collapse_data.add_item(item, collapse_max, mcmp, old_item);
     if (res == ADDED) {
 	++entry_count;
+	update_peak_memory();
     } else if (res == REJECTED || res == REPLACED) {
 	++dups_ignored;
     }
     return res;
 }
 
+void
+Collapser::prune(double min_weight)
+{
+    if (min_weight > 0) {
+	vector<Entry> new_table;
+	string new_key_buf;
+	vector<Entry>::iterator e;
+	for (e = table.begin(); e != table.end(); ++e) {
+	    if (e->data.get_best_weight() < min_weight) {
+		// None of the items for this collapse key value can be in the
+		// MSet, and any later documents with the same value which can
+		// be would replace them anyway.
+		entry_count -= e->data.get_item_count();
+		continue;
+	    }
+	    if (e->key_len > MAX_PACKED_KEY_LEN) {
+		uint64_t offset = new_key_buf.size();
+		new_key_buf.append(key_buf, e->key, e->key_len);
+		e->key = offset;
+	    }
+	    new_table.push_back(std::move(*e));
+	}
+	swap(table, new_table);
+	swap(key_buf, new_key_buf);
+	size_t new_size = INITIAL_SLOTS;
+	while (new_size < table.size() * 2) new_size *= 2;
+	rehash(new_size);
+    }
+    // If we didn't manage to free much, don't try again until the memory
+    // used has doubled.
+    prune_threshold = max(memory_limit, memory_used() * 2);
+}
+
 Xapian::doccount
 Collapser::get_collapse_count(const string & collapse_key, int percent_cutoff,
 			      double min_weight) const
 {
-    map<string, CollapseData>::const_iterator key = table.find(collapse_key);
+    uint64_t packed = 0;
+    uint64_t hash = hash_key(collapse_key, packed);
+    size_t i = find_slot(collapse_key, hash, packed);
     // If a collapse key is present in the MSet, it must be in our table.
-    Assert(key != table.end());
+    Assert(slots[i]);
+    const CollapseData & collapse_data = table[slots[i] - 1].data;
 
     if (!percent_cutoff) {
 	// The recorded collapse_count is correct.
-	return key->second.get_collapse_count();
+	return collapse_data.get_collapse_count();
     }
 
-    if (key->second.get_next_best_weight() < min_weight) {
+    if (collapse_data.get_next_best_weight() < min_weight) {
 	// We know for certain that all collapsed items would have failed the
 	// percentage cutoff, so collapse_count should be 0.
 	return 0;
@@ -147,10 +302,10 @@ Collapser::get_matches_lower_bound() const
     // many documents.
 #if 0
     Xapian::doccount max_kept = 0;
-    map<string, CollapseData>::const_iterator i;
+    vector<Entry>::const_iterator i;
     for (i = table.begin(); i != table.end(); ++i) {
-	if (i->second.get_collapse_count() > max_kept) {
-	    max_kept = i->second.get_collapse_count();
+	if (i->data.get_collapse_count() > max_kept) {
+	    max_kept = i->data.get_collapse_count();
 	    if (max_kept == collapse_max) {
 		return matches_lower_bound;
 	    }
@@ -26,7 +26,15 @@
 #include "api/omenquireinternal.h"
 #include "api/postlist.h"
 
-#include <map>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Default memory limit for the Collapser, in megabytes.
+ *
+ *  Can be overridden by setting XAPIAN_COLLAPSE_MEMORY in the environment.
+ */
+#define COLLAPSER_DEFAULT_MEMORY_MB 64
 
 /// Enumeration reporting how a document was handled by the Collapser.
 typedef enum {
@@ -79,14 +87,64 @@ class CollapseData {
     /// The highest weight of a document we've rejected.
     double get_next_best_weight() const { return next_best_weight; }
 
+    /// The highest weight of the documents we're keeping.
+    double get_best_weight() const;
+
+    /// The number of documents we're keeping.
+    Xapian::doccount get_item_count() const { return items.size(); }
+
     /// The number of documents we've rejected.
     Xapian::doccount get_collapse_count() const { return collapse_count; }
 };
 
-/// The Collapser class tracks collapse keys and the documents they match.
+/** The Collapser class tracks collapse keys and the documents they match.
+ *
+ *  Collapse key values are stored in an open-addressing hash table.  Values
+ *  of up to 8 bytes (which covers integers, and hashes of URLs and similar)
+ *  are stored in the table entry itself and compared as a single word;
+ *  longer values are appended to a shared buffer.
+ *
+ *  Once the table uses more than the memory limit, we discard values for
+ *  which all the documents we're keeping have less than the minimum weight
+ *  needed to get into the MSet, since they can no longer affect which
+ *  documents are returned.  This only loses information used to calculate
+ *  collapse counts (which are lower bounds) and the match estimates.
+ */
 class Collapser {
-    /// Map from collapse key values to the items we're keeping for them.
-    std::map<std::string, CollapseData> table;
+    /// An entry in the hash table.
+    struct Entry {
+	/// Hash of the collapse key value.
+	uint64_t hash;
+
+	/** The collapse key value packed into a word, if it's at most 8 bytes
+	 *  long, or its offset in @a key_buf otherwise.
+	 */
+	uint64_t key;
+
+	/// Length of the collapse key value.
+	size_t key_len;
+
+	/// The items we're keeping for this collapse key value.
+	CollapseData data;
+
+	Entry(uint64_t hash_, uint64_t key_, size_t key_len_,
+	      const Xapian::Internal::MSetItem & item)
+	    : hash(hash_), key(key_), key_len(key_len_), data(item) { }
+    };
+
+    /// The entries in the table, in the order they were added.
+    std::vector<Entry> table;
+
+    /** The hash table slots.
+     *
+     *  Each is 0 for an empty slot, or one more than the index of an entry in
+     *  @a table.  The size is always a power of 2 (or 0 before we've added
+     *  anything) and we use linear probing.
+     */
+    std::vector<uint32_t> slots;
+
+    /// Storage for collapse key values longer than 8 bytes.
+    std::string key_buf;
 
     /// How many items we're currently keeping in @a table.
     Xapian::doccount entry_count;
@@ -117,14 +175,41 @@ class Collapser {
     /** The maximum number of items to keep for each collapse key value. */
     Xapian::doccount collapse_max;
 
+    /// Memory use (in bytes) above which we try to discard entries.
+    size_t memory_limit;
+
+    /** Memory use (in bytes) at which we next try to discard entries.
+     *
+     *  If we can't discard enough, this is raised so we don't keep trying
+     *  to on every new collapse key value.
+     */
+    size_t prune_threshold;
+
+    /// The highest memory use we've seen (in bytes).
+    size_t peak_memory;
+
+    /** Find the slot for a collapse key value.
+     *
+     *  @return The index of the slot containing @a key, or of the empty slot
+     *		where it should be added.
+     */
+    size_t find_slot(const std::string & key, uint64_t hash,
+		     uint64_t packed) const;
+
+    /// Rebuild @a slots with @a new_size slots.
+    void rehash(size_t new_size);
+
+    /// Update @a peak_memory.
+    void update_peak_memory() {
+	size_t used = memory_used();
+	if (used > peak_memory) peak_memory = used;
+    }
+
   public:
     /// Replaced item when REPLACED is returned by @a collapse().
     Xapian::Internal::MSetItem old_item;
 
-    Collapser(Xapian::valueno slot_, Xapian::doccount collapse_max_)
-	: entry_count(0), no_collapse_key(0), dups_ignored(0),
-	  docs_considered(0), slot(slot_), collapse_max(collapse_max_),
-	  old_item(0, 0) { }
+    Collapser(Xapian::valueno slot_, Xapian::doccount collapse_max_);
 
     /// Return true if collapsing is active for this match.
     operator bool() const { return collapse_max != 0; }
@@ -144,6 +229,17 @@ class Collapser {
 			    Xapian::Document::Internal & vsdoc,
 			    const MSetCmp & mcmp);
 
+    /// Return true if we've reached the memory limit.
+    bool over_memory_limit() const { return memory_used() > prune_threshold; }
+
+    /** Discard entries which can't affect the MSet.
+     *
+     *  @param min_weight	The minimum weight a document needs to get
+     *				into the MSet.  Entries where all the items
+     *				kept have a lower weight are discarded.
+     */
+    void prune(double min_weight);
+
     Xapian::doccount get_collapse_count(const std::string & collapse_key,
 					int percent_cutoff,
 					double min_weight) const;
@@ -157,6 +253,17 @@ class Collapser {
     Xapian::doccount get_matches_lower_bound() const;
 
     bool empty() const { return table.empty(); }
+
+    /// Approximate memory used (in bytes).
+    size_t memory_used() const {
+	return table.capacity() * sizeof(Entry) +
+	       slots.capacity() * sizeof(uint32_t) +
+	       key_buf.capacity() +
+	       entry_count * sizeof(Xapian::Internal::MSetItem);
+    }
+
+    /// The highest memory use during the match (in bytes).
+    size_t get_peak_memory() const { return peak_memory; }
 };
 
 #endif // XAPIAN_INCLUDED_COLLAPSER_H
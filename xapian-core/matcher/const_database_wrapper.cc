@@ -139,6 +139,12 @@ ConstDatabaseWrapper::open_allterms(const string & prefix) const
     return realdb->open_allterms(prefix);
 }
 
+TermList *
+ConstDatabaseWrapper::open_wildcard_termlist(const WildcardPattern & pattern) const
+{
+    return realdb->open_wildcard_termlist(pattern);
+}
+
 PositionList *
 ConstDatabaseWrapper::open_position_list(Xapian::docid did,
 					 const string & tname) const
@@ -158,6 +164,13 @@ ConstDatabaseWrapper::open_spelling_termlist(const string & word) const
     return realdb->open_spelling_termlist(word);
 }
 
+TermList *
+ConstDatabaseWrapper::open_spelling_candidates(const string & word,
+					       unsigned max_edit_distance) const
+{
+    return realdb->open_spelling_candidates(word, max_edit_distance);
+}
+
 TermList *
 ConstDatabaseWrapper::open_spelling_wordlist() const
 {
@@ -212,6 +225,12 @@ ConstDatabaseWrapper::get_revision_info() const
     return realdb->get_revision_info();
 }
 
+string
+ConstDatabaseWrapper::get_revision_key() const
+{
+    return realdb->get_revision_key();
+}
+
 string
 ConstDatabaseWrapper::get_uuid() const
 {
@@ -66,11 +66,14 @@ class ConstDatabaseWrapper : public Xapian::Database::Internal {
     ValueList * open_value_list(Xapian::valueno slot) const;
     TermList * open_term_list(Xapian::docid did) const;
     TermList * open_allterms(const string & prefix) const;
+    TermList * open_wildcard_termlist(const WildcardPattern & pattern) const;
     PositionList * open_position_list(Xapian::docid did,
 				      const string & tname) const;
     Xapian::Document::Internal *
 	open_document(Xapian::docid did, bool lazy) const;
     TermList * open_spelling_termlist(const string & word) const;
+    TermList * open_spelling_candidates(const string & word,
+					unsigned max_edit_distance) const;
     TermList * open_spelling_wordlist() const;
     Xapian::doccount get_spelling_frequency(const string & word) const;
     TermList * open_synonym_termlist(const string & term) const;
@@ -80,6 +83,7 @@ class ConstDatabaseWrapper : public Xapian::Database::Internal {
     void request_document(Xapian::docid did) const;
     Xapian::Document::Internal * collect_document(Xapian::docid did) const;
     string get_revision_info() const;
+    string get_revision_key() const;
     string get_uuid() const;
     void invalidate_doc_object(Xapian::Document::Internal * obj) const;
     int get_backend_info(std::string * path) const { return realdb->get_backend_info(path); }
@@ -305,7 +305,7 @@ LocalSubMatch::open_post_list(const string& term,
 	    // (needed for the remote database case).
 	    wt = new LazyWeight(pl, wt, stats, qlen, wqf, factor);
 	}
-	pl->set_termweight(wt);
+	pl->set_termweight(wt, factor);
     }
     RETURN(pl);
 }
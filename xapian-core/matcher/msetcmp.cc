@@ -64,6 +64,8 @@ msetcmp_by_value(const Xapian::Internal::MSetItem &a,
 	if (a.did == 0) return false;
 	if (b.did == 0) return true;
     }
+    if (a.sort_key_prefix != b.sort_key_prefix)
+	return (a.sort_key_prefix > b.sort_key_prefix) == FORWARD_VALUE;
     if (a.sort_key > b.sort_key) return FORWARD_VALUE;
     if (a.sort_key < b.sort_key) return !FORWARD_VALUE;
     return msetcmp_by_did<FORWARD_DID, FORWARD_VALUE>(a, b);
@@ -79,6 +81,8 @@ msetcmp_by_value_then_relevance(const Xapian::Internal::MSetItem &a,
 	if (a.did == 0) return false;
 	if (b.did == 0) return true;
     }
+    if (a.sort_key_prefix != b.sort_key_prefix)
+	return (a.sort_key_prefix > b.sort_key_prefix) == FORWARD_VALUE;
     if (a.sort_key > b.sort_key) return FORWARD_VALUE;
     if (a.sort_key < b.sort_key) return !FORWARD_VALUE;
     if (a.wt > b.wt) return true;
@@ -98,6 +102,8 @@ msetcmp_by_relevance_then_value(const Xapian::Internal::MSetItem &a,
     }
     if (a.wt > b.wt) return true;
     if (a.wt < b.wt) return false;
+    if (a.sort_key_prefix != b.sort_key_prefix)
+	return (a.sort_key_prefix > b.sort_key_prefix) == FORWARD_VALUE;
     if (a.sort_key > b.sort_key) return FORWARD_VALUE;
     if (a.sort_key < b.sort_key) return !FORWARD_VALUE;
     return msetcmp_by_did<FORWARD_DID, FORWARD_VALUE>(a, b);
@@ -25,6 +25,9 @@
 
 #include "api/omenquireinternal.h"
 
+#include <cstdint>
+#include <string>
+
 // typedef for MSetItem comparison function.
 typedef bool (* mset_cmp)(const Xapian::Internal::MSetItem &,
 			  const Xapian::Internal::MSetItem &);
@@ -32,6 +35,25 @@ typedef bool (* mset_cmp)(const Xapian::Internal::MSetItem &,
 /// Select the appropriate msetcmp function.
 mset_cmp get_msetcmp_function(Xapian::Enquire::Internal::sort_setting sort_by, bool sort_forward, bool sort_value_forward);
 
+/** Pack the first 8 bytes of a sort key into an integer.
+ *
+ *  The bytes are packed big-endian and shorter keys are padded with zero
+ *  bytes, so comparing two packed prefixes gives the same order as comparing
+ *  the keys as strings, except that keys with equal prefixes need comparing
+ *  in full.  Serialised numbers from sortable_serialise() and dates like
+ *  "YYYYMMDD" are distinguished by their prefix alone.
+ */
+inline uint64_t
+pack_sort_key_prefix(const std::string & key)
+{
+    uint64_t prefix = 0;
+    for (size_t i = 0; i != 8; ++i) {
+	prefix <<= 8;
+	if (i < key.size()) prefix |= static_cast<unsigned char>(key[i]);
+    }
+    return prefix;
+}
+
 /// MSetItem comparison functor.
 class MSetCmp {
     mset_cmp fn;
@@ -32,6 +32,7 @@
 #include "debuglog.h"
 #include "submatch.h"
 #include "localsubmatch.h"
+#include "parallelsubmatch.h"
 #include "omassert.h"
 #include "api/omenquireinternal.h"
 #include "realtime.h"
@@ -59,6 +60,8 @@
 #include <algorithm>
 #include <cfloat> // For DBL_EPSILON.
 #include <climits> // For UINT_MAX.
+#include <system_error>
+#include <thread>
 #include <vector>
 #include <map>
 #include <set>
@@ -245,6 +248,54 @@ prepare_sub_matches(vector<intrusive_ptr<SubMatch> > & leaves,
     }
 }
 
+/** Run the matches for sub-databases being matched in separate threads.
+ *
+ *  Up to @a max_threads threads are used (including the calling thread), each
+ *  repeatedly taking the next sub-match which hasn't been run yet.
+ */
+static void
+run_parallel_sub_matches(vector<intrusive_ptr<SubMatch> > & leaves,
+			 const vector<bool> & returns_mset,
+			 unsigned max_threads)
+{
+    LOGCALL_STATIC_VOID(MATCH, "run_parallel_sub_matches", leaves | returns_mset | max_threads);
+    vector<ParallelSubMatch *> todo;
+    for (size_t i = 0; i != leaves.size(); ++i) {
+	ParallelSubMatch * submatch =
+	    dynamic_cast<ParallelSubMatch*>(leaves[i].get());
+	if (submatch) {
+	    Assert(returns_mset[i]);
+	    todo.push_back(submatch);
+	}
+    }
+    (void)returns_mset;
+
+    std::atomic<size_t> next(0);
+    auto worker = [&todo, &next]() {
+	size_t i;
+	while ((i = next++) < todo.size()) {
+	    todo[i]->run();
+	}
+    };
+
+    vector<std::thread> threads;
+    size_t n_threads = min(size_t(max_threads), todo.size());
+    while (threads.size() + 1 < n_threads) {
+	try {
+	    threads.emplace_back(worker);
+	} catch (const std::system_error &) {
+	    // We failed to start a thread, so just make do with the threads
+	    // we already have.
+	    break;
+	}
+    }
+    // The calling thread runs sub-matches too.
+    worker();
+    for (auto & t : threads) {
+	t.join();
+    }
+}
+
 /// Class which applies several match spies in turn.
 class MultipleMatchSpy : public Xapian::MatchSpy {
   private:
@@ -289,7 +340,8 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		       Xapian::Weight::Internal & stats,
 		       const Xapian::Weight * weight_,
 		       const vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> & matchspies_,
-		       bool have_sorter, bool have_mdecider)
+		       bool have_sorter, bool have_mdecider,
+		       unsigned max_threads_)
 	: db(db_), query(query_),
 	  collapse_max(collapse_max_), collapse_key(collapse_key_),
 	  percent_cutoff(percent_cutoff_), weight_cutoff(weight_cutoff_),
@@ -298,10 +350,13 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 	  sort_value_forward(sort_value_forward_),
 	  time_limit(time_limit_),
 	  errorhandler(errorhandler_), weight(weight_),
-	  is_remote(db.internal.size()),
+	  returns_mset(db.internal.size()),
+	  max_threads(max_threads_),
+	  parallel_min_weight(0.0),
+	  shared_min_weight(NULL),
 	  matchspies(matchspies_)
 {
-    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | time_limit_| errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider);
+    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | time_limit_| errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider | max_threads_);
 
     if (query.empty()) return;
 
@@ -309,12 +364,43 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
     vector<Xapian::RSet> subrsets;
     split_rset_by_db(omrset, number_of_subdbs, subrsets);
 
+    if (max_threads > 1) {
+	// Sorters and match deciders are user-supplied objects which we can't
+	// assume are safe to call from several threads at once.  Match spies
+	// are OK if each thread can use its own clone.
+	if (have_sorter || have_mdecider ||
+	    !ParallelSubMatch::can_clone_spies(matchspies))
+	    max_threads = 1;
+    }
+
+    if (max_threads > 1) {
+	// A sub-database can only be used from one thread at a time, and
+	// there's no point using threads for fewer than two local
+	// sub-databases.
+	set<const Xapian::Database::Internal *> local_subdbs;
+	size_t local_count = 0;
+	for (size_t i = 0; i != number_of_subdbs; ++i) {
+	    Xapian::Database::Internal *subdb = db.internal[i].get();
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+	    if (subdb->get_backend_info(NULL) == BACKEND_REMOTE) continue;
+#endif
+	    local_subdbs.insert(subdb);
+	    ++local_count;
+	}
+	if (local_count < 2 || local_subdbs.size() != local_count)
+	    max_threads = 1;
+    }
+
+    if (max_threads > 1 && !ParallelSubMatch::can_copy_query(query))
+	max_threads = 1;
+
     for (size_t i = 0; i != number_of_subdbs; ++i) {
 	Xapian::Database::Internal *subdb = db.internal[i].get();
 	Assert(subdb);
 	intrusive_ptr<SubMatch> smatch;
 	try {
-	    // There is currently only one special case, for network databases.
+	    // Remote databases are matched by the remote server, and local
+	    // databases may be matched in a separate thread.
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
 	    if (subdb->get_backend_info(NULL) == BACKEND_REMOTE) {
 		RemoteDatabase *rem_db = static_cast<RemoteDatabase*>(subdb);
@@ -334,17 +420,29 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		bool decreasing_relevance =
 		    (sort_by == REL || sort_by == REL_VAL);
 		smatch = new RemoteSubMatch(rem_db, decreasing_relevance, matchspies);
-		is_remote[i] = true;
+		returns_mset[i] = true;
+	    } else
+#endif /* XAPIAN_HAS_REMOTE_BACKEND */
+	    if (max_threads > 1) {
+		// Only use the shared minimum weight if we're sorting primarily
+		// by relevance, since otherwise the MSet can contain documents
+		// with lower weights.
+		std::atomic<double> * min_weight_ptr = NULL;
+		if (sort_by == REL || sort_by == REL_VAL)
+		    min_weight_ptr = &parallel_min_weight;
+		smatch = new ParallelSubMatch(subdb, query, qlen, subrsets[i],
+					      collapse_max, collapse_key,
+					      percent_cutoff, weight_cutoff,
+					      order, sort_key, sort_by,
+					      sort_value_forward, time_limit,
+					      weight, min_weight_ptr,
+					      matchspies);
+		returns_mset[i] = true;
+		subdb->readahead_for_query(query);
 	    } else {
 		smatch = new LocalSubMatch(subdb, query, qlen, subrsets[i], weight);
 		subdb->readahead_for_query(query);
 	    }
-#else
-	    // Avoid unused parameter warnings.
-	    (void)have_sorter;
-	    (void)have_mdecider;
-	    smatch = new LocalSubMatch(subdb, query, qlen, subrsets[i], weight);
-#endif /* XAPIAN_HAS_REMOTE_BACKEND */
 	} catch (Xapian::Error & e) {
 	    if (!errorhandler) throw;
 	    LOGLINE(EXCEPTION, "Calling error handler for creation of a SubMatch from a database and query.");
@@ -401,8 +499,9 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
     // If there's only one database and it's remote, we can just unserialise
-    // its MSet and return that.
-    if (leaves.size() == 1 && is_remote[0]) {
+    // its MSet and return that.  (A single local database is never matched
+    // in a separate thread.)
+    if (leaves.size() == 1 && returns_mset[0]) {
 	RemoteSubMatch * rem_match;
 	rem_match = static_cast<RemoteSubMatch*>(leaves[0].get());
 	rem_match->start_match(first, maxitems, check_at_least, stats);
@@ -430,23 +529,28 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	}
     }
 
+    if (max_threads > 1) {
+	run_parallel_sub_matches(leaves, returns_mset, max_threads);
+    }
+
     // Get postlists and term info
     vector<PostList *> postlists;
     Xapian::termcount total_subqs = 0;
     // Keep a count of matches which we know exist, but we won't see.  This
-    // occurs when a submatch is remote, and returns a lower bound on the
-    // number of matching documents which is higher than the number of
-    // documents it returns (because it wasn't asked for more documents).
+    // occurs when a submatch returns an MSet (e.g. because it is remote),
+    // and the MSet has a lower bound on the number of matching documents
+    // which is higher than the number of documents it contains (because it
+    // wasn't asked for more documents).
     Xapian::doccount definite_matches_not_seen = 0;
     for (size_t i = 0; i != leaves.size(); ++i) {
 	PostList *pl;
 	try {
 	    pl = leaves[i]->get_postlist(this, &total_subqs);
-	    if (is_remote[i]) {
+	    if (returns_mset[i]) {
 		if (pl->get_termfreq_min() > first + maxitems) {
 		    LOGLINE(MATCH, "Found " <<
 				   pl->get_termfreq_min() - (first + maxitems)
-				   << " definite matches in remote submatch "
+				   << " definite matches in MSet submatch "
 				   "which aren't passed to local match");
 		    definite_matches_not_seen += pl->get_termfreq_min();
 		    definite_matches_not_seen -= first + maxitems;
@@ -484,9 +588,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     Xapian::doccount docs_matched = 0;
     double greatest_wt = 0;
     Xapian::termcount greatest_wt_subqs_matched = 0;
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
     unsigned greatest_wt_subqs_db_num = UINT_MAX;
-#endif
     vector<Xapian::Internal::MSetItem> items;
 
     // maximum weight a document could possibly have
@@ -588,9 +690,21 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     // Is the mset a valid heap?
     bool is_heap = false;
 
+    // Have we started using the minimum weight shared with other threads?
+    bool using_shared_min_weight = false;
+
     while (true) {
 	bool pushback;
 
+	if (using_shared_min_weight) {
+	    double w = shared_min_weight->load(std::memory_order_relaxed);
+	    if (w > min_weight) {
+		LOGLINE(MATCH, "Setting min_weight to " << w << " from " <<
+			min_weight << " (shared)");
+		min_weight = w;
+	    }
+	}
+
 	if (rare(recalculate_w_max)) {
 	    if (min_weight > 0.0) {
 		if (rare(getorrecalc_maxweight(pl.get()) < min_weight)) {
@@ -645,20 +759,40 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	}
 
 	if (sort_by != REL) {
+	    // If the postlist can give us the sort key, we only copy it into
+	    // new_item once we know we need it.
 	    const string * ptr = pl->get_sort_key();
 	    if (ptr) {
-		new_item.sort_key = *ptr;
-	    } else if (sorter) {
-		new_item.sort_key = (*sorter)(doc);
+		new_item.sort_key_prefix = pack_sort_key_prefix(*ptr);
 	    } else {
-		new_item.sort_key = vsdoc.get_value(sort_key);
+		if (sorter) {
+		    new_item.sort_key = (*sorter)(doc);
+		} else {
+		    new_item.sort_key = vsdoc.get_value(sort_key);
+		}
+		new_item.sort_key_prefix =
+		    pack_sort_key_prefix(new_item.sort_key);
 	    }
 
 	    // We're sorting by value (in part at least), so compare the item
 	    // against the lowest currently in the proto-mset.  If sort_by is
 	    // VAL, then new_item.wt won't yet be set, but that doesn't
 	    // matter since it's not used by the sort function.
-	    if (!mcmp(new_item, min_item)) {
+	    bool sorts_lower;
+	    if (sort_by != REL_VAL && min_item.did != 0 &&
+		new_item.sort_key_prefix != min_item.sort_key_prefix) {
+		// The packed prefixes differ, so they decide the order without
+		// needing the full key.
+		sorts_lower = (new_item.sort_key_prefix >
+			       min_item.sort_key_prefix) != sort_value_forward;
+	    } else {
+		if (ptr) {
+		    new_item.sort_key = *ptr;
+		    ptr = NULL;
+		}
+		sorts_lower = !mcmp(new_item, min_item);
+	    }
+	    if (sorts_lower) {
 		if (mdecider == NULL && !collapser) {
 		    // Document was definitely suitable for mset - no more
 		    // processing needed.
@@ -666,7 +800,12 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		    ++docs_matched;
 		    if (!calculated_weight) wt = pl->get_weight();
 		    if (matchspy) {
-			matchspy->operator()(doc, wt);
+			const unsigned int multiplier = db.internal.size();
+			Xapian::doccount n = (did - 1) % multiplier;
+			// The spy has already seen documents from remote and
+			// parallel sub-databases.
+			if (!returns_mset[n])
+			    matchspy->operator()(doc, wt);
 		    }
 		    if (wt > greatest_wt) goto new_greatest_weight;
 		    continue;
@@ -684,6 +823,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		// collapsed.
 		LOGLINE(MATCH, "Keeping candidate which sorts lower than min_item for further investigation");
 	    }
+	    if (ptr) new_item.sort_key = *ptr;
 	}
 
 	// Use the match spy and/or decision functors (if specified).
@@ -693,7 +833,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	    Xapian::doccount n = (did - 1) % multiplier; // which actual database
 	    // If the results are from a remote database, then the functor will
 	    // already have been applied there so we can skip this step.
-	    if (!is_remote[n]) {
+	    if (!returns_mset[n]) {
 		++decider_considered;
 		if (mdecider && !mdecider->operator()(doc)) {
 		    ++decider_denied;
@@ -722,6 +862,11 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	if (collapser) {
 	    collapse_result res;
 	    res = collapser.process(new_item, pl.get(), vsdoc, mcmp);
+	    if (rare(collapser.over_memory_limit())) {
+		// Documents with less than min_weight can't make it into the
+		// MSet, so the collapser can forget about those it has kept.
+		collapser.prune(min_weight);
+	    }
 	    if (res == REJECTED) {
 		// If we're sorting by relevance primarily, then we throw away
 		// the lower weighted document anyway.
@@ -806,6 +951,16 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 				    min_item.wt << " from " << min_weight);
 			    min_weight = min_item.wt;
 			}
+			if (shared_min_weight) {
+			    // Our MSet is full and we've seen enough matches,
+			    // so other threads can use our minimum weight, and
+			    // we can use theirs.
+			    double w = shared_min_weight->load();
+			    while (w < min_weight &&
+				   !shared_min_weight->compare_exchange_weak(w, min_weight)) {
+			    }
+			    using_shared_min_weight = true;
+			}
 		    }
 		}
 		if (rare(getorrecalc_maxweight(pl.get()) < min_weight)) {
@@ -837,20 +992,15 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	if (wt > greatest_wt) {
 new_greatest_weight:
 	    greatest_wt = wt;
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 	    const unsigned int multiplier = db.internal.size();
 	    unsigned int db_num = (did - 1) % multiplier;
-	    if (is_remote[db_num]) {
-		// Note that the greatest weighted document came from a remote
-		// database, and which one.
+	    if (returns_mset[db_num]) {
+		// Note that the greatest weighted document came from an MSet
+		// returned by a submatch, and which one.
 		greatest_wt_subqs_db_num = db_num;
-	    } else
-#endif
-	    {
+	    } else {
 		greatest_wt_subqs_matched = pl->count_matching_subqs();
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 		greatest_wt_subqs_db_num = UINT_MAX;
-#endif
 	    }
 	    if (percent_cutoff) {
 		double w = wt * percent_cutoff_factor;
@@ -883,15 +1033,10 @@ new_greatest_weight:
 
     double percent_scale = 0;
     if (!items.empty() && greatest_wt > 0) {
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 	if (greatest_wt_subqs_db_num != UINT_MAX) {
 	    const unsigned int n = greatest_wt_subqs_db_num;
-	    RemoteSubMatch * rem_match;
-	    rem_match = static_cast<RemoteSubMatch*>(leaves[n].get());
-	    percent_scale = rem_match->get_percent_factor() / 100.0;
-	} else
-#endif
-	{
+	    percent_scale = leaves[n]->get_percent_factor() / 100.0;
+	} else {
 	    percent_scale = greatest_wt_subqs_matched / double(total_subqs);
 	    percent_scale /= greatest_wt;
 	}
@@ -1166,4 +1311,5 @@ new_greatest_weight:
 				       uncollapsed_estimated,
 				       max_possible, greatest_wt, items,
 				       percent_scale * 100.0);
+    mset.internal->collapse_memory = collapser.get_peak_memory();
 }
@@ -26,6 +26,7 @@
 
 #include "submatch.h"
 
+#include <atomic>
 #include <vector>
 
 #include "xapian/query.h"
@@ -70,8 +71,32 @@ class MultiMatch
 	 */
 	bool recalculate_w_max;
 
-	/** Is each sub-database remote? */
-	vector<bool> is_remote;
+	/** Does the SubMatch for each sub-database return an MSet?
+	 *
+	 *  This is true for remote databases, and for local databases which
+	 *  are matched in a separate thread.
+	 */
+	vector<bool> returns_mset;
+
+	/** Maximum number of threads to use for matching local databases.
+	 *
+	 *  If this is 1, all matching is done in the calling thread.
+	 */
+	unsigned max_threads;
+
+	/** Minimum weight shared between threads matching sub-databases.
+	 *
+	 *  This is the greatest minimum weight any of the threads has found,
+	 *  which is a lower bound on the minimum weight for the combined MSet.
+	 */
+	std::atomic<double> parallel_min_weight;
+
+	/** If not NULL, shared minimum weight to update and use.
+	 *
+	 *  This is set for a MultiMatch running in one of the threads which a
+	 *  parent MultiMatch uses to match its local sub-databases.
+	 */
+	std::atomic<double> * shared_min_weight;
 
 	/// The matchspies to use.
 	const vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> & matchspies;
@@ -103,6 +128,8 @@ class MultiMatch
 	 *  @param matchspies_ Any the MatchSpy objects in use.
 	 *  @param have_sorter Is there a sorter in use?
 	 *  @param have_mdecider Is there a Xapian::MatchDecider in use?
+	 *  @param max_threads_ Maximum number of threads to use for matching
+	 *			local sub-databases (default 1).
 	 */
 	MultiMatch(const Xapian::Database &db_,
 		   const Xapian::Query & query,
@@ -121,7 +148,8 @@ class MultiMatch
 		   Xapian::Weight::Internal & stats,
 		   const Xapian::Weight *wtscheme,
 		   const vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> & matchspies_,
-		   bool have_sorter, bool have_mdecider);
+		   bool have_sorter, bool have_mdecider,
+		   unsigned max_threads_ = 1);
 
 	/** Run the match and generate an MSet object.
 	 *
@@ -135,6 +163,17 @@ class MultiMatch
 		      const Xapian::MatchDecider * mdecider,
 		      const Xapian::KeyMaker * sorter);
 
+	/** Share the minimum weight with MultiMatch objects in other threads.
+	 *
+	 *  This is used when matching a sub-database in a separate thread.
+	 *  Once this matcher has found enough matches, it raises the shared
+	 *  value to its own minimum weight, and adopts the shared value if
+	 *  another thread has found a higher one.
+	 */
+	void set_shared_min_weight(std::atomic<double> * shared_min_weight_) {
+	    shared_min_weight = shared_min_weight_;
+	}
+
 	/** Called by postlists to indicate that they've rearranged themselves
 	 *  and the maxweight now possible is smaller.
 	 */
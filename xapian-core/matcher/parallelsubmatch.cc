@@ -0,0 +1,192 @@
+/** @file parallelsubmatch.cc
+ *  @brief SubMatch class for matching a local database in another thread.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "parallelsubmatch.h"
+
+#include "debuglog.h"
+#include "msetpostlist.h"
+#include "omassert.h"
+
+#include "xapian/error.h"
+
+#include <map>
+#include <string>
+
+using namespace std;
+
+/// Make a copy of @a query which shares no Query::Internal objects with it.
+static Xapian::Query
+copy_query(const Xapian::Query & query)
+{
+    return Xapian::Query::unserialise(query.serialise());
+}
+
+ParallelSubMatch::ParallelSubMatch(Xapian::Database::Internal * subdb,
+				   const Xapian::Query & query_,
+				   Xapian::termcount qlen,
+				   const Xapian::RSet & rset,
+				   Xapian::doccount collapse_max,
+				   Xapian::valueno collapse_key,
+				   int percent_cutoff,
+				   double weight_cutoff,
+				   Xapian::Enquire::docid_order order,
+				   Xapian::valueno sort_key,
+				   Xapian::Enquire::Internal::sort_setting sort_by,
+				   bool sort_value_forward,
+				   double time_limit,
+				   const Xapian::Weight * wtscheme,
+				   std::atomic<double> * shared_min_weight,
+				   const vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> & matchspies_)
+    : db(subdb),
+      query(copy_query(query_)),
+      wt(wtscheme->clone()),
+      matchspies(matchspies_),
+      total_stats(NULL),
+      maxitems(0),
+      check_at_least(0),
+      decreasing_relevance(sort_by == Xapian::Enquire::Internal::REL ||
+			   sort_by == Xapian::Enquire::Internal::REL_VAL),
+      percent_factor(0.0)
+{
+    LOGCALL_CTOR(MATCH, "ParallelSubMatch", subdb | query_ | qlen | rset | collapse_max | collapse_key | percent_cutoff | weight_cutoff | int(order) | sort_key | int(sort_by) | sort_value_forward | time_limit | wtscheme | shared_min_weight | matchspies_);
+    for (auto i : matchspies) {
+	spies.push_back(i->clone()->release());
+    }
+    // The sub-database's statistics are gathered here, in the calling
+    // thread, much as the remote server does when it receives the query.
+    match.reset(new MultiMatch(db, query, qlen, &rset,
+			       collapse_max, collapse_key,
+			       percent_cutoff, weight_cutoff,
+			       order, sort_key, sort_by, sort_value_forward,
+			       time_limit, NULL, local_stats, wt.get(),
+			       spies, false, false));
+    match->set_shared_min_weight(shared_min_weight);
+}
+
+bool
+ParallelSubMatch::can_copy_query(const Xapian::Query & query)
+{
+    LOGCALL_STATIC(MATCH, bool, "ParallelSubMatch::can_copy_query", query);
+    try {
+	(void)copy_query(query);
+    } catch (const Xapian::UnimplementedError &) {
+	// A PostingSource which doesn't support serialisation.
+	RETURN(false);
+    } catch (const Xapian::InvalidArgumentError &) {
+	// A PostingSource which isn't registered.
+	RETURN(false);
+    }
+    RETURN(true);
+}
+
+bool
+ParallelSubMatch::can_clone_spies(const vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> & matchspies)
+{
+    LOGCALL_STATIC(MATCH, bool, "ParallelSubMatch::can_clone_spies", matchspies);
+    try {
+	for (auto i : matchspies) {
+	    AutoPtr<Xapian::MatchSpy> spy(i->clone());
+	    (void)spy->serialise_results();
+	}
+    } catch (const Xapian::UnimplementedError &) {
+	RETURN(false);
+    }
+    RETURN(true);
+}
+
+bool
+ParallelSubMatch::prepare_match(bool nowait,
+				Xapian::Weight::Internal & total_stats_)
+{
+    LOGCALL(MATCH, bool, "ParallelSubMatch::prepare_match", nowait | total_stats_);
+    (void)nowait;
+    total_stats_ += local_stats;
+    RETURN(true);
+}
+
+void
+ParallelSubMatch::start_match(Xapian::doccount first,
+			      Xapian::doccount maxitems_,
+			      Xapian::doccount check_at_least_,
+			      Xapian::Weight::Internal & total_stats_)
+{
+    LOGCALL_VOID(MATCH, "ParallelSubMatch::start_match", first | maxitems_ | check_at_least_ | total_stats_);
+    AssertEq(first, 0);
+    (void)first;
+    maxitems = maxitems_;
+    check_at_least = check_at_least_;
+    total_stats = &total_stats_;
+    // The thread needs its own copy of the statistics as building the
+    // postlist tree updates them.  We keep the bounds from the combined
+    // database so the max_part values we pass back agree with those a
+    // LocalSubMatch would report, but look them up here as the thread
+    // mustn't access the other sub-databases.  Database and Query objects
+    // use non-atomic reference counts, so the copy mustn't share those
+    // with the caller either.
+    total_stats_.cache_bounds();
+    stats = total_stats_;
+    stats.db = Xapian::Database();
+    stats.query = query;
+}
+
+void
+ParallelSubMatch::run()
+{
+    LOGCALL_VOID(MATCH, "ParallelSubMatch::run", NO_ARGS);
+    try {
+	match->get_mset(0, maxitems, check_at_least, mset, stats, NULL, NULL);
+    } catch (...) {
+	error = std::current_exception();
+    }
+}
+
+PostList *
+ParallelSubMatch::get_postlist(MultiMatch * matcher,
+			       Xapian::termcount * total_subqs_ptr)
+{
+    LOGCALL(MATCH, PostList *, "ParallelSubMatch::get_postlist", matcher | total_subqs_ptr);
+    (void)matcher;
+    if (error) {
+	std::exception_ptr e;
+	swap(e, error);
+	std::rethrow_exception(e);
+    }
+
+    // Pass back the weight contributions for the query terms, which are
+    // reported via MSet::get_termweight().
+    Assert(total_stats);
+    map<string, TermFreqs>::const_iterator i;
+    for (i = stats.termfreqs.begin(); i != stats.termfreqs.end(); ++i) {
+	if (i->second.max_part != 0.0)
+	    total_stats->set_max_part(i->first, i->second.max_part);
+    }
+
+    // Merge in what our clones of the match spies saw.
+    for (size_t j = 0; j != spies.size(); ++j) {
+	matchspies[j]->merge_results(spies[j]->serialise_results());
+    }
+
+    percent_factor = mset.internal->percent_factor;
+    // As for remote databases, we report percent_factor rather than
+    // counting the number of subqueries.
+    (void)total_subqs_ptr;
+    RETURN(new MSetPostList(mset, decreasing_relevance));
+}
@@ -0,0 +1,168 @@
+/** @file parallelsubmatch.h
+ *  @brief SubMatch class for matching a local database in another thread.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_PARALLELSUBMATCH_H
+#define XAPIAN_INCLUDED_PARALLELSUBMATCH_H
+
+#include "submatch.h"
+
+#include "autoptr.h"
+#include "multimatch.h"
+#include "weight/weightinternal.h"
+#include "xapian/database.h"
+#include "xapian/enquire.h"
+#include "xapian/matchspy.h"
+#include "xapian/query.h"
+
+#include <atomic>
+#include <exception>
+#include <vector>
+
+/** Class for matching a local database in a separate thread.
+ *
+ *  This works much like RemoteSubMatch - the sub-database is searched by its
+ *  own MultiMatch object and the resulting MSet is merged with those from
+ *  the other sub-databases.  The difference is that the MultiMatch runs when
+ *  run() is called (from a worker thread) rather than in a remote server.
+ *
+ *  Everything which run() uses is private to this object, apart from the
+ *  sub-database itself, so the caller must ensure that each sub-database is
+ *  only being searched by one ParallelSubMatch at once.
+ */
+class ParallelSubMatch : public SubMatch {
+    /// Don't allow assignment.
+    void operator=(const ParallelSubMatch &);
+
+    /// Don't allow copying.
+    ParallelSubMatch(const ParallelSubMatch &);
+
+    /// Database object containing just the sub-database to search.
+    Xapian::Database db;
+
+    /** Our own copy of the query.
+     *
+     *  Query objects use non-atomic reference counts, so the thread
+     *  running the match can't share the caller's query.
+     */
+    Xapian::Query query;
+
+    /// Our own copy of the weighting scheme.
+    AutoPtr<Xapian::Weight> wt;
+
+    /// Our own clones of the match spies, used by the thread.
+    std::vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> spies;
+
+    /// The caller's match spies, which our spies' results are merged into.
+    const std::vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> & matchspies;
+
+    /// The statistics for just this sub-database.
+    Xapian::Weight::Internal local_stats;
+
+    /// The MultiMatch object which searches the sub-database.
+    AutoPtr<MultiMatch> match;
+
+    /// Copy of the total statistics for the thread to use.
+    Xapian::Weight::Internal stats;
+
+    /// The total statistics, which we add our max_part values to.
+    Xapian::Weight::Internal * total_stats;
+
+    /// The number of items to ask the sub-database for.
+    Xapian::doccount maxitems;
+
+    /// The minimum number of items to check in the sub-database.
+    Xapian::doccount check_at_least;
+
+    /** Is the sort order such the relevance decreases down the MSet?
+     *
+     *  This is true for sort_by_relevance and sort_by_relevance_then_value.
+     */
+    bool decreasing_relevance;
+
+    /// The MSet from the sub-database, set by run().
+    Xapian::MSet mset;
+
+    /// Any exception thrown by the match in run().
+    std::exception_ptr error;
+
+    /// The factor to use to convert weights to percentages.
+    double percent_factor;
+
+  public:
+    /// Constructor.
+    ParallelSubMatch(Xapian::Database::Internal * subdb,
+		     const Xapian::Query & query_,
+		     Xapian::termcount qlen,
+		     const Xapian::RSet & rset,
+		     Xapian::doccount collapse_max,
+		     Xapian::valueno collapse_key,
+		     int percent_cutoff,
+		     double weight_cutoff,
+		     Xapian::Enquire::docid_order order,
+		     Xapian::valueno sort_key,
+		     Xapian::Enquire::Internal::sort_setting sort_by,
+		     bool sort_value_forward,
+		     double time_limit,
+		     const Xapian::Weight * wtscheme,
+		     std::atomic<double> * shared_min_weight,
+		     const std::vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> & matchspies_);
+
+    /** Check if we can make a private copy of a query.
+     *
+     *  The copy is made by serialising and unserialising the query, so this
+     *  fails for queries containing a PostingSource subclass which doesn't
+     *  support serialisation, or isn't known to the default Registry.
+     */
+    static bool can_copy_query(const Xapian::Query & query);
+
+    /** Check if match spies can be used from a separate thread.
+     *
+     *  Each thread uses its own clone of each spy, and the results are
+     *  merged using serialise_results() and merge_results() (as for a
+     *  remote database), so this fails for spies which don't implement
+     *  clone() or serialise_results().
+     */
+    static bool can_clone_spies(const std::vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> & matchspies);
+
+    /// Fetch and collate statistics.
+    bool prepare_match(bool nowait, Xapian::Weight::Internal & total_stats_);
+
+    /// Start the match.
+    void start_match(Xapian::doccount first,
+		     Xapian::doccount maxitems_,
+		     Xapian::doccount check_at_least_,
+		     Xapian::Weight::Internal & total_stats_);
+
+    /** Run the match against the sub-database.
+     *
+     *  This is called between start_match() and get_postlist(), and may be
+     *  called from any thread.  Any exception thrown is caught and rethrown
+     *  by get_postlist().
+     */
+    void run();
+
+    /// Get PostList.
+    PostList * get_postlist(MultiMatch * matcher,
+			    Xapian::termcount * total_subqs_ptr);
+
+    /// Get percentage factor - only valid after get_postlist().
+    double get_percent_factor() const { return percent_factor; }
+};
+
+#endif // XAPIAN_INCLUDED_PARALLELSUBMATCH_H
@@ -35,11 +35,13 @@ ValueGePostList::next(double)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->next();
+    // An empty upper bound means there's no upper bound.
+    bool in_range = valuelist->next_in_range(begin, string());
     while (!valuelist->at_end()) {
+	if (in_range) return NULL;
 	const string & v = valuelist->get_value();
 	if (v >= begin) return NULL;
-	valuelist->next();
+	in_range = valuelist->next_in_range(begin, string());
     }
     db = NULL;
     return NULL;
@@ -50,11 +52,12 @@ ValueGePostList::skip_to(Xapian::docid did, double)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->skip_to(did);
+    bool in_range = valuelist->skip_to_in_range(did, begin, string());
     while (!valuelist->at_end()) {
+	if (in_range) return NULL;
 	const string & v = valuelist->get_value();
 	if (v >= begin) return NULL;
-	valuelist->next();
+	in_range = valuelist->next_in_range(begin, string());
     }
     db = NULL;
     return NULL;
@@ -46,9 +46,7 @@ Xapian::doccount
 ValueRangePostList::get_termfreq_est() const
 {
     AssertParanoid(!db || db_size == db->get_doccount());
-    // FIXME: It's hard to estimate well - perhaps consider the values of
-    // begin and end?
-    return db_size / 2;
+    return termfreq_est;
 }
 
 TermFreqs
@@ -56,11 +54,12 @@ ValueRangePostList::get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const
 {
     LOGCALL(MATCH, TermFreqs, "ValueRangePostList::get_termfreq_est_using_stats", stats);
-    // FIXME: It's hard to estimate well - perhaps consider the values of
-    // begin and end?
-    RETURN(TermFreqs(stats.collection_size / 2,
-		     stats.rset_size / 2,
-		     stats.total_term_count / 2));
+    // Scale the statistics by the proportion of this database which we
+    // estimate matches.
+    double ratio = db_size ? double(termfreq_est) / db_size : 0.5;
+    RETURN(TermFreqs(Xapian::doccount(stats.collection_size * ratio + 0.5),
+		     Xapian::doccount(stats.rset_size * ratio + 0.5),
+		     Xapian::termcount(stats.total_term_count * ratio + 0.5)));
 }
 
 Xapian::doccount
@@ -130,14 +129,21 @@ PostList *
 ValueRangePostList::next(double)
 {
     Assert(db);
+    if (rare(end.empty())) {
+	// Empty values aren't stored, and an empty upper bound means "no upper
+	// bound" to next_in_range(), so handle this case specially.
+	db = NULL;
+	return NULL;
+    }
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->next();
+    bool in_range = valuelist->next_in_range(begin, end);
     while (!valuelist->at_end()) {
+	if (in_range) return NULL;
 	const string & v = valuelist->get_value();
 	if (v >= begin && v <= end) {
 	    return NULL;
 	}
-	valuelist->next();
+	in_range = valuelist->next_in_range(begin, end);
     }
     db = NULL;
     return NULL;
@@ -147,14 +153,20 @@ PostList *
 ValueRangePostList::skip_to(Xapian::docid did, double)
 {
     Assert(db);
+    if (rare(end.empty())) {
+	// See the comment in next().
+	db = NULL;
+	return NULL;
+    }
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->skip_to(did);
+    bool in_range = valuelist->skip_to_in_range(did, begin, end);
     while (!valuelist->at_end()) {
+	if (in_range) return NULL;
 	const string & v = valuelist->get_value();
 	if (v >= begin && v <= end) {
 	    return NULL;
 	}
-	valuelist->next();
+	in_range = valuelist->next_in_range(begin, end);
     }
     db = NULL;
     return NULL;
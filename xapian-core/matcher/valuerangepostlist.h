@@ -37,6 +37,9 @@ class ValueRangePostList : public PostList {
 
     Xapian::doccount db_size;
 
+    /// Estimate of how many documents match.
+    Xapian::doccount termfreq_est;
+
     ValueList * valuelist;
 
     /// Disallow copying.
@@ -50,7 +53,9 @@ class ValueRangePostList : public PostList {
 		       Xapian::valueno slot_,
 		       const std::string &begin_, const std::string &end_)
 	: db(db_), slot(slot_), begin(begin_), end(end_),
-	  db_size(db->get_doccount()), valuelist(0) { }
+	  db_size(db->get_doccount()),
+	  termfreq_est(db->estimate_value_freq(slot, begin, end)),
+	  valuelist(0) { }
 
     ~ValueRangePostList();
 
@@ -60,37 +60,52 @@ struct ConnectionClosed { };
 RemoteServer::RemoteServer(const std::vector<std::string> &dbpaths,
 			   int fdin_, int fdout_,
 			   double active_timeout_, double idle_timeout_,
-			   bool writable_)
+			   bool writable_, Xapian::Database * db_)
     : RemoteConnection(fdin_, fdout_, std::string()),
-      db(NULL), wdb(NULL), writable(writable_),
+      db(db_), wdb(NULL), writable(writable_),
       active_timeout(active_timeout_), idle_timeout(idle_timeout_)
 {
     // Catch errors opening the database and propagate them to the client.
     try {
 	Assert(!dbpaths.empty());
-	// We always open the database read-only to start with.  If we're
-	// writable, the client can ask to be upgraded to write access once
-	// connected if it wants it.
-	db = new Xapian::Database(dbpaths[0]);
 	// Build a better description than Database::get_description() gives
 	// in the variable context.  FIXME: improve Database::get_description()
 	// and then just use that instead.
 	context = dbpaths[0];
-
 	if (!writable) {
 	    vector<std::string>::const_iterator i(dbpaths.begin());
 	    for (++i; i != dbpaths.end(); ++i) {
-		db->add_database(Xapian::Database(*i));
 		context += ' ';
 		context += *i;
 	    }
 	} else {
 	    AssertEq(dbpaths.size(), 1); // Expecting exactly one database.
 	}
+
+	if (db) {
+	    // Make sure we see the same revision that opening the database
+	    // afresh would.
+	    db->reopen();
+	} else {
+	    // We always open the database read-only to start with.  If we're
+	    // writable, the client can ask to be upgraded to write access once
+	    // connected if it wants it.
+	    db = new Xapian::Database(dbpaths[0]);
+	    if (!writable) {
+		vector<std::string>::const_iterator i(dbpaths.begin());
+		for (++i; i != dbpaths.end(); ++i) {
+		    db->add_database(Xapian::Database(*i));
+		}
+	    }
+	}
     } catch (const Xapian::Error &err) {
+	delete db;
+	db = NULL;
 	// Propagate the exception to the client.
 	send_message(REPLY_EXCEPTION, serialise_error(err));
-	// And rethrow it so our caller can log it and close the connection.
+	// Our destructor won't be called, so close the connection here, and
+	// rethrow the exception so our caller can log it.
+	do_close(false);
 	throw;
     }
 
@@ -107,10 +122,22 @@ RemoteServer::RemoteServer(const std::vector<std::string> &dbpaths,
 
 RemoteServer::~RemoteServer()
 {
+    // Close the connection if the client didn't.  It's important the fds are
+    // only closed once, since another thread may already have reused them.
+    do_close(false);
     delete db;
     // wdb is either NULL or equal to db, so we shouldn't delete it too!
 }
 
+Xapian::Database *
+RemoteServer::release_database()
+{
+    if (wdb) return NULL;
+    Xapian::Database * result = db;
+    db = NULL;
+    return result;
+}
+
 message_type
 RemoteServer::get_message(double timeout, string & result,
 			  message_type required_type)
@@ -182,14 +182,19 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
      *  @param idle_timeout_	Timeout while waiting for a new action from
      *			the client (specified in seconds).
      *  @param writable Should the database be opened for writing?
+     *  @param db_	A read-only database already opened on @a dbpaths (by
+     *			an earlier RemoteServer) to use instead of opening it
+     *			again, or NULL to open it.  It is reopened to bring it
+     *			up to date, and this object takes ownership of it.
      */
     RemoteServer(const std::vector<std::string> &dbpaths,
 		 int fdin, int fdout,
 		 double active_timeout_,
 		 double idle_timeout_,
-		 bool writable = false);
+		 bool writable = false,
+		 Xapian::Database * db_ = NULL);
 
-    /// Destructor.
+    /// Destructor, which closes the connection if it's still open.
     ~RemoteServer();
 
     /** Repeatedly accept messages from the client and process them.
@@ -199,6 +204,16 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
      */
     void run();
 
+    /** Release ownership of the read-only database.
+     *
+     *  This allows the caller to pass it to a RemoteServer for a later
+     *  connection.
+     *
+     *  @return The database, or NULL if the client upgraded to write access
+     *		(in which case the read-only database has been closed).
+     */
+    Xapian::Database * release_database();
+
     /// Get the registry used for (un)serialisation.
     const Xapian::Registry & get_registry() const { return reg; }
 
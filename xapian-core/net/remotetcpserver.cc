@@ -43,14 +43,56 @@ RemoteTcpServer::RemoteTcpServer(const vector<std::string> &dbpaths_,
 {
 }
 
+RemoteTcpServer::~RemoteTcpServer()
+{
+    for (auto db : idle_dbs) delete db;
+}
+
+/// Give a RemoteServer a copy of a registry for as long as this object exists.
+class RegistryCopy {
+    RemoteServer & server;
+
+    std::mutex & reg_mutex;
+
+  public:
+    RegistryCopy(RemoteServer & server_, const Xapian::Registry & reg,
+		 std::mutex & reg_mutex_)
+	: server(server_), reg_mutex(reg_mutex_)
+    {
+	lock_guard<mutex> lock(reg_mutex);
+	server.set_registry(reg);
+    }
+
+    ~RegistryCopy() {
+	// Drop the server's reference to the shared registry while we hold
+	// the lock.
+	Xapian::Registry unshared;
+	lock_guard<mutex> lock(reg_mutex);
+	server.set_registry(unshared);
+    }
+};
+
 void
 RemoteTcpServer::handle_one_connection(int socket)
 {
+    Xapian::Database * db = NULL;
+    {
+	lock_guard<mutex> lock(idle_dbs_mutex);
+	if (!idle_dbs.empty()) {
+	    db = idle_dbs.back();
+	    idle_dbs.pop_back();
+	}
+    }
     try {
 	RemoteServer sserv(dbpaths, socket, socket,
-			   active_timeout, idle_timeout, writable);
-	sserv.set_registry(reg);
+			   active_timeout, idle_timeout, writable, db);
+	RegistryCopy reg_copy(sserv, reg, reg_mutex);
 	sserv.run();
+	db = sserv.release_database();
+	if (db) {
+	    lock_guard<mutex> lock(idle_dbs_mutex);
+	    idle_dbs.push_back(db);
+	}
     } catch (const Xapian::NetworkTimeoutError &e) {
 	if (verbose)
 	    cerr << "Connection timed out: " << e.get_description() << endl;
@@ -27,6 +27,7 @@
 #include <xapian/registry.h>
 #include <xapian/visibility.h>
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -59,6 +60,24 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
     /** Registry used for (un)serialisation. */
     Xapian::Registry reg;
 
+    /** Mutex serialising copies of reg.
+     *
+     *  Registry uses a non-atomic reference count, so when connections are
+     *  handled by threads, copying reg into each connection's RemoteServer
+     *  and releasing that copy mustn't happen in two threads at once.
+     */
+    std::mutex reg_mutex;
+
+    /** Databases opened for earlier connections which aren't in use.
+     *
+     *  When connections are handled by threads in this process we reuse
+     *  these rather than opening the databases again for each connection.
+     */
+    std::vector<Xapian::Database *> idle_dbs;
+
+    /// Mutex protecting idle_dbs.
+    std::mutex idle_dbs_mutex;
+
     /** Accept a connection and return the filedescriptor for it. */
     int accept_connection();
 
@@ -82,6 +101,9 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
 		    double active_timeout, double idle_timeout,
 		    bool writable, bool verbose);
 
+    /// Destructor.
+    ~RemoteTcpServer();
+
     /// Set the registry used for (un)serialisation.
     void set_registry(const Xapian::Registry & reg_) { reg = reg_; }
 
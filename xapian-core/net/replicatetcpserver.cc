@@ -64,4 +64,6 @@ ReplicateTcpServer::handle_one_connection(int socket)
     } catch (...) {
 	// Ignore exceptions.
     }
+    // This is a no-op if the client already closed the connection.
+    client.do_close(false);
 }
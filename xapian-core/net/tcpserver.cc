@@ -47,7 +47,12 @@
 # include <sys/wait.h>
 #endif
 
+#include <chrono>
+#include <exception>
 #include <iostream>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 #include <cstring>
 #include <cstdio> // For sprintf() on __WIN32__ or cygwin.
@@ -260,6 +265,7 @@ TcpServer::accept_connection()
     }
 
     if (remote_address_size != sizeof(remote_address)) {
+	CLOSESOCKET(con_socket);
 	throw Xapian::NetworkError("accept: unexpected remote address size");
     }
 
@@ -271,16 +277,21 @@ TcpServer::accept_connection()
 	// non-const second parameter in case it's more widespread.
 	void * src = &remote_address.sin_addr;
 	const char * r = inet_ntop(AF_INET, src, buf, sizeof(buf));
-	if (!r)
-	    throw Xapian::NetworkError("inet_ntop failed", errno);
+	if (!r) {
+	    int saved_errno = errno;
+	    CLOSESOCKET(con_socket);
+	    throw Xapian::NetworkError("inet_ntop failed", saved_errno);
+	}
 #else
 	// inet_ntop() isn't always available, at least with mingw.
 	// WSAAddressToString() supports both IPv4 and IPv6, so just use that.
 	DWORD size = sizeof(buf);
 	if (WSAAddressToString(reinterpret_cast<sockaddr*>(&remote_address),
 			       sizeof(remote_address), NULL, buf, &size) != 0) {
+	    int saved_errno = WSAGetLastError();
+	    CLOSESOCKET(con_socket);
 	    throw Xapian::NetworkError("WSAAddressToString failed",
-				       WSAGetLastError());
+				       saved_errno);
 	}
 	const char * r = buf;
 #endif
@@ -311,7 +322,6 @@ TcpServer::run_once()
 	close(listen_socket);
 
 	handle_one_connection(connected_socket);
-	close(connected_socket);
 
 	if (verbose) cout << "Connection closed." << endl;
 	exit(0);
@@ -450,7 +460,6 @@ run_thread(void * param_)
     int socket = param->connected_socket;
 
     param->server->handle_one_connection(socket);
-    closesocket(socket);
 
     delete param;
 
@@ -509,9 +518,71 @@ TcpServer::run_once()
     // Run a single request on the current thread.
     int fd = accept_connection();
     handle_one_connection(fd);
-    closesocket(fd);
 }
 
 #else
 # error Neither HAVE_FORK nor __WIN32__ are defined.
 #endif
+
+void
+TcpServer::serve_connections()
+{
+    while (true) {
+	int connected_socket;
+	try {
+	    connected_socket = accept_connection();
+	} catch (const Xapian::Error &e) {
+	    // accept() can fail for reasons which won't stop later calls
+	    // working (e.g. the client has already given up, or we've run out
+	    // of fds until another connection is closed), so report the error
+	    // and carry on.  Pause briefly so a persistent failure doesn't
+	    // make us spin.
+	    cerr << "Failed to accept connection: " << e.get_description()
+		 << endl;
+	    this_thread::sleep_for(chrono::milliseconds(100));
+	    continue;
+	}
+	if (connected_socket == -1)
+	    return; // Shutdown has happened (only under __WIN32__).
+
+	// handle_one_connection() closes the socket even if it throws, so an
+	// error here only affects this client.
+	try {
+	    handle_one_connection(connected_socket);
+	    if (verbose) cout << "Connection closed." << endl;
+	} catch (const Xapian::Error &e) {
+	    cerr << "Error handling connection: " << e.get_description()
+		 << endl;
+	} catch (const exception &e) {
+	    cerr << "Error handling connection: " << e.what() << endl;
+	} catch (...) {
+	    cerr << "Unknown exception handling connection" << endl;
+	}
+    }
+}
+
+void
+TcpServer::run_threads(unsigned num_threads)
+{
+    // Handle connections until shutdown.  Each thread waits in accept() on
+    // the listening socket, and serves the connection it gets before going
+    // back to wait for another, so at most num_threads connections are
+    // served at once and any others wait in the listen queue.
+    vector<thread> threads;
+    threads.reserve(num_threads - 1);
+    try {
+	while (threads.size() + 1 < num_threads)
+	    threads.push_back(thread(&TcpServer::serve_connections, this));
+    } catch (const system_error & e) {
+	if (threads.empty())
+	    throw Xapian::NetworkError("Couldn't create thread",
+				       e.code().value());
+	cerr << "Only managed to create " << threads.size() + 1 << " threads: "
+	     << e.what() << endl;
+    }
+
+    // Use this thread too.
+    serve_connections();
+
+    for (auto & t : threads) t.join();
+}
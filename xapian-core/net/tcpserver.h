@@ -69,6 +69,9 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
 #endif
 	    );
 
+    /// Accept and handle connections until shutdown.
+    void serve_connections();
+
   protected:
     /** Should we produce output when connections are made or lost? */
     bool verbose;
@@ -100,10 +103,31 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
      */
     void run();
 
+    /** Accept connections and service requests indefinitely using threads.
+     *
+     *  Unlike run(), this serves connections in the current process using
+     *  a fixed number of threads, each of which accepts a connection and
+     *  services requests on it before accepting another.  Connections made
+     *  while all the threads are busy wait to be accepted.
+     *
+     *  @param num_threads	The number of threads to use (including the
+     *				calling thread).  Must be at least 1.
+     */
+    void run_threads(unsigned num_threads);
+
     /** Accept a single connection, service requests on it, then stop.  */
     void run_once();
 
-    /// Handle a single connection on an already connected socket.
+    /** Handle a single connection on an already connected socket.
+     *
+     *  This method is responsible for closing @a socket.  The connection
+     *  classes close their fds when the client closes the connection, so
+     *  closing it again afterwards could close a socket which another thread
+     *  has since been given the same fd for.
+     *
+     *  If run_threads() is used, this method is called by several threads
+     *  at once.
+     */
     virtual void handle_one_connection(int socket) = 0;
 };
 
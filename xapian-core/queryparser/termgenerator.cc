@@ -60,6 +60,7 @@ TermGenerator::set_document(const Xapian::Document & doc)
 {
     internal->doc = doc;
     internal->termpos = 0;
+    internal->prev_term.resize(0);
 }
 
 const Xapian::Document &
@@ -30,6 +30,7 @@
 #include <xapian/stem.h>
 #include <xapian/unicode.h>
 
+#include "phrasebigrams.h"
 #include "stringutils.h"
 
 #include <algorithm>
@@ -245,6 +246,12 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 
     if (!stopper) stop_mode = STOPWORDS_NONE;
 
+    bool bigrams = (flags & FLAG_PHRASE_BIGRAMS) && with_positions;
+    // Words from separate calls can still be adjacent, so we keep prev_term
+    // and rely on the position check in index_bigram().
+    if (bigrams)
+	doc.add_term(PHRASE_BIGRAM_MARKER_TERM, 0);
+
     parse_terms(itor, cjk_ngram, with_positions,
 	[=](const string & term, bool positional, const Utf8Iterator &) {
 	    if (term.size() > max_word_length) return true;
@@ -256,6 +263,9 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 		strategy == TermGenerator::STEM_NONE) {
 		if (positional) {
 		    doc.add_posting(prefix + term, ++termpos, wdf_inc);
+		    if (bigrams)
+			index_bigram(prefix + term,
+				     stopper && (*stopper)(term));
 		} else {
 		    doc.add_term(prefix + term, wdf_inc);
 		}
@@ -283,9 +293,15 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 		stem += "Z";
 	    }
 	    stem += prefix;
-	    stem += stemmer(term);
+	    string stemmed = stemmer(term);
+	    stem += stemmed;
 	    if (strategy != TermGenerator::STEM_SOME && with_positions) {
 		doc.add_posting(stem, ++termpos, wdf_inc);
+		// The pair is made from the stemmed form, so check that for
+		// being a stopword too - otherwise whether a pair of stems is
+		// indexed would depend on which words they came from.
+		if (bigrams)
+		    index_bigram(stem, stopper && (*stopper)(stemmed));
 	    } else {
 		doc.add_term(stem, wdf_inc);
 	    }
@@ -293,6 +309,20 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 	});
 }
 
+void
+TermGenerator::Internal::index_bigram(const string & term, bool is_stopword)
+{
+    if (!prev_term.empty() && prev_termpos + 1 == termpos &&
+	(!stopper || is_stopword || prev_is_stopword)) {
+	// The pair is only used to filter phrase matches, so give it wdf 0
+	// to avoid changing the document length.
+	doc.add_term(make_phrase_bigram_term(prev_term, term), 0);
+    }
+    prev_term = term;
+    prev_termpos = termpos;
+    prev_is_stopword = is_stopword;
+}
+
 struct Sniplet {
     double relevance;
 
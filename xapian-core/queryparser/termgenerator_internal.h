@@ -42,9 +42,30 @@ class TermGenerator::Internal : public Xapian::Internal::intrusive_base {
     unsigned max_word_length;
     WritableDatabase db;
 
+    /// The previous positional term, for FLAG_PHRASE_BIGRAMS.
+    std::string prev_term;
+
+    /// The position of prev_term.
+    termcount prev_termpos;
+
+    /// Is the word which prev_term came from a stopword?
+    bool prev_is_stopword;
+
+    /** Index the pair formed by the previous positional term and @a term.
+     *
+     *  The pair is only indexed if the two terms are adjacent and either is
+     *  a stopword (or if there's no stopper).  Pairs are added with wdf 0 so
+     *  they don't change the document length.
+     *
+     *  @param term		The positional term just added at termpos.
+     *  @param is_stopword	Is @a term (without any prefix) a stopword?
+     */
+    void index_bigram(const std::string & term, bool is_stopword);
+
   public:
     Internal() : strategy(STEM_SOME), stopper(NULL), termpos(0),
-	flags(TermGenerator::flags(0)), max_word_length(64) { }
+	flags(TermGenerator::flags(0)), max_word_length(64),
+	prev_termpos(0), prev_is_stopword(false) { }
     void index_text(Utf8Iterator itor,
 		    termcount weight,
 		    const std::string & prefix,
@@ -36,6 +36,7 @@
 #include "testutils.h"
 
 #include "apitest.h"
+#include "str.h"
 
 #include <list>
 
@@ -1196,6 +1197,96 @@ DEFINE_TESTCASE(fetchdocs1, backend) {
     return true;
 }
 
+/// Check prefetched documents are right when fetched out of order.
+DEFINE_TESTCASE(fetchdocs2, backend) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query(Xapian::Query::OP_OR, "this", "word"));
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_REL(mset.size(), >=, 4);
+
+    // Fetch a later range before an earlier one.
+    mset.fetch(mset[2], mset[mset.size() - 1]);
+    mset.fetch(mset[0], mset[1]);
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	Xapian::Document doc = db.get_document(*i);
+	TEST_EQUAL(i.get_document().get_data(), doc.get_data());
+    }
+
+    // Check other calls made while documents are being fetched work.
+    mset = enquire.get_mset(0, 10);
+    mset.fetch();
+    TEST_EQUAL(db.get_termfreq("this"), 6);
+    Xapian::MSetIterator i = mset.end();
+    while (i != mset.begin()) {
+	--i;
+	TEST_EQUAL(i.get_document().get_data(),
+		   db.get_document(*i).get_data());
+    }
+    return true;
+}
+
+/// Regression test - fetch() on an MSet not starting at the first match.
+DEFINE_TESTCASE(fetchdocs3, backend) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query(Xapian::Query::OP_OR, "this", "word"));
+    for (Xapian::doccount first = 0; first <= 3; ++first) {
+	Xapian::MSet mset = enquire.get_mset(first, 10);
+	TEST(!mset.empty());
+	mset.fetch();
+	mset.fetch(mset.begin(), mset.end());
+	mset.fetch(mset.back());
+	for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	    TEST_EQUAL(i.get_document().get_data(),
+		       db.get_document(*i).get_data());
+	}
+    }
+    return true;
+}
+
+/// Check fetching lots of large documents works.
+DEFINE_TESTCASE(fetchdocs4, writable) {
+    // Documents large enough that the replies to a batch of requests won't
+    // fit in the socket buffers, and more data in total than the remote
+    // backend will hold for uncollected documents.
+    Xapian::WritableDatabase db = get_writable_database();
+    for (unsigned i = 1; i <= 60; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all", i);
+	doc.set_data(string(300000, char('a' + i % 26)) + str(i));
+	doc.add_value(0, string(1000, 'v') + str(i));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("all"));
+    Xapian::MSet mset = enquire.get_mset(0, 100);
+    TEST_EQUAL(mset.size(), 60);
+
+    mset.fetch();
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	Xapian::docid did = *i;
+	Xapian::Document doc = i.get_document();
+	TEST_EQUAL(doc.get_data(),
+		   string(300000, char('a' + did % 26)) + str(did));
+	TEST_EQUAL(doc.get_value(0), string(1000, 'v') + str(did));
+    }
+
+    // Fetch everything, but collect the documents in reverse order.
+    mset = enquire.get_mset(0, 100);
+    mset.fetch();
+    Xapian::MSetIterator i = mset.end();
+    while (i != mset.begin()) {
+	--i;
+	Xapian::docid did = *i;
+	TEST_EQUAL(i.get_document().get_data(),
+		   string(300000, char('a' + did % 26)) + str(did));
+    }
+    return true;
+}
+
 // test that searching for a term not in the database fails nicely
 DEFINE_TESTCASE(absentterm1, backend) {
     Xapian::Enquire enquire(get_database("apitest_simpledata"));
@@ -30,6 +30,7 @@
 #include "backendmanager.h"
 #include "filetests.h"
 #include "str.h"
+#include "stringutils.h"
 #include "testrunner.h"
 #include "testsuite.h"
 #include "testutils.h"
@@ -46,7 +47,12 @@
 # include "safesyswait.h"
 #endif
 
+#if defined HAVE_FORK && defined XAPIAN_HAS_REMOTE_BACKEND
+# include "net/remotetcpserver.h"
+#endif
+
 #include <fstream>
+#include <thread>
 
 using namespace std;
 
@@ -434,6 +440,11 @@ DEFINE_TESTCASE(databasemodified1, writable && !inmemory && !remote) {
     doc.add_term("ghi");
     const int N = 500;
     for (int i = 0; i < N; ++i) {
+	// Use large and varied wdfs so that glass can't store the postlist
+	// in a much more compact form (as a bitmap or packed blocks), as we
+	// need the blocks it is in to get reused.
+	doc.remove_term("abc");
+	doc.add_term("abc", i * 1000 + 1);
 	db.add_document(doc);
     }
     db.commit();
@@ -682,6 +693,286 @@ DEFINE_TESTCASE(ordecay2, generated) {
     return true;
 }
 
+static void
+make_blockmax_db(Xapian::WritableDatabase &db, const string &)
+{
+    // Enough documents that the postlist for "A" spans many chunks, with the
+    // high wdf entries all at the start.
+    for (int n = 1; n <= 5000; ++n) {
+	Xapian::Document doc;
+	if (n % 2 == 0) doc.add_term("A", n <= 20 ? 20 : 1);
+	if (n % 10 != 0) doc.add_term("B");
+	doc.add_term("N" + str(n % 7), 20);
+	db.add_document(doc);
+    }
+}
+
+/// Check that skipping chunks which can't reach the minimum weight works.
+DEFINE_TESTCASE(blockmax1, generated) {
+    Xapian::Database db = get_database("blockmax", make_blockmax_db);
+    Xapian::Enquire enq(db);
+    Xapian::Query queries[] = {
+	Xapian::Query("A"),
+	Xapian::Query(Xapian::Query::OP_OR,
+		      Xapian::Query("A"),
+		      Xapian::Query("B"))
+    };
+    // PL2Weight calculates its upper bound in init(), so check that too.
+    Xapian::BM25Weight bm25;
+    Xapian::PL2Weight pl2;
+    const Xapian::Weight * weights[] = { &bm25, &pl2 };
+    for (const Xapian::Weight * wt : weights) {
+	enq.set_weighting_scheme(*wt);
+	for (const Xapian::Query & query : queries) {
+	    tout << wt->name() << ' ' << query.get_description() << '\n';
+	    enq.set_query(query);
+	    Xapian::MSet msetall = enq.get_mset(0, db.get_doccount());
+	    for (unsigned int i = 1; i <= 20; ++i) {
+		Xapian::MSet submset = enq.get_mset(0, i);
+		TEST(mset_range_is_same(submset, 0,
+					msetall, 0, submset.size()));
+		TEST(mset_range_is_same_weights(submset, 0,
+						msetall, 0, submset.size()));
+		TEST_REL(submset.get_matches_lower_bound(), <=,
+			 msetall.size());
+	    }
+	}
+    }
+    return true;
+}
+
+/// Check matching sub-databases in parallel gives the same results.
+DEFINE_TESTCASE(parallelmatch1, backend) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    db.add_database(get_database("apitest_simpledata2"));
+    Xapian::Enquire enq(db);
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, enq.set_max_threads(0));
+
+    Xapian::Query queries[] = {
+	Xapian::Query("this"),
+	Xapian::Query(Xapian::Query::OP_OR,
+		      Xapian::Query("this"),
+		      Xapian::Query("paragraph")),
+	Xapian::Query(Xapian::Query::OP_AND,
+		      Xapian::Query("this"),
+		      Xapian::Query("is"))
+    };
+    for (const Xapian::Query & query : queries) {
+	tout << query.get_description() << '\n';
+	enq.set_query(query);
+	for (unsigned int first = 0; first <= 2; ++first) {
+	    for (unsigned int n = 1; n <= 10; ++n) {
+		enq.set_max_threads(1);
+		Xapian::MSet serial = enq.get_mset(first, n, db.get_doccount());
+		enq.set_max_threads(4);
+		Xapian::MSet parallel = enq.get_mset(first, n, db.get_doccount());
+		TEST_EQUAL(serial.size(), parallel.size());
+		TEST(mset_range_is_same(serial, 0, parallel, 0, serial.size()));
+		TEST(mset_range_is_same_weights(serial, 0,
+						parallel, 0, serial.size()));
+		for (unsigned int i = 0; i != serial.size(); ++i) {
+		    TEST_EQUAL(serial[i].get_percent(), parallel[i].get_percent());
+		}
+		TEST_EQUAL(serial.get_matches_lower_bound(),
+			   parallel.get_matches_lower_bound());
+		TEST_EQUAL(serial.get_matches_upper_bound(),
+			   parallel.get_matches_upper_bound());
+		TEST_EQUAL(serial.get_termweight("this"),
+			   parallel.get_termweight("this"));
+	    }
+	}
+    }
+    return true;
+}
+
+/// Check the MSet cache gives the same results as not caching.
+DEFINE_TESTCASE(msetcache1, backend) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enq(db);
+    Xapian::Enquire cached_enq(db);
+    cached_enq.set_mset_cache(2, 3);
+
+    Xapian::Query queries[] = {
+	Xapian::Query("this"),
+	Xapian::Query(Xapian::Query::OP_OR,
+		      Xapian::Query("this"),
+		      Xapian::Query("paragraph")),
+	Xapian::Query(Xapian::Query::OP_AND,
+		      Xapian::Query("this"),
+		      Xapian::Query("is"))
+    };
+    for (int pass = 0; pass != 2; ++pass) {
+	for (const Xapian::Query & query : queries) {
+	    tout << query.get_description() << '\n';
+	    enq.set_query(query);
+	    cached_enq.set_query(query);
+	    for (unsigned int first = 0; first <= 4; ++first) {
+		for (unsigned int n = 0; n <= 5; ++n) {
+		    Xapian::MSet mset = enq.get_mset(first, n);
+		    Xapian::MSet cached = cached_enq.get_mset(first, n);
+		    TEST_EQUAL(mset.get_firstitem(), cached.get_firstitem());
+		    TEST_EQUAL(mset.size(), cached.size());
+		    TEST_EQUAL(mset.get_termfreq("this"),
+			       cached.get_termfreq("this"));
+		    if (mset.empty()) continue;
+		    TEST(mset_range_is_same(mset, 0, cached, 0, mset.size()));
+		    TEST(mset_range_is_same_weights(mset, 0,
+						    cached, 0, mset.size()));
+		    // Check the documents can be fetched.
+		    TEST_EQUAL(cached.begin().get_document().get_data(),
+			       mset.begin().get_document().get_data());
+		}
+	    }
+	    // Changing a setting must change the results.
+	    cached_enq.set_docid_order(Xapian::Enquire::DESCENDING);
+	    enq.set_docid_order(Xapian::Enquire::DESCENDING);
+	    Xapian::MSet mset = enq.get_mset(0, 10);
+	    Xapian::MSet cached = cached_enq.get_mset(0, 10);
+	    TEST(mset_range_is_same(mset, 0, cached, 0, mset.size()));
+	    cached_enq.set_docid_order(Xapian::Enquire::ASCENDING);
+	    enq.set_docid_order(Xapian::Enquire::ASCENDING);
+	}
+    }
+    TEST(!cached_enq.get_mset(10000, 10).size());
+    return true;
+}
+
+/// Weighting scheme which counts the number of matches it's used for.
+class CountingWeight : public Xapian::Weight {
+    unsigned & inits;
+
+  public:
+    explicit CountingWeight(unsigned & inits_) : inits(inits_) {
+	need_stat(WDF);
+	need_stat(WDF_MAX);
+    }
+
+    void init(double) { ++inits; }
+
+    Weight * clone() const { return new CountingWeight(inits); }
+
+    std::string name() const { return "CountingWeight"; }
+
+    std::string serialise() const { return std::string(); }
+
+    double get_sumpart(Xapian::termcount wdf, Xapian::termcount,
+		       Xapian::termcount) const {
+	return wdf;
+    }
+
+    double get_maxpart() const { return get_wdf_upper_bound(); }
+
+    double get_sumextra(Xapian::termcount, Xapian::termcount) const {
+	return 0.0;
+    }
+
+    double get_maxextra() const { return 0.0; }
+};
+
+/// Check the MSet cache is used, and not used after the database changes.
+DEFINE_TESTCASE(msetcache2, chert || glass) {
+    Xapian::WritableDatabase wdb = get_writable_database();
+    for (Xapian::docid did = 1; did <= 50; ++did) {
+	Xapian::Document doc;
+	doc.add_term("common", did % 5 + 1);
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    Xapian::Database db = get_writable_database_as_database();
+    Xapian::Enquire enq(db);
+    enq.set_mset_cache(10, 20);
+    unsigned inits = 0;
+    enq.set_weighting_scheme(CountingWeight(inits));
+    enq.set_query(Xapian::Query("common"));
+
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 10);
+    unsigned inits_per_match = inits;
+    TEST_REL(inits_per_match,>,0);
+
+    // Later pages within the cached depth should come from the cache.
+    Xapian::MSet page2 = enq.get_mset(10, 10);
+    TEST_EQUAL(inits, inits_per_match);
+    TEST_EQUAL(page2.size(), 10);
+    TEST_EQUAL(page2.get_firstitem(), 10);
+    TEST_EQUAL(page2[0].get_rank(), 10);
+
+    // Asking for more than the cached depth needs a new match.
+    Xapian::MSet all = enq.get_mset(0, 50);
+    TEST_EQUAL(inits, inits_per_match * 2);
+    TEST(mset_range_is_same(all, 0, mset, 0, 10));
+    TEST(mset_range_is_same(all, 10, page2, 0, 10));
+
+    // A WritableDatabase with uncommitted changes shouldn't be cached.
+    Xapian::Enquire wenq(wdb);
+    wenq.set_mset_cache(10, 20);
+    wenq.set_query(Xapian::Query("common"));
+    TEST_EQUAL(wenq.get_mset(0, 100).size(), 50);
+    Xapian::Document doc;
+    doc.add_term("common", 10);
+    wdb.add_document(doc);
+    Xapian::MSet wmset = wenq.get_mset(0, 100);
+    TEST_EQUAL(wmset.size(), 51);
+    TEST_EQUAL(*wmset[0], 51);
+
+    // Until the database is reopened we get the cached results, but after
+    // that, the new document should appear.
+    wdb.commit();
+    (void)enq.get_mset(0, 10);
+    TEST_EQUAL(inits, inits_per_match * 2);
+    TEST(db.reopen());
+    mset = enq.get_mset(0, 10);
+    TEST_EQUAL(inits, inits_per_match * 3);
+    TEST_EQUAL(*mset[0], 51);
+
+    // Turning the cache off means every search is run.
+    enq.set_mset_cache(0);
+    (void)enq.get_mset(0, 10);
+    TEST_EQUAL(inits, inits_per_match * 4);
+
+    // Results with a time limit depend on timing, so aren't cached.
+    enq.set_mset_cache(10, 20);
+    enq.set_time_limit(100.0);
+    (void)enq.get_mset(0, 10);
+    (void)enq.get_mset(0, 10);
+    TEST_EQUAL(inits, inits_per_match * 6);
+    return true;
+}
+
+/// Check the MSet cache isn't used after reopening a replaced database.
+DEFINE_TESTCASE(msetcache3, glass) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("msetcache3");
+    const string & path = get_named_writable_database_path("msetcache3");
+    Xapian::Document doc;
+    doc.add_term("foo");
+    wdb.add_document(doc);
+    wdb.add_document(doc);
+    wdb.commit();
+    wdb.close();
+
+    Xapian::Database db(path);
+    Xapian::Enquire enq(db);
+    enq.set_mset_cache(10, 20);
+    enq.set_query(Xapian::Query("foo"));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+
+    // Replace the database with a different one which has also had a single
+    // commit, so is at the same revision.
+    string uuid = db.get_uuid();
+    wdb = Xapian::WritableDatabase(path, Xapian::DB_CREATE_OR_OVERWRITE);
+    wdb.add_document(doc);
+    wdb.add_document(Xapian::Document());
+    wdb.commit();
+    wdb.close();
+    TEST_NOT_EQUAL(Xapian::Database(path).get_uuid(), uuid);
+
+    db.reopen();
+    TEST_EQUAL(db.get_doccount(), 2);
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    return true;
+}
+
 static void
 make_orcheck_db(Xapian::WritableDatabase &db, const string &)
 {
@@ -1046,6 +1337,148 @@ DEFINE_TESTCASE(notermlist1, glass) {
     return true;
 }
 
+/// Feature test for Xapian::DB_MMAP.
+DEFINE_TESTCASE(mmap1, glass) {
+    const string & path = get_database_path("apitest_simpledata");
+    Xapian::Database db(path);
+    Xapian::Database mdb(path, Xapian::DB_MMAP);
+    TEST_EQUAL(mdb.get_doccount(), db.get_doccount());
+    TEST_EQUAL(mdb.get_avlength(), db.get_avlength());
+
+    // Walk all the terms, which reads every leaf block of the postlist table.
+    Xapian::TermIterator t = db.allterms_begin();
+    Xapian::TermIterator mt = mdb.allterms_begin();
+    while (t != db.allterms_end()) {
+	TEST(mt != mdb.allterms_end());
+	TEST_EQUAL(*mt, *t);
+	TEST_EQUAL(mt.get_termfreq(), t.get_termfreq());
+	++t;
+	++mt;
+    }
+    TEST(mt == mdb.allterms_end());
+
+    for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+	TEST_EQUAL(mdb.get_document(did).get_data(),
+		   db.get_document(did).get_data());
+    }
+
+    Xapian::Enquire enquire(db);
+    Xapian::Enquire menquire(mdb);
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("this"), Xapian::Query("paragraph"));
+    enquire.set_query(query);
+    menquire.set_query(query);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    Xapian::MSet mmset = menquire.get_mset(0, 10);
+    TEST(!mset.empty());
+    TEST_EQUAL(mmset.size(), mset.size());
+    TEST(mset_range_is_same(mmset, 0, mset, 0, mset.size()));
+
+    // Reopening should keep working (and is a no-op here).
+    mdb.reopen();
+    TEST_EQUAL(mdb.get_doccount(), db.get_doccount());
+    return true;
+}
+
+/// Check mappings of a DB_MMAP database aren't kept after reopening.
+DEFINE_TESTCASE(mmap2, glass) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("mmap2");
+    const string & path = get_named_writable_database_path("mmap2");
+    Xapian::Document doc;
+    doc.add_term("foo");
+    wdb.add_document(doc);
+    wdb.commit();
+
+    Xapian::Database mdb(path, Xapian::DB_MMAP);
+    Xapian::Enquire enquire(mdb);
+    enquire.set_query(Xapian::Query("foo"));
+    for (Xapian::doccount i = 2; i <= 20; ++i) {
+	wdb.add_document(doc);
+	wdb.commit();
+	TEST(mdb.reopen());
+	TEST_EQUAL(enquire.get_mset(0, 30).size(), i);
+    }
+
+    // Count the mappings of the postlist table.  Only the current one should
+    // remain, but allow for the kernel splitting a mapping.
+    ifstream maps("/proc/self/maps");
+    if (!maps.is_open()) {
+	SKIP_TEST("Can't read /proc/self/maps");
+    }
+    string postlist = path + "/postlist.glass";
+    int count = 0;
+    string line;
+    while (getline(maps, line)) {
+	if (endswith(line, postlist)) ++count;
+    }
+    tout << count << " mappings of " << postlist << endl;
+    TEST_REL(count,>=,1);
+    TEST_REL(count,<=,2);
+    return true;
+}
+
+/// Check read-only glass databases share blocks via the block cache.
+DEFINE_TESTCASE(blockcache1, glass) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("blockcache1");
+    const string & path = get_named_writable_database_path("blockcache1");
+    Xapian::Document doc;
+    for (int i = 0; i != 200; ++i) {
+	doc.add_term("term" + str(i));
+    }
+    for (int i = 0; i != 50; ++i) {
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    size_t old_size = Xapian::Glass::get_block_cache_size();
+    Xapian::Glass::set_block_cache_size(1024 * 1024);
+    TEST_EQUAL(Xapian::Glass::get_block_cache_size(), 1024 * 1024);
+
+    Xapian::Database db1(path);
+    Xapian::Database db2(path);
+    for (int i = 0; i != 200; ++i) {
+	TEST_EQUAL(db1.get_termfreq("term" + str(i)), 50);
+    }
+
+    // The blocks db2 needs have all been read by db1.
+    unsigned long long hits = Xapian::Glass::get_block_cache_hits();
+    unsigned long long misses = Xapian::Glass::get_block_cache_misses();
+    for (int i = 0; i != 200; ++i) {
+	TEST_EQUAL(db2.get_termfreq("term" + str(i)), 50);
+    }
+    TEST_REL(Xapian::Glass::get_block_cache_hits(),>,hits);
+    TEST_EQUAL(Xapian::Glass::get_block_cache_misses(), misses);
+
+    // Cached blocks are kept across commits, but readers of the new revision
+    // must still see the blocks which have changed.
+    for (Xapian::doccount n = 51; n <= 70; ++n) {
+	Xapian::Document newdoc;
+	newdoc.add_term("term" + str(n % 7));
+	newdoc.add_term("new" + str(n));
+	wdb.add_document(newdoc);
+	wdb.commit();
+	TEST(db1.reopen());
+	TEST_EQUAL(db1.get_doccount(), n);
+	TEST_EQUAL(db1.get_termfreq("new" + str(n)), 1);
+	for (int i = 0; i != 7; ++i) {
+	    string term = "term" + str(i);
+	    TEST_EQUAL(db1.get_termfreq(term), wdb.get_termfreq(term));
+	    Xapian::PostingIterator p = db1.postlist_begin(term);
+	    Xapian::PostingIterator wp = wdb.postlist_begin(term);
+	    while (wp != wdb.postlist_end(term)) {
+		TEST(p != db1.postlist_end(term));
+		TEST_EQUAL(*p, *wp);
+		++p;
+		++wp;
+	    }
+	    TEST(p == db1.postlist_end(term));
+	}
+    }
+
+    Xapian::Glass::set_block_cache_size(old_size);
+    return true;
+}
+
 /// Regression test for bug starting a new glass freelist block.
 DEFINE_TESTCASE(newfreelistblock1, writable) {
     Xapian::Document doc;
@@ -1244,6 +1677,100 @@ DEFINE_TESTCASE(retrylock1, writable && !inmemory && !remote) {
     return true;
 }
 
+/// Check a TCP server handling connections in threads serves them correctly.
+DEFINE_TESTCASE(tcpsrvthreads1, glass) {
+#if defined HAVE_FORK && defined HAVE_SOCKETPAIR && \
+    defined XAPIAN_HAS_REMOTE_BACKEND
+    vector<string> dbpaths(1, get_database_path("apitest_simpledata"));
+
+    // We want to reap the server ourselves.
+    void (*old_handler)(int) = signal(SIGCHLD, SIG_DFL);
+
+    int port = 1239;
+    pid_t child;
+    int fds[2];
+    while (true) {
+	if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, PF_UNSPEC, fds) < 0) {
+	    FAIL_TEST("socketpair() failed");
+	}
+	// Make sure buffered output isn't written twice by the child.
+	fflush(stdout);
+	child = fork();
+	if (child == -1)
+	    FAIL_TEST("fork() failed");
+	if (child == 0) {
+	    close(fds[0]);
+	    // The constructor exits with status 69 if the port is in use.
+	    RemoteTcpServer server(dbpaths, "127.0.0.1", port, 30.0, 30.0,
+				   false, false);
+	    if (write(fds[1], "L", 1)) { }
+	    server.run_threads(4);
+	    _exit(0);
+	}
+
+	close(fds[1]);
+	char ch;
+	ssize_t r;
+	while ((r = read(fds[0], &ch, 1)) < 0 && errno == EINTR) { }
+	close(fds[0]);
+	if (r == 1) break;
+
+	int status;
+	while (waitpid(child, &status, 0) < 0) {
+	    if (errno != EINTR) break;
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 69 || ++port == 65536)
+	    FAIL_TEST("Failed to start TCP server");
+    }
+
+    Xapian::Database local(dbpaths[0]);
+    Xapian::Enquire enq_local(local);
+    enq_local.set_query(Xapian::Query("this"));
+    Xapian::MSet expected = enq_local.get_mset(0, 10);
+
+    // Each client thread makes several connections, so the server's threads
+    // set up and tear down connections concurrently.
+    const int N_CLIENTS = 8;
+    vector<string> errors(N_CLIENTS);
+    vector<thread> clients;
+    for (int i = 0; i != N_CLIENTS; ++i) {
+	clients.emplace_back([&, i]() {
+	    try {
+		for (int j = 0; j != 5; ++j) {
+		    Xapian::Database db = Xapian::Remote::open("127.0.0.1", port);
+		    Xapian::Enquire enq(db);
+		    enq.set_query(Xapian::Query("this"));
+		    Xapian::MSet mset = enq.get_mset(0, 10);
+		    if (!mset_range_is_same(mset, 0, expected, 0, expected.size())) {
+			errors[i] = "MSet differs";
+			return;
+		    }
+		}
+	    } catch (const Xapian::Error & e) {
+		errors[i] = e.get_description();
+	    }
+	});
+    }
+    for (auto & client : clients) client.join();
+
+    kill(child, SIGKILL);
+    int status;
+    while (waitpid(child, &status, 0) < 0) {
+	if (errno != EINTR) break;
+    }
+    signal(SIGCHLD, old_handler);
+
+    for (const string & error : errors) {
+	TEST_EQUAL(error, string());
+    }
+    TEST(!expected.empty());
+#else
+    SKIP_TEST("Test requires fork(), socketpair() and the remote backend");
+#endif
+
+    return true;
+}
+
 // Opening a WritableDatabase with low fds available - it should avoid them.
 DEFINE_TESTCASE(dbfilefd012, chert || glass) {
 #if !defined __WIN32__ && !defined __CYGWIN__ && !defined __OS2__
@@ -25,6 +25,8 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
+#include "stringutils.h"
 #include "testutils.h"
 
 using namespace std;
@@ -81,3 +83,66 @@ DEFINE_TESTCASE(collapsekey5,backend) {
 
     return true;
 }
+
+static void
+make_collapsememory1_db(Xapian::WritableDatabase &db, const string &)
+{
+    // Mostly unique collapse keys, with a mix of short keys (which the
+    // collapser packs into an integer) and long ones.  The weights increase
+    // with the docid so every document gets considered for the MSet.
+    for (unsigned i = 1; i <= 20000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all", i);
+	unsigned k = i % 15000;
+	if (k % 3 == 0) {
+	    doc.add_value(0, "long collapse key number " + str(k));
+	} else {
+	    doc.add_value(0, str(k));
+	}
+	db.add_document(doc);
+    }
+}
+
+/// Check collapsing gives the same answer when its memory use is bounded.
+DEFINE_TESTCASE(collapsememory1, generated) {
+    Xapian::Database db = get_database("collapsememory1",
+				       make_collapsememory1_db);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("all"));
+
+    Xapian::MSet mset = enquire.get_mset(0, 100);
+    TEST_EQUAL(mset.get_collapse_memory(), 0);
+
+    enquire.set_collapse_key(0);
+    mset = enquire.get_mset(0, 100);
+    TEST_EQUAL(mset.size(), 100);
+    bool remote = startswith(get_dbtype(), "remote");
+    if (!remote) {
+	TEST_REL(mset.get_collapse_memory(),>,1024 * 1024);
+    }
+
+    Xapian::MSet bounded_mset;
+    {
+	ScopedEnvVar collapse_memory("XAPIAN_COLLAPSE_MEMORY", "1");
+	bounded_mset = enquire.get_mset(0, 100);
+    }
+    if (!remote) {
+	// Pruning happens once the limit is exceeded, so allow some slack.
+	TEST_REL(bounded_mset.get_collapse_memory(),<,2 * 1024 * 1024);
+	TEST_REL(bounded_mset.get_collapse_memory(),<,
+		 mset.get_collapse_memory());
+    }
+
+    // The documents returned must be the same, but collapse counts may be
+    // lower since values which were pruned are no longer counted.
+    TEST_EQUAL(bounded_mset.size(), mset.size());
+    for (Xapian::doccount i = 0; i != mset.size(); ++i) {
+	TEST_EQUAL(*bounded_mset[i], *mset[i]);
+	TEST_EQUAL(bounded_mset[i].get_collapse_key(),
+		   mset[i].get_collapse_key());
+	TEST_REL(bounded_mset[i].get_collapse_count(),<=,
+		 mset[i].get_collapse_count());
+    }
+
+    return true;
+}
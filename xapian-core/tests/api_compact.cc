@@ -30,11 +30,13 @@
 #include "dbcheck.h"
 #include "filetests.h"
 #include "str.h"
+#include "stringutils.h"
 #include "testsuite.h"
 #include "testutils.h"
 
 #include <cstdlib>
 #include <fstream>
+#include <vector>
 
 #include <sys/types.h>
 #include "safesysstat.h"
@@ -257,6 +259,55 @@ DEFINE_TESTCASE(compactmerge1, chert || glass) {
     return true;
 }
 
+/// Check compaction keeps the sample of values in each slot ordered.
+DEFINE_TESTCASE(compactvaluestats1, glass) {
+    string outdbpath = get_named_writable_database_path("compactvaluestats1out");
+    rm_rf(outdbpath);
+
+    {
+	Xapian::WritableDatabase db1 =
+	    get_named_writable_database("compactvaluestats1a");
+	Xapian::WritableDatabase db2 =
+	    get_named_writable_database("compactvaluestats1b");
+	for (int i = 1; i <= 300; ++i) {
+	    Xapian::Document doc;
+	    doc.add_value(0, str(i));
+	    db1.add_document(doc);
+	    doc.add_value(0, str(i + 300));
+	    db2.add_document(doc);
+	}
+	// Deleting the first few documents means the first input's docids get
+	// renumbered too.
+	for (Xapian::docid did = 1; did <= 10; ++did)
+	    db1.delete_document(did);
+	db1.commit();
+	db2.commit();
+
+	Xapian::Database db;
+	db.add_database(db1);
+	db.add_database(db2);
+	db.compact(outdbpath);
+    }
+
+    TEST_EQUAL(Xapian::Database::check(outdbpath, 0, &tout), 0);
+
+    // Later updates rely on the order of the sample.
+    {
+	Xapian::WritableDatabase db(outdbpath);
+	for (int i = 1; i <= 300; ++i) {
+	    Xapian::Document doc;
+	    doc.add_value(0, str(i + 600));
+	    db.add_document(doc);
+	}
+	db.commit();
+	TEST_EQUAL(db.get_value_freq(0), 890);
+    }
+
+    TEST_EQUAL(Xapian::Database::check(outdbpath, 0, &tout), 0);
+
+    return true;
+}
+
 static void
 make_multichunk_db(Xapian::WritableDatabase &db, const string &)
 {
@@ -633,3 +684,117 @@ DEFINE_TESTCASE(compacttofd2, glass) {
 
     return true;
 }
+
+static void
+make_parallelcompact_db(Xapian::WritableDatabase &db, const string & s)
+{
+    Xapian::docid base = strtoul(s.c_str(), NULL, 10);
+    for (Xapian::docid i = base; i != base + 3000; ++i) {
+	Xapian::Document doc;
+	doc.set_data(str(i));
+	doc.add_term("Q" + str(i));
+	doc.add_posting("w" + str(i % 251), 1);
+	doc.add_posting("w" + str(i % 17), 2);
+	doc.add_term("common");
+	doc.add_value(0, str(i));
+	db.add_document(doc);
+    }
+    db.set_metadata("key" + s, s);
+    db.add_synonym("word" + s, "synonym");
+    db.commit();
+}
+
+/// Compactor which records the status messages reported for a table.
+class StatusRecordingCompactor : public Xapian::Compactor {
+    string table;
+
+  public:
+    vector<string> messages;
+
+    explicit StatusRecordingCompactor(const string & table_)
+	: table(table_) { }
+
+    void set_status(const string & t, const string & status) {
+	if (t == table) messages.push_back(status);
+    }
+};
+
+// Test compacting using several threads gives the same result as without.
+DEFINE_TESTCASE(compactthreads1, glass) {
+    string a = get_database_path("compactthreads1a", make_parallelcompact_db,
+				 "1");
+    string b = get_database_path("compactthreads1b", make_parallelcompact_db,
+				 "2000");
+    string c = get_database_path("compactthreads1c", make_parallelcompact_db,
+				 "7000");
+    string serialpath = get_named_writable_database_path("compactthreads1s");
+    string parallelpath = get_named_writable_database_path("compactthreads1p");
+    rm_rf(serialpath);
+    rm_rf(parallelpath);
+
+    {
+	Xapian::Database db;
+	db.add_database(Xapian::Database(a));
+	db.add_database(Xapian::Database(b));
+	db.add_database(Xapian::Database(c));
+	db.compact(serialpath);
+
+	StatusRecordingCompactor compactor("postlist");
+	TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		       compactor.set_max_threads(0));
+	compactor.set_max_threads(4);
+	db.compact(parallelpath, 0, 0, compactor);
+
+	// Check the postlist merge was actually split into parts - the
+	// inputs have enough terms that their postlist tables have branch
+	// blocks to choose the split points from.
+	bool split = false;
+	for (const string & m : compactor.messages) {
+	    tout << "postlist: " << m << '\n';
+	    if (startswith(m, "Merging in "))
+		split = true;
+	}
+	TEST(split);
+    }
+
+    // The temporary tables for the parts of the postlist merge should have
+    // been removed.
+    TEST(!file_exists(parallelpath + "/tmppart1.glass"));
+
+    Xapian::Database serial(serialpath);
+    Xapian::Database parallel(parallelpath);
+    dbcheck(parallel, 9000, 9000);
+    TEST_EQUAL(serial.get_doccount(), parallel.get_doccount());
+    TEST_EQUAL(serial.get_avlength(), parallel.get_avlength());
+
+    Xapian::TermIterator t1 = serial.allterms_begin();
+    Xapian::TermIterator t2 = parallel.allterms_begin();
+    while (t1 != serial.allterms_end()) {
+	TEST(t2 != parallel.allterms_end());
+	TEST_EQUAL(*t1, *t2);
+	TEST_EQUAL(t1.get_termfreq(), t2.get_termfreq());
+	TEST_EQUAL(serial.get_collection_freq(*t1),
+		   parallel.get_collection_freq(*t2));
+	Xapian::PostingIterator p1 = serial.postlist_begin(*t1);
+	Xapian::PostingIterator p2 = parallel.postlist_begin(*t2);
+	while (p1 != serial.postlist_end(*t1)) {
+	    TEST(p2 != parallel.postlist_end(*t2));
+	    TEST_EQUAL(*p1, *p2);
+	    TEST_EQUAL(p1.get_wdf(), p2.get_wdf());
+	    ++p1;
+	    ++p2;
+	}
+	TEST(p2 == parallel.postlist_end(*t2));
+	++t1;
+	++t2;
+    }
+    TEST(t2 == parallel.allterms_end());
+
+    TEST_EQUAL(parallel.get_metadata("key2000"), "2000");
+    TEST_EQUAL(parallel.get_value_freq(0), 9000);
+    TEST_EQUAL(parallel.get_document(4321).get_value(0),
+	       serial.get_document(4321).get_value(0));
+    TEST(parallel.synonyms_begin("word7000") != parallel.synonyms_end("word7000"));
+
+    return true;
+}
@@ -327,3 +327,261 @@ DEFINE_TESTCASE(matchspy6, !backend)
 
     return true;
 }
+
+static string
+facet_values_to_repr(Xapian::TermIterator i, Xapian::TermIterator end)
+{
+    string resultrepr("|");
+    for ( ; i != end; ++i) {
+	resultrepr += *i;
+	resultrepr += ':';
+	resultrepr += str(i.get_termfreq());
+	resultrepr += '|';
+    }
+    return resultrepr;
+}
+
+/// Check FacetCountMatchSpy gives the same counts as ValueCountMatchSpy.
+DEFINE_TESTCASE(facetcount1, generated)
+{
+    Xapian::Database db = get_database("matchspy2", make_matchspy2_db);
+
+    Xapian::FacetCountMatchSpy facets;
+    Xapian::ValueCountMatchSpy spy0(0);
+    Xapian::ValueCountMatchSpy spy1(1);
+    Xapian::ValueCountMatchSpy spy2(2);
+    Xapian::ValueCountMatchSpy spy3(3);
+    Xapian::ValueCountMatchSpy * spies[4] = { &spy0, &spy1, &spy2, &spy3 };
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("all"));
+    for (Xapian::valueno slot = 0; slot != 4; ++slot) {
+	facets.add_slot(slot);
+	enq.add_matchspy(spies[slot]);
+    }
+    // Adding a slot twice should have no effect.
+    facets.add_slot(1);
+    enq.add_matchspy(&facets);
+    // Sort by value so the spies see documents which don't make the MSet.
+    enq.set_sort_by_value(0, false);
+    Xapian::MSet mset = enq.get_mset(0, 10, 100);
+
+    TEST_EQUAL(facets.get_total(), 25);
+    for (Xapian::valueno slot = 0; slot != 4; ++slot) {
+	tout << "slot " << slot << endl;
+	const Xapian::ValueCountMatchSpy & spy = *spies[slot];
+	TEST_STRINGS_EQUAL(facet_values_to_repr(facets.values_begin(slot),
+						facets.values_end(slot)),
+			   values_to_repr(spy));
+	for (size_t count = 0; count != 12; ++count) {
+	    TEST_STRINGS_EQUAL(
+		facet_values_to_repr(facets.top_values_begin(slot, count),
+				     facets.top_values_end(slot, count)),
+		facet_values_to_repr(spy.top_values_begin(count),
+				     spy.top_values_end(count)));
+	}
+    }
+
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, facets.values_begin(4));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   facets.top_values_begin(4, 10));
+
+    return true;
+}
+
+/// Check FacetCountMatchSpy gives the same counts with parallel matching.
+DEFINE_TESTCASE(facetcount2, generated)
+{
+    Xapian::Database db = get_database("matchspy2", make_matchspy2_db);
+    db.add_database(get_database("facetcount2", make_matchspy2_db));
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("all"));
+    string results[2];
+    for (int threads = 0; threads != 2; ++threads) {
+	Xapian::FacetCountMatchSpy facets;
+	facets.add_slot(0);
+	facets.add_slot(3);
+	enq.clear_matchspies();
+	enq.add_matchspy(&facets);
+	enq.set_max_threads(threads ? 4 : 1);
+	Xapian::MSet mset = enq.get_mset(0, 10, 100);
+	TEST_EQUAL(facets.get_total(), 50);
+	results[threads] = facet_values_to_repr(facets.values_begin(0),
+						facets.values_end(0));
+	results[threads] += facet_values_to_repr(facets.values_begin(3),
+						 facets.values_end(3));
+    }
+    TEST_STRINGS_EQUAL(results[0], "|1:2|2:18|3:6|4:14|5:2|6:6|8:2||1:18|2:32|");
+    TEST_STRINGS_EQUAL(results[1], results[0]);
+
+    return true;
+}
+
+/// Check match spies count each document once when sorting by value in
+/// parallel.
+DEFINE_TESTCASE(matchspythreads1, generated)
+{
+    Xapian::Database db = get_database("matchspy2", make_matchspy2_db);
+    db.add_database(get_database("facetcount2", make_matchspy2_db));
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("all"));
+    enq.set_sort_by_value_then_relevance(0, false);
+    string results[2];
+    for (int threads = 0; threads != 2; ++threads) {
+	Xapian::ValueCountMatchSpy spy(0);
+	enq.clear_matchspies();
+	enq.add_matchspy(&spy);
+	enq.set_max_threads(threads ? 4 : 1);
+	Xapian::MSet mset = enq.get_mset(0, 10, 100);
+	TEST_EQUAL(spy.get_total(), 50);
+	results[threads] = values_to_repr(spy);
+    }
+    TEST_STRINGS_EQUAL(results[1], results[0]);
+
+    return true;
+}
+
+/// Check FacetCountMatchSpy works with all backends (including remote).
+DEFINE_TESTCASE(facetcount3, backend)
+{
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("this"));
+
+    Xapian::FacetCountMatchSpy facets;
+    facets.add_slot(0);
+    facets.add_slot(1);
+    Xapian::ValueCountMatchSpy spy0(0);
+    Xapian::ValueCountMatchSpy spy1(1);
+    enquire.add_matchspy(&facets);
+    enquire.add_matchspy(&spy0);
+    enquire.add_matchspy(&spy1);
+    Xapian::MSet mset = enquire.get_mset(0, 100);
+    TEST_EQUAL(mset.size(), 6);
+
+    TEST_EQUAL(facets.get_total(), spy0.get_total());
+    TEST_STRINGS_EQUAL(facet_values_to_repr(facets.values_begin(0),
+					    facets.values_end(0)),
+		       values_to_repr(spy0));
+    TEST_STRINGS_EQUAL(facet_values_to_repr(facets.values_begin(1),
+					    facets.values_end(1)),
+		       "|h:5|n:1|");
+    TEST_STRINGS_EQUAL(facet_values_to_repr(facets.top_values_begin(1, 1),
+					    facets.top_values_end(1, 1)),
+		       "|h:5|");
+
+    return true;
+}
+
+static void
+make_distinctcount1_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (int i = 0; i != 12000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	if (i % 2) doc.add_term("odd");
+	// 4500 distinct values, or 2000 for the odd documents.
+	if (i % 10 != 9) doc.add_value(0, "site" + str(i % 5000));
+	db.add_document(doc);
+    }
+}
+
+/// Check DistinctCountMatchSpy counts exactly and estimates.
+DEFINE_TESTCASE(distinctcount1, generated)
+{
+    Xapian::Database db = get_database("distinctcount1",
+				       make_distinctcount1_db);
+    Xapian::Enquire enq(db);
+
+    enq.set_query(Xapian::Query("odd"));
+    Xapian::DistinctCountMatchSpy exact(0, 3000);
+    enq.add_matchspy(&exact);
+    enq.get_mset(0, 10, db.get_doccount());
+    TEST_EQUAL(exact.get_total(), 6000);
+    TEST(exact.is_exact());
+    TEST_EQUAL(exact.get_distinct_count(), 2000);
+
+    enq.clear_matchspies();
+    enq.set_query(Xapian::Query("all"));
+    Xapian::DistinctCountMatchSpy approx(0, 3000);
+    enq.add_matchspy(&approx);
+    enq.get_mset(0, 10, db.get_doccount());
+    TEST_EQUAL(approx.get_total(), 12000);
+    TEST(!approx.is_exact());
+    Xapian::doccount count = approx.get_distinct_count();
+    tout << "Estimated " << count << " distinct values" << endl;
+    TEST_REL(count,>,4365);
+    TEST_REL(count,<,4635);
+
+    return true;
+}
+
+/// Check DistinctCountMatchSpy works with all backends (including remote).
+DEFINE_TESTCASE(distinctcount2, backend)
+{
+    Xapian::Database db(get_database("apitest_simpledata"));
+    db.add_database(get_database("apitest_simpledata2"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("this"));
+
+    Xapian::DistinctCountMatchSpy spy(1);
+    Xapian::ValueCountMatchSpy value_spy(1);
+    enquire.add_matchspy(&spy);
+    enquire.add_matchspy(&value_spy);
+    enquire.get_mset(0, 100);
+
+    Xapian::doccount distinct = 0;
+    for (Xapian::TermIterator i = value_spy.values_begin();
+	 i != value_spy.values_end(); ++i) {
+	++distinct;
+    }
+    TEST_EQUAL(spy.get_total(), value_spy.get_total());
+    TEST(spy.is_exact());
+    TEST_EQUAL(spy.get_distinct_count(), distinct);
+
+    return true;
+}
+
+/// Check merging DistinctCountMatchSpy results.
+DEFINE_TESTCASE(distinctcount3, !backend)
+{
+    Xapian::DistinctCountMatchSpy spy0(0, 50);
+    Xapian::DistinctCountMatchSpy spy1(0, 50);
+    Xapian::DistinctCountMatchSpy spy2(0, 100);
+    // The first two spies see overlapping sets of values.
+    for (int i = 0; i != 1000; ++i) {
+	Xapian::Document doc;
+	doc.add_value(0, str(i % 150));
+	if (i % 2) {
+	    spy1(doc, 0);
+	} else {
+	    spy0(doc, 0);
+	}
+	if (i < 100) spy2(doc, 0);
+    }
+    TEST(!spy0.is_exact());
+    TEST(!spy1.is_exact());
+    TEST(spy2.is_exact());
+    TEST_EQUAL(spy2.get_distinct_count(), 100);
+
+    Xapian::DistinctCountMatchSpy merged(0, 100);
+    merged.merge_results(spy2.serialise_results());
+    TEST(merged.is_exact());
+    TEST_EQUAL(merged.get_distinct_count(), 100);
+    TEST_EQUAL(merged.get_total(), 100);
+    merged.merge_results(spy0.serialise_results());
+    merged.merge_results(spy1.serialise_results());
+    TEST(!merged.is_exact());
+    TEST_EQUAL(merged.get_total(), 1100);
+    // The estimate is very accurate for small counts.
+    TEST_REL(merged.get_distinct_count(),>=,147);
+    TEST_REL(merged.get_distinct_count(),<=,153);
+
+    TEST_EXCEPTION(Xapian::NetworkError, merged.merge_results(string()));
+    TEST_EXCEPTION(Xapian::NetworkError,
+		   merged.merge_results(string("\0X", 2)));
+
+    return true;
+}
@@ -122,6 +122,103 @@ DEFINE_TESTCASE(valuerange5, generated) {
     return true;
 }
 
+static void
+make_valuerange6(Xapian::WritableDatabase &db, const string &)
+{
+    // Values rise and then fall back, so that some chunks of the value stream
+    // fall entirely inside or outside the ranges tested, and some overlap.
+    for (int i = 1; i <= 6000; ++i) {
+	Xapian::Document doc;
+	doc.add_value(0, Xapian::sortable_serialise(i % 2500));
+	doc.add_term(i % 7 ? "rare" : "common");
+	db.add_document(doc);
+    }
+}
+
+// Check filtering on value ranges over a long value stream.
+DEFINE_TESTCASE(valuerange6, generated) {
+    Xapian::Database db = get_database("valuerange6", make_valuerange6);
+    Xapian::Enquire enq(db);
+    enq.set_weighting_scheme(Xapian::BoolWeight());
+
+    static const struct { double lo, hi; } ranges[] = {
+	{ 0, 100 }, { 100, 2000 }, { 1500, 1600 }, { 2400, 3000 },
+	{ -10, 0 }, { 3000, 4000 }, { 2499, 2499 }
+    };
+    for (size_t r = 0; r != sizeof(ranges) / sizeof(ranges[0]); ++r) {
+	string lo = Xapian::sortable_serialise(ranges[r].lo);
+	string hi = Xapian::sortable_serialise(ranges[r].hi);
+	Xapian::Query queries[] = {
+	    Xapian::Query(Xapian::Query::OP_VALUE_RANGE, 0, lo, hi),
+	    Xapian::Query(Xapian::Query::OP_VALUE_GE, 0, lo),
+	    Xapian::Query(Xapian::Query::OP_VALUE_LE, 0, hi)
+	};
+	for (size_t q = 0; q != sizeof(queries) / sizeof(queries[0]); ++q) {
+	    // Filtering a term means skip_to() gets used too.
+	    for (int filter = 0; filter != 2; ++filter) {
+		Xapian::Query query = queries[q];
+		if (filter) {
+		    query = Xapian::Query(Xapian::Query::OP_FILTER,
+					  Xapian::Query("common"), query);
+		}
+		tout << query.get_description() << endl;
+		enq.set_query(query);
+		Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+		Xapian::doccount count = 0;
+		for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+		    if (filter && did % 7) continue;
+		    string v = db.get_document(did).get_value(0);
+		    if (q != 2 && v < lo) continue;
+		    if (q != 1 && v > hi) continue;
+		    TEST_REL(count,<,mset.size());
+		    TEST_EQUAL(*mset[count], did);
+		    ++count;
+		}
+		TEST_EQUAL(mset.size(), count);
+	    }
+	}
+    }
+
+    return true;
+}
+
+/// Check the estimated number of matches for value ranges.
+DEFINE_TESTCASE(valuerangeestimate1, glass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int i = 1; i <= 1000; ++i) {
+	Xapian::Document doc;
+	doc.add_value(0, Xapian::sortable_serialise(i));
+	db.add_document(doc);
+    }
+
+    static const struct { double lo, hi; Xapian::doccount count; } ranges[] = {
+	{ 1, 100, 100 }, { 401, 700, 300 }, { 901, 2000, 100 },
+	{ 0, 500, 500 }, { 1500, 2000, 0 }, { 0, 2000, 1000 }
+    };
+    Xapian::Enquire enq(db);
+    for (int committed = 0; committed != 2; ++committed) {
+	for (size_t r = 0; r != sizeof(ranges) / sizeof(ranges[0]); ++r) {
+	    Xapian::Query query(Xapian::Query::OP_VALUE_RANGE, 0,
+				Xapian::sortable_serialise(ranges[r].lo),
+				Xapian::sortable_serialise(ranges[r].hi));
+	    tout << query.get_description() << endl;
+	    enq.set_query(query);
+	    Xapian::MSet mset = enq.get_mset(0, 0);
+	    Xapian::doccount est = mset.get_matches_estimated();
+	    Xapian::doccount count = ranges[r].count;
+	    // The estimate comes from a sample of 64 values, so allow for some
+	    // error, but it should be much better than the old fixed estimate
+	    // of half the documents.
+	    TEST_REL(est,<=,count + 100);
+	    TEST_REL(est + 100,>=,count);
+	}
+	db.commit();
+	enq = Xapian::Enquire(db);
+    }
+
+    return true;
+}
+
 // Feature test for Query::OP_VALUE_GE.
 DEFINE_TESTCASE(valuege1, backend) {
     Xapian::Database db(get_database("apitest_phrase"));
@@ -34,6 +34,7 @@ using namespace std;
 #include "testutils.h"
 
 #include "apitest.h"
+#include "stringutils.h"
 
 /// Simple test of NEAR
 DEFINE_TESTCASE(near1, positional) {
@@ -609,6 +610,74 @@ DEFINE_TESTCASE(poslist3, positional && writable) {
     return true;
 }
 
+/// Test iterating and skipping through positionlists long enough to need
+/// several blocks in backends which split them up.
+DEFINE_TESTCASE(poslist4, positional && writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    static const Xapian::termcount sizes[] = { 64, 65, 66, 129, 1000 };
+    const size_t n_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    for (size_t i = 0; i != n_sizes; ++i) {
+	Xapian::Document document;
+	for (Xapian::termpos j = 1; j <= sizes[i]; ++j) {
+	    document.add_posting("foo", j * 3);
+	}
+	db.add_document(document);
+    }
+    db.commit();
+
+    for (size_t i = 0; i != n_sizes; ++i) {
+	Xapian::docid did = i + 1;
+	Xapian::termcount size = sizes[i];
+	tout << "size " << size << endl;
+	Xapian::TermIterator t = db.termlist_begin(did);
+	TEST_EQUAL(*t, "foo");
+	TEST_EQUAL(t.get_wdf(), size);
+
+	Xapian::PositionIterator pl = db.positionlist_begin(did, "foo");
+	Xapian::PositionIterator pl_end = db.positionlist_end(did, "foo");
+	Xapian::termpos expected = 3;
+	while (pl != pl_end) {
+	    TEST_EQUAL(*pl, expected);
+	    expected += 3;
+	    ++pl;
+	}
+	TEST_EQUAL(expected, (size + 1) * 3);
+
+	// Skip to each position in turn, and to the gaps before them, using
+	// steps of various sizes.
+	for (Xapian::termpos step = 1; step < 300; step = step * 2 + 1) {
+	    pl = db.positionlist_begin(did, "foo");
+	    Xapian::termpos target = 1;
+	    while (target <= size * 3) {
+		pl.skip_to(target);
+		TEST(pl != pl_end);
+		TEST_EQUAL(*pl, (target + 2) / 3 * 3);
+		target += step;
+	    }
+	    pl.skip_to(target);
+	    TEST(pl == pl_end);
+	}
+
+	// Check next() works after skip_to() lands at the end of a block.
+	pl = db.positionlist_begin(did, "foo");
+	pl.skip_to(65 * 3);
+	if (size >= 65) {
+	    TEST_EQUAL(*pl, 65 * 3);
+	    ++pl;
+	    if (size == 65) {
+		TEST(pl == pl_end);
+	    } else {
+		TEST_EQUAL(*pl, 66 * 3);
+	    }
+	} else {
+	    TEST(pl == pl_end);
+	}
+    }
+
+    return true;
+}
+
 // Regression test - in 0.9.4 (and many previous versions) you couldn't get a
 // PositionIterator from a TermIterator from Database::termlist_begin().
 //
@@ -632,3 +701,121 @@ DEFINE_TESTCASE(positfromtermit1, positional) {
 
     return true;
 }
+
+/// Test phrase searches use pairs indexed by FLAG_PHRASE_BIGRAMS.
+struct phrase_bigram_test {
+    const char * phrase;
+    Xapian::docid dids[6];
+};
+
+static void
+check_phrases(Xapian::Enquire & enquire, const phrase_bigram_test * tests)
+{
+    for (size_t i = 0; tests[i].phrase; ++i) {
+	vector<Xapian::Query> subqs;
+	string phrase = tests[i].phrase;
+	string::size_type start = 0, space;
+	while ((space = phrase.find(' ', start)) != string::npos) {
+	    subqs.push_back(Xapian::Query(phrase.substr(start, space - start)));
+	    start = space + 1;
+	}
+	subqs.push_back(Xapian::Query(phrase.substr(start)));
+	enquire.set_query(Xapian::Query(Xapian::Query::OP_PHRASE,
+					subqs.begin(), subqs.end()));
+	Xapian::MSet mset = enquire.get_mset(0, 10);
+	tout << phrase << endl;
+	vector<Xapian::docid> expected;
+	for (const Xapian::docid * d = tests[i].dids; *d; ++d)
+	    expected.push_back(*d);
+	TEST_EQUAL(mset.size(), expected.size());
+	for (size_t j = 0; j != expected.size(); ++j)
+	    TEST_EQUAL(*mset[j], expected[j]);
+    }
+}
+
+DEFINE_TESTCASE(phrasebigrams1, positional && writable) {
+    static const char * const texts[] = {
+	"to be or not to be",
+	"not to be trusted",
+	"be or not",
+	"the who sang to be",
+	"to not be or",
+	NULL
+    };
+    Xapian::SimpleStopper stopper;
+    stopper.add("be");
+    stopper.add("not");
+    stopper.add("or");
+    stopper.add("the");
+    stopper.add("to");
+    stopper.add("who");
+
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::TermGenerator termgen;
+    termgen.set_stopper(&stopper);
+    termgen.set_flags(Xapian::TermGenerator::FLAG_PHRASE_BIGRAMS);
+    for (const char * const * p = texts; *p; ++p) {
+	Xapian::Document doc;
+	termgen.set_document(doc);
+	termgen.index_text(*p);
+	db.add_document(doc);
+    }
+    // Words from separate index_text() calls can still form a phrase.
+    Xapian::Document doc;
+    termgen.set_document(doc);
+    termgen.index_text("who sang to");
+    termgen.index_text("be");
+    db.add_document(doc);
+    db.commit();
+
+    TEST_EQUAL(db.get_termfreq("\xff" "to be"), 4);
+    TEST_EQUAL(db.get_termfreq("\xff" "sang to"), 2);
+    TEST_EQUAL(db.get_termfreq("\xff" "who sang"), 2);
+    // The pairs shouldn't contribute to the document length.
+    TEST_EQUAL(db.get_doclength(1), 6);
+
+    Xapian::Enquire enquire(db);
+    enquire.set_weighting_scheme(Xapian::BoolWeight());
+    static const phrase_bigram_test tests[] = {
+	{ "to be or not", { 1, 0 } },
+	{ "not to be", { 1, 2, 0 } },
+	{ "be or", { 1, 3, 5, 0 } },
+	{ "to be", { 1, 2, 4, 6, 0 } },
+	{ "the who sang", { 4, 0 } },
+	{ "who to", { 0 } },
+	// No pairs are indexed for "trusted" as it isn't a stopword.
+	{ "be trusted", { 2, 0 } },
+	{ NULL, { 0 } }
+    };
+    check_phrases(enquire, tests);
+
+    // The pair terms shouldn't be visible as ordinary terms.
+    for (Xapian::TermIterator t = db.allterms_begin(); t != db.allterms_end(); ++t)
+	TEST(!startswith(*t, '\xff'));
+    // "to be" shouldn't count towards the expansion limit for "to*".
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_WILDCARD, "to", 1,
+				    Xapian::Query::WILDCARD_LIMIT_ERROR));
+    TEST_EQUAL(enquire.get_mset(0, 10).size(), 5);
+    Xapian::RSet rset;
+    rset.add_document(4);
+    Xapian::ESet eset = enquire.get_eset(100, rset);
+    TEST(!eset.empty());
+    for (Xapian::ESetIterator e = eset.begin(); e != eset.end(); ++e)
+	TEST(!startswith(*e, '\xff'));
+
+    // A document which has the positions for "to be" but wasn't indexed with
+    // pairs, so phrase searches must fall back to checking positions.
+    doc = Xapian::Document();
+    doc.add_posting("to", 1);
+    doc.add_posting("be", 2);
+    db.add_document(doc);
+    db.commit();
+
+    static const phrase_bigram_test tests2[] = {
+	{ "to be", { 1, 2, 4, 6, 7, 0 } },
+	{ "who to", { 0 } },
+	{ NULL, { 0 } }
+    };
+    check_phrases(enquire, tests2);
+    return true;
+}
@@ -29,6 +29,7 @@
 #include "testutils.h"
 
 #include "apitest.h"
+#include "filetests.h"
 
 using namespace std;
 
@@ -365,6 +366,136 @@ DEFINE_TESTCASE(wildcard2, backend) {
     return true;
 }
 
+struct glob_testcase {
+    const char * pattern;
+    int flags;
+    const char * terms[4];
+};
+
+#define MULTI Xapian::Query::WILDCARD_PATTERN_MULTI
+#define SINGLE Xapian::Query::WILDCARD_PATTERN_SINGLE
+#define GLOB Xapian::Query::WILDCARD_PATTERN_GLOB
+static const
+glob_testcase wildcard3_testcases[] = {
+    { "*ch",	MULTI,	{ "match", "much", "search", "which" } },
+    { "*ther",	GLOB,	{ "other", 0, 0, 0 } },
+    { "th*e",	MULTI,	{ "the", "there", "three", 0 } },
+    { "s*l*",	GLOB,	{ "should", "simpl", "simplic", "split" } },
+    { "w*d",	MULTI,	{ "word", 0, 0, 0 } },
+    { "*oo*",	MULTI,	{ 0, 0, 0, 0 } },
+    { "t?o",	SINGLE,	{ "two", 0, 0, 0 } },
+    { "?o",	GLOB,	{ "so", "to", 0, 0 } },
+    { "a?",	SINGLE,	{ "as", "at", 0, 0 } },
+    // Without WILDCARD_PATTERN_SINGLE, '?' is a literal character.
+    { "t?o",	MULTI,	{ 0, 0, 0, 0 } },
+    // Without WILDCARD_PATTERN_MULTI, '*' is a literal character.
+    { "*ch",	SINGLE,	{ 0, 0, 0, 0 } },
+    { 0,	0,	{ 0, 0, 0, 0 } }
+};
+#undef MULTI
+#undef SINGLE
+#undef GLOB
+
+/// Test OP_WILDCARD with WILDCARD_PATTERN_* flags.
+DEFINE_TESTCASE(wildcard3, backend) {
+    // FIXME: Wildcards are expanded per subdatabase, so the weights differ
+    // from the equivalent OP_SYNONYM query (see wildcard1).
+    SKIP_TEST_FOR_BACKEND("multi");
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enq(db);
+    const Xapian::Query::op o = Xapian::Query::OP_WILDCARD;
+
+    for (const glob_testcase * p = wildcard3_testcases; p->pattern; ++p) {
+	tout << p->pattern << " flags " << p->flags << endl;
+	const char * const * tend = p->terms + 4;
+	while (tend != p->terms && tend[-1] == NULL) --tend;
+	Xapian::Query q(o, p->pattern, 0,
+			Xapian::Query::WILDCARD_LIMIT_ERROR | p->flags);
+	enq.set_query(q);
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	enq.set_query(Xapian::Query(q.OP_SYNONYM, p->terms, tend));
+	Xapian::MSet mset2 = enq.get_mset(0, 10);
+	TEST_EQUAL(mset.size(), mset2.size());
+	TEST(mset.empty() || mset_range_is_same(mset, 0, mset2, 0, mset.size()));
+    }
+
+    return true;
+}
+
+/// Test wildcard patterns using the glass wildcard index.
+DEFINE_TESTCASE(wildcard4, glass) {
+    Xapian::WritableDatabase db = get_named_writable_database("wildcard4");
+    const string path = get_named_writable_database_path("wildcard4");
+    Xapian::Document doc;
+    doc.add_term("abstraction");
+    doc.add_term("attention");
+    doc.add_term("banana");
+    doc.add_term("information");
+    doc.add_term("x");
+    db.add_document(doc);
+    doc.clear_terms();
+    doc.add_term("bandana");
+    doc.add_term("intention");
+    db.add_document(doc);
+    db.commit();
+    TEST(!file_exists(path + "/wildcard.glass"));
+    db.close();
+
+    // Opening with DB_WILDCARD_INDEX should build the index from the
+    // existing terms.
+    db = Xapian::WritableDatabase(path, Xapian::DB_WILDCARD_INDEX);
+    TEST(file_exists(path + "/wildcard.glass"));
+
+    const int glob = Xapian::Query::WILDCARD_PATTERN_GLOB;
+    const Xapian::Query::op o = Xapian::Query::OP_WILDCARD;
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(o, "*tion", 0, glob));
+    TEST_EQUAL(enq.get_mset(0, 10).get_matches_estimated(), 2);
+    enq.set_query(Xapian::Query(o, "in*tion", 0, glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+    enq.set_query(Xapian::Query(o, "*ana", 0, glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+    enq.set_query(Xapian::Query(o, "ban?na", 0, glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    // Too short to use the index.
+    enq.set_query(Xapian::Query(o, "*x*", 0, glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    // Fragment not in the index.
+    enq.set_query(Xapian::Query(o, "*zzz*", 0, glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 0);
+
+    // Check the index is kept up to date, including uncommitted changes.
+    db.delete_document(1);
+    doc.clear_terms();
+    doc.add_term("ration");
+    db.add_document(doc);
+    enq.set_query(Xapian::Query(o, "*ana", 0, glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    enq.set_query(Xapian::Query(o, "*ation", 0, glob));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 1);
+    TEST_EQUAL(*mset.begin(), 3);
+    db.commit();
+    db.close();
+
+    // The index should be maintained without DB_WILDCARD_INDEX once it
+    // exists.
+    db = Xapian::WritableDatabase(path, Xapian::DB_OPEN);
+    doc.clear_terms();
+    doc.add_term("station");
+    db.add_document(doc);
+    db.commit();
+
+    Xapian::Database rodb(path);
+    Xapian::Enquire enq2(rodb);
+    enq2.set_query(Xapian::Query(o, "*ation", 0, glob));
+    TEST_EQUAL(enq2.get_mset(0, 10).size(), 2);
+    enq2.set_query(Xapian::Query(o, "*tion", 0, glob));
+    TEST_EQUAL(enq2.get_mset(0, 10).size(), 3);
+
+    return true;
+}
+
 DEFINE_TESTCASE(dualprefixwildcard1, backend) {
     Xapian::Database db = get_database("apitest_simpledata");
     Xapian::Query q(Xapian::Query::OP_SYNONYM,
@@ -377,6 +508,72 @@ DEFINE_TESTCASE(dualprefixwildcard1, backend) {
     return true;
 }
 
+struct editdistance_testcase {
+    const char * word;
+    unsigned edit_distance;
+    size_t min_prefix_len;
+    const char * terms[4];
+};
+
+static const
+editdistance_testcase editdistance1_testcases[] = {
+    // Transposition, deletion and substitution.
+    { "tset", 1, 0, { "mset", "set", "test", 0 } },
+    // Insertion and substitution.
+    { "mach", 1, 0, { "match", "much", 0, 0 } },
+    { "mach", 0, 0, { 0, 0, 0, 0 } },
+    { "work", 1, 3, { "word", "work", 0, 0 } },
+    { "work", 1, 4, { "work", 0, 0, 0 } },
+    { "xyzzy", 2, 0, { 0, 0, 0, 0 } },
+    { 0, 0, 0, { 0, 0, 0, 0 } }
+};
+
+/// Test OP_EDIT_DISTANCE.
+DEFINE_TESTCASE(editdistance1, backend) {
+    // FIXME: The expansion is per subdatabase, so the weights differ from
+    // the equivalent OP_SYNONYM query (see wildcard1).
+    SKIP_TEST_FOR_BACKEND("multi");
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enq(db);
+    const Xapian::Query::op o = Xapian::Query::OP_EDIT_DISTANCE;
+    const int limit_error = Xapian::Query::WILDCARD_LIMIT_ERROR;
+
+    for (const editdistance_testcase * p = editdistance1_testcases;
+	 p->word; ++p) {
+	tout << p->word << " ~" << p->edit_distance << endl;
+	const char * const * tend = p->terms + 4;
+	while (tend != p->terms && tend[-1] == NULL) --tend;
+	Xapian::Query q(o, p->word, p->edit_distance, p->min_prefix_len);
+	enq.set_query(q);
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	enq.set_query(Xapian::Query(q.OP_SYNONYM, p->terms, tend));
+	Xapian::MSet mset2 = enq.get_mset(0, 10);
+	TEST_EQUAL(mset.size(), mset2.size());
+	TEST(mset.empty() || mset_range_is_same(mset, 0, mset2, 0, mset.size()));
+    }
+
+    // Check the expansion limit is enforced.
+    enq.set_query(Xapian::Query(o, "tset", 1, 0, 1, limit_error));
+    TEST_EXCEPTION(Xapian::WildcardError, enq.get_mset(0, 10));
+    enq.set_query(Xapian::Query(o, "tset", 1, 0, 1,
+				Xapian::Query::WILDCARD_LIMIT_FIRST));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    enq.set_query(Xapian::Query("mset"));
+    Xapian::MSet mset2 = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), mset2.size());
+
+    // These short forms match the OP_WILDCARD constructor's signature, which
+    // should handle them the same way.
+    TEST_STRINGS_EQUAL(Xapian::Query(o, "work", 1).get_description(),
+		       Xapian::Query(o, "work", 1, size_t(0)).get_description());
+    TEST_STRINGS_EQUAL(Xapian::Query(o, "work", 1, 3).get_description(),
+		       Xapian::Query(o, "work", 1, size_t(3)).get_description());
+    TEST_STRINGS_EQUAL(Xapian::Query(o, "work", 1, 3).get_description(),
+		       "Query(EDIT_DISTANCE SYNONYM work~1 prefix 3)");
+
+    return true;
+}
+
 struct positional_testcase {
     int window;
     const char * terms[4];
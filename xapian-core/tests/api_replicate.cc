@@ -45,8 +45,6 @@
 #include <cstdlib>
 #include <string>
 
-#include <stdlib.h> // For setenv() or putenv()
-
 using namespace std;
 
 static void rmtmpdir(const string & path) {
@@ -247,13 +245,7 @@ set_max_changesets(int count) {
 }
 #endif
 
-#ifdef HAVE__PUTENV_S
-# define set_max_changesets(N) _putenv_s("XAPIAN_MAX_CHANGESETS", #N)
-#elif defined HAVE_SETENV
-# define set_max_changesets(N) setenv("XAPIAN_MAX_CHANGESETS", #N, 1)
-#else
-# define set_max_changesets(N) putenv(const_cast<char*>("XAPIAN_MAX_CHANGESETS="#N))
-#endif
+#define set_max_changesets(N) set_env_var("XAPIAN_MAX_CHANGESETS", #N)
 
 struct unset_max_changesets_helper_ {
     unset_max_changesets_helper_() { }
@@ -604,16 +596,22 @@ DEFINE_TESTCASE(replicate4, replicas) {
     orig.commit();
 
     // Replicate, and check that we have the positional information.
-    count = replicate(master, replica, tempdir, 0, 1, true);
-    TEST_EQUAL(count, 1);
+    if (get_dbtype() == "chert") {
+	// Should pull a full copy.
+	count = replicate(master, replica, tempdir, 0, 1, true);
+	TEST_EQUAL(count, 1);
+    } else {
+	// The changeset is missing, so the master should send just the blocks
+	// which have changed since the replica's revision.
+	count = replicate(master, replica, tempdir, 1, 0, true);
+	TEST_EQUAL(count, 2);
+    }
     {
 	Xapian::Database dbcopy(replicapath);
 	TEST_EQUAL(orig.get_uuid(), dbcopy.get_uuid());
     }
-    // Should have pulled a full copy
     check_equal_dbs(masterpath, replicapath);
     TEST(!file_exists(masterpath + "/changes3"));
-    
 
     // Need to close the replica before we remove the temporary directory on
     // Windows.
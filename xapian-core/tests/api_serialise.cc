@@ -214,6 +214,12 @@ DEFINE_TESTCASE(serialise_query1, !backend) {
     q2 = Xapian::Query::unserialise(q.serialise());
     TEST_EQUAL(q.get_description(), q2.get_description());
 
+    q = Xapian::Query(q.OP_EDIT_DISTANCE, "colour", 2, 1, 10,
+		      q.WILDCARD_LIMIT_FIRST, q.OP_MAX);
+    q2 = Xapian::Query::unserialise(q.serialise());
+    TEST_EQUAL(q.get_description(), q2.get_description());
+    TEST_EQUAL(q.get_description(), "Query(EDIT_DISTANCE MAX colour~2 prefix 1)");
+
     return true;
 }
 
@@ -25,6 +25,11 @@
 
 #include <xapian.h>
 
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "apitest.h"
 #include "testutils.h"
 
@@ -319,3 +324,65 @@ DEFINE_TESTCASE(sortfunctorremote1,remote) {
     );
     return true;
 }
+
+static void
+make_sortvalueprefix1_db(Xapian::WritableDatabase &db, const string &)
+{
+    // Values which share an 8 byte prefix, or differ only in trailing zero
+    // bytes, need the full sort key comparing.
+    static const char * const values[] = {
+	"", "a", "a\0", "a\0\0", "abcdefgh", "abcdefgh\0", "abcdefghi",
+	"abcdefghij", "abcdefgg\xff", "20150102", "20150101", "2015010",
+	"\xff\xff\xff\xff\xff\xff\xff\xff\xff", "\xff\xff\xff\xff\xff\xff\xff\xff"
+    };
+    static const size_t lengths[] = {
+	0, 1, 2, 3, 8, 9, 9, 10, 9, 8, 8, 7, 9, 8
+    };
+    for (unsigned i = 0; i != 200; ++i) {
+	Xapian::Document doc;
+	unsigned j = (i * 7) % (sizeof(values) / sizeof(values[0]));
+	if (i % 3 == 0) {
+	    doc.add_value(0, Xapian::sortable_serialise(double(i % 50) - 20));
+	} else {
+	    doc.add_value(0, string(values[j], lengths[j]));
+	}
+	db.add_document(doc);
+    }
+}
+
+/// Check sorting by value when sort keys share a long prefix.
+DEFINE_TESTCASE(sortvalueprefix1, generated) {
+    Xapian::Database db = get_database("sortvalueprefix1",
+				       make_sortvalueprefix1_db);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query::MatchAll);
+
+    for (int reverse = 0; reverse != 2; ++reverse) {
+	vector<pair<string, Xapian::docid>> expected;
+	for (Xapian::docid did = 1; did <= db.get_doccount(); ++did) {
+	    expected.push_back(make_pair(db.get_document(did).get_value(0),
+					 did));
+	}
+	if (reverse) {
+	    stable_sort(expected.begin(), expected.end(),
+			[](const pair<string, Xapian::docid> & a,
+			   const pair<string, Xapian::docid> & b) {
+			    return a.first > b.first;
+			});
+	} else {
+	    stable_sort(expected.begin(), expected.end());
+	}
+
+	enquire.set_sort_by_value(0, reverse);
+	for (Xapian::doccount size : { 1, 10, 37, 200 }) {
+	    tout << "reverse=" << reverse << " size=" << size << endl;
+	    Xapian::MSet mset = enquire.get_mset(0, size);
+	    TEST_EQUAL(mset.size(), size);
+	    for (Xapian::doccount i = 0; i != size; ++i) {
+		TEST_EQUAL(*mset[i], expected[i].second);
+	    }
+	}
+    }
+
+    return true;
+}
@@ -314,3 +314,119 @@ DEFINE_TESTCASE(spell8, spelling) {
 
     return true;
 }
+
+/// Test spelling correction using a deletion index.
+DEFINE_TESTCASE(spelldeletes1, glass) {
+    Xapian::WritableDatabase db = get_named_writable_database("spelldeletes1");
+    const string path = get_named_writable_database_path("spelldeletes1");
+    db.add_spelling("hello");
+    db.add_spelling("cell", 2);
+    db.add_spelling("ch");
+    db.commit();
+    // Without the index, we don't handle substitutions in two character
+    // words.
+    TEST_EQUAL(db.get_spelling_suggestion("qh"), "");
+    db.close();
+
+    // Opening with the flag should index the existing words.
+    db = Xapian::WritableDatabase(path, Xapian::DB_SPELLING_DELETION_INDEX);
+    TEST_EQUAL(db.get_spelling_suggestion("hell"), "cell");
+    TEST_EQUAL(db.get_spelling_suggestion("helo"), "hello");
+    TEST_EQUAL(db.get_spelling_suggestion("shello"), "hello");
+    TEST_EQUAL(db.get_spelling_suggestion("clel"), "cell");
+    TEST_EQUAL(db.get_spelling_suggestion("acella"), "cell");
+    TEST_EQUAL(db.get_spelling_suggestion("hc"), "ch");
+    TEST_EQUAL(db.get_spelling_suggestion("qh"), "ch");
+    TEST_EQUAL(db.get_spelling_suggestion("celling"), "");
+    // Edit distance 3 falls back to the trigram lists.
+    TEST_EQUAL(db.get_spelling_suggestion("celling", 3), "cell");
+
+    // Check the index is updated, including before changes are committed.
+    db.add_spelling("zig");
+    TEST_EQUAL(db.get_spelling_suggestion("izg"), "zig");
+    TEST_EQUAL(db.get_spelling_suggestion("zi"), "zig");
+    TEST_EQUAL(db.get_spelling_suggestion("ziag"), "zig");
+    db.add_spelling("hello", 2);
+    TEST_EQUAL(db.get_spelling_suggestion("hell"), "hello");
+    db.remove_spelling("hello", 3);
+    TEST_EQUAL(db.get_spelling_suggestion("helo"), "cell");
+    db.commit();
+    db.close();
+
+    // The index should be maintained without the flag once it exists.
+    db = Xapian::WritableDatabase(path);
+    db.add_spelling("wibble");
+    db.add_spelling("\xc3\xa9t\xc3\xa9");
+    db.commit();
+    Xapian::Database rodb(path);
+    TEST_EQUAL(rodb.get_spelling_suggestion("wible"), "wibble");
+    TEST_EQUAL(rodb.get_spelling_suggestion("wbbile"), "wibble");
+    TEST_EQUAL(rodb.get_spelling_suggestion("qh"), "ch");
+    // Deletions remove whole UTF-8 characters.
+    TEST_EQUAL(rodb.get_spelling_suggestion("\xc3\xa9t"), "\xc3\xa9t\xc3\xa9");
+    TEST_EQUAL(rodb.get_spelling_suggestion("\xc3\xa9te"), "\xc3\xa9t\xc3\xa9");
+
+    return true;
+}
+
+/// Test compaction of spelling tables with a deletion index.
+DEFINE_TESTCASE(spelldeletes2, glass) {
+    Xapian::WritableDatabase db = get_named_writable_database("spelldeletes2");
+    const string path = get_named_writable_database_path("spelldeletes2");
+    db.close();
+    db = Xapian::WritableDatabase(path, Xapian::DB_SPELLING_DELETION_INDEX);
+    db.add_spelling("ch");
+    db.add_spelling("hello");
+    db.commit();
+
+    Xapian::WritableDatabase db2 =
+	get_named_writable_database("spelldeletes2b");
+    const string path2 = get_named_writable_database_path("spelldeletes2b");
+    db2.close();
+    db2 = Xapian::WritableDatabase(path2, Xapian::DB_SPELLING_DELETION_INDEX);
+    db2.add_spelling("ch");
+    db2.add_spelling("cell");
+    db2.commit();
+
+    Xapian::WritableDatabase db3 =
+	get_named_writable_database("spelldeletes2c");
+    db3.add_spelling("zig");
+    db3.commit();
+
+    // If every input has the index, so should the output.
+    const string out = get_named_writable_database_path("spelldeletes2out");
+    {
+	Xapian::Database in;
+	in.add_database(db);
+	in.add_database(db2);
+	in.compact(out);
+    }
+    Xapian::Database outdb(out);
+    TEST_EQUAL(outdb.get_spelling_suggestion("qh"), "ch");
+    TEST_EQUAL(outdb.get_spelling_suggestion("helo"), "hello");
+    TEST_EQUAL(outdb.get_spelling_suggestion("cel"), "cell");
+
+    // Otherwise the output shouldn't have an index (since it would be
+    // incomplete), but the spelling data should still be there.
+    const string out2 = get_named_writable_database_path("spelldeletes2out2");
+    {
+	Xapian::Database in;
+	in.add_database(db);
+	in.add_database(db3);
+	in.compact(out2);
+    }
+    Xapian::Database outdb2(out2);
+    TEST_EQUAL(outdb2.get_spelling_suggestion("qh"), "");
+    TEST_EQUAL(outdb2.get_spelling_suggestion("helo"), "hello");
+    TEST_EQUAL(outdb2.get_spelling_suggestion("zif"), "zig");
+
+    // A multi-database only uses the index if all subdatabases have one.
+    Xapian::Database multi;
+    multi.add_database(outdb);
+    multi.add_database(outdb2);
+    TEST_EQUAL(multi.get_spelling_suggestion("qh"), "");
+    TEST_EQUAL(multi.get_spelling_suggestion("zif"), "zig");
+    TEST_EQUAL(multi.get_spelling_suggestion("cel"), "cell");
+
+    return true;
+}
@@ -262,6 +262,9 @@ DEFINE_TESTCASE(valuestats3, valuestats) {
 
 DEFINE_TESTCASE(valuestats4, transactions && valuestats) {
     const size_t FLUSH_THRESHOLD = 10000;
+    // Glass flushes based on memory use by default, so ask for a flush after
+    // FLUSH_THRESHOLD changes.
+    ScopedEnvVar flush_threshold("XAPIAN_FLUSH_THRESHOLD", "10000");
     {
 	Xapian::WritableDatabase db_w = get_writable_database();
 	Xapian::Document doc;
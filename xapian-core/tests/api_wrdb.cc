@@ -43,6 +43,7 @@
 #include <cmath>
 #include <cstdlib>
 #include <map>
+#include <set>
 #include <string>
 
 using namespace std;
@@ -2045,3 +2046,348 @@ DEFINE_TESTCASE(modifyvalues1, writable) {
 
     return true;
 }
+
+/// Check add_documents() gives the same result as add_document().
+DEFINE_TESTCASE(adddocuments1, writable) {
+    vector<Xapian::Document> docs;
+    for (unsigned n = 1; n <= 300; ++n) {
+	Xapian::Document doc;
+	doc.set_data("doc " + str(n));
+	doc.add_value(n % 3, str(n));
+	for (unsigned t = 1; t <= 12; ++t) {
+	    if (n % t) continue;
+	    string term = "T" + str(t);
+	    if (t % 2) {
+		doc.add_term(term, n % 5 + 1);
+	    } else {
+		for (Xapian::termpos p = 1; p <= n % 7 + 1; ++p)
+		    doc.add_posting(term, p * t);
+	    }
+	}
+	docs.push_back(doc);
+    }
+    // Include an empty document.
+    docs.push_back(Xapian::Document());
+
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::WritableDatabase db_serial =
+	get_named_writable_database("adddocuments1_serial");
+    db.add_document(Xapian::Document());
+    db_serial.add_document(Xapian::Document());
+
+    TEST_EQUAL(db.add_documents(vector<Xapian::Document>(), 4), 0);
+    TEST_EQUAL(db.add_documents(docs, 4), 2);
+    for (const Xapian::Document & doc : docs) db_serial.add_document(doc);
+    db.commit();
+    db_serial.commit();
+
+    TEST_EQUAL(db.get_doccount(), db_serial.get_doccount());
+    TEST_EQUAL(db.get_lastdocid(), db_serial.get_lastdocid());
+    TEST_EQUAL(db.get_avlength(), db_serial.get_avlength());
+    for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+	Xapian::Document doc = db.get_document(did);
+	Xapian::Document doc_serial = db_serial.get_document(did);
+	TEST_EQUAL(doc.get_data(), doc_serial.get_data());
+	TEST_EQUAL(doc.serialise(), doc_serial.serialise());
+	TEST_EQUAL(db.get_doclength(did), db_serial.get_doclength(did));
+    }
+    for (unsigned t = 1; t <= 12; ++t) {
+	string term = "T" + str(t);
+	TEST_EQUAL(db.get_termfreq(term), db_serial.get_termfreq(term));
+	TEST_EQUAL(db.get_collection_freq(term),
+		   db_serial.get_collection_freq(term));
+	Xapian::PostingIterator p = db.postlist_begin(term);
+	Xapian::PostingIterator p_serial = db_serial.postlist_begin(term);
+	while (p != db.postlist_end(term)) {
+	    TEST(p_serial != db_serial.postlist_end(term));
+	    TEST_EQUAL(*p, *p_serial);
+	    TEST_EQUAL(p.get_wdf(), p_serial.get_wdf());
+	    Xapian::PositionIterator pos = db.positionlist_begin(*p, term);
+	    Xapian::PositionIterator pos_serial =
+		db_serial.positionlist_begin(*p, term);
+	    while (pos != db.positionlist_end(*p, term)) {
+		TEST_EQUAL(*pos, *pos_serial);
+		++pos;
+		++pos_serial;
+	    }
+	    TEST(pos_serial == db_serial.positionlist_end(*p, term));
+	    ++p;
+	    ++p_serial;
+	}
+	TEST(p_serial == db_serial.postlist_end(term));
+    }
+    return true;
+}
+
+/// Check add_documents() reports problems like add_document() does.
+DEFINE_TESTCASE(adddocuments2, writable) {
+    // Inmemory doesn't impose a limit on the term length.
+    SKIP_TEST_FOR_BACKEND("inmemory");
+
+    Xapian::WritableDatabase db = get_writable_database();
+    vector<Xapian::Document> docs(20);
+    for (unsigned n = 0; n != docs.size(); ++n) {
+	docs[n].add_term("T" + str(n));
+    }
+    docs[13].add_term(string(300, 'X'));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, db.add_documents(docs, 4));
+    // The uncommitted changes should have been discarded.
+    TEST_EQUAL(db.get_doccount(), 0);
+
+    docs[13] = Xapian::Document();
+    TEST_EQUAL(db.add_documents(docs, 4), 1);
+    db.commit();
+    TEST_EQUAL(db.get_doccount(), 20);
+    TEST_EQUAL(db.get_termfreq("T13"), 0);
+    TEST_EQUAL(db.get_termfreq("T19"), 1);
+    return true;
+}
+
+/// Check glass flushes when the buffered changes reach XAPIAN_FLUSH_MEMORY.
+DEFINE_TESTCASE(flushmemory1, glass) {
+    ScopedEnvVar flush_memory("XAPIAN_FLUSH_MEMORY", "1");
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Database db_r = get_writable_database_as_database();
+
+    // 500 documents with 500 terms each needs well over 1MB of buffered
+    // changes, but a long way short of the number of documents which would
+    // have triggered a flush before.
+    for (Xapian::docid did = 1; did <= 500; ++did) {
+	Xapian::Document doc;
+	for (unsigned t = 0; t != 500; ++t) {
+	    doc.add_term("T" + str((did + t) % 1000), did % 7 + 1);
+	}
+	db.add_document(doc);
+    }
+    TEST(db_r.reopen());
+    TEST_REL(db_r.get_doccount(),>,0);
+
+    // Replace documents in descending docid order, so the buffered changes
+    // for each term aren't in docid order.
+    for (Xapian::docid did = 500; did >= 1; --did) {
+	Xapian::Document doc;
+	doc.add_term("T" + str(did % 3), did);
+	doc.add_term("both", 2);
+	db.replace_document(did, doc);
+	if (did % 100 == 0) db.replace_document(did, doc);
+    }
+    db.commit();
+
+    TEST(db_r.reopen());
+    TEST_EQUAL(db_r.get_doccount(), 500);
+    TEST_EQUAL(db_r.get_termfreq("T5"), 0);
+    TEST_EQUAL(db_r.get_termfreq("both"), 500);
+    TEST_EQUAL(db_r.get_collection_freq("both"), 1000);
+    for (Xapian::docid r = 0; r != 3; ++r) {
+	string term = "T" + str(r);
+	Xapian::docid expected = r ? r : 3;
+	Xapian::PostingIterator p;
+	for (p = db_r.postlist_begin(term); p != db_r.postlist_end(term); ++p) {
+	    TEST_EQUAL(*p, expected);
+	    TEST_EQUAL(p.get_wdf(), expected);
+	    expected += 3;
+	}
+	TEST_REL(expected,>,500);
+    }
+    return true;
+}
+
+static void
+check_dense_postlist(const Xapian::Database & db, const string & term,
+		     const map<Xapian::docid, Xapian::termcount> & expected)
+{
+    TEST_EQUAL(db.get_termfreq(term), expected.size());
+    Xapian::termcount cf = 0;
+    map<Xapian::docid, Xapian::termcount>::const_iterator i = expected.begin();
+    Xapian::PostingIterator p;
+    for (p = db.postlist_begin(term); p != db.postlist_end(term); ++p) {
+	TEST(i != expected.end());
+	TEST_EQUAL(*p, i->first);
+	TEST_EQUAL(p.get_wdf(), i->second);
+	cf += i->second;
+	++i;
+    }
+    TEST(i == expected.end());
+    TEST_EQUAL(db.get_collection_freq(term), cf);
+
+    // Check skip_to() to every docid, and over increasing gaps.
+    for (Xapian::docid step = 1; step < 300; step = step * 3 + 1) {
+	p = db.postlist_begin(term);
+	Xapian::docid target = 1;
+	while (true) {
+	    p.skip_to(target);
+	    i = expected.lower_bound(target);
+	    if (i == expected.end()) {
+		TEST(p == db.postlist_end(term));
+		break;
+	    }
+	    TEST(p != db.postlist_end(term));
+	    TEST_EQUAL(*p, i->first);
+	    TEST_EQUAL(p.get_wdf(), i->second);
+	    target = *p + step;
+	}
+    }
+}
+
+/// Check dense postlists, which glass stores as bitmaps.
+DEFINE_TESTCASE(bitmappostings1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    map<Xapian::docid, Xapian::termcount> bool_docs, dense_docs, sparse_docs;
+    for (Xapian::docid did = 1; did <= 3000; ++did) {
+	Xapian::Document doc;
+	if (did % 5 != 0) {
+	    doc.add_boolean_term("XBOOL");
+	    bool_docs[did] = 0;
+	}
+	if (did % 3 == 0 || did % 7 == 0 || (did > 1000 && did < 1100)) {
+	    doc.add_term("dense", 2);
+	    dense_docs[did] = 2;
+	}
+	if (did % 97 == 0) {
+	    doc.add_term("sparse", did % 4 + 1);
+	    sparse_docs[did] = did % 4 + 1;
+	}
+	doc.add_term("all");
+	db.add_document(doc);
+    }
+    db.commit();
+    check_dense_postlist(db, "XBOOL", bool_docs);
+    check_dense_postlist(db, "dense", dense_docs);
+    check_dense_postlist(db, "sparse", sparse_docs);
+
+    // Delete documents, including the first and last ones, replace others
+    // so that the postlists change in the middle of chunks, and append more.
+    for (Xapian::docid did = 1; did <= 3000; did += 11) {
+	db.delete_document(did);
+	bool_docs.erase(did);
+	dense_docs.erase(did);
+	sparse_docs.erase(did);
+    }
+    db.delete_document(3000);
+    bool_docs.erase(3000);
+    dense_docs.erase(3000);
+    sparse_docs.erase(3000);
+    for (Xapian::docid did = 1500; did <= 2500; did += 13) {
+	Xapian::Document doc;
+	doc.add_term("dense", did % 2 + 1);
+	dense_docs[did] = did % 2 + 1;
+	bool_docs.erase(did);
+	sparse_docs.erase(did);
+	db.replace_document(did, doc);
+    }
+    for (Xapian::docid did = 3001; did <= 3500; ++did) {
+	Xapian::Document doc;
+	doc.add_boolean_term("XBOOL");
+	bool_docs[did] = 0;
+	db.replace_document(did, doc);
+    }
+    db.commit();
+    check_dense_postlist(db, "XBOOL", bool_docs);
+    check_dense_postlist(db, "dense", dense_docs);
+    check_dense_postlist(db, "sparse", sparse_docs);
+
+    // Check a boolean filter on a dense term matches the expected documents.
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+				Xapian::Query("dense"),
+				Xapian::Query("XBOOL")));
+    Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+    set<Xapian::docid> matches;
+    for (Xapian::MSetIterator m = mset.begin(); m != mset.end(); ++m) {
+	matches.insert(*m);
+    }
+    set<Xapian::docid> expected_matches;
+    map<Xapian::docid, Xapian::termcount>::const_iterator i;
+    for (i = dense_docs.begin(); i != dense_docs.end(); ++i) {
+	if (bool_docs.find(i->first) != bool_docs.end())
+	    expected_matches.insert(i->first);
+    }
+    TEST(matches == expected_matches);
+
+    return true;
+}
+
+/// Check postlists with varied gaps and wdfs, which glass stores packed.
+DEFINE_TESTCASE(packedpostings1, glass) {
+    Xapian::WritableDatabase db =
+	get_named_writable_database("packedpostings1");
+    map<Xapian::docid, Xapian::termcount> common_docs, wide_docs, rare_docs;
+    for (Xapian::docid did = 1; did <= 3000; ++did) {
+	Xapian::Document doc;
+	if (did % 4 != 1) {
+	    doc.add_term("common", did % 37 + 1);
+	    common_docs[did] = did % 37 + 1;
+	}
+	if (did % 3 == 0 || did % 100 < 5) {
+	    // Large wdfs need more bits, and the occasional huge one much more.
+	    Xapian::termcount wdf = (did % 1000 == 0) ? 1000000 : did;
+	    doc.add_term("wide", wdf);
+	    wide_docs[did] = wdf;
+	}
+	if (did % 211 == 0 || did == 1 || did == 1234) {
+	    doc.add_term("rare", 2);
+	    rare_docs[did] = 2;
+	}
+	doc.add_term("all");
+	db.add_document(doc);
+    }
+    db.commit();
+    check_dense_postlist(db, "common", common_docs);
+    check_dense_postlist(db, "wide", wide_docs);
+    check_dense_postlist(db, "rare", rare_docs);
+
+    // Delete documents, replace others so the postlists change in the middle
+    // of blocks, and append more.
+    for (Xapian::docid did = 2; did <= 3000; did += 17) {
+	db.delete_document(did);
+	common_docs.erase(did);
+	wide_docs.erase(did);
+	rare_docs.erase(did);
+    }
+    for (Xapian::docid did = 1000; did <= 2000; did += 9) {
+	Xapian::Document doc;
+	doc.add_term("common", 50);
+	common_docs[did] = 50;
+	wide_docs.erase(did);
+	rare_docs.erase(did);
+	db.replace_document(did, doc);
+    }
+    for (Xapian::docid did = 3001; did <= 3300; ++did) {
+	Xapian::Document doc;
+	doc.add_term("wide", did * 7);
+	wide_docs[did] = did * 7;
+	db.replace_document(did, doc);
+    }
+    db.commit();
+    check_dense_postlist(db, "common", common_docs);
+    check_dense_postlist(db, "wide", wide_docs);
+    check_dense_postlist(db, "rare", rare_docs);
+
+    string path = get_named_writable_database_path("packedpostings1");
+    TEST_EQUAL(Xapian::Database::check(path, 0, &tout), 0);
+
+    // The blocks are copied as they are by compaction.
+    string outpath = get_named_writable_database_path("packedpostings1out");
+    rm_rf(outpath);
+    db.compact(outpath);
+    Xapian::Database outdb(outpath);
+    check_dense_postlist(outdb, "common", common_docs);
+    check_dense_postlist(outdb, "wide", wide_docs);
+    TEST_EQUAL(Xapian::Database::check(outpath, 0, &tout), 0);
+
+    // Check a weighted search which can skip entries gives the same top
+    // documents as one which can't.
+    Xapian::Enquire enq(outdb);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				Xapian::Query("common"),
+				Xapian::Query("wide")));
+    Xapian::MSet top = enq.get_mset(0, 10);
+    Xapian::MSet all = enq.get_mset(0, outdb.get_doccount());
+    TEST_EQUAL(top.size(), 10);
+    for (Xapian::doccount r = 0; r != top.size(); ++r) {
+	TEST_EQUAL(*top[r], *all[r]);
+	TEST_EQUAL_DOUBLE(top[r].get_weight(), all[r].get_weight());
+    }
+
+    return true;
+}
@@ -33,9 +33,12 @@
 
 #include <xapian.h>
 
+#include <list>
 #include <string>
 #include <vector>
 
+#include <stdlib.h> // For setenv() or putenv()
+
 using namespace std;
 
 std::string get_dbtype()
@@ -136,6 +139,22 @@ skip_test_for_backend(const std::string & backend_prefix)
     }
 }
 
+void
+set_env_var(const char * var, const char * value)
+{
+#ifdef HAVE__PUTENV_S
+    _putenv_s(var, value);
+#elif defined HAVE_SETENV
+    setenv(var, value, 1);
+#else
+    // putenv() keeps a pointer to the string passed rather than copying it,
+    // so each setting needs to remain valid.
+    static list<string> settings;
+    settings.push_back(string(var) + '=' + value);
+    putenv(const_cast<char*>(settings.back().c_str()));
+#endif
+}
+
 class ApiTestRunner : public TestRunner
 {
   public:
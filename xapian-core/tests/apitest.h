@@ -72,4 +72,33 @@ void skip_test_for_backend(const std::string & backend_prefix);
 #define SKIP_TEST_UNLESS_BACKEND(B) skip_test_unless_backend(B)
 #define SKIP_TEST_FOR_BACKEND(B) skip_test_for_backend(B)
 
+/** Set environment variable @a var to @a value.
+ *
+ *  Used to set tuning parameters which the library reads from the
+ *  environment, such as XAPIAN_FLUSH_THRESHOLD.
+ */
+void set_env_var(const char * var, const char * value);
+
+/** Set an environment variable, and reset it to "0" when going out of scope.
+ *
+ *  This ensures we don't leave a setting in place for the next testcase,
+ *  even if this one exits with an exception.
+ */
+class ScopedEnvVar {
+    /// Don't allow copying.
+    ScopedEnvVar(const ScopedEnvVar &);
+
+    /// Don't allow assignment.
+    void operator=(const ScopedEnvVar &);
+
+    const char * var;
+
+  public:
+    ScopedEnvVar(const char * var_, const char * value) : var(var_) {
+	set_env_var(var, value);
+    }
+
+    ~ScopedEnvVar() { set_env_var(var, "0"); }
+};
+
 #endif // XAPIAN_INCLUDED_APITEST_H
@@ -1102,6 +1102,62 @@ static bool test_qp_flag_wildcard3()
 #endif
 }
 
+// Test wildcards anywhere in a term.
+static bool test_qp_flag_wildcard4()
+{
+#ifndef XAPIAN_HAS_INMEMORY_BACKEND
+    SKIP_TEST("Testcase requires the InMemory backend which is disabled");
+#else
+    Xapian::WritableDatabase db(Xapian::InMemory::open());
+    Xapian::Document doc;
+    doc.add_term("biology");
+    doc.add_term("woman");
+    db.add_document(doc);
+    doc.clear_terms();
+    doc.add_term("geology");
+    doc.add_term("women");
+    db.add_document(doc);
+    doc.clear_terms();
+    doc.add_term("information");
+    doc.add_term("Aheinlein");
+    db.add_document(doc);
+    Xapian::QueryParser qp;
+    qp.add_prefix("author", "A");
+    const unsigned glob = Xapian::QueryParser::FLAG_WILDCARD_GLOB;
+    const unsigned multi = Xapian::QueryParser::FLAG_WILDCARD_MULTI;
+    Xapian::Query qobj = qp.parse_query("*ology", glob);
+    TEST_STRINGS_EQUAL(qobj.get_description(), "Query((SYNONYM WILDCARD OR *ology))");
+    qobj = qp.parse_query("In*tion wom?n", glob);
+    TEST_STRINGS_EQUAL(qobj.get_description(), "Query(((SYNONYM WILDCARD OR in*tion) OR (SYNONYM WILDCARD OR wom?n)))");
+    qobj = qp.parse_query("author:*lein", glob);
+    TEST_STRINGS_EQUAL(qobj.get_description(), "Query((SYNONYM WILDCARD OR A*lein))");
+    // Without FLAG_WILDCARD_SINGLE, '?' isn't special.
+    qobj = qp.parse_query("wom?n", multi);
+    TEST_STRINGS_EQUAL(qobj.get_description(), "Query((wom@1 OR n@2))");
+    // A trailing '*' with FLAG_WILDCARD needs to be part of the pattern.
+    qobj = qp.parse_query("bio*", Xapian::QueryParser::FLAG_WILDCARD | glob);
+    TEST_STRINGS_EQUAL(qobj.get_description(), "Query((SYNONYM WILDCARD OR bio*))");
+    // '*' on its own isn't a wildcard.
+    qobj = qp.parse_query("* biology", glob);
+    TEST_STRINGS_EQUAL(qobj.get_description(), "Query(biology@1)");
+
+    Xapian::Enquire enq(db);
+    enq.set_query(qp.parse_query("*ology", glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+    enq.set_query(qp.parse_query("wom?n", glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+    enq.set_query(qp.parse_query("wom?n", Xapian::QueryParser::FLAG_WILDCARD_SINGLE));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 2);
+    enq.set_query(qp.parse_query("g*y", glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    enq.set_query(qp.parse_query("bio*", Xapian::QueryParser::FLAG_WILDCARD | glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    enq.set_query(qp.parse_query("author:*lein", glob));
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+    return true;
+#endif
+}
+
 // Test partial queries.
 static bool test_qp_flag_partial1()
 {
@@ -2707,6 +2763,7 @@ static const test_desc tests[] = {
     TESTCASE(qp_flag_wildcard1),
     TESTCASE(qp_flag_wildcard2),
     TESTCASE(qp_flag_wildcard3),
+    TESTCASE(qp_flag_wildcard4),
     TESTCASE(qp_flag_partial1),
     TESTCASE(qp_flag_bool_any_case1),
     TESTCASE(qp_stopper1),
@@ -842,12 +842,67 @@ static bool test_tg_max_word_length1()
     return true;
 }
 
+/// Test FLAG_PHRASE_BIGRAMS.
+static bool test_tg_phrase_bigrams1()
+{
+    Xapian::TermGenerator termgen;
+    termgen.set_flags(Xapian::TermGenerator::FLAG_PHRASE_BIGRAMS);
+
+    Xapian::Document doc;
+    termgen.set_document(doc);
+
+    // Without a stopper, every pair of adjacent words is indexed (including
+    // words from separate calls) under a reserved prefix, along with a
+    // marker term.
+    termgen.index_text("red fish");
+    termgen.index_text("blue fish", 1, "XT");
+    termgen.index_text_without_positions("one two");
+    TEST_STRINGS_EQUAL(format_doc_termlist(doc),
+		       "XTblue[3] XTfish[4] fish[2] one:1 red[1] two:1 "
+		       "\xff \xff" "XTblue XTfish \xff" "fish XTblue "
+		       "\xff" "red fish");
+
+    // With a stopper, only pairs including a stopword are indexed.
+    Xapian::SimpleStopper stopper;
+    stopper.add("of");
+    stopper.add("the");
+    termgen.set_stopper(&stopper);
+    termgen.set_stemmer(Xapian::Stem("en"));
+    doc = Xapian::Document();
+    termgen.set_document(doc);
+    termgen.index_text("The cat of the hats sat");
+    TEST_STRINGS_EQUAL(format_doc_termlist(doc),
+		       "Zcat:1 Zhat:1 Zsat:1 cat[2] hats[5] of[3] sat[6] "
+		       "the[1,4] \xff \xff" "cat of \xff" "of the "
+		       "\xff" "the cat \xff" "the hats");
+
+    // With STEM_ALL, the pairs are formed from the stemmed terms.
+    termgen.set_stemming_strategy(termgen.STEM_ALL);
+    doc = Xapian::Document();
+    termgen.set_document(doc);
+    termgen.index_text("the hats sat");
+    TEST_STRINGS_EQUAL(format_doc_termlist(doc),
+		       "hat[2] sat[3] the[1] \xff \xff" "the hat");
+
+    // The stopper is checked against the stemmed form too, so "hats" pairs
+    // up just like "hat" does.
+    stopper.add("hat");
+    doc = Xapian::Document();
+    termgen.set_document(doc);
+    termgen.index_text("hats sat hat");
+    TEST_STRINGS_EQUAL(format_doc_termlist(doc),
+		       "hat[1,3] sat[2] \xff \xff" "hat sat \xff" "sat hat");
+
+    return true;
+}
+
 /// Test cases for the TermGenerator.
 static const test_desc tests[] = {
     TESTCASE(termgen1),
     TESTCASE(tg_spell1),
     TESTCASE(tg_spell2),
     TESTCASE(tg_max_word_length1),
+    TESTCASE(tg_phrase_bigrams1),
     END_OF_TESTCASES
 };
 
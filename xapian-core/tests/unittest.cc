@@ -23,6 +23,7 @@
 #include <config.h>
 
 #include <cfloat>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
@@ -55,6 +56,10 @@ using namespace std;
 #include "../net/serialise-error.cc"
 #include "../api/error.cc"
 #include "../api/sortable-serialise.cc"
+#include "../api/editdistance.cc"
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+#include "../backends/glass/glass_blockcache.cc"
+#endif
 
 // Stub replacement, which doesn't deal with escaping or producing valid UTF-8.
 // The full implementation needs Xapian::Utf8Iterator and
@@ -527,6 +532,156 @@ static bool test_strbool1()
     return true;
 }
 
+/// Simple dynamic programming version of the edit distance to check against.
+static int
+reference_edit_distance(const vector<unsigned> & a, const vector<unsigned> & b)
+{
+    vector<vector<int>> d(a.size() + 1, vector<int>(b.size() + 1));
+    for (size_t i = 0; i <= a.size(); ++i) d[i][0] = int(i);
+    for (size_t j = 0; j <= b.size(); ++j) d[0][j] = int(j);
+    for (size_t i = 1; i <= a.size(); ++i) {
+	for (size_t j = 1; j <= b.size(); ++j) {
+	    int cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+	    d[i][j] = min(d[i - 1][j - 1] + cost,
+			  min(d[i - 1][j], d[i][j - 1]) + 1);
+	    if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+		d[i][j] = min(d[i][j], d[i - 2][j - 2] + 1);
+	}
+    }
+    return d[a.size()][b.size()];
+}
+
+/// Check the bit-parallel and banded edit distance calculations.
+static bool test_editdistance1()
+{
+    // Use a small alphabet so that matches and transpositions are common,
+    // and include characters which aren't in the low table.
+    static const unsigned alphabet[] = { 'a', 'b', 'c', 0xe9, 0x263a };
+    srand(42);
+    for (int n = 0; n != 2000; ++n) {
+	// Exercise both sides of the switch to banded calculation at 64.
+	size_t len = rand() % 80;
+	vector<unsigned> a, b;
+	for (size_t i = 0; i != len; ++i)
+	    a.push_back(alphabet[rand() % 5]);
+	// Make b by applying a few random edits to a.
+	b = a;
+	int edits = rand() % 6;
+	for (int e = 0; e != edits; ++e) {
+	    size_t pos = b.empty() ? 0 : rand() % b.size();
+	    switch (rand() % 4) {
+		case 0:
+		    b.insert(b.begin() + pos, alphabet[rand() % 5]);
+		    break;
+		case 1:
+		    if (!b.empty()) b.erase(b.begin() + pos);
+		    break;
+		case 2:
+		    if (!b.empty()) b[pos] = alphabet[rand() % 5];
+		    break;
+		case 3:
+		    if (pos + 1 < b.size()) swap(b[pos], b[pos + 1]);
+		    break;
+	    }
+	}
+	int expect = reference_edit_distance(a, b);
+	EditDistanceCalculator edcalc(a.data(), int(a.size()));
+	for (int k = 0; k != 6; ++k) {
+	    int result = edcalc(b.data(), int(b.size()), k);
+	    if (expect <= k) {
+		TEST_EQUAL(result, expect);
+	    } else {
+		TEST_REL(result,>,k);
+	    }
+	    result = edit_distance_unsigned(a.data(), int(a.size()),
+					    b.data(), int(b.size()), k);
+	    if (expect <= k) {
+		TEST_EQUAL(result, expect);
+	    } else {
+		TEST_REL(result,>,k);
+	    }
+	}
+    }
+    return true;
+}
+
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+// Check GlassBlockCache hit/miss accounting and LRU eviction.
+static bool test_glassblockcache1()
+{
+    const unsigned block_size = 2048;
+    GlassBlockCache cache(3 * block_size);
+    TEST(cache.enabled());
+
+    byte block[block_size];
+    byte out[block_size];
+    GlassBlockKey key;
+    key.ino = 42;
+    for (uint4 n = 0; n != 3; ++n) {
+	key.n = n;
+	memset(block, 'a' + n, block_size);
+	setint4(block, 0, 7);
+	TEST_EQUAL(cache.get(key, 7, out, block_size), GlassBlockCache::MISS);
+	cache.add(key, 7, block, block_size);
+    }
+    TEST_EQUAL(cache.get_misses(), 3);
+    TEST_EQUAL(cache.get_size(), 3 * block_size);
+
+    // Block 0 is now most recently used, so adding a fourth block should
+    // evict block 1.
+    key.n = 0;
+    TEST_EQUAL(cache.get(key, 7, out, block_size), GlassBlockCache::HIT);
+    TEST_EQUAL(out[4], 'a');
+    TEST_EQUAL(out[block_size - 1], 'a');
+    key.n = 3;
+    memset(block, 'd', block_size);
+    setint4(block, 0, 7);
+    cache.add(key, 7, block, block_size);
+    TEST_EQUAL(cache.get_size(), 3 * block_size);
+    key.n = 1;
+    TEST_EQUAL(cache.get(key, 7, out, block_size), GlassBlockCache::MISS);
+    key.n = 2;
+    TEST_EQUAL(cache.get(key, 7, out, block_size), GlassBlockCache::HIT);
+    TEST_EQUAL(out[4], 'c');
+    TEST_EQUAL(cache.get_hits(), 2);
+    TEST_EQUAL(cache.get_misses(), 4);
+
+    // A reader of an earlier revision can use the cached block.
+    TEST_EQUAL(cache.get(key, 5, out, block_size), GlassBlockCache::HIT);
+
+    // A reader of a later revision needs to check the block is unchanged,
+    // after which other readers of that revision can use it directly.
+    TEST_EQUAL(cache.get(key, 9, out, block_size), GlassBlockCache::CHECK);
+    TEST(cache.revalidate(key, 9, 7, out, block_size));
+    TEST_EQUAL(out[4], 'c');
+    TEST_EQUAL(cache.get(key, 9, out, block_size), GlassBlockCache::HIT);
+    TEST_EQUAL(cache.get_hits(), 5);
+
+    // If the block has been reused, the cached copy is discarded.
+    TEST_EQUAL(cache.get(key, 10, out, block_size), GlassBlockCache::CHECK);
+    TEST(!cache.revalidate(key, 10, 10, out, block_size));
+    TEST_EQUAL(cache.get(key, 10, out, block_size), GlassBlockCache::MISS);
+    TEST_EQUAL(cache.get_size(), 2 * block_size);
+    TEST_EQUAL(cache.get_misses(), 6);
+
+    cache.set_max_size(block_size);
+    TEST_EQUAL(cache.get_size(), block_size);
+    TEST_EQUAL(cache.get_max_size(), block_size);
+
+    cache.clear();
+    TEST_EQUAL(cache.get_size(), 0);
+    TEST_EQUAL(cache.get_hits(), 0);
+    TEST_EQUAL(cache.get_misses(), 0);
+
+    cache.set_max_size(0);
+    TEST(!cache.enabled());
+    key.n = 0;
+    cache.add(key, 7, block, block_size);
+    TEST_EQUAL(cache.get_size(), 0);
+    return true;
+}
+#endif
+
 static const test_desc tests[] = {
     TESTCASE(simple_exceptions_work1),
     TESTCASE(class_exceptions_work1),
@@ -541,6 +696,10 @@ static const test_desc tests[] = {
     TESTCASE(sortableserialise1),
     TESTCASE(tostring1),
     TESTCASE(strbool1),
+    TESTCASE(editdistance1),
+#ifdef XAPIAN_HAS_GLASS_BACKEND
+    TESTCASE(glassblockcache1),
+#endif
     END_OF_TESTCASES
 };
 
@@ -119,6 +119,49 @@ Weight::Internal::accumulate_stats(const Xapian::Database::Internal &subdb,
     }
 }
 
+void
+Weight::Internal::cache_bounds()
+{
+    if (have_cached_bounds) return;
+    cached_doclength_upper_bound = db.get_doclength_upper_bound();
+    cached_doclength_lower_bound = db.get_doclength_lower_bound();
+    map<string, TermFreqs>::const_iterator i;
+    for (i = termfreqs.begin(); i != termfreqs.end(); ++i) {
+	cached_wdf_upper_bounds[i->first] = db.get_wdf_upper_bound(i->first);
+    }
+    have_cached_bounds = true;
+}
+
+double
+Weight::Internal::get_maxpart_for_wdf(const Xapian::Weight & wt,
+				      double factor,
+				      Xapian::termcount wdf_max,
+				      Xapian::Weight *& bound_wt)
+{
+    if (!(wt.stats_needed & WDF_MAX) || wdf_max >= wt.wdf_upper_bound_)
+	return wt.get_maxpart();
+
+    if (!bound_wt) {
+	// clone() only copies the parameters of the weighting scheme, so copy
+	// the statistics which init_() set too.
+	bound_wt = wt.clone();
+	bound_wt->collection_size_ = wt.collection_size_;
+	bound_wt->rset_size_ = wt.rset_size_;
+	bound_wt->average_length_ = wt.average_length_;
+	bound_wt->termfreq_ = wt.termfreq_;
+	bound_wt->collectionfreq_ = wt.collectionfreq_;
+	bound_wt->reltermfreq_ = wt.reltermfreq_;
+	bound_wt->query_length_ = wt.query_length_;
+	bound_wt->wqf_ = wt.wqf_;
+	bound_wt->doclength_lower_bound_ = wt.doclength_lower_bound_;
+	bound_wt->doclength_upper_bound_ = wt.doclength_upper_bound_;
+    }
+    // Schemes may calculate their bounds in init(), so rerun it.
+    bound_wt->wdf_upper_bound_ = wdf_max;
+    bound_wt->init(factor);
+    return bound_wt->get_maxpart();
+}
+
 string
 Weight::Internal::get_description() const
 {
@@ -101,6 +101,18 @@ class Weight::Internal {
     /** Database to get the bounds on doclength and wdf from. */
     Xapian::Database db;
 
+    /** Have the bounds been looked up by cache_bounds()? */
+    bool have_cached_bounds;
+
+    /** Upper bound on document length, if have_cached_bounds. */
+    Xapian::termcount cached_doclength_upper_bound;
+
+    /** Lower bound on document length, if have_cached_bounds. */
+    Xapian::termcount cached_doclength_lower_bound;
+
+    /** Upper bound on wdf for each term, if have_cached_bounds. */
+    std::map<std::string, Xapian::termcount> cached_wdf_upper_bounds;
+
     /** The query. */
     Xapian::Query query;
 
@@ -114,7 +126,8 @@ class Weight::Internal {
 	  subdbs(0), finalised(false),
 #endif
 	  total_length(0), collection_size(0), rset_size(0),
-	  total_term_count(0), have_max_part(false) { }
+	  total_term_count(0), have_max_part(false),
+	  have_cached_bounds(false) { }
 
     /** Add in the supplied statistics from a sub-database.
      *
@@ -243,6 +256,55 @@ class Weight::Internal {
 	db = db_;
     }
 
+    /** Look up the bounds from db now, for all the terms in termfreqs.
+     *
+     *  After this, the get_*_bound() methods don't need to access db, so a
+     *  copy of this object can be used by a thread which mustn't touch the
+     *  other sub-databases.
+     */
+    void cache_bounds();
+
+    /// Upper bound on document length.
+    Xapian::termcount get_doclength_upper_bound() const {
+	if (have_cached_bounds) return cached_doclength_upper_bound;
+	return db.get_doclength_upper_bound();
+    }
+
+    /// Lower bound on document length.
+    Xapian::termcount get_doclength_lower_bound() const {
+	if (have_cached_bounds) return cached_doclength_lower_bound;
+	return db.get_doclength_lower_bound();
+    }
+
+    /// Upper bound on the wdf of @a term.
+    Xapian::termcount get_wdf_upper_bound(const std::string & term) const {
+	if (have_cached_bounds) {
+	    auto i = cached_wdf_upper_bounds.find(term);
+	    if (i != cached_wdf_upper_bounds.end()) return i->second;
+	}
+	return db.get_wdf_upper_bound(term);
+    }
+
+    /** Return an upper bound on the weight @a wt gives a document in
+     *  which the wdf is at most @a wdf_max.
+     *
+     *  This is found by calling get_maxpart() on a copy of @a wt with the
+     *  same statistics, but the upper bound on the wdf reduced to
+     *  @a wdf_max, so it is no larger than @a wt.get_maxpart().
+     *
+     *  @param wt	The initialised weighting object.
+     *  @param factor	The factor @a wt was initialised with.
+     *  @param wdf_max	Upper bound on the wdf.
+     *  @param bound_wt	The copy of @a wt to use.  If NULL, a copy is
+     *			created and stored here, which the caller must
+     *			delete, and which can be reused by later calls for
+     *			the same @a wt.
+     */
+    static double get_maxpart_for_wdf(const Xapian::Weight & wt,
+				      double factor,
+				      Xapian::termcount wdf_max,
+				      Xapian::Weight *& bound_wt);
+
     /// Return a std::string describing this object.
     std::string get_description() const;
 };